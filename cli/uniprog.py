@@ -9,12 +9,17 @@ import struct
 import sys
 import argparse
 import time
-from typing import Optional, Tuple, List
+from typing import Callable, Optional, Tuple, List
 
 # OPUP Protocol Constants
 OPUP_SOF = 0xA5
 OPUP_FLAG_RESP = 0x01
 OPUP_FLAG_ERROR = 0x02
+OPUP_FLAG_ASYNC = 0x04
+
+# Status byte of ASYNC event frames
+JOB_STATUS_NAMES = {0: "ok", 1: "failed", 2: "timeout", 3: "aborted"}
+JOB_EVENT_DATA = 0x10  # [JobId][0x10][Offset:4][Data:N]
 
 # OPUP Commands
 class OpupCmd:
@@ -22,29 +27,131 @@ class OpupCmd:
     SYS_GET_CAPS = 0x02
     SYS_GET_STATUS = 0x03
     SYS_RESET = 0x04
+    JOB_STATUS = 0x06
+    JOB_ABORT = 0x07
     SYS_GPIO_TEST = 0x05  # Debug: Read GPIO states
     
     I2C_SCAN = 0x10
     I2C_READ = 0x11
     I2C_WRITE = 0x12
+    I2C_EEPROM_WRITE = 0x13
+    I2C_WRITE_READ = 0x14
+    I2C_SET_SPEED = 0x15
+    I2C_BATCH = 0x16
+    I2C_SET_ENGINE = 0x17
     
     SPI_SCAN = 0x20
     SPI_CONFIG = 0x21
     SPI_XFER = 0x22
+    SPI_XFER_EX = 0x23
+    SPI_AUTOTUNE = 0x24
     
     QSPI_SET_MODE = 0x25
     QSPI_READ = 0x26
     QSPI_WRITE = 0x27
     QSPI_FAST_READ = 0x28
     QSPI_CMD = 0x29
+    QSPI_STATS = 0x2A
+    QSPI_AUTOTUNE = 0x2B
+    QSPI_PROBE_MODES = 0x2C
     
     ISP_ENTER = 0x30
     ISP_XFER = 0x31
     ISP_EXIT = 0x32
+    ISP_PROGRAM_PAGE = 0x33
+    ISP_READ_MEMORY = 0x34
+    ISP_VERIFY_MEMORY = 0x35
+    
+    UPDI_ENTER = 0x38
+    UPDI_EXIT = 0x39
+    UPDI_READ = 0x3A
+    UPDI_PROGRAM = 0x3B
+    UPDI_CHIP_ERASE = 0x3C
     
     SWD_INIT = 0x40
     SWD_READ = 0x41
     SWD_WRITE = 0x42
+    SWD_MEM_READ = 0x43
+    SWD_MEM_WRITE = 0x44
+    STM32_FLASH_BEGIN = 0x45
+    STM32_FLASH_WRITE = 0x46
+    STM32_FLASH_END = 0x47
+    
+    FLASH_PATCH = 0x60
+    FLASH_PROGRAM = 0x61
+    FLASH_CONFIG = 0x62
+    FLASH_ERASE = 0x63
+    FLASH_GANG_CONFIG = 0x64
+    FLASH_GANG_ERASE = 0x65
+    FLASH_GANG_PROGRAM = 0x66
+    FLASH_GANG_VERIFY = 0x67
+    
+    NAND_INFO = 0x70
+    NAND_READ = 0x71
+    NAND_PROGRAM = 0x72
+    NAND_ERASE = 0x73
+    NAND_BBT = 0x74
+    NAND_STATS = 0x75
+
+# Largest frame payload accepted by the firmware
+OPUP_MAX_PAYLOAD = 4096
+
+# Addresses at or above 16MB need 4-byte addressing
+FLASH_3B_LIMIT = 0x1000000
+
+# Largest FLASH_PROGRAM data block (15 pages, fits OPUP_MAX_PAYLOAD with header)
+FLASH_PROGRAM_CHUNK = 15 * 256
+
+# I2C_EEPROM_WRITE flags and status codes
+I2C_EEPROM_VERIFY = 0x01  # Read every page back after its write cycle
+I2C_EEPROM_CHUNK = 2048  # Data bytes per frame
+I2C_READ_CHUNK = 4096  # I2C_WRITE_READ bytes per frame
+I2C_EEPROM_STATUS = {0: "ok", 1: "NAK", 2: "write cycle timeout", 3: "verify failed"}
+
+# ISP_PROGRAM_PAGE
+ISP_PROGRAM_SKIP_BLANK = 0x01  # Skip all-0xFF pages (chip erased)
+ISP_PROGRAM_HEADER = 7  # [Flags][PageSize:2][Addr:4]
+
+# ISP_READ_MEMORY / ISP_VERIFY_MEMORY memory types
+AVR_MEMORY = {'flash': 0, 'eeprom': 1, 'fuses': 2, 'lock': 3, 'signature': 4}
+
+# UPDI_ENTER status / UPDI_PROGRAM flags
+UPDI_ENTER_STATUS = {0: "ok", 1: "no UPDI link", 2: "locked (chip erase required)",
+                     3: "NVMPROG key refused"}
+UPDI_FLASH_BASE = {1: 0x8000, 2: 0x800000}  # tinyAVR 0/1/2, AVR Dx (megaAVR 0: 0x4000)
+UPDI_PROGRAM_SKIP_BLANK = 0x01
+UPDI_PROGRAM_EEPROM = 0x02
+UPDI_PROGRAM_ERASE = 0x04
+
+# STM32_FLASH_BEGIN status / flags
+STM32_FLASH_STATUS = {0: "ok", 1: "core did not halt", 2: "unsupported device",
+                      3: "flash did not unlock", 4: "mass erase failed",
+                      5: "SWD error while loading the stub",
+                      6: "SWD not initialised"}
+STM32_FLASH_MASS_ERASE = 0x01
+STM32_FLASH_BASE = 0x08000000
+
+# NAND_READ flags
+NAND_READ_RAW = 0x01  # Physical pages, bad blocks not skipped
+NAND_READ_SPARE = 0x02  # Append the spare area to each page
+
+# NAND_PROGRAM status
+NAND_PROGRAM_BLANK = 1  # All-0xFF page skipped
+NAND_PROGRAM_RETRY = 2  # Block retired, resend it from its first page
+
+# I2C_BATCH
+I2C_BATCH_CONTINUE = 0x01  # Run the remaining ops after a failure
+I2C_BATCH_STATUS = {0: "ok", 1: "NAK", 2: "timeout", 3: "skipped"}
+
+# SPI_XFER_EX flags
+SPI_XFER_TX_ONLY = 0x01  # Discard RX, empty response
+SPI_XFER_RX_FILL = 0x02  # [Len:2][Fill:1] instead of TX data
+SPI_XFER_CS_KEEP = 0x04  # Leave CS asserted for the next frame
+SPI_XFER_CS_RELEASE = 0x08  # End a held transaction before this frame
+SPI_XFER_CHUNK = 4096  # Largest RX_FILL frame
+
+# Per-chip status codes of the FLASH_GANG_* commands
+GANG_STATUS = {0: "ok", 1: "skipped", 2: "WEL failed", 3: "timeout", 4: "mismatch"}
 
 # CRC32 Table (same as in protocol)
 CRC32_TABLE = []
@@ -66,6 +173,59 @@ def calculate_crc32(data: bytes) -> int:
         crc = CRC32_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8)
     return crc ^ 0xFFFFFFFF
 
+class I2CBatch:
+    """Op list for I2C_BATCH (one frame, executed back-to-back on the device)"""
+    
+    def __init__(self):
+        self.ops = bytearray()
+        self.read_lens: List[int] = []  # Response bytes of each op
+    
+    def _add(self, op: bytes, read_len: int = 0) -> 'I2CBatch':
+        self.ops += op
+        self.read_lens.append(read_len)
+        return self
+    
+    def write(self, addr: int, data: bytes) -> 'I2CBatch':
+        return self._add(bytes([0x00, addr, len(data)]) + data)
+    
+    def read(self, addr: int, length: int) -> 'I2CBatch':
+        return self._add(struct.pack('<BBH', 0x01, addr, length), length)
+    
+    def write_read(self, addr: int, data: bytes, length: int) -> 'I2CBatch':
+        return self._add(bytes([0x02, addr, len(data)]) + data + struct.pack('<H', length), length)
+    
+    def delay(self, us: int) -> 'I2CBatch':
+        return self._add(struct.pack('<BI', 0x03, us))
+    
+    def poll(self, addr: int, data: bytes, mask: int, value: int, timeout_ms: int = 100) -> 'I2CBatch':
+        return self._add(bytes([0x04, addr, len(data)]) + data +
+                         struct.pack('<BBH', mask, value, timeout_ms), 1)
+    
+    @staticmethod
+    def parse(tokens: List[str]) -> 'I2CBatch':
+        """Ops from CLI tokens: w:ADDR:HEX r:ADDR:LEN wr:ADDR:HEX:LEN d:US
+        p:ADDR:HEX:MASK:VALUE[:TIMEOUT_MS] (numbers in hex except LEN/US/TIMEOUT)"""
+        batch = I2CBatch()
+        for tok in tokens:
+            f = tok.split(':')
+            kind = f[0].lower()
+            if kind == 'd':
+                batch.delay(int(f[1], 0))
+                continue
+            addr = int(f[1], 16)
+            if kind == 'w':
+                batch.write(addr, bytes.fromhex(f[2]))
+            elif kind == 'r':
+                batch.read(addr, int(f[2], 0))
+            elif kind == 'wr':
+                batch.write_read(addr, bytes.fromhex(f[2]), int(f[3], 0))
+            elif kind == 'p':
+                batch.poll(addr, bytes.fromhex(f[2]), int(f[3], 16), int(f[4], 16),
+                           int(f[5], 0) if len(f) > 5 else 100)
+            else:
+                raise ValueError(f"unknown I2C op '{tok}'")
+        return batch
+
 class OPUPClient:
     def __init__(self, port: str, baudrate: int = 115200, timeout: float = 2.0):
         self.port = port
@@ -73,6 +233,9 @@ class OPUPClient:
         self.timeout = timeout
         self.serial: Optional[serial.Serial] = None
         self.seq = 0
+        self.last_write_stats = {}
+        self.events: List[bytes] = []  # Unclaimed ASYNC completion events
+        self.last_erase_ms = 0
         init_crc32_table()
     
     def connect(self):
@@ -98,11 +261,20 @@ class OPUPClient:
             self.serial.close()
             self.serial = None
     
-    def send_command(self, cmd: int, payload: bytes = b'') -> Tuple[bool, bytes]:
+    def send_command(self, cmd: int, payload: bytes = b'',
+                     timeout: Optional[float] = None, flags: int = 0) -> Tuple[bool, bytes]:
         """Send OPUP command and receive response"""
         if not self.serial:
             return False, b''
         
+        # Long device-side operations (erase) may need a longer wait
+        if timeout is not None and timeout > self.timeout:
+            self.serial.timeout = timeout
+            try:
+                return self.send_command(cmd, payload, flags=flags)
+            finally:
+                self.serial.timeout = self.timeout
+        
         self.seq = (self.seq + 1) & 0xFF
         
         # Build packet: SOF + SEQ + CMD + FLAGS + LEN_L + LEN_H + DATA + CRC32
@@ -110,7 +282,7 @@ class OPUPClient:
             OPUP_SOF,
             self.seq,
             cmd,
-            0,  # FLAGS = 0 for request
+            flags,  # 0 for request, OPUP_FLAG_ASYNC to start a background job
             len(payload) & 0xFF,
             (len(payload) >> 8) & 0xFF
         ])
@@ -123,20 +295,35 @@ class OPUPClient:
         self.serial.write(packet)
         print(f"TX: {packet.hex(' ')}")
         
-        # Receive response
+        # Receive response, queueing completion events of background jobs
+        while True:
+            frame = self._read_frame()
+            if frame is None:
+                return False, b''
+            rx_flags, rx_payload = frame
+            if rx_flags & OPUP_FLAG_ASYNC:
+                self.events.append(rx_payload)
+                continue
+            if rx_flags & OPUP_FLAG_ERROR:
+                print(f"✗ Error response: {rx_payload.hex(' ')}")
+                return False, rx_payload
+            return True, rx_payload
+    
+    def _read_frame(self, idle_ok: bool = False) -> Optional[Tuple[int, bytes]]:
+        """Read one frame, return (flags, payload) or None on timeout/CRC error"""
         try:
             # Read header (6 bytes)
             rx_header = self.serial.read(6)
+            if idle_ok and not rx_header:
+                return None  # Nothing sent yet, not an error
             if len(rx_header) < 6:
                 print(f"✗ Timeout waiting for response header")
-                return False, b''
+                return None
             
             if rx_header[0] != OPUP_SOF:
                 print(f"✗ Invalid SOF: 0x{rx_header[0]:02x}")
-                return False, b''
+                return None
             
-            rx_seq = rx_header[1]
-            rx_cmd = rx_header[2]
             rx_flags = rx_header[3]
             rx_len = rx_header[4] | (rx_header[5] << 8)
             
@@ -151,21 +338,83 @@ class OPUPClient:
             full_rx = rx_header + rx_payload
             calc_crc = calculate_crc32(full_rx)
             
-            print(f"RX: {(rx_header + rx_payload + rx_crc_bytes).hex(' ')}")
+            if not (rx_flags & OPUP_FLAG_ASYNC and len(rx_payload) > 6):
+                print(f"RX: {(rx_header + rx_payload + rx_crc_bytes).hex(' ')}")
             
             if rx_crc != calc_crc:
                 print(f"✗ CRC mismatch: RX=0x{rx_crc:08x} CALC=0x{calc_crc:08x}")
-                return False, b''
+                return None
             
-            if rx_flags & OPUP_FLAG_ERROR:
-                print(f"✗ Error response: {rx_payload.hex(' ')}")
-                return False, rx_payload
-            
-            return True, rx_payload
+            return rx_flags, rx_payload
             
         except Exception as e:
             print(f"✗ Error receiving response: {e}")
-            return False, b''
+            return None
+    
+    def start_job(self, cmd: int, payload: bytes = b'') -> Optional[Tuple[int, int]]:
+        """Start a command in the background, return (job_id, expected_ms)"""
+        ok, data = self.send_command(cmd, payload, flags=OPUP_FLAG_ASYNC)
+        if not ok or len(data) < 5:
+            return None
+        job_id, expected_ms = struct.unpack('<BI', data[:5])
+        return job_id, expected_ms
+    
+    def wait_job(self, job_id: int, timeout: float,
+                 on_data: Optional[Callable[[int, bytes], None]] = None) -> Optional[Tuple[int, int]]:
+        """Wait for the ASYNC completion event, return (status, elapsed_ms)
+        
+        DATA events of the job are passed to on_data(offset, data).
+        """
+        deadline = time.time() + timeout
+        while True:
+            for event in list(self.events):
+                if len(event) < 6 or event[0] != job_id:
+                    continue
+                self.events.remove(event)
+                if event[1] == JOB_EVENT_DATA:
+                    if on_data:
+                        on_data(struct.unpack('<I', event[2:6])[0], event[6:])
+                    continue
+                status, elapsed_ms = struct.unpack('<BI', event[1:6])
+                return status, elapsed_ms
+            
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                print(f"✗ Timeout waiting for job {job_id}")
+                return None
+            # The link stays idle while the device polls the target itself
+            self.serial.timeout = min(remaining, 1.0)
+            try:
+                frame = self._read_frame(idle_ok=True)
+            finally:
+                self.serial.timeout = self.timeout
+            if frame and frame[0] & OPUP_FLAG_ASYNC:
+                self.events.append(frame[1])
+    
+    def job_status(self) -> list:
+        """List background jobs running on the device"""
+        ok, data = self.send_command(OpupCmd.JOB_STATUS)
+        if not ok or not data:
+            print("✗ Job status failed")
+            return []
+        jobs = []
+        for i in range(data[0]):
+            job_id, cmd, prio, elapsed, progress, total = struct.unpack(
+                '<BBBIII', data[1 + i * 15:16 + i * 15])
+            jobs.append({'id': job_id, 'cmd': cmd, 'priority': prio,
+                         'elapsed_ms': elapsed, 'progress': progress, 'total': total})
+            done = f"{progress}/{total}" if total else f"{progress}"
+            print(f"  Job {job_id}: cmd 0x{cmd:02X} prio {prio} | {elapsed}ms | {done}")
+        if not jobs:
+            print("No background jobs")
+        return jobs
+    
+    def job_abort(self, job_id: int = 0) -> int:
+        """Cancel one background job (0 = all), CS and bus are released at once"""
+        ok, data = self.send_command(OpupCmd.JOB_ABORT, bytes([job_id]))
+        count = data[0] if ok and data else 0
+        print(f"✓ Aborted {count} job(s)" if ok else "✗ Job abort failed")
+        return count
     
     # === High-Level Commands ===
     
@@ -213,9 +462,9 @@ class OPUPClient:
         print("✗ GPIO test failed")
         return False
     
-    def i2c_scan(self) -> List[int]:
-        """Scan I2C bus for devices"""
-        ok, payload = self.send_command(OpupCmd.I2C_SCAN)
+    def i2c_scan(self, quick: bool = False) -> List[int]:
+        """Scan I2C bus for devices (quick: PIO probe with a short timeout)"""
+        ok, payload = self.send_command(OpupCmd.I2C_SCAN, bytes([0x01]) if quick else b'')
         if ok and len(payload) >= 1:
             count = payload[0]
             addresses = list(payload[1:count+1]) if count > 0 else []
@@ -227,6 +476,115 @@ class OPUPClient:
         print("✗ I2C scan failed")
         return []
     
+    def i2c_eeprom_write(self, data: bytes, page_size: int, mem_addr: int = 0,
+                         dev_addr: int = 0x50, addr_width: int = 2,
+                         verify: bool = False) -> bool:
+        """Write an I2C EEPROM; page splitting and ACK polling run on the device"""
+        print(f"Writing {len(data)} bytes at 0x{mem_addr:X} (page {page_size} B)...")
+        pages = twr_total = 0
+        twr_min, twr_max = None, 0
+        done = 0
+        while done < len(data):
+            chunk = data[done:done + I2C_EEPROM_CHUNK]
+            payload = struct.pack('<BBHIB', dev_addr, addr_width, page_size,
+                                  mem_addr + done, I2C_EEPROM_VERIFY if verify else 0) + chunk
+            ok, resp = self.send_command(OpupCmd.I2C_EEPROM_WRITE, payload, timeout=10.0)
+            if not ok or len(resp) < 11:
+                print(f"\n✗ EEPROM write failed at 0x{mem_addr + done:X}")
+                return False
+            status, written, n, t_min, t_avg, t_max = struct.unpack('<BHHHHH', resp[:11])
+            if n:
+                pages += n
+                twr_total += t_avg * n
+                twr_min = t_min if twr_min is None else min(twr_min, t_min)
+                twr_max = max(twr_max, t_max)
+            done += written
+            if status != 0:
+                print(f"\n✗ EEPROM write stopped at 0x{mem_addr + done:X}: "
+                      f"{I2C_EEPROM_STATUS.get(status, status)}")
+                return False
+            print(f"\r  Progress: {(done * 100) // len(data)}%", end='', flush=True)
+        print()
+        if pages:
+            print(f"✓ Wrote {done} bytes in {pages} page cycles, "
+                  f"tWR min/avg/max {twr_min}/{twr_total // pages}/{twr_max} µs"
+                  f"{', verified' if verify else ''}")
+        return True
+    
+    def i2c_read_mem(self, mem_addr: int, length: int, dev_addr: int = 0x50,
+                     addr_width: int = 2) -> Optional[bytes]:
+        """Random read (memory address + repeated start), 4KB per frame"""
+        out = bytearray()
+        while len(out) < length:
+            n = min(I2C_READ_CHUNK, length - len(out))
+            payload = struct.pack('<BBIH', dev_addr, addr_width, mem_addr + len(out), n)
+            ok, data = self.send_command(OpupCmd.I2C_WRITE_READ, payload, timeout=5.0)
+            if not ok or len(data) != n:
+                print(f"\n✗ I2C read failed at 0x{mem_addr + len(out):X}")
+                return None
+            out += data
+            print(f"\r  Progress: {(len(out) * 100) // length}%", end='', flush=True)
+        print()
+        return bytes(out)
+    
+    def i2c_dump(self, filename: str, size: int, mem_addr: int = 0,
+                 dev_addr: int = 0x50, addr_width: int = 2) -> bool:
+        """Dump an I2C EEPROM to a file"""
+        print(f"Reading {size} bytes from 0x{dev_addr:02X} at 0x{mem_addr:X}...")
+        start = time.time()
+        data = self.i2c_read_mem(mem_addr, size, dev_addr, addr_width)
+        if data is None:
+            return False
+        elapsed = time.time() - start
+        with open(filename, 'wb') as f:
+            f.write(data)
+        print(f"✓ Saved {size} bytes to {filename} in {elapsed:.2f}s "
+              f"({size / 1024 / max(elapsed, 1e-6):.1f} KB/s)")
+        return True
+    
+    def i2c_speed(self, hz: Optional[int] = None) -> Optional[int]:
+        """Set (or query) the I2C bus clock"""
+        payload = struct.pack('<I', hz) if hz else b''
+        ok, data = self.send_command(OpupCmd.I2C_SET_SPEED, payload)
+        if not ok or len(data) < 4:
+            print(f"✗ I2C speed {hz} Hz rejected (10 kHz - 1 MHz)")
+            return None
+        hz = struct.unpack('<I', data[:4])[0]
+        print(f"✓ I2C clock: {hz / 1000:g} kHz")
+        return hz
+    
+    def i2c_engine(self, name: Optional[str] = None) -> Optional[str]:
+        """Select (or query) the I2C bus master: 'wire' or 'pio'"""
+        engines = ['wire', 'pio']
+        payload = bytes([engines.index(name)]) if name else b''
+        ok, data = self.send_command(OpupCmd.I2C_SET_ENGINE, payload)
+        if not ok or len(data) < 1 or data[0] >= len(engines):
+            print(f"✗ I2C engine '{name}' unavailable")
+            return None
+        print(f"✓ I2C engine: {engines[data[0]]}")
+        return engines[data[0]]
+    
+    def i2c_batch(self, batch: I2CBatch, keep_going: bool = False
+                  ) -> Optional[List[Tuple[int, bytes]]]:
+        """Run an I2C op list in one round-trip; returns (status, data) per op"""
+        payload = bytes([I2C_BATCH_CONTINUE if keep_going else 0]) + bytes(batch.ops)
+        ok, data = self.send_command(OpupCmd.I2C_BATCH, payload, timeout=5.0)
+        if not ok or len(data) < 1 or data[0] != len(batch.read_lens):
+            print("✗ I2C batch rejected (malformed, response too large or waits over 1 s)")
+            return None
+        count = data[0]
+        pos = 1 + count
+        results = []
+        for i, n in enumerate(batch.read_lens):
+            results.append((data[1 + i], data[pos:pos + n]))
+            pos += n
+        for i, (status, rd) in enumerate(results):
+            text = I2C_BATCH_STATUS.get(status, status)
+            print(f"  op {i}: {text}{' ' + rd.hex() if rd and status == 0 else ''}")
+        failed = sum(1 for st, _ in results if st != 0)
+        print(f"{'✓' if not failed else '✗'} I2C batch: {count - failed}/{count} ops ok")
+        return results
+    
     def spi_scan(self) -> Tuple[int, int, int]:
         """Scan SPI bus for flash chip (JEDEC ID)"""
         ok, payload = self.send_command(OpupCmd.SPI_SCAN)
@@ -268,6 +626,74 @@ class OPUPClient:
         print("✗ SPI transfer failed")
         return b''
     
+    def spi_config(self, mode: int, freq: int, setup_ns: Optional[int] = None,
+                   hold_ns: Optional[int] = None,
+                   cs_timeout_ms: Optional[int] = None) -> bool:
+        """Set SPI mode/clock and optionally CS setup/hold times (ns) and CS watchdog"""
+        # Payload: [Mode:1][Speed:4][SetupNs:2][HoldNs:2][CsTimeoutMs:2] (tail optional)
+        payload = struct.pack('<BI', mode, freq)
+        if setup_ns is not None and hold_ns is not None:
+            payload += struct.pack('<HH', setup_ns, hold_ns)
+            if cs_timeout_ms is not None:
+                payload += struct.pack('<H', cs_timeout_ms)
+        ok, data = self.send_command(OpupCmd.SPI_CONFIG, payload)
+        if ok and data and data[0]:
+            timing = f", CS setup/hold {setup_ns}/{hold_ns} ns" if setup_ns is not None else ""
+            print(f"✓ SPI mode {mode} @ {freq / 1e6:.2f} MHz{timing}")
+            return True
+        print("✗ SPI config failed")
+        return False
+    
+    def spi_write(self, data: bytes, keep_cs: bool = False) -> bool:
+        """TX-only SPI transfer (received bytes are discarded on-device)"""
+        flags = SPI_XFER_TX_ONLY | (SPI_XFER_CS_KEEP if keep_cs else 0)
+        ok, _ = self.send_command(OpupCmd.SPI_XFER_EX, bytes([flags]) + data)
+        return ok
+    
+    def spi_read(self, length: int, fill: int = 0xFF, keep_cs: bool = False) -> bytes:
+        """RX-only SPI transfer clocking out a fill byte"""
+        flags = SPI_XFER_RX_FILL | (SPI_XFER_CS_KEEP if keep_cs else 0)
+        payload = struct.pack('<BHB', flags, length, fill)
+        ok, data = self.send_command(OpupCmd.SPI_XFER_EX, payload)
+        if ok:
+            return data
+        print("✗ SPI read failed")
+        return b''
+    
+    def spi_release_cs(self) -> bool:
+        """End a chained transaction (also clears a CS watchdog timeout)"""
+        ok, _ = self.send_command(OpupCmd.SPI_XFER_EX, bytes([SPI_XFER_CS_RELEASE]))
+        return ok
+    
+    def spi_stream(self, command: bytes, length: int, fill: int = 0xFF) -> bytes:
+        """Send a command, then read any number of bytes under one CS assertion"""
+        if not self.spi_write(command, keep_cs=True):
+            print("✗ SPI stream command failed")
+            return b''
+        buf = bytearray()
+        while len(buf) < length:
+            chunk = min(SPI_XFER_CHUNK, length - len(buf))
+            last = len(buf) + chunk >= length
+            data = self.spi_read(chunk, fill, keep_cs=not last)
+            if len(data) != chunk:
+                self.spi_release_cs()
+                print(f"✗ SPI stream broken at {len(buf)} bytes (CS watchdog?)")
+                return bytes(buf)
+            buf += data
+        return bytes(buf)
+    
+    def spi_autotune(self, force: bool = False, addr: int = 0, length: int = 256) -> int:
+        """Find the fastest reliable hardware SPI clock (cached per chip ID)"""
+        payload = struct.pack('<BIH', 1 if force else 0, addr, length)
+        ok, data = self.send_command(OpupCmd.SPI_AUTOTUNE, payload, timeout=30.0)
+        if not ok or len(data) < 8:
+            print("✗ SPI autotune failed (no chip, or unstable at 1MHz)")
+            return 0
+        hz = struct.unpack('<I', data[4:8])[0]
+        source = "cached profile" if data[3] else "tuned"
+        print(f"✓ Chip {data[:3].hex().upper()}: SPI clock {hz / 1e6:.2f} MHz ({source})")
+        return hz
+    
     def spi_read_jedec(self) -> bytes:
         """Read JEDEC ID directly via SPI_XFER"""
         # 0x9F = Read JEDEC ID, followed by 3 dummy bytes
@@ -309,18 +735,15 @@ class OPUPClient:
         print("✗ QSPI read failed")
         return b''
     
-    def qspi_fast_read(self, addr: int, pages: int = 1) -> bytes:
+    def qspi_fast_read(self, addr: int, pages: int = 1, quiet: bool = False) -> bytes:
         """Fast read pages using current QSPI mode"""
-        # Payload: [Addr:3][PageCount:1]
-        payload = bytes([
-            addr & 0xFF,
-            (addr >> 8) & 0xFF,
-            (addr >> 16) & 0xFF,
-            pages
-        ])
+        # Payload: [Addr:3][PageCount:1], or [Addr:4][PageCount:1] above 16MB
+        addr_len = 4 if addr + pages * 256 > FLASH_3B_LIMIT else 3
+        payload = addr.to_bytes(addr_len, 'little') + bytes([pages])
         ok, data = self.send_command(OpupCmd.QSPI_FAST_READ, payload)
         if ok:
-            print(f"✓ Fast read {pages} pages ({len(data)} bytes) from 0x{addr:06X}")
+            if not quiet:
+                print(f"✓ Fast read {pages} pages ({len(data)} bytes) from 0x{addr:06X}")
             return data
         print("✗ Fast read failed")
         return b''
@@ -374,6 +797,69 @@ class OPUPClient:
         
         return results
     
+    def qspi_stats(self, reset: bool = False) -> Optional[dict]:
+        """Fast read chaining and read-ahead counters"""
+        ok, data = self.send_command(OpupCmd.QSPI_STATS, bytes([1 if reset else 0]))
+        if not ok or len(data) < 16:
+            print("✗ QSPI stats failed")
+            return None
+        full, continuous, chained, saved = struct.unpack('<IIII', data[:16])
+        total = full + continuous + chained
+        print(f"Fast reads: {total} | full: {full} | continuous: {continuous} | chained: {chained}")
+        print(f"  Command/address/dummy clocks saved: {saved}")
+        stats = {'full': full, 'continuous': continuous, 'chained': chained,
+                 'clocks_saved': saved}
+        if len(data) >= 28:
+            hits, misses, ahead = struct.unpack('<III', data[16:28])
+            rate = 100.0 * hits / (hits + misses) if hits + misses else 0.0
+            print(f"  Read-ahead: {hits} hits / {misses} misses ({rate:.0f}%) | "
+                  f"{ahead} bytes prefetched")
+            stats.update({'ahead_hits': hits, 'ahead_misses': misses,
+                          'ahead_bytes': ahead})
+        return stats
+    
+    def qspi_autotune(self, modes: Optional[List[int]] = None, force: bool = False,
+                      addr: int = 0, length: int = 256) -> Optional[dict]:
+        """Tune bit-bang clock/sample delays per QSPI mode (cached per chip ID)"""
+        mask = sum(1 << m for m in modes) if modes else 0  # 0 = current mode
+        payload = struct.pack('<BBIH', 1 if force else 0, mask, addr, length)
+        ok, data = self.send_command(OpupCmd.QSPI_AUTOTUNE, payload, timeout=60.0)
+        if not ok or len(data) < 5 + 3 * 6:
+            print("✗ QSPI autotune failed (no chip answered)")
+            return None
+        tuned = data[4]
+        source = "cached profile" if data[3] else "tuned"
+        print(f"✓ Chip {data[:3].hex().upper()} ({source})")
+        names = ["1-1-1", "1-1-2", "1-2-2", "1-1-4", "1-4-4", "4-4-4"]
+        profile = {}
+        for m in range(6):
+            clock, sample, window = data[5 + 3 * m:8 + 3 * m]
+            if tuned & (1 << m):
+                print(f"  Mode {m} ({names[m]}): clock delay {clock}, sample delay {sample}, "
+                      f"window {window} steps")
+                profile[m] = (clock, sample, window)
+            elif not modes or m in modes:
+                print(f"  Mode {m} ({names[m]}): not tuned")
+        return profile
+    
+    def qspi_probe_modes(self, addr: int = 0, length: int = 1024) -> Optional[int]:
+        """Measure every QSPI mode against a reference read; the fastest correct one stays active"""
+        payload = struct.pack('<IH', addr, length)
+        ok, data = self.send_command(OpupCmd.QSPI_PROBE_MODES, payload, timeout=10.0)
+        if not ok or len(data) < 1 + 5 * 6:
+            print("✗ QSPI mode probe failed (blank region or busy)")
+            return None
+        names = ["1-1-1", "1-1-2", "1-2-2", "1-1-4", "1-4-4", "4-4-4"]
+        for m in range(6):
+            good, bps = struct.unpack('<BI', data[1 + 5 * m:6 + 5 * m])
+            result = f"{bps / 1024:.1f} KB/s" if good else "FAILED"
+            print(f"  Mode {m} ({names[m]}): {result}")
+        if data[0] == 0xFF:
+            print("✗ No mode read the reference back")
+            return None
+        print(f"✓ Selected mode {data[0]} ({names[data[0]]})")
+        return data[0]
+    
     def qspi_read_status(self) -> Tuple[int, int]:
         """Read Status Register 1 and 2"""
         self.qspi_set_mode(0)  # Standard mode
@@ -492,8 +978,11 @@ class OPUPClient:
         """Read data from flash using current mode"""
         self.qspi_set_mode(0)  # Use standard mode for reliability
         
-        # Use normal read (0x03) - works in all modes
-        data = self.qspi_read(0x03, addr, 3, 0, length)
+        # Use normal read (0x03) - works in all modes; 0x13 with 4-byte address above 16MB
+        if addr + length > FLASH_3B_LIMIT:
+            data = self.qspi_read(0x13, addr, 4, 0, length)
+        else:
+            data = self.qspi_read(0x03, addr, 3, 0, length)
         
         if show_data and data:
             print(f"✓ Read {len(data)} bytes from 0x{addr:06X}")
@@ -507,136 +996,327 @@ class OPUPClient:
         
         return data
     
+    def flash_erase(self, erase_type: int, addr: int = 0, timeout: float = 10.0) -> bool:
+        """Device-side erase: 0=4KB sector, 1=32KB, 2=64KB block, 3=chip"""
+        # Payload: [Type:1][Addr:4] (4-byte opcodes used above 16MB)
+        # Runs as a background job: the device polls BUSY and sends an ASYNC
+        # event with the measured erase time, so the link stays quiet.
+        payload = struct.pack('<BI', erase_type, addr)
+        job = self.start_job(OpupCmd.FLASH_ERASE, payload)
+        if not job:
+            return False
+        job_id, expected_ms = job
+        result = self.wait_job(job_id, max(timeout, expected_ms / 1000 * 4))
+        if not result:
+            return False
+        status, elapsed_ms = result
+        self.last_erase_ms = elapsed_ms
+        if status != 0:
+            print(f"✗ Erase {'timed out' if status == 2 else 'failed'} after {elapsed_ms}ms")
+            return False
+        return True
+    
     def flash_erase_sector(self, addr: int) -> bool:
         """Erase 4KB sector"""
-        self.qspi_set_mode(0)  # Standard mode
-        sector_addr = addr & 0xFFF000  # Align to 4KB boundary
+        sector_addr = addr & ~0xFFF  # Align to 4KB boundary
         
         print(f"Erasing sector at 0x{sector_addr:06X} (4KB)...")
         
-        if not self.flash_write_enable():
-            return False
-        
-        # Sector Erase (0x20) with 24-bit address
-        self.qspi_cmd(0x20, bytes([
-            (sector_addr >> 16) & 0xFF,
-            (sector_addr >> 8) & 0xFF,
-            sector_addr & 0xFF
-        ]))
-        
-        # Wait for erase to complete (typically 45-400ms)
-        if self.flash_wait_busy(10000):  # 10 second timeout
-            print(f"✓ Sector erased at 0x{sector_addr:06X}")
+        # Typically 45-400ms, polled on-device
+        if self.flash_erase(0, sector_addr):
+            print(f"✓ Sector erased at 0x{sector_addr:06X} in {self.last_erase_ms}ms")
             return True
+        print("✗ Sector erase failed")
         return False
     
     def flash_erase_block(self, addr: int, size_kb: int = 64) -> bool:
         """Erase 32KB or 64KB block"""
-        self.qspi_set_mode(0)
-        
         if size_kb == 32:
-            block_addr = addr & 0xFF8000  # Align to 32KB
-            cmd = 0x52
+            block_addr = addr & ~0x7FFF  # Align to 32KB
+            erase_type = 1
         else:
-            block_addr = addr & 0xFF0000  # Align to 64KB
-            cmd = 0xD8
+            block_addr = addr & ~0xFFFF  # Align to 64KB
+            erase_type = 2
         
         print(f"Erasing {size_kb}KB block at 0x{block_addr:06X}...")
         
-        if not self.flash_write_enable():
-            return False
-        
-        self.qspi_cmd(cmd, bytes([
-            (block_addr >> 16) & 0xFF,
-            (block_addr >> 8) & 0xFF,
-            block_addr & 0xFF
-        ]))
-        
-        if self.flash_wait_busy(30000):  # 30 second timeout
-            print(f"✓ {size_kb}KB block erased at 0x{block_addr:06X}")
+        if self.flash_erase(erase_type, block_addr, timeout=30.0):
+            print(f"✓ {size_kb}KB block erased at 0x{block_addr:06X} in {self.last_erase_ms}ms")
             return True
+        print("✗ Block erase failed")
         return False
     
     def flash_chip_erase(self) -> bool:
         """Erase entire chip (DANGEROUS!)"""
-        self.qspi_set_mode(0)
         print("⚠ CHIP ERASE - This will take 40-200 seconds!")
-        
-        if not self.flash_write_enable():
-            return False
-        
-        self.qspi_cmd(0xC7, b'')  # Chip Erase
-        
         print("Erasing chip... (please wait)")
-        if self.flash_wait_busy(300000):  # 5 minute timeout
-            print("✓ Chip erased!")
+        if self.flash_erase(3, 0, timeout=400.0):
+            print(f"✓ Chip erased in {self.last_erase_ms / 1000:.1f}s")
             return True
         return False
     
     def flash_write_page(self, addr: int, data: bytes) -> bool:
         """Write up to 256 bytes (one page)"""
-        self.qspi_set_mode(0)  # Standard mode for write
-        
         if len(data) > 256:
             data = data[:256]
         
-        # Use actual address, not page-aligned (allows partial page writes)
-        write_addr = addr
-        
-        if not self.flash_write_enable():
-            return False
-        
-        # Use QSPI_WRITE (0x27) which supports larger payloads
-        # Format: [Cmd:1][AddrLen:1][Addr:3 (Little-Endian)][Data:N]
-        # Firmware expects address Little-Endian
-        payload = bytes([
-            0x02,  # Page Program command
-            3,     # Address length = 3 bytes
-            write_addr & 0xFF,          # LSB first
-            (write_addr >> 8) & 0xFF,
-            (write_addr >> 16) & 0xFF   # MSB last
-        ]) + data
-        
-        ok, _ = self.send_command(OpupCmd.QSPI_WRITE, payload)
-        if not ok:
-            print("✗ QSPI_WRITE failed")
-            return False
-        
-        if self.flash_wait_busy(5000):  # 5 second timeout (typ 0.4-3ms)
-            print(f"✓ Wrote {len(data)} bytes at 0x{write_addr:06X}")
+        # FLASH_PROGRAM does WREN, (quad) page program and BUSY polling on-device
+        # Payload: [Flags:1][Addr:4][Data:N]
+        payload = struct.pack('<BI', 0x00, addr) + data
+        ok, _ = self.send_command(OpupCmd.FLASH_PROGRAM, payload)
+        if ok:
+            print(f"✓ Wrote {len(data)} bytes at 0x{addr:06X}")
             return True
+        print("✗ FLASH_PROGRAM failed")
         return False
     
-    def flash_write(self, addr: int, data: bytes) -> bool:
-        """Write data spanning multiple pages"""
+    def gang_config(self, select: Optional[int] = None,
+                    pins: Optional[List[int]] = None) -> Optional[Tuple[int, List[int]]]:
+        """Query or set the gang chip-select GPIOs and the active chip mask"""
+        # Payload: [Select:1][Count:1][Pin:1]*Count, all optional (empty = query)
+        payload = b''
+        if select is not None or pins is not None:
+            payload = bytes([0x01 if select is None else select])
+            if pins is not None:
+                payload += bytes([len(pins)]) + bytes(pins)
+        
+        ok, data = self.send_command(OpupCmd.FLASH_GANG_CONFIG, payload)
+        if not ok or len(data) < 2:
+            print("✗ Gang config failed (pins must be free GPIOs, max 8; select at most one chip)")
+            return None
+        cs_pins = list(data[2:2 + data[1]])
+        print("✓ Chip selects: " + ", ".join(f"#{i}=GP{p}" for i, p in enumerate(cs_pins)) +
+              f" | Selected mask: 0x{data[0]:02X}")
+        return data[0], cs_pins
+    
+    def _gang_report(self, op: str, done: int, status: bytes) -> int:
+        """Print per-chip results, return the mask of chips that passed"""
+        for i, st in enumerate(status):
+            if st != 1:
+                mark = "✓" if done & (1 << i) else "✗"
+                print(f"  {mark} Chip #{i}: {op} {GANG_STATUS.get(st, 'unknown')}")
+        return done
+    
+    def gang_write(self, addr: int, data: bytes, mask: int = 0xFF,
+                   erase: bool = True, verify: bool = True) -> int:
+        """Erase, program and verify identical data on every chip in mask"""
+        cfg = self.gang_config()
+        if not cfg:
+            return 0
+        mask &= (1 << len(cfg[1])) - 1
         total = len(data)
-        written = 0
-        current_addr = addr
+        print(f"Gang writing {total} bytes at 0x{addr:06X} (mask 0x{mask:02X})...")
+        start = time.time()
         
+        if erase:
+            # 64KB block erase covering the image, broadcast to all chips
+            block = addr & ~0xFFFF
+            while block < addr + total and mask:
+                ok, resp = self.send_command(OpupCmd.FLASH_GANG_ERASE,
+                                             struct.pack('<BBI', mask, 2, block), timeout=10.0)
+                if not ok or len(resp) < 2:
+                    print(f"✗ Gang erase failed at 0x{block:06X}")
+                    return 0
+                if resp[0] != mask:
+                    mask = self._gang_report("erase", resp[0], resp[2:2 + resp[1]])
+                block += 0x10000
+        
+        # Program: each frame is clocked out once for every chip
+        offset = 0
+        while offset < total and mask:
+            chunk = data[offset:offset + FLASH_PROGRAM_CHUNK]
+            if chunk.count(0xFF) != len(chunk):
+                payload = struct.pack('<BI', mask, addr + offset) + chunk
+                ok, resp = self.send_command(OpupCmd.FLASH_GANG_PROGRAM, payload)
+                if not ok or len(resp) < 6:
+                    print(f"\n✗ Gang program failed at 0x{addr + offset:06X}")
+                    return 0
+                if resp[0] != mask:
+                    print()
+                    mask = self._gang_report("program", resp[0], resp[6:6 + resp[5]])
+            offset += len(chunk)
+            print(f"\r  Program: {offset * 100 // total}%", end='', flush=True)
+        print()
+        
+        if verify:
+            offset = 0
+            status = {}
+            while offset < total and mask:
+                chunk = data[offset:offset + FLASH_PROGRAM_CHUNK]
+                payload = struct.pack('<BI', mask, addr + offset) + chunk
+                ok, resp = self.send_command(OpupCmd.FLASH_GANG_VERIFY, payload)
+                if not ok or len(resp) < 2:
+                    print(f"✗ Gang verify failed at 0x{addr + offset:06X}")
+                    return 0
+                for i in range(resp[1]):
+                    st, where = struct.unpack('<BI', resp[2 + i * 5:7 + i * 5])
+                    if st == 4:
+                        status[i] = where
+                mask = resp[0]
+                offset += len(chunk)
+            for i, where in status.items():
+                print(f"  ✗ Chip #{i}: mismatch at 0x{where:06X}")
+        
+        elapsed = time.time() - start
+        passed = bin(mask).count('1')
+        print(f"✓ Gang write done in {elapsed:.2f}s: {passed} chip(s) passed (mask 0x{mask:02X})")
+        return mask
+    
+    def flash_config(self, quad_write: Optional[bool] = None,
+                     addr_mode: Optional[int] = None,
+                     read_chain: Optional[bool] = None,
+                     read_ahead: Optional[bool] = None) -> Tuple[bool, int]:
+        """Query or set the quad write / 4-byte address / read chaining / read-ahead policy"""
+        # Payload: [QuadWrite:1][AddrMode:1][ReadChain:1][ReadAhead:1],
+        # all optional (empty = query)
+        payload = b''
+        if quad_write is not None:
+            payload = bytes([1 if quad_write else 0])
+            if addr_mode is not None:
+                payload += bytes([addr_mode])
+                if read_chain is not None:
+                    payload += bytes([1 if read_chain else 0])
+                    if read_ahead is not None:
+                        payload += bytes([1 if read_ahead else 0])
+        
+        ok, data = self.send_command(OpupCmd.FLASH_CONFIG, payload)
+        if ok and len(data) >= 3:
+            qe_names = {0: "unknown", 1: "set", 2: "unsupported"}
+            addr_names = {0: "auto", 1: "4-byte opcodes", 2: "EN4B"}
+            chain = f" | Read chaining: {'on' if data[3] else 'off'}" if len(data) >= 4 else ""
+            if len(data) >= 5:
+                chain += f" | Read-ahead: {'on' if data[4] else 'off'}"
+            print(f"✓ Quad writes: {'on' if data[0] else 'off'} | "
+                  f"QE: {qe_names.get(data[1], 'unknown')} | "
+                  f"Addressing: {addr_names.get(data[2], 'unknown')}{chain}")
+            return bool(data[0]), data[1]
+        print("✗ Flash config failed")
+        return False, 0
+    
+    def flash_stream_read(self, addr: int, length: int, timeout: float = 120.0) -> bytes:
+        """Read a range as a background job streaming DATA events"""
+        # Async QSPI_FAST_READ payload: [Addr:4][Length:4]
+        job = self.start_job(OpupCmd.QSPI_FAST_READ, struct.pack('<II', addr, length))
+        if not job:
+            print("✗ Stream read failed to start")
+            return b''
+        buf = bytearray(length)
+        
+        def store(offset: int, chunk: bytes):
+            buf[offset:offset + len(chunk)] = chunk
+        
+        result = self.wait_job(job[0], timeout, on_data=store)
+        if not result or result[0] != 0:
+            print("✗ Stream read did not complete")
+            return b''
+        return bytes(buf)
+    
+    def flash_dump(self, addr: int, length: int, path: str) -> bool:
+        """Dump flash to a file with QSPI_FAST_READ (4KB per frame)"""
+        print(f"Dumping {length} bytes from 0x{addr:06X} to {path}...")
+        start = time.time()
+        done = 0
+        with open(path, 'wb') as f:
+            while done < length:
+                pages = min(16, (length - done + 255) // 256)
+                data = self.qspi_fast_read(addr + done, pages, quiet=True)
+                if not data:
+                    print(f"\n✗ Dump failed at 0x{addr + done:06X}")
+                    return False
+                data = data[:length - done]
+                f.write(data)
+                done += len(data)
+                print(f"\r  Progress: {(done * 100) // length}% ({done}/{length} bytes)",
+                      end='', flush=True)
+        elapsed = time.time() - start
+        print()
+        print(f"✓ Dump complete: {length} bytes in {elapsed:.2f}s "
+              f"({length / elapsed / 1024:.1f} KB/s)")
+        return True
+    
+    def flash_write(self, addr: int, data: bytes, trim_tail: bool = True) -> bool:
+        """Write data spanning multiple pages (target range must be erased)"""
+        total = len(data)
         print(f"Writing {total} bytes starting at 0x{addr:06X}...")
         
-        while written < total:
-            # Calculate bytes to write in this page
-            page_offset = current_addr & 0xFF
-            page_remaining = 256 - page_offset
-            chunk_size = min(page_remaining, total - written)
-            
-            chunk = data[written:written + chunk_size]
-            if not self.flash_write_page(current_addr, chunk):
-                print(f"✗ Write failed at 0x{current_addr:06X}")
+        # Split on page boundaries and drop all-0xFF pages before upload
+        pages = []
+        host_skipped = 0
+        offset = 0
+        while offset < total:
+            page_addr = addr + offset
+            chunk_size = min(256 - (page_addr & 0xFF), total - offset)
+            chunk = data[offset:offset + chunk_size]
+            if chunk.count(0xFF) == len(chunk):
+                host_skipped += 1
+            else:
+                pages.append((page_addr, chunk))
+            offset += chunk_size
+        
+        # Group contiguous pages into FLASH_PROGRAM frames
+        frames = []
+        for page_addr, chunk in pages:
+            if frames:
+                frame_addr, frame_data = frames[-1]
+                if (frame_addr + len(frame_data) == page_addr and
+                        len(frame_data) + len(chunk) <= FLASH_PROGRAM_CHUNK):
+                    frames[-1] = (frame_addr, frame_data + chunk)
+                    continue
+            frames.append((page_addr, chunk))
+        
+        programmed = dev_skipped = trimmed = 0
+        quad = False
+        xfer_us = busy_us = 0
+        sent = 0
+        upload_total = max(1, sum(len(chunk) for _, chunk in pages))
+        for frame_addr, frame_data in frames:
+            # Payload: [Flags:1][Addr:4][Data:N]
+            payload = struct.pack('<BI', 0x01 if trim_tail else 0x00, frame_addr) + frame_data
+            ok, resp = self.send_command(OpupCmd.FLASH_PROGRAM, payload)
+            if not ok or len(resp) < 15:
+                print(f"\n✗ Write failed at 0x{frame_addr:06X}")
                 return False
+            p, s, t, q, x, b = struct.unpack('<HHHBII', resp[:15])
+            programmed += p
+            dev_skipped += s
+            trimmed += t
+            quad = quad or bool(q)
+            xfer_us += x
+            busy_us += b
             
-            written += chunk_size
-            current_addr += chunk_size
-            
-            # Progress indicator
-            pct = (written * 100) // total
-            print(f"\r  Progress: {pct}% ({written}/{total} bytes)", end='', flush=True)
+            sent += len(frame_data)
+            pct = (sent * 100) // upload_total
+            print(f"\r  Progress: {pct}% ({sent} bytes uploaded)", end='', flush=True)
         
         print()  # Newline
-        print(f"✓ Write complete: {written} bytes")
+        print(f"✓ Write complete: {total} bytes, {programmed} page(s) programmed")
+        print(f"  Blank pages skipped: host {host_skipped}, device {dev_skipped}"
+              f" | Trailing 0xFF bytes trimmed: {trimmed}")
+        if busy_us:
+            print(f"  Data phase: {'Quad' if quad else 'Single'} | upload {xfer_us / 1000:.1f}ms"
+                  f" vs tPP {busy_us / 1000:.1f}ms (ratio {xfer_us / busy_us:.2f})")
+        self.last_write_stats = {
+            'pages': programmed, 'quad': quad,
+            'xfer_us': xfer_us, 'busy_us': busy_us,
+        }
         return True
     
+    def flash_patch(self, edits: List[Tuple[int, bytes]]) -> bool:
+        """Patch bytes in place using the device-side read-modify-write engine"""
+        # Payload: repeated [Addr:4][Len:2][Data:N] (Little-Endian)
+        payload = b''
+        for edit_addr, edit_data in edits:
+            payload += struct.pack('<IH', edit_addr, len(edit_data)) + edit_data
+        
+        ok, data = self.send_command(OpupCmd.FLASH_PATCH, payload)
+        if ok and len(data) >= 6:
+            sectors, erased, pages = struct.unpack('<HHH', data[:6])
+            print(f"✓ Patched {len(edits)} edit(s): {sectors} sector(s) read, "
+                  f"{erased} erased, {pages} page(s) programmed")
+            return True
+        print("✗ Flash patch failed")
+        return False
+    
     def flash_test_rw(self, addr: int = 0x100000):
         """Test read/write at a specific address"""
         print(f"\n=== Flash Read/Write Test at 0x{addr:06X} ===")
@@ -717,55 +1397,38 @@ class OPUPClient:
         # Erase test area first
         print(f"\n🗑️  Erasing {test_size_kb}KB at 0x{addr:06X}...")
         sectors = (test_size + 4095) // 4096
+        device_ms = 0
         erase_start = time.time()
         for i in range(sectors):
             sector_addr = addr + (i * 4096)
-            self.qspi_set_mode(0)
-            if not self.flash_write_enable():
+            if not self.flash_erase(0, sector_addr):
                 print("   Erase failed!")
                 return
-            self.qspi_cmd(0x20, bytes([
-                (sector_addr >> 16) & 0xFF,
-                (sector_addr >> 8) & 0xFF,
-                sector_addr & 0xFF
-            ]))
-            self.flash_wait_busy(10000)
+            device_ms += self.last_erase_ms
         erase_time = time.time() - erase_start
-        print(f"   Erase: {erase_time:.2f}s ({test_size_kb / erase_time:.1f} KB/s)")
-        
-        # Write test data (standard mode only for now)
-        print(f"\n📝 Writing {test_size_kb}KB test pattern...")
-        self.qspi_set_mode(0)
-        write_start = time.time()
-        pages = test_size // 256
-        for i in range(pages):
-            page_addr = addr + (i * 256)
-            page_data = test_data[i*256:(i+1)*256]
+        print(f"   Erase: {erase_time:.2f}s ({test_size_kb / erase_time:.1f} KB/s)"
+              f" | device tSE total {device_ms}ms ({device_ms / sectors:.0f}ms/sector)")
+        
+        # Write test data, single-wire then Quad Page Program
+        for quad_write in (False, True):
+            label = "Quad" if quad_write else "Standard"
+            print(f"\n📝 Writing {test_size_kb}KB test pattern ({label} page program)...")
+            self.flash_config(quad_write)
+            if quad_write:  # Area still holds the single-wire pass
+                for i in range(sectors):
+                    self.flash_erase_sector(addr + (i * 4096))
             
-            if not self.flash_write_enable():
-                print("   Write failed (WREN)!")
+            write_start = time.time()
+            if not self.flash_write(addr, test_data, trim_tail=False):
+                print("   Write failed!")
                 return
-            
-            # Use QSPI_WRITE for large payload (address Little-Endian for firmware)
-            payload = bytes([
-                0x02,  # Page Program
-                3,     # AddrLen
-                page_addr & 0xFF,          # LSB first
-                (page_addr >> 8) & 0xFF,
-                (page_addr >> 16) & 0xFF   # MSB last
-            ]) + page_data
-            
-            self.send_command(OpupCmd.QSPI_WRITE, payload)
-            self.flash_wait_busy(5000)
-            
-            # Progress
-            pct = ((i + 1) * 100) // pages
-            print(f"\r   Progress: {pct}%", end='', flush=True)
-        
-        write_time = time.time() - write_start
-        write_speed = test_size / write_time / 1024
-        print(f"\n   Write: {write_time:.2f}s ({write_speed:.1f} KB/s)")
-        results.append(("Write (Standard)", write_time, write_speed))
+            write_time = time.time() - write_start
+            write_speed = test_size / write_time / 1024
+            stats = self.last_write_stats
+            ratio = stats['xfer_us'] / stats['busy_us'] if stats.get('busy_us') else 0
+            print(f"   Write: {write_time:.2f}s ({write_speed:.1f} KB/s) | upload/tPP ratio {ratio:.2f}")
+            results.append((f"Write ({label}, ratio {ratio:.2f})", write_time, write_speed))
+        self.flash_config(True)
         
         # Benchmark READ in each mode
         print(f"\n📖 Reading {test_size_kb}KB in each mode...")
@@ -824,11 +1487,158 @@ class OPUPClient:
         self.qspi_set_mode(0)
         return results
     
-    def isp_enter(self) -> bool:
-        """Enter ISP programming mode"""
-        ok, payload = self.send_command(OpupCmd.ISP_ENTER)
+    # === SPI NAND ===
+    
+    def nand_info(self, rescan: bool = False, single: bool = False) -> Optional[dict]:
+        """Identify the SPI NAND (first call scans the bad block table)"""
+        flags = (0x01 if rescan else 0) | (0x02 if single else 0)
+        ok, data = self.send_command(OpupCmd.NAND_INFO, bytes([flags]), timeout=10.0)
+        if not ok or len(data) < 15:
+            print("✗ No known SPI NAND found")
+            return None
+        page, spare, ppb, blocks = struct.unpack('<HHHH', data[3:11])
+        info = {'id': data[:3], 'page_size': page, 'spare_size': spare,
+                'pages_per_block': ppb, 'blocks': blocks, 'planes': data[11],
+                'flags': data[12], 'bad_blocks': struct.unpack('<H', data[13:15])[0]}
+        size_mb = page * ppb * blocks // (1024 * 1024)
+        pipeline = ("cache read sequential" if data[12] & 0x01 else
+                    "continuous read" if data[12] & 0x02 else "page reads")
+        print(f"✓ SPI NAND {data[:3].hex().upper()}: {size_mb}MB, {page}+{spare} byte pages, "
+              f"{ppb} pages/block, {blocks} blocks, {data[11]} plane(s)")
+        print(f"  Bad blocks: {info['bad_blocks']} | Pipeline: {pipeline}")
+        return info
+    
+    def nand_dump(self, path: str, page: int = 0, count: Optional[int] = None,
+                  raw: bool = False, spare: bool = False) -> bool:
+        """Dump logical (or raw) pages to a file as a streamed background read"""
+        info = self.nand_info()
+        if not info:
+            return False
+        if count is None:
+            blocks = info['blocks'] if raw else info['blocks'] - info['bad_blocks']
+            count = blocks * info['pages_per_block'] - page
+        page_len = info['page_size'] + (info['spare_size'] if spare else 0)
+        length = count * page_len
+        flags = (NAND_READ_RAW if raw else 0) | (NAND_READ_SPARE if spare else 0)
+        
+        print(f"Dumping {count} pages ({length} bytes) from page {page} to {path}...")
+        job = self.start_job(OpupCmd.NAND_READ, struct.pack('<IIB', page, count, flags))
+        if not job:
+            print("✗ NAND read failed to start")
+            return False
+        start = time.time()
+        with open(path, 'wb') as f:
+            f.truncate(length)
+            
+            def store(offset: int, chunk: bytes):
+                f.seek(offset)
+                f.write(chunk)
+                done = offset + len(chunk)
+                print(f"\r  Progress: {(done * 100) // length}% ({done}/{length} bytes)",
+                      end='', flush=True)
+            
+            result = self.wait_job(job[0], 60.0 + count * 0.01, on_data=store)
+        print()
+        if not result or result[0] != 0:
+            print("✗ NAND dump did not complete")
+            return False
+        elapsed = time.time() - start
+        print(f"✓ Dump complete in {elapsed:.2f}s ({length / elapsed / 1024:.1f} KB/s)")
+        self.nand_stats()
+        return True
+    
+    def nand_program(self, data: bytes, page: int = 0, erase: bool = True) -> bool:
+        """Program logical pages; blocks that fail are retired and rewritten"""
+        info = self.nand_info()
+        if not info:
+            return False
+        page_size, ppb = info['page_size'], info['pages_per_block']
+        pages = (len(data) + page_size - 1) // page_size
+        data = data.ljust(pages * page_size, b'\xff')
+        print(f"Programming {pages} pages from logical page {page}...")
+        
+        i = 0
+        programmed = blank = retried = 0
+        while i < pages:
+            chunk = data[i * page_size:(i + 1) * page_size]
+            payload = struct.pack('<BI', 0x01 if erase else 0, page + i) + chunk
+            ok, resp = self.send_command(OpupCmd.NAND_PROGRAM, payload, timeout=5.0)
+            if not ok or len(resp) < 5:
+                print(f"\n✗ Program failed at page {page + i} (out of good blocks?)")
+                return False
+            status, block, bad = struct.unpack('<BHH', resp[:5])
+            if status == NAND_PROGRAM_RETRY:
+                # The logical block moved to the next good block: start it again
+                retried += 1
+                i = max(0, (page + i) // ppb * ppb - page)
+                print(f"\n  Block {block} retired ({bad} bad), rewriting logical block")
+                continue
+            if status == NAND_PROGRAM_BLANK:
+                blank += 1
+            else:
+                programmed += 1
+            i += 1
+            print(f"\r  Progress: {(i * 100) // pages}% ({i}/{pages} pages)", end='', flush=True)
+        print()
+        print(f"✓ Programmed {programmed} pages, {blank} blank skipped, {retried} block rewrite(s)")
+        return True
+    
+    def nand_erase(self, block: int, count: int = 1) -> bool:
+        """Erase logical blocks (bad blocks skipped, failing ones retired)"""
+        done = 0
+        while done < count:
+            n = min(64, count - done)
+            ok, data = self.send_command(OpupCmd.NAND_ERASE,
+                                         struct.pack('<HH', block + done, n), timeout=5.0)
+            if not ok or len(data) < 4:
+                print(f"✗ Erase failed at block {block + done}")
+                return False
+            erased, new_bad = struct.unpack('<HH', data[:4])
+            if new_bad:
+                print(f"  {new_bad} block(s) retired")
+            done += erased
+            if erased < n:
+                print(f"✗ Out of good blocks after {done} blocks")
+                return False
+        print(f"✓ Erased {done} blocks")
+        return True
+    
+    def nand_bbt(self) -> List[int]:
+        """List bad (physical) blocks"""
+        ok, data = self.send_command(OpupCmd.NAND_BBT)
+        if not ok or len(data) < 2:
+            print("✗ Bad block table unavailable (run nand-info first)")
+            return []
+        count = struct.unpack('<H', data[:2])[0]
+        blocks = list(struct.unpack(f'<{count}H', data[2:2 + 2 * count]))
+        print(f"Bad blocks ({count}): {', '.join(map(str, blocks)) if blocks else 'none'}")
+        return blocks
+    
+    def nand_stats(self, reset: bool = False) -> Optional[dict]:
+        """Read-pipeline, ECC and bad block retirement counters"""
+        ok, data = self.send_command(OpupCmd.NAND_STATS, bytes([1 if reset else 0]))
+        if not ok or len(data) < 28:
+            print("✗ NAND stats failed")
+            return None
+        keys = ['pages_read', 'pipelined', 'corrected', 'uncorrectable',
+                'programmed', 'erased', 'new_bad']
+        stats = dict(zip(keys, struct.unpack('<7I', data[:28])))
+        print(f"NAND: {stats['pages_read']} pages read ({stats['pipelined']} pipelined) | "
+              f"ECC corrected {stats['corrected']}, uncorrectable {stats['uncorrectable']} | "
+              f"{stats['programmed']} programmed, {stats['erased']} erased, "
+              f"{stats['new_bad']} retired")
+        return stats
+    
+    def isp_enter(self, sck: Optional[int] = None) -> bool:
+        """Enter ISP programming mode (sck: pin SCK in Hz, 0 = negotiate)"""
+        payload = struct.pack('<I', sck) if sck is not None else b''
+        ok, payload = self.send_command(OpupCmd.ISP_ENTER, payload)
         if ok and len(payload) >= 1 and payload[0] == 1:
-            print("✓ Entered ISP mode")
+            if len(payload) >= 5:
+                hz = struct.unpack('<I', payload[1:5])[0]
+                print(f"✓ Entered ISP mode (SCK {hz / 1000:g} kHz)")
+            else:
+                print("✓ Entered ISP mode")
             return True
         print("✗ Failed to enter ISP mode")
         return False
@@ -849,6 +1659,235 @@ class OPUPClient:
             return payload[0], payload[1], payload[2], payload[3]
         return 0, 0, 0, 0
     
+    def isp_wait_ready(self, timeout: float = 0.1) -> bool:
+        """Poll RDY/BSY (0xF0) until the target is ready"""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            if not self.isp_xfer(0xF0, 0x00, 0x00, 0x00)[3] & 0x01:
+                return True
+        return False
+    
+    def avr_flash(self, data: bytes, page_size: int = 128, addr: int = 0,
+                  erase: bool = True) -> bool:
+        """Program AVR flash over ISP, several pages per frame"""
+        if len(data) % 2:
+            data += b'\xff'
+        if not self.isp_enter():
+            return False
+        try:
+            if erase:
+                self.isp_xfer(0xAC, 0x80, 0x00, 0x00)  # Chip Erase
+                if not self.isp_wait_ready():
+                    print("✗ Chip erase timeout")
+                    return False
+                print("✓ Chip erased")
+            
+            chunk = (OPUP_MAX_PAYLOAD - ISP_PROGRAM_HEADER) // page_size * page_size
+            flags = ISP_PROGRAM_SKIP_BLANK if erase else 0
+            print(f"Programming {len(data)} bytes ({page_size} B pages)...")
+            start = time.time()
+            pages = skipped = busy_max = 0
+            for off in range(0, len(data), chunk):
+                payload = struct.pack('<BHI', flags, page_size, addr + off) + data[off:off + chunk]
+                ok, resp = self.send_command(OpupCmd.ISP_PROGRAM_PAGE, payload, timeout=10.0)
+                if not ok or len(resp) < 7:
+                    print(f"\n✗ Page program rejected at 0x{addr + off:X}")
+                    return False
+                status, n, s, b = struct.unpack('<BHHH', resp[:7])
+                pages += n
+                skipped += s
+                busy_max = max(busy_max, b)
+                if status != 0:
+                    print(f"\n✗ RDY/BSY timeout at page 0x{addr + off + (n + s) * page_size:X}")
+                    return False
+                done = min(off + chunk, len(data))
+                print(f"\r  Progress: {(done * 100) // len(data)}%", end='', flush=True)
+            print()
+            print(f"✓ Programmed {pages} pages ({skipped} blank skipped) in "
+                  f"{time.time() - start:.2f}s, page write max {busy_max} µs")
+            return True
+        finally:
+            self.isp_exit()
+    
+    def avr_read_memory(self, mem: str, addr: int, length: int) -> Optional[bytes]:
+        """Read target memory over ISP (up to 4KB per frame; needs ISP mode)"""
+        out = bytearray()
+        while len(out) < length:
+            n = min(OPUP_MAX_PAYLOAD, length - len(out))
+            payload = struct.pack('<BIH', AVR_MEMORY[mem], addr + len(out), n)
+            ok, data = self.send_command(OpupCmd.ISP_READ_MEMORY, payload, timeout=10.0)
+            if not ok or len(data) != n:
+                print(f"\n✗ {mem} read failed at 0x{addr + len(out):X}")
+                return None
+            out += data
+            if length > n:
+                print(f"\r  Progress: {(len(out) * 100) // length}%", end='', flush=True)
+        if length > OPUP_MAX_PAYLOAD:
+            print()
+        return bytes(out)
+    
+    def avr_dump(self, filename: str, mem: str, length: int, addr: int = 0) -> bool:
+        """Dump AVR flash or EEPROM to a file"""
+        if not self.isp_enter():
+            return False
+        try:
+            start = time.time()
+            data = self.avr_read_memory(mem, addr, length)
+            if data is None:
+                return False
+            with open(filename, 'wb') as f:
+                f.write(data)
+            print(f"✓ Saved {length} bytes of {mem} to {filename} in {time.time() - start:.2f}s")
+            return True
+        finally:
+            self.isp_exit()
+    
+    def avr_verify(self, data: bytes, mem: str = 'flash', addr: int = 0) -> bool:
+        """Compare target memory with data on the device; prints mismatches"""
+        if not self.isp_enter():
+            return False
+        try:
+            chunk = OPUP_MAX_PAYLOAD - 5
+            total = 0
+            for off in range(0, len(data), chunk):
+                payload = struct.pack('<BI', AVR_MEMORY[mem], addr + off) + data[off:off + chunk]
+                ok, resp = self.send_command(OpupCmd.ISP_VERIFY_MEMORY, payload, timeout=10.0)
+                if not ok or len(resp) < 2:
+                    print(f"✗ Verify failed at 0x{addr + off:X}")
+                    return False
+                count = struct.unpack('<H', resp[:2])[0]
+                for i in range(min(count, 5 - min(total, 5))):
+                    o = struct.unpack('<H', resp[2 + i * 2:4 + i * 2])[0]
+                    print(f"  Diff @ 0x{addr + off + o:X}: file 0x{data[off + o]:02X}")
+                total += count
+            if total:
+                print(f"✗ Verify: {total} byte(s) differ")
+                return False
+            print(f"✓ Verified {len(data)} bytes of {mem}")
+            return True
+        finally:
+            self.isp_exit()
+    
+    def updi_enter(self, baud: Optional[int] = None) -> Optional[int]:
+        """Open the UPDI link and enter NVM programming; returns the NVM version"""
+        payload = struct.pack('<I', baud) if baud else b''
+        ok, resp = self.send_command(OpupCmd.UPDI_ENTER, payload, timeout=2.0)
+        if not ok or len(resp) < 18:
+            print("✗ UPDI_ENTER rejected")
+            return None
+        status, nvm = resp[0], resp[1]
+        sib = resp[2:18].decode('ascii', errors='replace').rstrip('\x00')
+        if status == 1:
+            print("✗ No UPDI link")
+            return None
+        print(f"  SIB: {sib}")
+        if status != 0:
+            print(f"✗ UPDI: {UPDI_ENTER_STATUS.get(status, status)}")
+            return None
+        print("✓ Entered UPDI NVM programming")
+        return nvm
+    
+    def updi_exit(self) -> bool:
+        """Reset the target into its application"""
+        ok, _ = self.send_command(OpupCmd.UPDI_EXIT)
+        return ok
+    
+    def updi_erase(self) -> bool:
+        """Chip erase over UPDI (also unlocks a locked part)"""
+        ok, resp = self.send_command(OpupCmd.UPDI_ENTER, timeout=2.0)
+        if not ok or len(resp) < 18 or resp[0] == 1:
+            print("✗ No UPDI link")
+            return False
+        try:
+            ok, _ = self.send_command(OpupCmd.UPDI_CHIP_ERASE, timeout=5.0)
+            print("✓ Chip erased" if ok else "✗ Chip erase failed")
+            return ok
+        finally:
+            self.updi_exit()
+    
+    def updi_read(self, addr: int, length: int) -> Optional[bytes]:
+        """Read the UPDI data space (up to 4KB per frame; needs UPDI mode)"""
+        out = bytearray()
+        while len(out) < length:
+            n = min(OPUP_MAX_PAYLOAD, length - len(out))
+            ok, data = self.send_command(OpupCmd.UPDI_READ,
+                                         struct.pack('<IH', addr + len(out), n), timeout=10.0)
+            if not ok or len(data) != n:
+                print(f"\n✗ UPDI read failed at 0x{addr + len(out):X}")
+                return None
+            out += data
+            if length > n:
+                print(f"\r  Progress: {(len(out) * 100) // length}%", end='', flush=True)
+        if length > OPUP_MAX_PAYLOAD:
+            print()
+        return bytes(out)
+    
+    def updi_dump(self, filename: str, addr: int, length: int, baud: Optional[int] = None) -> bool:
+        """Dump a UPDI data-space range (flash, EEPROM, fuses, SIGROW) to a file"""
+        if self.updi_enter(baud) is None:
+            return False
+        try:
+            start = time.time()
+            data = self.updi_read(addr, length)
+            if data is None:
+                return False
+            with open(filename, 'wb') as f:
+                f.write(data)
+            print(f"✓ Saved {length} bytes from 0x{addr:X} to {filename} in {time.time() - start:.2f}s")
+            return True
+        finally:
+            self.updi_exit()
+    
+    def updi_flash(self, data: bytes, addr: Optional[int] = None, page_size: int = 64,
+                   eeprom: bool = False, erase: bool = True,
+                   baud: Optional[int] = None) -> bool:
+        """Program flash (chip erased first) or EEPROM over UPDI"""
+        if not eeprom and len(data) % 2:
+            data += b'\xff'
+        nvm = self.updi_enter(baud)
+        if nvm is None:
+            return False
+        try:
+            if erase and not eeprom:
+                ok, _ = self.send_command(OpupCmd.UPDI_CHIP_ERASE, timeout=5.0)
+                if not ok:
+                    print("✗ Chip erase failed")
+                    return False
+                print("✓ Chip erased")
+            if addr is None:
+                addr = 0x1400 if eeprom else UPDI_FLASH_BASE.get(nvm, 0x8000)
+            
+            flags = UPDI_PROGRAM_EEPROM if eeprom else 0
+            if erase and not eeprom:
+                flags |= UPDI_PROGRAM_SKIP_BLANK
+            elif not eeprom:
+                flags |= UPDI_PROGRAM_ERASE
+            chunk = (OPUP_MAX_PAYLOAD - ISP_PROGRAM_HEADER) // page_size * page_size
+            print(f"Programming {len(data)} bytes at 0x{addr:X} ({page_size} B pages)...")
+            start = time.time()
+            pages = skipped = busy_max = 0
+            for off in range(0, len(data), chunk):
+                payload = struct.pack('<BHI', flags, page_size, addr + off) + data[off:off + chunk]
+                ok, resp = self.send_command(OpupCmd.UPDI_PROGRAM, payload, timeout=10.0)
+                if not ok or len(resp) < 7:
+                    print(f"\n✗ Page program rejected at 0x{addr + off:X}")
+                    return False
+                status, n, s, b = struct.unpack('<BHHH', resp[:7])
+                pages += n
+                skipped += s
+                busy_max = max(busy_max, b)
+                if status != 0:
+                    print(f"\n✗ NVM error at page 0x{addr + off + (n + s) * page_size:X}")
+                    return False
+                done = min(off + chunk, len(data))
+                print(f"\r  Progress: {(done * 100) // len(data)}%", end='', flush=True)
+            print()
+            print(f"✓ Programmed {pages} pages ({skipped} blank skipped) in "
+                  f"{time.time() - start:.2f}s, page write max {busy_max} µs")
+            return True
+        finally:
+            self.updi_exit()
+    
     def avr_read_signature(self) -> Tuple[int, int, int]:
         """Read AVR device signature"""
         if self.isp_enter():
@@ -860,6 +1899,138 @@ class OPUPClient:
             self.isp_exit()
             return s0, s1, s2
         return 0, 0, 0
+    
+    def swd_init(self, hz: Optional[int] = None) -> Optional[int]:
+        """Connect over SWD (optionally setting SWCLK); returns the DP IDCODE"""
+        payload = struct.pack('<I', hz) if hz else b''
+        ok, resp = self.send_command(OpupCmd.SWD_INIT, payload)
+        if ok and len(resp) >= 4:
+            idcode = struct.unpack('<I', resp[:4])[0]
+            print(f"✓ SWD IDCODE: 0x{idcode:08X}")
+            return idcode
+        print("✗ No SWD target")
+        return None
+    
+    def swd_read(self, ap: bool, addr: int) -> Optional[int]:
+        """Read a DP or AP register (AP: APSEL in addr bits 31:24)"""
+        ok, resp = self.send_command(OpupCmd.SWD_READ, struct.pack('<BI', int(ap), addr))
+        if ok and len(resp) >= 4:
+            return struct.unpack('<I', resp[:4])[0]
+        return None
+    
+    def swd_write(self, ap: bool, addr: int, value: int) -> bool:
+        """Write a DP or AP register"""
+        ok, _ = self.send_command(OpupCmd.SWD_WRITE, struct.pack('<BII', int(ap), addr, value))
+        return ok
+    
+    def swd_mem_read(self, addr: int, length: int, size: int = 4) -> Optional[bytes]:
+        """Read target memory through the MEM-AP (up to 4KB per frame; needs swd_init)"""
+        out = bytearray()
+        while len(out) < length:
+            n = min(OPUP_MAX_PAYLOAD, length - len(out))
+            ok, data = self.send_command(OpupCmd.SWD_MEM_READ,
+                                         struct.pack('<IHB', addr + len(out), n, size), timeout=5.0)
+            if not ok or len(data) != n:
+                print(f"\n✗ SWD memory read failed at 0x{addr + len(out):08X}")
+                return None
+            out += data
+            if length > n:
+                print(f"\r  Progress: {(len(out) * 100) // length}%", end='', flush=True)
+        if length > OPUP_MAX_PAYLOAD:
+            print()
+        return bytes(out)
+    
+    def swd_mem_write(self, addr: int, data: bytes, size: int = 4) -> bool:
+        """Write target memory through the MEM-AP (needs swd_init)"""
+        chunk = (OPUP_MAX_PAYLOAD - 5) & ~3
+        for off in range(0, len(data), chunk):
+            payload = struct.pack('<IB', addr + off, size) + data[off:off + chunk]
+            ok, _ = self.send_command(OpupCmd.SWD_MEM_WRITE, payload, timeout=5.0)
+            if not ok:
+                print(f"\n✗ SWD memory write failed at 0x{addr + off:08X}")
+                return False
+            if len(data) > chunk:
+                done = min(off + chunk, len(data))
+                print(f"\r  Progress: {(done * 100) // len(data)}%", end='', flush=True)
+        if len(data) > chunk:
+            print()
+        return True
+    
+    def swd_dump(self, filename: str, addr: int, length: int, size: int = 4) -> bool:
+        """Dump target memory to a file over SWD"""
+        if self.swd_init() is None:
+            return False
+        start = time.time()
+        data = self.swd_mem_read(addr, length, size)
+        if data is None:
+            return False
+        with open(filename, 'wb') as f:
+            f.write(data)
+        elapsed = time.time() - start
+        print(f"✓ Saved {length} bytes from 0x{addr:08X} to {filename} in {elapsed:.2f}s "
+              f"({length / 1024 / max(elapsed, 1e-6):.1f} KB/s)")
+        return True
+    
+    def stm32_flash(self, data: bytes, addr: int = STM32_FLASH_BASE, erase: bool = True,
+                    verify: bool = False) -> bool:
+        """Program STM32F1/F4 flash through the RAM-resident loader (mass erase first)"""
+        if len(data) % 4:
+            data += b'\xff' * (4 - len(data) % 4)
+        if self.swd_init() is None:
+            return False
+        flags = STM32_FLASH_MASS_ERASE if erase else 0
+        ok, resp = self.send_command(OpupCmd.STM32_FLASH_BEGIN, bytes([flags]), timeout=60.0)
+        if not ok or len(resp) < 5:
+            print("✗ STM32_FLASH_BEGIN rejected")
+            return False
+        status, dev_id, kb = struct.unpack('<BHH', resp[:5])
+        if dev_id:
+            print(f"  DEV_ID: 0x{dev_id:03X}, flash {kb} KB")
+        if status != 0:
+            print(f"✗ STM32 loader: {STM32_FLASH_STATUS.get(status, status)}")
+            return False
+        if erase:
+            print("✓ Mass erased")
+        
+        print(f"Programming {len(data)} bytes at 0x{addr:08X}...")
+        start = time.time()
+        chunk = OPUP_MAX_PAYLOAD - 4
+        written = True
+        for off in range(0, len(data), chunk):
+            payload = struct.pack('<I', addr + off) + data[off:off + chunk]
+            ok, _ = self.send_command(OpupCmd.STM32_FLASH_WRITE, payload, timeout=5.0)
+            if not ok:
+                print(f"\n✗ Write rejected at 0x{addr + off:08X}")
+                written = False
+                break
+            done = min(off + chunk, len(data))
+            print(f"\r  Progress: {(done * 100) // len(data)}%", end='', flush=True)
+        print()
+        
+        # Always ends the session: locks the flash and reports the SR errors
+        ok, resp = self.send_command(OpupCmd.STM32_FLASH_END, timeout=5.0)
+        if not ok or len(resp) < 4:
+            print("✗ Loader stopped answering")
+            return False
+        sr = struct.unpack('<I', resp[:4])[0]
+        if sr:
+            print(f"✗ Flash error, SR bits 0x{sr:08X}")
+            return False
+        if not written:
+            return False
+        elapsed = time.time() - start
+        print(f"✓ Programmed {len(data)} bytes in {elapsed:.2f}s "
+              f"({len(data) / 1024 / max(elapsed, 1e-6):.1f} KB/s)")
+        
+        if verify:
+            readback = self.swd_mem_read(addr, len(data))
+            if readback != data:
+                if readback is not None:
+                    diff = next(i for i in range(len(data)) if readback[i] != data[i])
+                    print(f"✗ Verify failed at 0x{addr + diff:08X}")
+                return False
+            print("✓ Verified")
+        return True
 
 
 def main():
@@ -913,7 +2084,48 @@ Examples:
             client.get_status()
         
         elif cmd == 'i2c-scan':
-            client.i2c_scan()
+            client.i2c_scan('quick' in args.args)
+        
+        elif cmd == 'i2c-engine':
+            if args.args and args.args[0].lower() not in ('wire', 'pio'):
+                print("Usage: i2c-engine [wire|pio]")
+            else:
+                client.i2c_engine(args.args[0].lower() if args.args else None)
+        
+        elif cmd == 'i2c-dump':
+            if len(args.args) < 2:
+                print("Usage: i2c-dump <file> <size> [mem] [dev] [addr8]")
+                print("Example: i2c-dump 24c512.bin 65536")
+            else:
+                nums = [int(a, 0) for a in args.args[1:] if a != 'addr8']
+                client.i2c_dump(args.args[0], nums[0], nums[1] if len(nums) > 1 else 0,
+                                nums[2] if len(nums) > 2 else 0x50,
+                                1 if 'addr8' in args.args else 2)
+        
+        elif cmd == 'i2c-batch':
+            ops = [a for a in args.args if a != 'continue']
+            if not ops:
+                print("Usage: i2c-batch <op> [op...] [continue]")
+                print("  w:ADDR:HEX  r:ADDR:LEN  wr:ADDR:HEX:LEN  d:US  p:ADDR:HEX:MASK:VALUE[:MS]")
+                print("Example: i2c-batch w:68:6B00 d:1000 wr:68:75:1 p:68:3A:01:01")
+            else:
+                client.i2c_batch(I2CBatch.parse(ops), 'continue' in args.args)
+        
+        elif cmd == 'i2c-speed':
+            client.i2c_speed(int(args.args[0], 0) if args.args else None)
+        
+        elif cmd == 'i2c-eeprom-write':
+            if len(args.args) < 2:
+                print("Usage: i2c-eeprom-write <file> <page_size> [mem] [dev] [addr8] [verify]")
+                print("Example: i2c-eeprom-write 24c512.bin 128 0 0x50 verify")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                nums = [int(a, 0) for a in args.args[1:] if a not in ('addr8', 'verify')]
+                client.i2c_eeprom_write(data, nums[0], nums[1] if len(nums) > 1 else 0,
+                                        nums[2] if len(nums) > 2 else 0x50,
+                                        1 if 'addr8' in args.args else 2,
+                                        'verify' in args.args)
         
         elif cmd == 'spi-scan':
             client.spi_scan()
@@ -927,6 +2139,42 @@ Examples:
                 data = bytes.fromhex(hex_data)
                 client.spi_transfer(data)
         
+        elif cmd == 'spi-config':
+            if len(args.args) < 2:
+                print("Usage: spi-config <mode> <hz> [setup_ns hold_ns [cs_timeout_ms]]")
+                print("Example: spi-config 0 31250000 20 20")
+            else:
+                timing = [int(a) for a in args.args[2:5]] if len(args.args) >= 4 else []
+                client.spi_config(int(args.args[0]), int(args.args[1], 0), *timing)
+        
+        elif cmd == 'spi-read':
+            length = int(args.args[0], 0) if args.args else 256
+            fill = int(args.args[1], 0) if len(args.args) > 1 else 0xFF
+            t0 = time.time()
+            data = client.spi_read(length, fill)
+            dt = time.time() - t0
+            if data:
+                print(f"✓ Read {len(data)} bytes in {dt * 1000:.1f} ms")
+                print(f"  {data[:32].hex(' ')}{' ...' if len(data) > 32 else ''}")
+        
+        elif cmd == 'spi-stream':
+            if len(args.args) < 2:
+                print("Usage: spi-stream <hex_cmd> <length> [file]")
+                print("Example: spi-stream 03000000 1048576 dump.bin")
+            else:
+                length = int(args.args[1], 0)
+                t0 = time.time()
+                data = client.spi_stream(bytes.fromhex(args.args[0]), length)
+                dt = time.time() - t0
+                if data:
+                    print(f"✓ Streamed {len(data)} bytes in {dt:.2f} s "
+                          f"({len(data) / 1024 / max(dt, 1e-6):.1f} KB/s)")
+                    if len(args.args) > 2:
+                        with open(args.args[2], 'wb') as f:
+                            f.write(data)
+                    else:
+                        print(f"  {data[:32].hex(' ')}{' ...' if len(data) > 32 else ''}")
+        
         elif cmd == 'spi-jedec':
             client.spi_read_jedec()
         
@@ -946,12 +2194,126 @@ Examples:
         elif cmd == 'avr-sig':
             client.avr_read_signature()
         
+        elif cmd == 'avr-flash':
+            if not args.args:
+                print("Usage: avr-flash <file.bin> [page_size] [addr] [noerase]")
+                print("Example: avr-flash blink.bin 128")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                nums = [int(a, 0) for a in args.args[1:] if a != 'noerase']
+                client.avr_flash(data, nums[0] if nums else 128,
+                                 nums[1] if len(nums) > 1 else 0,
+                                 'noerase' not in args.args)
+        
+        elif cmd == 'avr-dump':
+            if len(args.args) < 3 or args.args[1] not in AVR_MEMORY:
+                print("Usage: avr-dump <file> <flash|eeprom|fuses|lock|signature> <size> [addr]")
+                print("Example: avr-dump m328p.bin flash 32768")
+            else:
+                client.avr_dump(args.args[0], args.args[1], int(args.args[2], 0),
+                                int(args.args[3], 0) if len(args.args) > 3 else 0)
+        
+        elif cmd == 'avr-verify':
+            if not args.args:
+                print("Usage: avr-verify <file.bin> [flash|eeprom] [addr]")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                mem = next((a for a in args.args[1:] if a in AVR_MEMORY), 'flash')
+                nums = [int(a, 0) for a in args.args[1:] if a not in AVR_MEMORY]
+                client.avr_verify(data, mem, nums[0] if nums else 0)
+        
+        elif cmd == 'updi-info':
+            if client.updi_enter(int(args.args[0], 0) if args.args else None) is not None:
+                sig = client.updi_read(0x1100, 3)  # SIGROW
+                if sig:
+                    print(f"  Signature: {sig.hex(' ').upper()}")
+            client.updi_exit()
+        
+        elif cmd == 'updi-erase':
+            client.updi_erase()
+        
+        elif cmd == 'updi-dump':
+            if len(args.args) < 3:
+                print("Usage: updi-dump <file> <addr> <size>")
+                print("Example: updi-dump t1614.bin 0x8000 16384")
+            else:
+                client.updi_dump(args.args[0], int(args.args[1], 0), int(args.args[2], 0))
+        
+        elif cmd == 'updi-flash':
+            if not args.args:
+                print("Usage: updi-flash <file.bin> [addr] [page_size] [eeprom] [noerase]")
+                print("Example: updi-flash blink.bin 0x8000 64")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                nums = [int(a, 0) for a in args.args[1:] if a not in ('eeprom', 'noerase')]
+                eeprom = 'eeprom' in args.args
+                client.updi_flash(data, nums[0] if nums else None,
+                                  nums[1] if len(nums) > 1 else (32 if eeprom else 64),
+                                  eeprom, 'noerase' not in args.args)
+        
         elif cmd == 'isp-enter':
-            client.isp_enter()
+            if args.args:
+                # 'auto' drops a pinned SCK
+                client.isp_enter(0 if args.args[0] == 'auto' else int(args.args[0], 0))
+            else:
+                client.isp_enter()
         
         elif cmd == 'isp-exit':
             client.isp_exit()
         
+        elif cmd == 'swd-init':
+            client.swd_init(int(args.args[0], 0) if args.args else None)
+        
+        elif cmd == 'swd-read':
+            if len(args.args) < 2 or args.args[0] not in ('dp', 'ap'):
+                print("Usage: swd-read <dp|ap> <addr>")
+                print("Example: swd-read ap 0xFC  (AP IDR)")
+            else:
+                value = client.swd_read(args.args[0] == 'ap', int(args.args[1], 0))
+                print(f"✓ 0x{value:08X}" if value is not None else "✗ SWD read failed")
+        
+        elif cmd == 'swd-write':
+            if len(args.args) < 3 or args.args[0] not in ('dp', 'ap'):
+                print("Usage: swd-write <dp|ap> <addr> <value>")
+            else:
+                ok = client.swd_write(args.args[0] == 'ap', int(args.args[1], 0), int(args.args[2], 0))
+                print("✓ Written" if ok else "✗ SWD write failed")
+        
+        elif cmd == 'swd-dump':
+            if len(args.args) < 3 or (len(args.args) > 3 and args.args[3] not in ('8', '16', '32')):
+                print("Usage: swd-dump <file> <addr> <size> [8|16|32]")
+                print("Example: swd-dump sram.bin 0x20000000 0x5000")
+            else:
+                width = int(args.args[3]) // 8 if len(args.args) > 3 else 4
+                client.swd_dump(args.args[0], int(args.args[1], 0), int(args.args[2], 0), width)
+        
+        elif cmd == 'swd-write-mem':
+            if len(args.args) < 2:
+                print("Usage: swd-write-mem <file> <addr>")
+                print("Example: swd-write-mem stub.bin 0x20000000")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                # Byte accesses unless the whole image is word aligned
+                addr = int(args.args[1], 0)
+                width = 4 if not (addr | len(data)) % 4 else 1
+                if client.swd_init() is not None and client.swd_mem_write(addr, data, width):
+                    print(f"✓ Wrote {len(data)} bytes at 0x{addr:08X}")
+        
+        elif cmd == 'stm32-flash':
+            if not args.args:
+                print("Usage: stm32-flash <file.bin> [addr] [noerase] [verify]")
+                print("Example: stm32-flash blink.bin 0x08000000 verify")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                nums = [int(a, 0) for a in args.args[1:] if a not in ('noerase', 'verify')]
+                client.stm32_flash(data, nums[0] if nums else STM32_FLASH_BASE,
+                                   'noerase' not in args.args, 'verify' in args.args)
+        
         elif cmd == 'help':
             parser.print_help()
         
@@ -1000,6 +2362,22 @@ Examples:
         elif cmd == 'qspi-status':
             client.qspi_read_status()
         
+        elif cmd == 'qspi-autotune':
+            force = 'force' in args.args
+            modes = [int(a) for a in args.args if a != 'force']
+            client.qspi_autotune(modes or None, force)
+        
+        elif cmd == 'qspi-probe':
+            addr = int(args.args[0], 0) if args.args else 0
+            length = int(args.args[1]) if len(args.args) > 1 else 1024
+            client.qspi_probe_modes(addr, length)
+        
+        elif cmd == 'spi-autotune':
+            client.spi_autotune(force='force' in args.args)
+        
+        elif cmd == 'qspi-stats':
+            client.qspi_stats(reset=bool(args.args and args.args[0] == 'reset'))
+        
         elif cmd == 'flash-read':
             if len(args.args) < 1:
                 print("Usage: flash-read <addr> [length]")
@@ -1018,6 +2396,57 @@ Examples:
                 data = bytes.fromhex(args.args[1])
                 client.flash_write(addr, data)
         
+        elif cmd == 'flash-patch':
+            if len(args.args) < 2 or len(args.args) % 2:
+                print("Usage: flash-patch <addr> <hex_data> [<addr> <hex_data> ...]")
+                print("Example: flash-patch 0x100010 DEADBEEF 0x100800 00")
+            else:
+                edits = [(int(args.args[i], 0), bytes.fromhex(args.args[i + 1]))
+                         for i in range(0, len(args.args), 2)]
+                client.flash_patch(edits)
+        
+        elif cmd == 'flash-dump':
+            if len(args.args) < 3:
+                print("Usage: flash-dump <addr> <length> <file>")
+                print("Example: flash-dump 0x0 0x2000000 w25q256.bin")
+            else:
+                client.flash_dump(int(args.args[0], 0), int(args.args[1], 0), args.args[2])
+        
+        elif cmd == 'flash-config':
+            if not args.args:
+                client.flash_config()
+            else:
+                quad = bool(int(args.args[0]))
+                addr_mode = int(args.args[1]) if len(args.args) > 1 else None
+                read_chain = bool(int(args.args[2])) if len(args.args) > 2 else None
+                read_ahead = bool(int(args.args[3])) if len(args.args) > 3 else None
+                client.flash_config(quad, addr_mode, read_chain, read_ahead)
+        
+        elif cmd == 'job-status':
+            client.job_status()
+        
+        elif cmd == 'job-abort':
+            client.job_abort(int(args.args[0], 0) if args.args else 0)
+        
+        elif cmd == 'gang-config':
+            if not args.args:
+                client.gang_config()
+            elif len(args.args) == 1:
+                client.gang_config(select=int(args.args[0], 0))
+            else:
+                client.gang_config(select=int(args.args[0], 0),
+                                   pins=[int(p, 0) for p in args.args[1:]])
+        
+        elif cmd == 'gang-write':
+            if len(args.args) < 2:
+                print("Usage: gang-write <file> <addr> [mask]")
+                print("Example: gang-write firmware.bin 0x0 0x0F")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    image = f.read()
+                mask = int(args.args[2], 0) if len(args.args) > 2 else 0xFF
+                client.gang_write(int(args.args[1], 0), image, mask)
+        
         elif cmd == 'flash-erase':
             if len(args.args) < 1:
                 print("Usage: flash-erase <addr> [sector|block32|block64|chip]")
@@ -1047,6 +2476,41 @@ Examples:
             addr = int(args.args[1], 0) if len(args.args) > 1 else 0x100000
             client.flash_benchmark(size_kb, addr)
         
+        elif cmd == 'nand-info':
+            client.nand_info('rescan' in args.args, 'single' in args.args)
+        
+        elif cmd == 'nand-dump':
+            if not args.args:
+                print("Usage: nand-dump <file> [page] [count] [raw] [spare]")
+                print("Example: nand-dump w25n01.bin 0 65536 raw spare")
+            else:
+                nums = [int(a, 0) for a in args.args[1:] if a not in ('raw', 'spare')]
+                client.nand_dump(args.args[0], nums[0] if nums else 0,
+                                 nums[1] if len(nums) > 1 else None,
+                                 'raw' in args.args, 'spare' in args.args)
+        
+        elif cmd == 'nand-program':
+            if not args.args:
+                print("Usage: nand-program <file> [page] [noerase]")
+            else:
+                with open(args.args[0], 'rb') as f:
+                    data = f.read()
+                nums = [int(a, 0) for a in args.args[1:] if a != 'noerase']
+                client.nand_program(data, nums[0] if nums else 0, 'noerase' not in args.args)
+        
+        elif cmd == 'nand-erase':
+            if not args.args:
+                print("Usage: nand-erase <block> [count]")
+            else:
+                client.nand_erase(int(args.args[0], 0),
+                                  int(args.args[1], 0) if len(args.args) > 1 else 1)
+        
+        elif cmd == 'nand-bbt':
+            client.nand_bbt()
+        
+        elif cmd == 'nand-stats':
+            client.nand_stats('reset' in args.args)
+        
         else:
             print(f"Unknown command: {cmd}")
             print("Use 'help' for available commands")
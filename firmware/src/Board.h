@@ -35,6 +35,11 @@ constexpr uint8_t PIN_QSPI_IO3 = 22; // /HOLD
 // AVR ISP (In-System Programming)
 constexpr uint8_t PIN_AVR_RESET = 20;
 
+// AVR UPDI (UART1, half duplex): TX through a 1k resistor to UPDI, RX
+// directly on UPDI
+constexpr uint8_t PIN_UPDI_TX = 8;
+constexpr uint8_t PIN_UPDI_RX = 9;
+
 // STM32 SWD (Serial Wire Debug)
 constexpr uint8_t PIN_SWD_CLK = 2;
 constexpr uint8_t PIN_SWD_DIO = 3;
@@ -0,0 +1,264 @@
+#include "clock_tuner.h"
+#include "Logger.h"
+#include <cstring>
+
+// Define Trace Tag
+#define TAG "TUNE"
+
+#define TUNE_CMD_JEDEC 0x9F
+#define TUNE_CMD_SFDP 0x5A
+#define TUNE_CMD_FAST_READ 0x0B
+
+// QSPI half-period delays, slowest first, and CLK-to-sample delays (cycles)
+static const uint8_t clockSteps[] = {128, 64, 32, 16, 8, 4, 2, 0};
+static const uint8_t sampleSteps[] = {0, 8, 16, 32, 64};
+#define CLOCK_STEP_COUNT (sizeof(clockSteps) / sizeof(clockSteps[0]))
+#define SAMPLE_STEP_COUNT (sizeof(sampleSteps) / sizeof(sampleSteps[0]))
+
+// Hardware SPI rates (clk_peri / even divisors), slowest first
+static const uint32_t spiSteps[] = {1000000,  2000000,  4000000,
+                                    8000000,  12500000, 15625000,
+                                    20833333, 31250000, 62500000};
+#define SPI_STEP_COUNT (sizeof(spiSteps) / sizeof(spiSteps[0]))
+
+static bool validChipId(uint32_t id) { return id != 0 && id != 0xFFFFFF; }
+
+ClockProfile &ClockTuner::profileFor(uint32_t chipId) {
+  for (uint8_t i = 0; i < TUNE_CACHE_SIZE; i++) {
+    if (cache[i].chipId == chipId)
+      return cache[i];
+  }
+  for (uint8_t i = 0; i < TUNE_CACHE_SIZE; i++) {
+    if (cache[i].chipId == 0) {
+      cache[i].chipId = chipId;
+      return cache[i];
+    }
+  }
+
+  ClockProfile &slot = cache[nextSlot];
+  nextSlot = (nextSlot + 1) % TUNE_CACHE_SIZE;
+  slot = ClockProfile();
+  slot.chipId = chipId;
+  return slot;
+}
+
+// ============== QSPI (bit-bang) ==============
+
+uint16_t ClockTuner::readQSPI(QSPIMode mode, uint32_t addr, uint16_t len,
+                              uint8_t *buf) {
+  uint16_t n = 0;
+  if (mode == QSPIMode::STANDARD) {
+    qspi.csLow();
+    qspi.sendCommand(TUNE_CMD_JEDEC);
+    qspi.readData(buf, 3);
+    qspi.csHigh();
+
+    qspi.csLow();
+    qspi.sendCommand(TUNE_CMD_SFDP);
+    qspi.sendAddress(0, 3);
+    qspi.sendDummyCycles(8);
+    qspi.readData(&buf[3], 8);
+    qspi.csHigh();
+    n = TUNE_ID_LEN;
+  }
+
+  // Opcode, address and dummy phases all run in the mode being tuned
+  flash.fastRead(addr, &buf[n], len);
+  return n + len;
+}
+
+bool ClockTuner::passesQSPI(QSPIMode mode, uint32_t addr, uint16_t len,
+                            uint16_t patternLen) {
+  for (uint8_t i = 0; i < TUNE_PASSES; i++) {
+    readQSPI(mode, addr, len, readBuf);
+    if (memcmp(readBuf, refBuf, patternLen) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool ClockTuner::tuneMode(QSPIMode mode, uint32_t addr, uint16_t len,
+                          ClockProfile &profile) {
+  uint8_t m = static_cast<uint8_t>(mode);
+  QSPITiming prev = qspi.getTiming(mode);
+  if (!flash.setBusMode(mode))
+    return false;
+
+  // Reference at the slowest clock with a mid-range sample delay
+  QSPITiming t;
+  t.clockDelay = clockSteps[0];
+  t.sampleDelay = sampleSteps[SAMPLE_STEP_COUNT / 2];
+  qspi.setTiming(mode, t);
+  uint16_t patternLen = readQSPI(mode, addr, len, refBuf);
+  if (!passesQSPI(mode, addr, len, patternLen)) {
+    LOG_ERROR(TAG, "Mode unstable even at the slowest clock");
+    qspi.setTiming(mode, prev);
+    return false;
+  }
+
+  // For each clock step find the longest run of passing sample delays;
+  // stop at the first step where the eye is closed
+  uint8_t centre[CLOCK_STEP_COUNT];
+  uint8_t window[CLOCK_STEP_COUNT];
+  int fastest = -1;
+  for (uint8_t c = 0; c < CLOCK_STEP_COUNT; c++) {
+    uint8_t run = 0, first = 0, bestRun = 0, bestFirst = 0;
+    for (uint8_t s = 0; s < SAMPLE_STEP_COUNT; s++) {
+      t.clockDelay = clockSteps[c];
+      t.sampleDelay = sampleSteps[s];
+      qspi.setTiming(mode, t);
+      if (!passesQSPI(mode, addr, len, patternLen)) {
+        run = 0;
+        continue;
+      }
+      if (run++ == 0)
+        first = s;
+      if (run > bestRun) {
+        bestRun = run;
+        bestFirst = first;
+      }
+    }
+    if (bestRun == 0)
+      break;
+    centre[c] = sampleSteps[bestFirst + (bestRun - 1) / 2];
+    window[c] = bestRun;
+    fastest = c;
+  }
+
+  if (fastest < 0) {
+    qspi.setTiming(mode, prev);
+    return false;
+  }
+
+  // Back off one step from the fastest passing clock for margin
+  uint8_t chosen = fastest > 0 ? fastest - 1 : 0;
+  t.clockDelay = clockSteps[chosen];
+  t.sampleDelay = centre[chosen];
+  profile.qspi[m] = t;
+  profile.window[m] = window[chosen];
+  profile.qspiTuned |= 1 << m;
+  return true;
+}
+
+const ClockProfile *ClockTuner::tuneQSPI(uint8_t modeMask, uint32_t addr,
+                                         uint16_t len, bool force,
+                                         bool &cached) {
+  QSPIMode prevMode = qspi.getMode();
+  bool prevAhead = flash.getReadAhead();
+  bool prevChain = flash.getReadChaining();
+  // Every check read must be a complete, independent transaction
+  flash.setReadAhead(false);
+  flash.setReadChaining(false);
+  cached = false;
+
+  // Identify the chip at the slowest Standard timing
+  const ClockProfile *result = nullptr;
+  uint8_t id[3] = {0};
+  if (flash.setBusMode(QSPIMode::STANDARD)) {
+    QSPITiming prevStd = qspi.getTiming(QSPIMode::STANDARD);
+    QSPITiming slow;
+    slow.clockDelay = clockSteps[0];
+    slow.sampleDelay = sampleSteps[SAMPLE_STEP_COUNT / 2];
+    qspi.setTiming(QSPIMode::STANDARD, slow);
+    qspi.csLow();
+    qspi.sendCommand(TUNE_CMD_JEDEC);
+    qspi.readData(id, 3);
+    qspi.csHigh();
+    qspi.setTiming(QSPIMode::STANDARD, prevStd);
+  }
+
+  uint32_t chipId = chipIdOf(id);
+  if (validChipId(chipId)) {
+    ClockProfile &profile = profileFor(chipId);
+    cached = !force && (profile.qspiTuned & modeMask) == modeMask;
+    if (!cached) {
+      for (uint8_t m = 0; m < QSPI_MODE_COUNT; m++) {
+        if (!(modeMask & (1 << m)))
+          continue;
+        profile.qspiTuned &= ~(1 << m);
+        tuneMode(static_cast<QSPIMode>(m), addr, len, profile);
+      }
+    }
+
+    // Apply the whole profile: untuned modes drop another chip's timing
+    for (uint8_t m = 0; m < QSPI_MODE_COUNT; m++) {
+      qspi.setTiming(static_cast<QSPIMode>(m), (profile.qspiTuned & (1 << m))
+                                                   ? profile.qspi[m]
+                                                   : QSPITiming());
+    }
+    result = &profile;
+  }
+
+  flash.setBusMode(prevMode);
+  flash.setReadChaining(prevChain);
+  flash.setReadAhead(prevAhead);
+  return result;
+}
+
+// ============== HARDWARE SPI ==============
+
+uint16_t ClockTuner::readSPI(uint32_t addr, uint16_t len, uint8_t *buf) {
+  uint8_t cmd[5] = {TUNE_CMD_JEDEC};
+  spi.write(SPI_CS_PIN, cmd, 1, true);
+  spi.read(SPI_CS_PIN, buf, 3);
+
+  cmd[0] = TUNE_CMD_SFDP;
+  spi.write(SPI_CS_PIN, cmd, 5, true); // 24-bit address 0 + 8 dummy clocks
+  spi.read(SPI_CS_PIN, &buf[3], 8);
+
+  cmd[0] = TUNE_CMD_FAST_READ;
+  cmd[1] = (addr >> 16) & 0xFF;
+  cmd[2] = (addr >> 8) & 0xFF;
+  cmd[3] = addr & 0xFF;
+  spi.write(SPI_CS_PIN, cmd, 5, true);
+  spi.read(SPI_CS_PIN, &buf[TUNE_ID_LEN], len);
+  return TUNE_ID_LEN + len;
+}
+
+bool ClockTuner::passesSPI(uint32_t addr, uint16_t len, uint16_t patternLen) {
+  for (uint8_t i = 0; i < TUNE_PASSES; i++) {
+    readSPI(addr, len, readBuf);
+    if (memcmp(readBuf, refBuf, patternLen) != 0)
+      return false;
+  }
+  return true;
+}
+
+const ClockProfile *ClockTuner::tuneSPI(uint32_t addr, uint16_t len,
+                                        bool force, bool &cached) {
+  uint32_t prevHz = spi.getFrequency();
+  uint8_t mode = spi.getMode();
+  cached = false;
+
+  spi.configure(spiSteps[0], mode);
+  uint16_t patternLen = readSPI(addr, len, refBuf);
+  uint32_t chipId = chipIdOf(refBuf);
+  if (!validChipId(chipId)) {
+    spi.configure(prevHz, mode);
+    return nullptr;
+  }
+
+  ClockProfile &profile = profileFor(chipId);
+  cached = !force && profile.spiHz != 0;
+  if (!cached) {
+    profile.spiHz = 0;
+    if (!passesSPI(addr, len, patternLen)) {
+      LOG_ERROR(TAG, "SPI unstable even at 1MHz");
+      spi.configure(prevHz, mode);
+      return nullptr;
+    }
+
+    uint8_t fastest = 0;
+    for (uint8_t i = 1; i < SPI_STEP_COUNT; i++) {
+      spi.configure(spiSteps[i], mode);
+      if (!passesSPI(addr, len, patternLen))
+        break;
+      fastest = i;
+    }
+    // Back off one step from the fastest passing rate for margin
+    profile.spiHz = spiSteps[fastest > 0 ? fastest - 1 : 0];
+  }
+
+  spi.configure(profile.spiHz, mode);
+  return &profile;
+}
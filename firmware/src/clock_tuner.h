@@ -0,0 +1,96 @@
+#pragma once
+#include "qspi_driver.h"
+#include "spi_driver.h"
+#include "spi_flash.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+// Chips whose tuned profile is remembered (RAM, until reset)
+#define TUNE_CACHE_SIZE 8
+
+// Consecutive identical reads required for a setting to pass
+#define TUNE_PASSES 4
+
+// Check region read in the tuned mode (default and largest length)
+#define TUNE_REGION_DEFAULT 256
+#define TUNE_REGION_MAX 1024
+
+// JEDEC ID (3) + SFDP header (8) prefix of the Standard/SPI check pattern
+#define TUNE_ID_LEN 11
+
+/**
+ * @brief Tuned bus settings of one chip (one fixture/cable)
+ */
+struct ClockProfile {
+  uint32_t chipId = 0;    // JEDEC ID (Mfg << 16 | Type << 8 | Cap), 0 = free
+  uint32_t spiHz = 0;     // Hardware SPI clock, 0 = not tuned
+  uint8_t qspiTuned = 0;  // Bit n: qspi[n] was tuned for QSPIMode n
+  QSPITiming qspi[QSPI_MODE_COUNT];
+  uint8_t window[QSPI_MODE_COUNT] = {}; // Passing sample delays (margin)
+};
+
+/**
+ * @brief Signal-integrity clock autotuning for SPI and QSPI
+ *
+ * A check pattern (JEDEC ID, SFDP header and a flash region) is read at
+ * the slowest setting to get a reference, then repeatedly at faster
+ * settings. For the bit-banged QSPI modes every clock delay is tried with
+ * several sample delays; the centre of the passing sample window is used.
+ * The fastest passing step is not used directly: the tuner backs off one
+ * step to leave margin. Results are cached per JEDEC ID, so re-running the
+ * tuner on a known chip only applies its profile.
+ */
+class ClockTuner {
+public:
+  ClockTuner(QSPIDriver &qspiDriver, SPIFlash &flashEngine,
+             SPIDriver &spiDriver)
+      : qspi(qspiDriver), flash(flashEngine), spi(spiDriver) {}
+
+  /**
+   * @brief Tune QSPI clock/sample delays for every mode in modeMask
+   *
+   * The bus mode is restored afterwards. Modes that cannot be entered or
+   * never read back the reference keep their previous timing.
+   * @param modeMask Bit n selects QSPIMode n
+   * @param addr,len Region read in each mode (below 16MB)
+   * @param force Re-tune even if the chip is cached
+   * @param cached Set if the cached profile was applied instead
+   * @return Profile of the chip, nullptr if no chip answered
+   */
+  const ClockProfile *tuneQSPI(uint8_t modeMask, uint32_t addr, uint16_t len,
+                               bool force, bool &cached);
+
+  /**
+   * @brief Tune the hardware SPI clock (SPI mode is kept)
+   *
+   * Rates are raised from 1MHz until the pattern stops matching.
+   * @return Profile of the chip, nullptr if no chip answered
+   */
+  const ClockProfile *tuneSPI(uint32_t addr, uint16_t len, bool force,
+                              bool &cached);
+
+private:
+  QSPIDriver &qspi;
+  SPIFlash &flash;
+  SPIDriver &spi;
+
+  ClockProfile cache[TUNE_CACHE_SIZE];
+  uint8_t nextSlot = 0; // Replaced next when the cache is full
+
+  uint8_t refBuf[TUNE_ID_LEN + TUNE_REGION_MAX];
+  uint8_t readBuf[TUNE_ID_LEN + TUNE_REGION_MAX];
+
+  ClockProfile &profileFor(uint32_t chipId);
+
+  uint16_t readQSPI(QSPIMode mode, uint32_t addr, uint16_t len, uint8_t *buf);
+  uint16_t readSPI(uint32_t addr, uint16_t len, uint8_t *buf);
+  bool passesQSPI(QSPIMode mode, uint32_t addr, uint16_t len,
+                  uint16_t patternLen);
+  bool passesSPI(uint32_t addr, uint16_t len, uint16_t patternLen);
+  bool tuneMode(QSPIMode mode, uint32_t addr, uint16_t len,
+                ClockProfile &profile);
+
+  static uint32_t chipIdOf(const uint8_t *id) {
+    return ((uint32_t)id[0] << 16) | (id[1] << 8) | id[2];
+  }
+};
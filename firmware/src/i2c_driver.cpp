@@ -5,45 +5,243 @@ void I2CDriver::begin() {
   Wire.setSDA(Board::PIN_I2C_SDA);
   Wire.setSCL(Board::PIN_I2C_SCL);
   Wire.begin();
-  Wire.setClock(400000); // 400kHz Fast Mode
+  Wire.setClock(clockHz);
 }
 
-void I2CDriver::scan(uint8_t *found_addresses, uint8_t &count) {
+bool I2CDriver::setClock(uint32_t hz) {
+  if (hz < I2C_MIN_HZ || hz > I2C_MAX_HZ)
+    return false;
+  clockHz = hz;
+  if (engine == I2CEngine::PIO)
+    pio.setClock(hz);
+  else
+    Wire.setClock(hz);
+  return true;
+}
+
+bool I2CDriver::setEngine(I2CEngine e) {
+  if (e == engine)
+    return true;
+  if (e == I2CEngine::PIO) {
+    Wire.end();
+    if (!pio.begin(Board::PIN_I2C_SDA, Board::PIN_I2C_SCL, clockHz)) {
+      begin(); // Keep the bus usable
+      return false;
+    }
+  } else {
+    pio.end();
+    begin();
+  }
+  engine = e;
+  return true;
+}
+
+// ============== BUS PRIMITIVES ==============
+
+bool I2CDriver::probe(uint8_t addr) {
+  if (engine == I2CEngine::PIO)
+    return pio.probe(addr, PIO_I2C_STRETCH_TIMEOUT_US);
+  Wire.beginTransmission(addr);
+  return Wire.endTransmission() == 0;
+}
+
+bool I2CDriver::writeBytes(uint8_t addr, const uint8_t *prefix,
+                           uint8_t prefixLen, const uint8_t *data,
+                           uint16_t len, bool stop) {
+  if (engine == I2CEngine::PIO)
+    return pio.write(addr, prefix, prefixLen, data, len, stop);
+
+  Wire.beginTransmission(addr);
+  size_t written = Wire.write(prefix, prefixLen);
+  written += Wire.write(data, len);
+  if (written != (size_t)prefixLen + len) {
+    Wire.endTransmission();
+    return false;
+  }
+  return Wire.endTransmission(stop) == 0;
+}
+
+bool I2CDriver::readBytes(uint8_t addr, uint8_t *data, uint16_t len) {
+  if (engine == I2CEngine::PIO)
+    return pio.read(addr, data, len);
+
+  // requestFrom fails above the Wire buffer size: the device's address
+  // counter carries on across chunks (EEPROM current address read)
+  uint16_t received = 0;
+  while (received < len) {
+    uint16_t n = len - received;
+    if (n > I2C_WIRE_BUFFER)
+      n = I2C_WIRE_BUFFER;
+    if (Wire.requestFrom(addr, (size_t)n) != n)
+      return false;
+    for (uint16_t i = 0; i < n; i++)
+      data[received++] = Wire.read();
+  }
+  return true;
+}
+
+// ============== TRANSFERS ==============
+
+void I2CDriver::scan(uint8_t *found_addresses, uint8_t &count, bool quick) {
+  // Quick scan runs on the PIO engine, whatever the current one is
+  I2CEngine prev = engine;
+  if (quick && !setEngine(I2CEngine::PIO))
+    quick = false;
+
   count = 0;
   for (uint8_t address = 1; address < 127; address++) {
-    Wire.beginTransmission(address);
-    uint8_t error = Wire.endTransmission();
-    if (error == 0) {
+    bool ack = quick ? pio.probe(address, PIO_I2C_SCAN_TIMEOUT_US)
+                     : probe(address);
+    if (ack) {
       found_addresses[count++] = address;
       if (count >= 128)
         break; // Safety
     }
   }
+  setEngine(prev);
 }
 
 bool I2CDriver::read(uint8_t addr, uint16_t len, uint8_t *data) {
-  uint16_t received = 0;
+  return readBytes(addr, data, len);
+}
 
-  // Chunked reading if necessary, but Wire buffer is usually limited
-  // For large reads, we might need multiple requests or a custom driver.
-  // Standard Wire buffer is 256 bytes on RP2040 usually.
+bool I2CDriver::write(uint8_t addr, uint8_t *data, uint16_t len) {
+  return writeBytes(addr, nullptr, 0, data, len, true);
+}
 
-  uint8_t requested = Wire.requestFrom(addr, (size_t)len);
-  if (requested != len)
+bool I2CDriver::writeRead(uint8_t addr, const uint8_t *wdata, uint8_t wlen,
+                          uint8_t *rdata, uint16_t rlen) {
+  if (wlen && !writeBytes(addr, nullptr, 0, wdata, wlen, false))
     return false;
+  return readBytes(addr, rdata, rlen);
+}
 
-  while (Wire.available()) {
-    data[received++] = Wire.read();
+bool I2CDriver::pollValue(uint8_t addr, const uint8_t *wdata, uint8_t wlen,
+                          uint8_t mask, uint8_t value, uint16_t timeoutMs,
+                          uint8_t &last, bool &timedOut) {
+  uint32_t start = millis();
+  timedOut = false;
+  for (;;) {
+    if (!writeRead(addr, wdata, wlen, &last, 1))
+      return false;
+    if ((last & mask) == value)
+      return true;
+    if (millis() - start > timeoutMs) {
+      timedOut = true;
+      return false;
+    }
   }
-  return received == len;
 }
 
-bool I2CDriver::write(uint8_t addr, uint8_t *data, uint16_t len) {
-  Wire.beginTransmission(addr);
-  size_t written = Wire.write(data, len);
-  if (written != len) {
-    Wire.endTransmission();
-    return false;
+bool I2CDriver::ackPoll(uint8_t addr, uint32_t timeoutUs,
+                        uint32_t &elapsedUs) {
+  uint32_t start = micros();
+  for (;;) {
+    // Address-only write: the EEPROM NAKs until its write cycle is over
+    if (probe(addr)) {
+      elapsedUs = micros() - start;
+      return true;
+    }
+    if (micros() - start > timeoutUs) {
+      elapsedUs = timeoutUs;
+      return false;
+    }
+  }
+}
+
+bool I2CDriver::readMem(uint8_t addr, uint8_t addrWidth, uint32_t memAddr,
+                        uint8_t *data, uint16_t len) {
+  if (addrWidth == 0)
+    return read(addr, len, data);
+
+  uint32_t blockMask = (1UL << (8 * addrWidth)) - 1;
+  uint16_t received = 0;
+  while (received < len) {
+    uint32_t mem = memAddr + received;
+    uint16_t n = len - received;
+    if (n > maxChunk())
+      n = maxChunk();
+    // Sequential reads wrap inside the addressed block: never cross it
+    if (n > blockMask + 1 - (mem & blockMask))
+      n = blockMask + 1 - (mem & blockMask);
+
+    uint8_t dev = deviceAddress(addr, addrWidth, mem);
+    uint8_t prefix[2];
+    memAddress(addrWidth, mem, prefix);
+    if (!writeBytes(dev, prefix, addrWidth, nullptr, 0, false) ||
+        !readBytes(dev, &data[received], n))
+      return false;
+    received += n;
+  }
+  return true;
+}
+
+void I2CDriver::memAddress(uint8_t addrWidth, uint32_t memAddr,
+                           uint8_t *out) {
+  if (addrWidth == 2)
+    *out++ = memAddr >> 8;
+  *out = memAddr;
+}
+
+bool I2CDriver::verifyPage(uint8_t dev, uint8_t addrWidth, uint32_t memAddr,
+                           const uint8_t *data, uint16_t len) {
+  // Random read: address write, repeated start, sequential read
+  uint8_t buf[I2C_WIRE_BUFFER];
+  uint8_t prefix[2];
+  for (uint16_t done = 0; done < len;) {
+    uint16_t n = len - done;
+    if (n > sizeof(buf))
+      n = sizeof(buf);
+    memAddress(addrWidth, memAddr + done, prefix);
+    if (!writeBytes(dev, prefix, addrWidth, nullptr, 0, false) ||
+        !readBytes(dev, buf, n) || memcmp(buf, &data[done], n) != 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+void I2CDriver::eepromWrite(uint8_t addr, uint8_t addrWidth, uint16_t pageSize,
+                            uint32_t memAddr, const uint8_t *data,
+                            uint16_t len, bool verify,
+                            I2CEepromResult &result) {
+  result = I2CEepromResult();
+  // Pages larger than the Wire buffer are written in several cycles
+  uint16_t chunkMax = maxChunk() - addrWidth;
+
+  while (result.written < len) {
+    uint32_t mem = memAddr + result.written;
+    uint16_t n = pageSize - (mem % pageSize);
+    if (n > len - result.written)
+      n = len - result.written;
+    if (n > chunkMax)
+      n = chunkMax;
+
+    uint8_t dev = deviceAddress(addr, addrWidth, mem);
+    const uint8_t *src = data + result.written;
+    uint8_t prefix[2];
+    memAddress(addrWidth, mem, prefix);
+    if (!writeBytes(dev, prefix, addrWidth, src, n, true)) {
+      result.status = I2CEepromStatus::NAK;
+      return;
+    }
+
+    uint32_t twr;
+    if (!ackPoll(dev, I2C_EEPROM_TWR_TIMEOUT_US, twr)) {
+      result.status = I2CEepromStatus::TIMEOUT;
+      return;
+    }
+    if (result.pages == 0 || twr < result.twrMinUs)
+      result.twrMinUs = twr;
+    if (twr > result.twrMaxUs)
+      result.twrMaxUs = twr;
+    result.twrTotalUs += twr;
+    result.pages++;
+
+    if (verify && !verifyPage(dev, addrWidth, mem, src, n)) {
+      result.status = I2CEepromStatus::VERIFY;
+      return;
+    }
+    result.written += n;
   }
-  return Wire.endTransmission() == 0;
 }
@@ -1,11 +1,152 @@
 #pragma once
+#include "pio_i2c.h"
 #include <Arduino.h>
 #include <Wire.h>
 
+// Wire transmit/receive buffer (arduino-pico WIRE_BUFFER_SIZE)
+#define I2C_WIRE_BUFFER 256
+
+// Bus clock: Fast-mode after begin(), up to Fast-mode Plus
+#define I2C_DEFAULT_HZ 400000
+#define I2C_MIN_HZ 10000
+#define I2C_MAX_HZ 1000000
+
+// EEPROM write cycle (tWR is 5ms on most parts, 10ms on some): ACK polling
+// gives up after this long
+#define I2C_EEPROM_TWR_TIMEOUT_US 20000
+
+/**
+ * @brief Bus master used by I2CDriver
+ */
+enum class I2CEngine : uint8_t {
+  WIRE = 0, // RP2040 I2C block through Wire (256-byte transactions)
+  PIO = 1   // PIO state machine + DMA (any length, clock stretching)
+};
+
+/**
+ * @brief Outcome of I2CDriver::eepromWrite
+ */
+enum class I2CEepromStatus : uint8_t {
+  OK = 0,      // All data written (and verified)
+  NAK = 1,     // Device did not acknowledge a page write
+  TIMEOUT = 2, // Write cycle did not complete
+  VERIFY = 3   // Read back differs
+};
+
+/**
+ * @brief Progress and write cycle statistics of an EEPROM write
+ */
+struct I2CEepromResult {
+  I2CEepromStatus status = I2CEepromStatus::OK;
+  uint16_t written = 0;    // Bytes written (and verified)
+  uint16_t pages = 0;      // Write cycles
+  uint16_t twrMinUs = 0;   // Shortest write cycle
+  uint16_t twrMaxUs = 0;   // Longest write cycle
+  uint32_t twrTotalUs = 0; // Sum over all write cycles
+};
+
+/**
+ * @brief I2C master on GP4/GP5
+ *
+ * All transfers go through probe / writeBytes / readBytes, served by Wire
+ * or by the PIO engine (see I2CEngine).
+ */
 class I2CDriver {
 public:
   void begin();
-  void scan(uint8_t *found_addresses, uint8_t &count);
+
+  /**
+   * @brief Find the addresses that ACK an address-only write
+   * @param quick Probe on the PIO engine with a short timeout per address
+   */
+  void scan(uint8_t *found_addresses, uint8_t &count, bool quick = false);
+
+  /**
+   * @brief Read len bytes (Wire: split into Wire-buffer sized transactions)
+   */
   bool read(uint8_t addr, uint16_t len, uint8_t *data);
   bool write(uint8_t addr, uint8_t *data, uint16_t len);
+
+  /**
+   * @brief Write wlen bytes, repeated start, read rlen bytes
+   * (register read of sensors and PMICs)
+   */
+  bool writeRead(uint8_t addr, const uint8_t *wdata, uint8_t wlen,
+                 uint8_t *rdata, uint16_t rlen);
+
+  /**
+   * @brief Repeat a one-byte writeRead until (byte & mask) == value
+   * @param last Last byte read
+   * @return false on NAK or timeout (timedOut tells them apart)
+   */
+  bool pollValue(uint8_t addr, const uint8_t *wdata, uint8_t wlen,
+                 uint8_t mask, uint8_t value, uint16_t timeoutMs,
+                 uint8_t &last, bool &timedOut);
+
+  /**
+   * @brief Set the SCL frequency (I2C_MIN_HZ - I2C_MAX_HZ)
+   * @return false if out of range
+   */
+  bool setClock(uint32_t hz);
+  uint32_t getClock() const { return clockHz; }
+
+  /**
+   * @brief Switch the bus master (pins move between Wire and the PIO)
+   * @return false if the PIO engine could not be started (Wire kept)
+   */
+  bool setEngine(I2CEngine e);
+  I2CEngine getEngine() const { return engine; }
+
+  /**
+   * @brief Random read: memory address write, repeated start, read
+   *
+   * Split into Wire-buffer sized transactions (Wire engine), each re-sending
+   * its memory address. Memory address bits above the address width go into the low
+   * device address bits, like eepromWrite.
+   * @param addrWidth Memory address bytes (0: current address read, 1 or 2)
+   */
+  bool readMem(uint8_t addr, uint8_t addrWidth, uint32_t memAddr,
+               uint8_t *data, uint16_t len);
+
+  /**
+   * @brief Wait for a device to acknowledge its address again
+   * (end of an EEPROM write cycle)
+   * @param elapsedUs Time until the ACK
+   * @return false on timeout
+   */
+  bool ackPoll(uint8_t addr, uint32_t timeoutUs, uint32_t &elapsedUs);
+
+  /**
+   * @brief Page-aligned EEPROM write with ACK polling after every page
+   *
+   * Memory address bits above the address width go into the low device
+   * address bits (24C04/08/16, 24CM01/02).
+   * @param addrWidth Memory address bytes (1 or 2)
+   * @param pageSize EEPROM page size (writes never cross a page boundary)
+   * @param verify Read every page back after its write cycle
+   */
+  void eepromWrite(uint8_t addr, uint8_t addrWidth, uint16_t pageSize,
+                   uint32_t memAddr, const uint8_t *data, uint16_t len,
+                   bool verify, I2CEepromResult &result);
+
+private:
+  uint32_t clockHz = I2C_DEFAULT_HZ;
+  I2CEngine engine = I2CEngine::WIRE;
+  PIOI2C pio;
+
+  bool probe(uint8_t addr);
+  bool writeBytes(uint8_t addr, const uint8_t *prefix, uint8_t prefixLen,
+                  const uint8_t *data, uint16_t len, bool stop);
+  bool readBytes(uint8_t addr, uint8_t *data, uint16_t len);
+
+  // Largest transfer in one transaction
+  uint16_t maxChunk() const {
+    return engine == I2CEngine::PIO ? 0xFFFF : I2C_WIRE_BUFFER;
+  }
+  uint8_t deviceAddress(uint8_t addr, uint8_t addrWidth, uint32_t memAddr) {
+    return addr | ((memAddr >> (8 * addrWidth)) & 0x07);
+  }
+  void memAddress(uint8_t addrWidth, uint32_t memAddr, uint8_t *out);
+  bool verifyPage(uint8_t dev, uint8_t addrWidth, uint32_t memAddr,
+                  const uint8_t *data, uint16_t len);
 };
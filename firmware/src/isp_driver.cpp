@@ -1,30 +1,103 @@
 #include "isp_driver.h"
 #include "Board.h"
+#include <hardware/gpio.h>
+
+// SCK steps tried by enterProgrammingMode, fastest first. SCK must stay
+// below a quarter of the target clock: 4 MHz suits 16 MHz parts, 125 kHz the
+// factory 1 MHz setting (CKDIV8) and 31.25 kHz the 128 kHz oscillator
+static const uint32_t sckSteps[] = {ISP_SCK_MAX, 2000000, 1000000, 500000,
+                                    250000,      125000,  62500,   ISP_SCK_MIN};
 
 void ISPDriver::begin() {
   pinMode(Board::PIN_AVR_RESET, OUTPUT);
   digitalWrite(Board::PIN_AVR_RESET, HIGH); // Default to high (inactive)
 }
 
-bool ISPDriver::enterProgrammingMode() {
-  // 1. Power up sequence (assumed target is powered)
-  // 2. Pull RESET low
+bool ISPDriver::setFixedClock(uint32_t hz) {
+  if (hz && (hz < ISP_SCK_MIN || hz > ISP_SCK_MAX))
+    return false;
+  _fixedSck = hz;
+  return true;
+}
+
+void ISPDriver::beginSpi() {
+  // SPIDriver::release and the bit-banged QSPI/NAND paths leave the pins on
+  // SIO: mux them to SPI0 for this transaction
+  gpio_set_function(Board::PIN_SPI_MISO, GPIO_FUNC_SPI);
+  gpio_set_function(Board::PIN_SPI_SCK, GPIO_FUNC_SPI);
+  gpio_set_function(Board::PIN_SPI_MOSI, GPIO_FUNC_SPI);
+  SPI.beginTransaction(settings());
+}
+
+void ISPDriver::endSpi() {
+  SPI.endTransaction();
+
+  // Back to SIO with the idle levels of SPIDriver::release. The SIO levels
+  // are set first, so SCK stays low and the target sees no extra edge.
+  gpio_put(Board::PIN_SPI_SCK, 0);
+  gpio_set_dir(Board::PIN_SPI_SCK, GPIO_OUT);
+  gpio_put(Board::PIN_SPI_MOSI, 0);
+  gpio_set_dir(Board::PIN_SPI_MOSI, GPIO_OUT);
+  gpio_set_dir(Board::PIN_SPI_MISO, GPIO_IN);
+  gpio_pull_up(Board::PIN_SPI_MISO);
+  gpio_set_function(Board::PIN_SPI_SCK, GPIO_FUNC_SIO);
+  gpio_set_function(Board::PIN_SPI_MOSI, GPIO_FUNC_SIO);
+  gpio_set_function(Board::PIN_SPI_MISO, GPIO_FUNC_SIO);
+}
+
+bool ISPDriver::trySync() {
+  // Positive RESET pulse, then wait at least 20ms (SCK is low, mode 0)
+  digitalWrite(Board::PIN_AVR_RESET, HIGH);
+  delayMicroseconds(100);
   digitalWrite(Board::PIN_AVR_RESET, LOW);
-  delay(20); // Wait at least 20ms
+  delay(20);
 
-  // 3. Send Programming Enable command (0xAC, 0x53, 0x00, 0x00)
-  SPI.beginTransaction(SPISettings(ISP_CLOCK, MSBFIRST, SPI_MODE0));
+  beginSpi();
+  // Programming Enable (0xAC, 0x53, 0x00, 0x00): byte 3 echoes 0x53 when in
+  // sync
+  SPI.transfer(0xAC);
+  SPI.transfer(0x53);
+  bool sync = SPI.transfer(0x00) == 0x53;
+  SPI.transfer(0x00);
 
-  uint8_t response[4];
-  response[0] = SPI.transfer(0xAC);
-  response[1] = SPI.transfer(0x53);
-  response[2] = SPI.transfer(0x00);
-  response[3] = SPI.transfer(0x00);
+  // An SCK slightly too fast for the target can still echo 0x53: the
+  // signature must read back the same twice (and not as a floating bus)
+  bool stable = false;
+  if (sync) {
+    uint8_t sig[2][3];
+    for (uint8_t n = 0; n < 2; n++)
+      for (uint8_t i = 0; i < 3; i++)
+        sig[n][i] = command(0x30, 0x00, i, 0x00);
+    stable = memcmp(sig[0], sig[1], 3) == 0 && sig[0][0] != 0x00 &&
+             sig[0][0] != 0xFF;
+  }
+  endSpi();
+  return stable;
+}
 
-  SPI.endTransaction();
+bool ISPDriver::enterProgrammingMode() {
+  // Target is assumed powered
+  _extAddr = 0; // Reset value of the extended address byte
+
+  if (_fixedSck) {
+    _sck = _fixedSck;
+    _sckKnown = trySync();
+    return _sckKnown;
+  }
+
+  // Same target again: skip the ladder
+  if (_sckKnown && trySync())
+    return true;
 
-  // Check for sync (byte 3 should be 0x53)
-  return (response[2] == 0x53);
+  for (uint32_t hz : sckSteps) {
+    _sck = hz;
+    if (trySync()) {
+      _sckKnown = true;
+      return true;
+    }
+  }
+  _sckKnown = false;
+  return false;
 }
 
 void ISPDriver::endProgrammingMode() {
@@ -32,16 +105,110 @@ void ISPDriver::endProgrammingMode() {
 }
 
 uint8_t ISPDriver::transfer(uint8_t data) {
-  SPI.beginTransaction(SPISettings(ISP_CLOCK, MSBFIRST, SPI_MODE0));
+  beginSpi();
   uint8_t result = SPI.transfer(data);
-  SPI.endTransaction();
+  endSpi();
   return result;
 }
 
 void ISPDriver::transferBlock(uint8_t *cmd, uint8_t *response) {
-  SPI.beginTransaction(SPISettings(ISP_CLOCK, MSBFIRST, SPI_MODE0));
+  beginSpi();
   for (int i = 0; i < 4; i++) {
     response[i] = SPI.transfer(cmd[i]);
   }
-  SPI.endTransaction();
+  endSpi();
+}
+
+uint8_t ISPDriver::command(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+  SPI.transfer(b0);
+  SPI.transfer(b1);
+  SPI.transfer(b2);
+  return SPI.transfer(b3);
+}
+
+bool ISPDriver::waitReady(uint32_t timeoutUs, uint32_t &elapsedUs) {
+  uint32_t start = micros();
+  beginSpi();
+  // Poll RDY/BSY: bit 0 set while busy
+  bool busy;
+  do {
+    busy = command(0xF0, 0x00, 0x00, 0x00) & 0x01;
+  } while (busy && micros() - start < timeoutUs);
+  endSpi();
+  elapsedUs = micros() - start;
+  return !busy;
+}
+
+bool ISPDriver::programPage(uint32_t byteAddr, const uint8_t *data,
+                            uint16_t len, uint32_t &busyUs) {
+  uint32_t word = byteAddr >> 1;
+
+  beginSpi();
+  // Load Program Memory Page: low byte (0x40) then high byte (0x48) of each
+  // word, addressed by the word offset inside the page
+  for (uint16_t i = 0; i + 1 < len; i += 2) {
+    uint8_t offset = (word + i / 2) & 0xFF;
+    command(0x40, 0x00, offset, data[i]);
+    command(0x48, 0x00, offset, data[i + 1]);
+  }
+  // Load Extended Address byte (parts above 128KB) when it changes
+  uint8_t ext = word >> 16;
+  if (ext != _extAddr) {
+    command(0x4D, 0x00, ext, 0x00);
+    _extAddr = ext;
+  }
+  // Write Program Memory Page
+  command(0x4C, (word >> 8) & 0xFF, word & 0xFF, 0x00);
+  endSpi();
+
+  return waitReady(ISP_TIMEOUT_FLASH_US, busyUs);
+}
+
+bool ISPDriver::readMemory(AvrMemory mem, uint32_t addr, uint8_t *buf,
+                           uint16_t len) {
+  // Fixed-size memories
+  uint32_t size = 0;
+  if (mem == AvrMemory::FUSES || mem == AvrMemory::SIGNATURE)
+    size = 3;
+  else if (mem == AvrMemory::LOCK)
+    size = 1;
+  if (size && addr + len > size)
+    return false;
+
+  // Read Fuse bits: low, high, extended
+  static const uint8_t fuseCmd[3][2] = {
+      {0x50, 0x00}, {0x58, 0x08}, {0x50, 0x08}};
+
+  beginSpi();
+  for (uint16_t i = 0; i < len; i++) {
+    uint32_t a = addr + i;
+    switch (mem) {
+    case AvrMemory::FLASH: {
+      uint32_t word = a >> 1;
+      uint8_t ext = word >> 16;
+      if (ext != _extAddr) {
+        command(0x4D, 0x00, ext, 0x00);
+        _extAddr = ext;
+      }
+      // Read Program Memory: 0x20 low byte, 0x28 high byte
+      buf[i] = command((a & 1) ? 0x28 : 0x20, (word >> 8) & 0xFF, word & 0xFF,
+                       0x00);
+      break;
+    }
+    case AvrMemory::EEPROM:
+      buf[i] = command(0xA0, (a >> 8) & 0xFF, a & 0xFF, 0x00);
+      break;
+    case AvrMemory::FUSES:
+      buf[i] = command(fuseCmd[a][0], fuseCmd[a][1], 0x00, 0x00);
+      break;
+    case AvrMemory::LOCK:
+      buf[i] = command(0x58, 0x00, 0x00, 0x00);
+      break;
+    case AvrMemory::SIGNATURE:
+      buf[i] = command(0x30, 0x00, a & 0x03, 0x00);
+      break;
+    }
+  }
+  endSpi();
+  return true;
 }
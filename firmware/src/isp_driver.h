@@ -4,17 +4,94 @@
 #include <Arduino.h>
 #include <SPI.h>
 
+// SCK range of enterProgrammingMode / setFixedClock
+#define ISP_SCK_MIN 31250
+#define ISP_SCK_MAX 4000000
+
+// Flash page write (tWD_FLASH is 2.6 - 4.5 ms) before RDY/BSY gives up
+#define ISP_TIMEOUT_FLASH_US 20000
+
+/**
+ * @brief Target memories readable over ISP
+ */
+enum class AvrMemory : uint8_t {
+    FLASH = 0,     // Byte addressed (word read low / high)
+    EEPROM = 1,
+    FUSES = 2,     // 0 = low, 1 = high, 2 = extended
+    LOCK = 3,      // Lock bits (1 byte)
+    SIGNATURE = 4  // 3 bytes
+};
+
 class ISPDriver {
 public:
     void begin();
+
+    /**
+     * @brief Reset the target and send Programming Enable
+     *
+     * With no fixed clock the last working SCK is tried first, then the
+     * SCK steps from ISP_SCK_MAX down. A step is accepted when the 0x53 echo
+     * arrives and two signature reads agree.
+     * @return false if no SCK gave a working target
+     */
     bool enterProgrammingMode();
     void endProgrammingMode();
     uint8_t transfer(uint8_t data);
     void transferBlock(uint8_t* cmd, uint8_t* response);
 
+    /**
+     * @brief Load a flash page buffer and write it, polling RDY/BSY
+     * @param byteAddr Byte address of the page (page aligned)
+     * @param data Page data (len even, at most one page)
+     * @param busyUs Time until the target reported ready
+     * @return false if the write did not complete in ISP_TIMEOUT_FLASH_US
+     */
+    bool programPage(uint32_t byteAddr, const uint8_t* data, uint16_t len,
+                     uint32_t& busyUs);
+
+    /**
+     * @brief Poll RDY/BSY (0xF0) until the target is ready
+     * @param elapsedUs Time until ready
+     */
+    bool waitReady(uint32_t timeoutUs, uint32_t& elapsedUs);
+
+    /**
+     * @brief Read len bytes of a memory, one ISP instruction per byte
+     * @return false if the range does not exist (fuses, lock, signature)
+     */
+    bool readMemory(AvrMemory mem, uint32_t addr, uint8_t* buf, uint16_t len);
+
+    /**
+     * @brief Pin SCK for the next enterProgrammingMode (0 = negotiate)
+     * @return false if hz is outside ISP_SCK_MIN .. ISP_SCK_MAX
+     */
+    bool setFixedClock(uint32_t hz);
+    uint32_t getFixedClock() const { return _fixedSck; }
+
+    /**
+     * @brief SCK in use (last negotiated or pinned value)
+     */
+    uint32_t getClock() const { return _sck; }
+
 private:
     const uint8_t PIN_RESET = 20; // Use GPIO 20 for AVR Reset
-    const uint32_t ISP_CLOCK = 100000; // 100kHz for ISP
+    uint32_t _sck = 125000;  // Used by every transaction, cached across enters
+    uint32_t _fixedSck = 0;  // Pinned SCK, 0 = negotiate
+    bool _sckKnown = false;  // _sck worked for the last entered target
+    uint8_t _extAddr = 0; // Last Load Extended Address byte (> 128KB flash)
+
+    // One 4-byte instruction inside an open SPI transaction
+    uint8_t command(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3);
+
+    // Open / close an SPI transaction at _sck with GP16/18/19 muxed to SPI0
+    void beginSpi();
+    void endSpi();
+
+    // RESET pulse, Programming Enable and signature check at _sck
+    bool trySync();
+    SPISettings settings() const {
+        return SPISettings(_sck, MSBFIRST, SPI_MODE0);
+    }
 };
 
 #endif
@@ -1,20 +1,27 @@
 #include "Board.h"
 #include "Logger.h"
 
+#include "clock_tuner.h"
 #include "i2c_driver.h"
 #include "isp_driver.h"
 #include "led_driver.h"
 #include "qspi_driver.h"
 #include "spi_driver.h"
+#include "spi_flash.h"
+#include "spi_nand.h"
+#include "stm32_loader.h"
 #include "swd_driver.h"
+#include "updi_driver.h"
 
 #include "protocol/OPUP.h"
 #include "protocol/drivers/OPUP_I2C.h"
 #include "protocol/drivers/OPUP_ISP.h"
+#include "protocol/drivers/OPUP_NAND.h"
 #include "protocol/drivers/OPUP_QSPI.h"
 #include "protocol/drivers/OPUP_SPI.h"
 #include "protocol/drivers/OPUP_SWD.h"
 #include "protocol/drivers/OPUP_System.h"
+#include "protocol/drivers/OPUP_UPDI.h"
 
 // Define Trace Tag
 #define TAG "MAIN"
@@ -23,20 +30,27 @@
 I2CDriver i2c;
 SPIDriver spi;
 QSPIDriver qspi;
+SPIFlash flash(qspi);
+SPINand nand(qspi);
+ClockTuner tuner(qspi, flash, spi);
 ISPDriver isp;
+UPDIDriver updi;
 SWDDriver swd;
+STM32Loader stm32(swd);
 LEDDriver led;
 
 // Protocol Handler
 OPUP opup;
 
 // Protocol Drivers
-OPUP_System opup_sys;
+OPUP_System opup_sys(opup.getScheduler());
 OPUP_I2C opup_i2c(i2c);
-OPUP_SPI opup_spi(spi);
-OPUP_QSPI opup_qspi(qspi);
+OPUP_SPI opup_spi(spi, tuner);
+OPUP_QSPI opup_qspi(qspi, flash, tuner);
+OPUP_NAND opup_nand(nand);
 OPUP_ISP opup_isp(isp);
-OPUP_SWD opup_swd(swd);
+OPUP_UPDI opup_updi(updi);
+OPUP_SWD opup_swd(swd, stm32);
 
 void setup() {
   // Initialize Logging (Serial)
@@ -57,6 +71,7 @@ void setup() {
   spi.begin();
   qspi.begin();
   isp.begin();
+  updi.begin();
   // SWD initialized on demand
 
   LOG_INFO(TAG, "Hardware Drivers Initialized");
@@ -74,8 +89,17 @@ void setup() {
   // QSPI: 0x25 - 0x2F (Extended)
   opup.registerDriver(0x25, 0x2F, &opup_qspi);
 
-  // AVR ISP: 0x30 - 0x3F
-  opup.registerDriver(0x30, 0x3F, &opup_isp);
+  // SPI NOR Flash Engine: 0x60 - 0x6F (served by the QSPI driver)
+  opup.registerDriver(0x60, 0x6F, &opup_qspi);
+
+  // SPI NAND Engine: 0x70 - 0x7F (same QSPI bus)
+  opup.registerDriver(0x70, 0x7F, &opup_nand);
+
+  // AVR ISP: 0x30 - 0x37
+  opup.registerDriver(0x30, 0x37, &opup_isp);
+
+  // AVR UPDI: 0x38 - 0x3F
+  opup.registerDriver(0x38, 0x3F, &opup_updi);
 
   // STM32 SWD: 0x40 - 0x4F
   opup.registerDriver(0x40, 0x4F, &opup_swd);
@@ -87,5 +111,8 @@ void setup() {
 
 void loop() {
   opup.update();
+  flash.update(); // Sequential read-ahead, one chunk per loop
+  qspi.update();  // Close idle held read streams
+  spi.update();   // Release CS of stalled chained transfers
   led.update();
 }
@@ -0,0 +1,316 @@
+#include "pio_i2c.h"
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+
+// ============================================
+// PIO program (pioasm output, .side_set 1 opt pindirs)
+//
+// SDA is the OUT/SET/IN/JMP pin, SCL the side-set pin (SDA + 1). Both are
+// driven low through an inverted OE: pindir 1 releases the line.
+// 32 PIO cycles per bit.
+//
+// TX FIFO record (16 bits, MSB first):
+//   [15:10 Instr][9 NakOk][8:1 Data][0 Ack]
+//   Instr > 0: the next Instr + 1 records are executed as instructions
+//   Instr = 0: shift out Data (0xFF when reading), then Ack
+//   (1 = release SDA for the slave's ACK / send NAK). A NAK seen on a
+//   record without NakOk stops the machine on IRQ (sm).
+// RX FIFO: the 8 bits sampled during every data record
+// ============================================
+static const uint16_t pio_i2c_program_instructions[] = {
+    0x008c, //  0: do_nack: jmp y--, entry_point
+    0xc030, //  1:          irq wait 0 rel
+    0xe027, //  2: do_byte: set x, 7
+    0x6781, //  3: bitloop: out pindirs, 1         [7]
+    0xba42, //  4:          nop             side 1 [2]
+    0x24a1, //  5:          wait 1 pin, 1          [4] (clock stretching)
+    0x4701, //  6:          in pins, 1             [7]
+    0x1743, //  7:          jmp x--, bitloop side 0 [7]
+    0x6781, //  8:          out pindirs, 1         [7] (ACK bit)
+    0xbf42, //  9:          nop             side 1 [7]
+    0x27a1, // 10:          wait 1 pin, 1          [7]
+    0x12c0, // 11:          jmp pin, do_nack side 0 [2]
+    0x6026, // 12: entry_point (wrap target): out x, 6
+    0x6041, // 13:          out y, 1
+    0x0022, // 14:          jmp !x, do_byte
+    0x6060, // 15:          out null, 32
+    0x60f0, // 16: do_exec: out exec, 16
+    0x0050, // 17:          jmp x--, do_exec (wrap)
+};
+
+static const pio_program_t pio_i2c_program = {
+    pio_i2c_program_instructions,
+    sizeof(pio_i2c_program_instructions) / sizeof(uint16_t), -1};
+
+#define PIO_I2C_WRAP_TARGET 12
+#define PIO_I2C_WRAP 17
+#define PIO_I2C_ENTRY 12
+
+#define PIO_I2C_ICOUNT_LSB 10
+#define PIO_I2C_NAK_OK_LSB 9
+#define PIO_I2C_DATA_LSB 1
+
+// START / STOP building blocks: set pindirs (SDA), side-set SCL, [7]
+#define PIO_I2C_SC0_SD0 0xf780
+#define PIO_I2C_SC0_SD1 0xf781
+#define PIO_I2C_SC1_SD0 0xff80
+#define PIO_I2C_SC1_SD1 0xff81
+
+// 32 PIO cycles per SCL period
+static float clockDiv(uint32_t hz) {
+  return (float)clock_get_hz(clk_sys) / (32.0f * hz);
+}
+
+bool PIOI2C::begin(uint8_t sda, uint8_t scl, uint32_t hz) {
+  if (scl != sda + 1)
+    return false;
+
+  // Program, state machine and DMA channels are kept once claimed
+  if (_offset < 0) {
+    if (!pio_can_add_program(_pio, &pio_i2c_program))
+      return false;
+    _offset = pio_add_program(_pio, &pio_i2c_program);
+  }
+  if (_sm < 0 && (_sm = pio_claim_unused_sm(_pio, false)) < 0)
+    return false;
+  if (_dmaTx < 0 && (_dmaTx = dma_claim_unused_channel(false)) < 0)
+    return false;
+  if (_dmaRx < 0 && (_dmaRx = dma_claim_unused_channel(false)) < 0)
+    return false;
+
+  _sda = sda;
+  _scl = scl;
+  _hz = hz;
+
+  pio_sm_config c = pio_get_default_sm_config();
+  sm_config_set_wrap(&c, _offset + PIO_I2C_WRAP_TARGET,
+                     _offset + PIO_I2C_WRAP);
+  sm_config_set_sideset(&c, 2, true, true);
+  sm_config_set_out_pins(&c, sda, 1);
+  sm_config_set_set_pins(&c, sda, 1);
+  sm_config_set_in_pins(&c, sda);
+  sm_config_set_sideset_pins(&c, scl);
+  sm_config_set_jmp_pin(&c, sda);
+  sm_config_set_out_shift(&c, false, true, 16);
+  sm_config_set_in_shift(&c, false, true, 8);
+  sm_config_set_clkdiv(&c, clockDiv(hz));
+
+  // Connect the pins without glitching the bus: output level 0, OE
+  // inverted, both released
+  uint32_t pins = (1u << sda) | (1u << scl);
+  gpio_pull_up(sda);
+  gpio_pull_up(scl);
+  pio_sm_set_pins_with_mask(_pio, _sm, pins, pins);
+  pio_sm_set_pindirs_with_mask(_pio, _sm, pins, pins);
+  pio_gpio_init(_pio, sda);
+  gpio_set_oeover(sda, GPIO_OVERRIDE_INVERT);
+  pio_gpio_init(_pio, scl);
+  gpio_set_oeover(scl, GPIO_OVERRIDE_INVERT);
+  pio_sm_set_pins_with_mask(_pio, _sm, 0, pins);
+
+  // The IRQ flag is a NAK status bit, not a system interrupt
+  pio_set_irq0_source_enabled(
+      _pio, (pio_interrupt_source)(pis_interrupt0 + _sm), false);
+  pio_set_irq1_source_enabled(
+      _pio, (pio_interrupt_source)(pis_interrupt0 + _sm), false);
+  pio_interrupt_clear(_pio, _sm);
+
+  pio_sm_init(_pio, _sm, _offset + PIO_I2C_ENTRY, &c);
+  pio_sm_set_enabled(_pio, _sm, true);
+  _open = false;
+  _active = true;
+  return true;
+}
+
+void PIOI2C::end() {
+  if (!_active)
+    return;
+  if (_open)
+    stopCondition();
+  pio_sm_set_enabled(_pio, _sm, false);
+  pio_sm_clear_fifos(_pio, _sm);
+  gpio_set_oeover(_sda, GPIO_OVERRIDE_NORMAL);
+  gpio_set_oeover(_scl, GPIO_OVERRIDE_NORMAL);
+  gpio_init(_sda);
+  gpio_init(_scl);
+  gpio_pull_up(_sda);
+  gpio_pull_up(_scl);
+  _active = false;
+}
+
+void PIOI2C::setClock(uint32_t hz) {
+  _hz = hz;
+  if (_active)
+    pio_sm_set_clkdiv(_pio, _sm, clockDiv(hz));
+}
+
+// ============== FIFO ACCESS ==============
+
+void PIOI2C::drainRx() {
+  while (!pio_sm_is_rx_fifo_empty(_pio, _sm))
+    (void)_pio->rxf[_sm];
+}
+
+bool PIOI2C::put(uint16_t record, uint32_t start, uint32_t timeoutUs,
+                 bool drain) {
+  while (pio_sm_is_tx_fifo_full(_pio, _sm)) {
+    // Bytes clocked out meanwhile push RX data: keep autopush from stalling
+    if (drain)
+      drainRx();
+    if (failed() || micros() - start > timeoutUs)
+      return false;
+  }
+  // OUT shifts left: the record goes in the upper half
+  _pio->txf[_sm] = (uint32_t)record << 16;
+  return true;
+}
+
+bool PIOI2C::putByte(uint8_t b, uint32_t start, uint32_t timeoutUs) {
+  drainRx();
+  return put((b << PIO_I2C_DATA_LSB) | 1, start, timeoutUs);
+}
+
+bool PIOI2C::putInstructions(const uint16_t *instr, uint8_t count,
+                             uint32_t start, uint32_t timeoutUs) {
+  if (!put((count - 1) << PIO_I2C_ICOUNT_LSB, start, timeoutUs))
+    return false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (!put(instr[i], start, timeoutUs))
+      return false;
+  }
+  return true;
+}
+
+bool PIOI2C::startCondition(uint32_t start, uint32_t timeoutUs) {
+  static const uint16_t startSeq[] = {PIO_I2C_SC1_SD0, PIO_I2C_SC0_SD0};
+  static const uint16_t repStartSeq[] = {PIO_I2C_SC0_SD1, PIO_I2C_SC1_SD1,
+                                         PIO_I2C_SC1_SD0, PIO_I2C_SC0_SD0};
+  bool ok = _open ? putInstructions(repStartSeq, 4, start, timeoutUs)
+                  : putInstructions(startSeq, 2, start, timeoutUs);
+  _open = true;
+  return ok;
+}
+
+void PIOI2C::stopCondition() {
+  static const uint16_t stopSeq[] = {PIO_I2C_SC0_SD0, PIO_I2C_SC1_SD0,
+                                     PIO_I2C_SC1_SD1};
+  uint32_t start = micros();
+  if (putInstructions(stopSeq, 3, start, PIO_I2C_STRETCH_TIMEOUT_US))
+    waitIdle(start, PIO_I2C_STRETCH_TIMEOUT_US);
+  _open = false;
+}
+
+bool PIOI2C::waitIdle(uint32_t start, uint32_t timeoutUs) {
+  // Done when the machine stalls on an empty TX FIFO (or stops on a NAK).
+  // Queued write records still push their RX byte: drain it, or the
+  // machine stalls on a full RX FIFO instead
+  uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + _sm);
+  _pio->fdebug = stall;
+  while (!(_pio->fdebug & stall)) {
+    drainRx();
+    if (failed() || micros() - start > timeoutUs)
+      return false;
+  }
+  return !failed();
+}
+
+void PIOI2C::recover() {
+  // NAK or a slave holding SCL: drop queued records, jump back to the
+  // entry point and release the bus
+  dma_channel_abort(_dmaTx);
+  dma_channel_abort(_dmaRx);
+  pio_sm_drain_tx_fifo(_pio, _sm);
+  pio_sm_exec(_pio, _sm, pio_encode_jmp(_offset + PIO_I2C_ENTRY));
+  pio_interrupt_clear(_pio, _sm);
+  drainRx();
+  stopCondition();
+}
+
+// ============== TRANSFERS ==============
+
+bool PIOI2C::probe(uint8_t addr, uint32_t timeoutUs) {
+  uint32_t start = micros();
+  timeoutUs += busTimeUs(2);
+  bool ok = startCondition(start, timeoutUs) &&
+            putByte(addr << 1, start, timeoutUs) && waitIdle(start, timeoutUs);
+  if (!ok) {
+    recover();
+    return false;
+  }
+  stopCondition();
+  return true;
+}
+
+bool PIOI2C::write(uint8_t addr, const uint8_t *prefix, uint8_t prefixLen,
+                   const uint8_t *data, uint16_t len, bool stop) {
+  uint32_t start = micros();
+  uint32_t timeoutUs =
+      PIO_I2C_STRETCH_TIMEOUT_US + 2 * busTimeUs(2 + prefixLen + len);
+
+  bool ok = startCondition(start, timeoutUs) &&
+            putByte(addr << 1, start, timeoutUs);
+  for (uint8_t i = 0; ok && i < prefixLen; i++)
+    ok = putByte(prefix[i], start, timeoutUs);
+  for (uint16_t i = 0; ok && i < len; i++)
+    ok = putByte(data[i], start, timeoutUs);
+  if (!(ok && waitIdle(start, timeoutUs))) {
+    recover();
+    return false;
+  }
+  drainRx();
+  if (stop)
+    stopCondition();
+  return true;
+}
+
+bool PIOI2C::read(uint8_t addr, uint8_t *data, uint16_t len) {
+  uint32_t start = micros();
+  uint32_t timeoutUs = PIO_I2C_STRETCH_TIMEOUT_US + 2 * busTimeUs(2 + len);
+
+  // Address phase first: its RX byte is discarded and a NAK caught here
+  if (!(startCondition(start, timeoutUs) &&
+        putByte((addr << 1) | 1, start, timeoutUs) &&
+        waitIdle(start, timeoutUs))) {
+    recover();
+    return false;
+  }
+  drainRx();
+  if (len == 0) {
+    stopCondition();
+    return true;
+  }
+
+  // RX: one byte per record. TX: len - 1 ACKed 0xFF records, then the
+  // NAKed last one from the CPU
+  dma_channel_config c = dma_channel_get_default_config(_dmaRx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, pio_get_dreq(_pio, _sm, false));
+  dma_channel_configure(_dmaRx, &c, data, &_pio->rxf[_sm], len, false);
+
+  _ackRecord = (uint32_t)(0xFF << PIO_I2C_DATA_LSB) << 16;
+  c = dma_channel_get_default_config(_dmaTx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(_pio, _sm, true));
+  dma_channel_configure(_dmaTx, &c, &_pio->txf[_sm], &_ackRecord, len - 1,
+                        false);
+
+  dma_start_channel_mask((1u << _dmaRx) | (len > 1 ? (1u << _dmaTx) : 0));
+  bool ok = true;
+  while (ok && dma_channel_is_busy(_dmaTx))
+    ok = micros() - start <= timeoutUs;
+  ok = ok && put((1 << PIO_I2C_NAK_OK_LSB) | (0xFF << PIO_I2C_DATA_LSB) | 1,
+                 start, timeoutUs, false); // RX belongs to the DMA
+  while (ok && dma_channel_is_busy(_dmaRx))
+    ok = micros() - start <= timeoutUs;
+  if (!ok) {
+    recover();
+    return false;
+  }
+  stopCondition();
+  return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Arduino.h>
+#include <hardware/pio.h>
+#include <stdint.h>
+
+// Bus held low by a stretching slave for longer than this fails the
+// transaction (SMBus tTIMEOUT)
+#define PIO_I2C_STRETCH_TIMEOUT_US 25000
+
+// Quick scan: an address that has not answered within this long (plus the
+// time of the probe itself) is reported absent
+#define PIO_I2C_SCAN_TIMEOUT_US 50
+
+/**
+ * @brief I2C master on a PIO state machine
+ *
+ * Every SCL high phase waits for SCL to actually rise, so slaves may stretch
+ * the clock at any bit. Reads are moved by two DMA channels (ACK records in,
+ * data out) and have no length limit. SCL must be the GPIO after SDA.
+ */
+class PIOI2C {
+public:
+  /**
+   * @brief Load the program (once) and take over the SDA/SCL pins
+   * @return false if scl != sda + 1 or no PIO state machine / DMA channel
+   * is free
+   */
+  bool begin(uint8_t sda, uint8_t scl, uint32_t hz);
+
+  /**
+   * @brief Stop the state machine and release the pins (pulled up inputs)
+   */
+  void end();
+
+  bool isActive() const { return _active; }
+  void setClock(uint32_t hz);
+
+  /**
+   * @brief Address-only write, then STOP
+   * @return true if the address was acknowledged within timeoutUs
+   */
+  bool probe(uint8_t addr, uint32_t timeoutUs);
+
+  /**
+   * @brief START (or repeated START), address, prefix and data bytes
+   * @param stop false: leave the bus to the next transfer (repeated START)
+   */
+  bool write(uint8_t addr, const uint8_t *prefix, uint8_t prefixLen,
+             const uint8_t *data, uint16_t len, bool stop);
+
+  /**
+   * @brief START (or repeated START), read len bytes, NAK the last, STOP
+   */
+  bool read(uint8_t addr, uint8_t *data, uint16_t len);
+
+private:
+  PIO _pio = pio0;
+  int _sm = -1;
+  int _offset = -1;
+  int _dmaTx = -1;
+  int _dmaRx = -1;
+  uint8_t _sda = 0;
+  uint8_t _scl = 0;
+  uint32_t _hz = 100000;
+  bool _active = false;
+  bool _open = false;      // No STOP after the last transfer
+  uint32_t _ackRecord = 0; // DMA source of the read byte records
+
+  uint32_t busTimeUs(uint32_t bytes) const {
+    return bytes * 9 * 1000000ULL / _hz + 1;
+  }
+  bool failed() const { return pio_interrupt_get(_pio, _sm); }
+
+  bool put(uint16_t record, uint32_t start, uint32_t timeoutUs,
+           bool drain = true);
+  bool putByte(uint8_t b, uint32_t start, uint32_t timeoutUs);
+  bool putInstructions(const uint16_t *instr, uint8_t count, uint32_t start,
+                       uint32_t timeoutUs);
+  bool startCondition(uint32_t start, uint32_t timeoutUs);
+  void stopCondition();
+  bool waitIdle(uint32_t start, uint32_t timeoutUs);
+  void drainRx();
+  void recover();
+};
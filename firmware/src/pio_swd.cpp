@@ -0,0 +1,174 @@
+#include "pio_swd.h"
+#include <hardware/clocks.h>
+#include <hardware/gpio.h>
+
+// ============================================
+// PIO program (pioasm output, .side_set 1 opt)
+//
+// SWDIO is the OUT/SET/IN pin, SWCLK the side-set pin. Two PIO cycles per
+// bit: host data changes with the falling edge, the target samples on the
+// rising edge; target data is sampled on the rising edge (it changes after
+// it).
+//
+// Phase command (TX FIFO, LSB first):
+//   [7:0 Bits - 1][8 Turnaround][9 Drive]
+//   Drive = 1: the next TX word holds the bits to send
+//   Drive = 0: the sampled bits are pushed (top-aligned in the RX word)
+// ============================================
+static const uint16_t pio_swd_program_instructions[] = {
+    0x90a0, //  0: start:  pull block      side 0
+    0x6028, //  1:         out x, 8
+    0x6041, //  2:         out y, 1
+    0x0066, //  3:         jmp !y, phase
+    0xe080, //  4:         set pindirs, 0         (release SWDIO)
+    0xb842, //  5:         nop             side 1 (turnaround clock)
+    0x7041, //  6: phase:  out y, 1        side 0
+    0x008d, //  7:         jmp y--, drive
+    0xe080, //  8:         set pindirs, 0
+    0x5801, //  9: rdloop: in pins, 1      side 1
+    0x1049, // 10:         jmp x--, rdloop side 0
+    0x8020, // 11:         push block
+    0x0000, // 12:         jmp start
+    0xe081, // 13: drive:  set pindirs, 1
+    0x80a0, // 14:         pull block
+    0x7001, // 15: wrloop: out pins, 1     side 0
+    0x184f, // 16:         jmp x--, wrloop side 1 (wrap)
+};
+
+static const pio_program_t pio_swd_program = {
+    pio_swd_program_instructions,
+    sizeof(pio_swd_program_instructions) / sizeof(uint16_t), -1};
+
+#define PIO_SWD_WRAP_TARGET 0
+#define PIO_SWD_WRAP 16
+
+#define PIO_SWD_TURNAROUND (1u << 8)
+#define PIO_SWD_DRIVE (1u << 9)
+
+static float clockDiv(uint32_t hz) {
+  return (float)clock_get_hz(clk_sys) / (2.0f * hz);
+}
+
+static bool parity(uint32_t v) {
+  v ^= v >> 16;
+  v ^= v >> 8;
+  v ^= v >> 4;
+  v ^= v >> 2;
+  v ^= v >> 1;
+  return v & 1;
+}
+
+bool PIOSWD::begin(uint8_t swclk, uint8_t swdio, uint32_t hz) {
+  // Program and state machine are kept once claimed
+  if (_offset < 0) {
+    if (!pio_can_add_program(_pio, &pio_swd_program))
+      return false;
+    _offset = pio_add_program(_pio, &pio_swd_program);
+  }
+  if (_sm < 0 && (_sm = pio_claim_unused_sm(_pio, false)) < 0)
+    return false;
+
+  _swclk = swclk;
+  _swdio = swdio;
+
+  pio_sm_config c = pio_get_default_sm_config();
+  sm_config_set_wrap(&c, _offset + PIO_SWD_WRAP_TARGET,
+                     _offset + PIO_SWD_WRAP);
+  sm_config_set_sideset(&c, 2, true, false);
+  sm_config_set_out_pins(&c, swdio, 1);
+  sm_config_set_set_pins(&c, swdio, 1);
+  sm_config_set_in_pins(&c, swdio);
+  sm_config_set_sideset_pins(&c, swclk);
+  sm_config_set_out_shift(&c, true, false, 32);
+  sm_config_set_in_shift(&c, true, false, 32);
+  sm_config_set_clkdiv(&c, clockDiv(hz));
+
+  // SWCLK low, SWDIO driven high until the first phase
+  gpio_pull_up(swdio);
+  pio_sm_set_pins_with_mask(_pio, _sm, 1u << swdio,
+                            (1u << swclk) | (1u << swdio));
+  pio_sm_set_pindirs_with_mask(_pio, _sm, (1u << swclk) | (1u << swdio),
+                               (1u << swclk) | (1u << swdio));
+  pio_gpio_init(_pio, swclk);
+  pio_gpio_init(_pio, swdio);
+
+  pio_sm_init(_pio, _sm, _offset + PIO_SWD_WRAP_TARGET, &c);
+  pio_sm_set_enabled(_pio, _sm, true);
+  _released = false;
+  _active = true;
+  return true;
+}
+
+void PIOSWD::end() {
+  if (!_active)
+    return;
+  flush();
+  pio_sm_set_enabled(_pio, _sm, false);
+  pio_sm_clear_fifos(_pio, _sm);
+  gpio_init(_swclk);
+  gpio_init(_swdio);
+  gpio_pull_up(_swdio);
+  _active = false;
+}
+
+void PIOSWD::setClock(uint32_t hz) {
+  if (_active) {
+    flush();
+    pio_sm_set_clkdiv(_pio, _sm, clockDiv(hz));
+  }
+}
+
+void PIOSWD::flush() {
+  // Done when the machine stalls on an empty TX FIFO (SWD has no clock
+  // stretching: this always completes)
+  uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + _sm);
+  _pio->fdebug = stall;
+  while (!(_pio->fdebug & stall))
+    ;
+}
+
+void PIOSWD::phase(uint8_t bits, bool drive) {
+  uint32_t cmd = (bits - 1) | (drive ? PIO_SWD_DRIVE : 0);
+  // Turnaround whenever the host takes SWDIO back or hands it over
+  if (_released == drive)
+    cmd |= PIO_SWD_TURNAROUND;
+  _released = !drive;
+  pio_sm_put_blocking(_pio, _sm, cmd);
+}
+
+void PIOSWD::write(uint32_t data, uint8_t bits) {
+  phase(bits, true);
+  pio_sm_put_blocking(_pio, _sm, data);
+}
+
+uint32_t PIOSWD::read(uint8_t bits) {
+  phase(bits, false);
+  return pio_sm_get_blocking(_pio, _sm) >> (32 - bits);
+}
+
+SwdAck PIOSWD::transfer(uint8_t request, uint32_t &data) {
+  // Start(1) APnDP RnW A2 A3 Parity Stop(0) Park(1)
+  uint8_t header = 0x81 | ((request & 0x0F) << 1) |
+                   (parity(request & 0x0F) << 5);
+  write(header, 8);
+
+  uint8_t ack = read(3);
+  if (ack != static_cast<uint8_t>(SwdAck::OK)) {
+    // WAIT / FAULT: no data phase, the target released SWDIO
+    if (ack != static_cast<uint8_t>(SwdAck::WAIT) &&
+        ack != static_cast<uint8_t>(SwdAck::FAULT))
+      return SwdAck::NO_RESPONSE;
+    return static_cast<SwdAck>(ack);
+  }
+
+  if (request & 0x02) {
+    data = read(32);
+    bool p = read(1);
+    if (p != parity(data))
+      return SwdAck::PARITY;
+  } else {
+    write(data, 32);
+    write(parity(data), 1);
+  }
+  return SwdAck::OK;
+}
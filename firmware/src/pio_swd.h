@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+#include <hardware/pio.h>
+#include <stdint.h>
+
+// SWCLK range (two PIO cycles per bit; fractional dividers above ~15 MHz
+// add jitter on the high phase)
+#define SWD_CLOCK_MIN 100000
+#define SWD_CLOCK_MAX 31250000
+#define SWD_CLOCK_DEFAULT 4000000
+
+/**
+ * @brief SWD acknowledge (ACK bits as received, LSB first)
+ */
+enum class SwdAck : uint8_t {
+  OK = 1,
+  WAIT = 2,
+  FAULT = 4,
+  NO_RESPONSE = 7, // Line not driven (no target, lost sync)
+  PARITY = 8       // Read data parity error (not a wire value)
+};
+
+/**
+ * @brief SWD PHY on a PIO state machine
+ *
+ * The state machine runs phases queued in its TX FIFO: an optional
+ * turnaround clock, then up to 32 bits driven (data on the falling edge) or
+ * sampled (on the rising edge, pushed to the RX FIFO). A transfer is one
+ * request phase, the ACK read, and the data phase; SWCLK stops low whenever
+ * the FIFO runs dry, which SWD allows at any bit. SWDIO ownership is tracked
+ * so every change of direction gets its turnaround cycle.
+ */
+class PIOSWD {
+public:
+  /**
+   * @brief Load the program (once) and take over SWCLK / SWDIO
+   * @param hz SWD_CLOCK_MIN .. SWD_CLOCK_MAX
+   * @return false if no PIO state machine or instruction space is free
+   */
+  bool begin(uint8_t swclk, uint8_t swdio, uint32_t hz);
+
+  /**
+   * @brief Stop the state machine and release the pins
+   */
+  void end();
+
+  bool isActive() const { return _active; }
+
+  void setClock(uint32_t hz);
+
+  /**
+   * @brief Drive bits (LSB first) with SWDIO owned by the host
+   * @param bits 1 .. 32
+   */
+  void write(uint32_t data, uint8_t bits);
+
+  /**
+   * @brief Idle cycles (SWDIO low): lets posted writes complete
+   */
+  void idle(uint8_t cycles) { write(0, cycles); }
+
+  /**
+   * @brief One SWD transfer: request, ACK, data and parity
+   * @param request APnDP (bit 0), RnW (bit 1), A[3:2] (bits 3:2)
+   * @param data Written, or filled with the read value when the ACK is OK
+   */
+  SwdAck transfer(uint8_t request, uint32_t &data);
+
+  /**
+   * @brief Wait until every queued phase is on the wire
+   */
+  void flush();
+
+private:
+  PIO _pio = pio1;
+  int _sm = -1;
+  int _offset = -1;
+  uint8_t _swclk = 0;
+  uint8_t _swdio = 0;
+  bool _active = false;
+  bool _released = false; // SWDIO last driven by the target
+
+  void phase(uint8_t bits, bool drive);
+  uint32_t read(uint8_t bits);
+};
@@ -8,6 +8,7 @@
 OPUP::OPUP() {
   state = WAIT_SOF;
   rxIndex = 0;
+  activeDriver = nullptr;
 }
 
 void OPUP::begin() {
@@ -81,6 +82,8 @@ void OPUP::update() {
       break;
     }
   }
+
+  serviceJobs();
 }
 
 void OPUP::processPacket() {
@@ -93,6 +96,14 @@ void OPUP::processPacket() {
   OPUPDriver *driver = registry.getDriver(currentCmd);
 
   if (driver) {
+    switchDriver(driver);
+
+    if (currentFlags & OPUP_FLAG_ASYNC) {
+      startJob(driver);
+      led.setActivity(false);
+      return;
+    }
+
     uint8_t *payload = &rxBuffer[6];
     // Allocate max response buffer (can be optimized later)
     uint8_t respBuffer[OPUP_MAX_PAYLOAD];
@@ -117,13 +128,58 @@ void OPUP::processPacket() {
   led.setActivity(false);
 }
 
+void OPUP::switchDriver(OPUPDriver *driver) {
+  // Let the previous driver give up any bus state it kept across commands
+  if (!driver->sharesPins())
+    return;
+  if (activeDriver && activeDriver != driver)
+    activeDriver->release();
+  activeDriver = driver;
+}
+
+void OPUP::startJob(OPUPDriver *driver) {
+  uint8_t error = 0;
+  OPUPJob *job = scheduler.start(driver, currentCmd, currentSeq, &rxBuffer[6],
+                                 payloadLen, error);
+  if (!job) {
+    sendError(currentSeq, error, error == 0x05 ? "Busy" : "Async Failed");
+    led.setStatus(STATUS_ERROR);
+    return;
+  }
+
+  // Response: [JobId:1][ExpectedMs:4]
+  uint8_t resp[5];
+  resp[0] = job->id;
+  memcpy(&resp[1], &job->expectedMs, 4);
+  sendResponse(currentCmd, currentSeq, resp, sizeof(resp));
+  led.setStatus(STATUS_SUCCESS);
+}
+
+void OPUP::serviceJobs() {
+  // One step per loop pass: pending packets are always handled first
+  OPUPJob *job = scheduler.next();
+  if (!job)
+    return;
+
+  switchDriver(job->driver);
+
+  OPUPJobEvent event;
+  if (scheduler.step(*job, event)) {
+    sendResponse(event.cmd, event.seq, event.data, event.len, event.error,
+                 true);
+    if (event.final)
+      led.setStatus(event.error ? STATUS_ERROR : STATUS_SUCCESS);
+  }
+}
+
 void OPUP::sendResponse(uint8_t cmd, uint8_t seq, uint8_t *data, uint16_t len,
-                        bool error) {
+                        bool error, bool async) {
   uint8_t header[6];
   header[0] = OPUP_SOF;
   header[1] = seq;
   header[2] = cmd;
-  header[3] = OPUP_FLAG_RESP | (error ? OPUP_FLAG_ERROR : 0);
+  header[3] = OPUP_FLAG_RESP | (error ? OPUP_FLAG_ERROR : 0) |
+              (async ? OPUP_FLAG_ASYNC : 0);
   header[4] = len & 0xFF;
   header[5] = (len >> 8) & 0xFF;
 
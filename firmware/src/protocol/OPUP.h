@@ -2,6 +2,7 @@
 #define OPUP_H
 
 #include "OPUPRegistry.h"
+#include "OPUPScheduler.h"
 #include <Arduino.h>
 #include <cstdint>
 #include <vector>
@@ -22,31 +23,78 @@ enum OpupCmd : uint8_t {
   SYS_GET_STATUS = 0x03,
   SYS_RESET = 0x04,
   SYS_GPIO_TEST = 0x05, // Debug: Read GPIO states
+  JOB_STATUS = 0x06,    // List background jobs
+  JOB_ABORT = 0x07,     // Cancel background jobs
 
   I2C_SCAN = 0x10,
   I2C_READ = 0x11,
   I2C_WRITE = 0x12,
+  I2C_EEPROM_WRITE = 0x13, // Page writes with ACK polling
+  I2C_WRITE_READ = 0x14,   // Memory address + repeated start read
+  I2C_SET_SPEED = 0x15,    // SCL frequency (up to 1 MHz Fm+)
+  I2C_BATCH = 0x16,        // Op list executed back-to-back
+  I2C_SET_ENGINE = 0x17,   // Wire or PIO bus master
 
   SPI_SCAN = 0x20,
   SPI_CONFIG = 0x21,
   SPI_XFER = 0x22,
+  SPI_XFER_EX = 0x23,  // Transfer with direction / CS-hold flags
+  SPI_AUTOTUNE = 0x24, // Find the fastest reliable SPI clock
 
   // QSPI Commands (Quad SPI modes)
-  QSPI_SET_MODE = 0x25,  // Set QSPI mode (0-5)
-  QSPI_READ = 0x26,      // Read with current mode
-  QSPI_WRITE = 0x27,     // Write with current mode
-  QSPI_FAST_READ = 0x28, // Fast page read
-  QSPI_CMD = 0x29,       // Raw command execution
+  QSPI_SET_MODE = 0x25,    // Set QSPI mode (0-5)
+  QSPI_READ = 0x26,        // Read with current mode
+  QSPI_WRITE = 0x27,       // Write with current mode
+  QSPI_FAST_READ = 0x28,   // Fast page read
+  QSPI_CMD = 0x29,         // Raw command execution
+  QSPI_STATS = 0x2A,       // Fast read chaining counters
+  QSPI_AUTOTUNE = 0x2B,    // Tune per-mode clock/sample delays
+  QSPI_PROBE_MODES = 0x2C, // Measure every mode, select the fastest
 
   ISP_ENTER = 0x30,
   ISP_XFER = 0x31,
   ISP_EXIT = 0x32,
+  ISP_PROGRAM_PAGE = 0x33,  // Flash page load + write, RDY/BSY polling
+  ISP_READ_MEMORY = 0x34,   // Flash/EEPROM/fuses/lock/signature read
+  ISP_VERIFY_MEMORY = 0x35, // Compare, return mismatch offsets
+
+  // AVR UPDI (tinyAVR 0/1/2, megaAVR 0, AVR Dx)
+  UPDI_ENTER = 0x38,      // Double break, SIB, NVMPROG key
+  UPDI_EXIT = 0x39,       // Reset into the application
+  UPDI_READ = 0x3A,       // Data-space read in REPEAT bursts
+  UPDI_PROGRAM = 0x3B,    // Flash/EEPROM pages, NVM controller polling
+  UPDI_CHIP_ERASE = 0x3C, // NVMErase key (unlocks the part)
 
   SWD_INIT = 0x40,
   SWD_READ = 0x41,
   SWD_WRITE = 0x42,
-
-  BOOTLOADER = 0x50
+  SWD_MEM_READ = 0x43,  // MEM-AP block read, TAR auto-increment
+  SWD_MEM_WRITE = 0x44, // MEM-AP block write, TAR auto-increment
+
+  // STM32 flash through the RAM-resident loader (SWD)
+  STM32_FLASH_BEGIN = 0x45, // Reset-halt, unlock, optional mass erase, stub
+  STM32_FLASH_WRITE = 0x46, // Queue data into the double buffer
+  STM32_FLASH_END = 0x47,   // Drain, lock, reset into the application
+
+  BOOTLOADER = 0x50,
+
+  // SPI NOR Flash Engine (device-side algorithms)
+  FLASH_PATCH = 0x60,        // Sector read-modify-write with edit list
+  FLASH_PROGRAM = 0x61,      // Multi-page program with blank-page skipping
+  FLASH_CONFIG = 0x62,       // Quad write / address mode policy
+  FLASH_ERASE = 0x63,        // Sector/block/chip erase with BUSY polling
+  FLASH_GANG_CONFIG = 0x64,  // Gang chip-select set / selection
+  FLASH_GANG_ERASE = 0x65,   // Broadcast erase, per-chip status
+  FLASH_GANG_PROGRAM = 0x66, // Broadcast program, per-chip status
+  FLASH_GANG_VERIFY = 0x67,  // Per-chip read-back compare
+
+  // SPI NAND Engine (bad blocks, on-die ECC, cache read pipelining)
+  NAND_INFO = 0x70,    // Identify, geometry and bad block count
+  NAND_READ = 0x71,    // Logical/raw page read (ASYNC: streamed)
+  NAND_PROGRAM = 0x72, // Logical page program with bad block retirement
+  NAND_ERASE = 0x73,   // Logical block erase
+  NAND_BBT = 0x74,     // Bad block list
+  NAND_STATS = 0x75    // Read pipeline / ECC / retirement counters
 };
 
 struct OpupPacket {
@@ -65,12 +113,15 @@ public:
 
   // Send a response packet
   void sendResponse(uint8_t cmd, uint8_t seq, uint8_t *data, uint16_t len,
-                    bool error = false);
+                    bool error = false, bool async = false);
   void sendError(uint8_t seq, uint8_t errorCode, const char *msg = nullptr);
 
   // Registry
   void registerDriver(uint8_t startCmd, uint8_t endCmd, OPUPDriver *driver);
 
+  // Background job scheduler (JOB_STATUS / JOB_ABORT)
+  OPUPScheduler &getScheduler() { return scheduler; }
+
 private:
   // Parsing state
   enum State { WAIT_SOF, WAIT_HEADER, WAIT_DATA, WAIT_CRC };
@@ -86,8 +137,15 @@ private:
   uint8_t currentFlags;
 
   OPUPRegistry registry;
+  OPUPDriver *activeDriver; // Driver that handled the previous command
+
+  // Background jobs (commands sent with FLAGS.ASYNC)
+  OPUPScheduler scheduler;
 
   void processPacket();
+  void startJob(OPUPDriver *driver);
+  void serviceJobs();
+  void switchDriver(OPUPDriver *driver);
   uint32_t calculateCRC32(const uint8_t *data, size_t len);
 };
 
@@ -1,4 +1,5 @@
 #pragma once
+#include "OPUPJob.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -32,4 +33,62 @@ public:
    */
   virtual bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                              uint8_t *respData, uint16_t &respLen) = 0;
+
+  /**
+   * @brief Release bus state held across commands (e.g. an open CS).
+   *
+   * Called by the OPUP Core before another driver handles a command, since
+   * several subsystems share the same GPIOs.
+   */
+  virtual void release() {}
+
+  /**
+   * @brief Whether the driver's commands use the shared GPIOs.
+   *
+   * Drivers that don't (system commands) are served without releasing the
+   * active driver, so a held transaction survives a PING or JOB_STATUS.
+   */
+  virtual bool sharesPins() const { return true; }
+
+  /**
+   * @brief Start a long-running command in the background (FLAGS.ASYNC).
+   *
+   * The driver kicks off the operation, fills in the job priority, expected
+   * and worst-case duration and total size, and returns immediately. The
+   * scheduler then calls stepJob() until the job finishes and reports
+   * completion with an ASYNC event frame.
+   *
+   * @return false if the command has no async form or failed to start.
+   */
+  virtual bool startJob(uint8_t cmd, uint8_t *payload, uint16_t len,
+                        OPUPJob &job) {
+    return false;
+  }
+
+  /**
+   * @brief Run one bounded chunk of a background job.
+   *
+   * Steps must return quickly (one BUSY poll, one page, one read chunk) so
+   * that control commands are served between them.
+   *
+   * @param data Buffer for streamed data (up to OPUP_JOB_DATA_MAX bytes)
+   * @param dataLen Bytes written to data; sent as a DATA event ending at
+   * job.progress. Return RUNNING with the last chunk and DONE on the
+   * following step.
+   */
+  virtual OPUPJobState stepJob(OPUPJob &job, uint8_t *data,
+                               uint16_t &dataLen) {
+    return OPUPJobState::FAILED;
+  }
+
+  /**
+   * @brief Cancel a background job: release CS and bus state immediately.
+   */
+  virtual void abortJob(OPUPJob &job) {}
+
+  /**
+   * @brief Called once when a background job completes, fails, times out
+   * or is aborted.
+   */
+  virtual void endJob(OPUPJob &job) {}
 };
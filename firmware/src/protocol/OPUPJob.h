@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+
+class OPUPDriver;
+
+// Concurrent background jobs tracked by the OPUP Core
+#define OPUP_MAX_JOBS 4
+
+// Largest data chunk a job step may emit in one DATA event
+#define OPUP_JOB_DATA_MAX 1024
+
+// Bounds of the adaptive completion poll interval
+#define OPUP_JOB_POLL_MIN_MS 1
+#define OPUP_JOB_POLL_MAX_MS 250
+
+/**
+ * @brief Progress of a background job as reported by its driver
+ */
+enum class OPUPJobState : uint8_t {
+  RUNNING = 0, // More steps needed
+  DONE = 1,    // Completed successfully
+  FAILED = 2   // Target reported an error
+};
+
+/**
+ * @brief Status byte of an ASYNC event frame
+ */
+enum class OPUPJobStatus : uint8_t {
+  OK = 0,
+  FAILED = 1,
+  TIMEOUT = 2,
+  ABORTED = 3,
+  DATA = 0x10 // Not a completion: [Offset:4][Data:N] follows
+};
+
+/**
+ * @brief Scheduling class. Lower values run first when several jobs are due.
+ */
+enum class OPUPJobPriority : uint8_t {
+  CONTROL = 0, // Short housekeeping steps
+  NORMAL = 1,  // Completion polling (erase)
+  BULK = 2     // Chunked data transfer (program, stream read)
+};
+
+/**
+ * @brief A long-running command started with FLAGS.ASYNC
+ *
+ * The driver fills in priority, durations and total size when the job is
+ * started. Each step does one bounded chunk of work; the scheduler decides
+ * when the next step runs.
+ */
+struct OPUPJob {
+  uint8_t id = 0;  // Job ID returned to the host, 0 = slot free
+  uint8_t cmd = 0; // Command that started the job
+  uint8_t seq = 0; // SEQ of the starting request, echoed in events
+  OPUPJobPriority priority = OPUPJobPriority::NORMAL;
+  OPUPDriver *driver = nullptr;
+  bool aborted = false; // JOB_ABORT received, report and free next step
+
+  uint32_t startMs = 0;    // millis() when the job was started
+  uint32_t expectedMs = 0; // Typical duration; non-zero = adaptive polling
+  uint32_t timeoutMs = 0;  // Worst-case duration before giving up, 0 = none
+  uint32_t nextRunMs = 0;  // millis() of the next step
+
+  uint32_t progress = 0; // Bytes (or units) done, reported by JOB_STATUS
+  uint32_t total = 0;    // Bytes (or units) to do, 0 = unknown
+};
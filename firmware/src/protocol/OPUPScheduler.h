@@ -0,0 +1,205 @@
+#pragma once
+#include "OPUPDriver.h"
+#include "OPUPJob.h"
+#include <Arduino.h>
+#include <string.h>
+
+/**
+ * @brief Event frame produced by a job step (sent with FLAGS.ASYNC)
+ */
+struct OPUPJobEvent {
+  uint8_t cmd;
+  uint8_t seq;
+  bool error;
+  bool final; // Completion event (job slot freed)
+  uint8_t *data;
+  uint16_t len;
+};
+
+/**
+ * @brief Cooperative run-to-completion scheduler for background jobs.
+ *
+ * Jobs are resumable: every step does one bounded chunk of work and
+ * returns. The OPUP Core drains the serial link before each step, so
+ * control commands (ping, status, JOB_ABORT) wait for at most one chunk.
+ * When several jobs are due, the lowest OPUPJobPriority runs first.
+ */
+class OPUPScheduler {
+public:
+  /**
+   * @brief Start a job on a driver
+   * @param error OPUP error code when nullptr is returned
+   * @return The started job, or nullptr
+   */
+  OPUPJob *start(OPUPDriver *driver, uint8_t cmd, uint8_t seq,
+                 uint8_t *payload, uint16_t len, uint8_t &error) {
+    OPUPJob *slot = nullptr;
+    for (uint8_t i = 0; i < OPUP_MAX_JOBS; i++) {
+      if (jobs[i].id == 0) {
+        slot = &jobs[i];
+        break;
+      }
+    }
+    if (!slot) {
+      error = 0x05; // BUSY
+      return nullptr;
+    }
+
+    OPUPJob job;
+    job.cmd = cmd;
+    job.seq = seq;
+    job.driver = driver;
+    job.startMs = millis();
+    if (!driver->startJob(cmd, payload, len, job)) {
+      error = 0x02;
+      return nullptr;
+    }
+
+    job.id = nextId;
+    nextId = (nextId == 0xFF) ? 1 : nextId + 1; // 0 marks a free slot
+    // Polled jobs first look shortly before their typical completion time
+    job.nextRunMs = job.startMs + job.expectedMs / 2;
+    *slot = job;
+    return slot;
+  }
+
+  /**
+   * @brief Pick the job to step next: aborted jobs first, then the due job
+   * with the lowest priority value (earliest deadline breaks ties)
+   */
+  OPUPJob *next() {
+    uint32_t now = millis();
+    OPUPJob *best = nullptr;
+    for (uint8_t i = 0; i < OPUP_MAX_JOBS; i++) {
+      OPUPJob &job = jobs[i];
+      if (job.id == 0)
+        continue;
+      if (job.aborted)
+        return &job;
+      if ((int32_t)(now - job.nextRunMs) < 0)
+        continue;
+      if (!best || job.priority < best->priority ||
+          (job.priority == best->priority &&
+           (int32_t)(job.nextRunMs - best->nextRunMs) < 0)) {
+        best = &job;
+      }
+    }
+    return best;
+  }
+
+  /**
+   * @brief Run one step of a job
+   * @return true if event must be sent to the host
+   */
+  bool step(OPUPJob &job, OPUPJobEvent &event) {
+    event.cmd = job.cmd;
+    event.seq = job.seq;
+    event.error = false;
+    event.final = false;
+    event.data = eventBuf;
+
+    if (job.aborted)
+      return finish(job, OPUPJobStatus::ABORTED, event);
+
+    uint16_t dataLen = 0;
+    OPUPJobState state = job.driver->stepJob(job, &eventBuf[6], dataLen);
+    uint32_t elapsed = millis() - job.startMs;
+
+    if (state == OPUPJobState::FAILED)
+      return finish(job, OPUPJobStatus::FAILED, event);
+
+    if (state == OPUPJobState::RUNNING && job.timeoutMs &&
+        elapsed > job.timeoutMs) {
+      job.driver->abortJob(job);
+      return finish(job, OPUPJobStatus::TIMEOUT, event);
+    }
+
+    if (dataLen) {
+      // DATA event: [JobId:1][Status:1][Offset:4][Data:N]
+      uint32_t offset = job.progress - dataLen;
+      eventBuf[0] = job.id;
+      eventBuf[1] = static_cast<uint8_t>(OPUPJobStatus::DATA);
+      memcpy(&eventBuf[2], &offset, 4);
+      event.len = 6 + dataLen;
+      // A final chunk is followed by the completion event on the next step
+      job.nextRunMs = millis();
+      return true;
+    }
+
+    if (state == OPUPJobState::DONE)
+      return finish(job, OPUPJobStatus::OK, event);
+
+    job.nextRunMs = millis() + pollInterval(job, elapsed);
+    return false;
+  }
+
+  /**
+   * @brief Cancel one job (id != 0) or all jobs (id == 0)
+   *
+   * Bus state is cleaned up at once; the ABORTED event is sent by the next
+   * step.
+   * @return Number of jobs aborted
+   */
+  uint8_t abort(uint8_t id) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < OPUP_MAX_JOBS; i++) {
+      OPUPJob &job = jobs[i];
+      if (job.id == 0 || job.aborted || (id != 0 && job.id != id))
+        continue;
+      job.driver->abortJob(job);
+      job.aborted = true;
+      count++;
+    }
+    return count;
+  }
+
+  /**
+   * @brief True while any job holds a slot (aborted ones until their final
+   * event is sent)
+   */
+  bool busy() const {
+    for (uint8_t i = 0; i < OPUP_MAX_JOBS; i++) {
+      if (jobs[i].id != 0)
+        return true;
+    }
+    return false;
+  }
+
+  const OPUPJob &slot(uint8_t index) const { return jobs[index]; }
+
+private:
+  OPUPJob jobs[OPUP_MAX_JOBS];
+  uint8_t nextId = 1;
+  uint8_t eventBuf[6 + OPUP_JOB_DATA_MAX];
+
+  // Halve the remaining time until the typical duration, then poll at 1/32
+  // of it so the reported time stays within a few percent. Jobs without an
+  // expected duration run again on the next loop.
+  static uint32_t pollInterval(const OPUPJob &job, uint32_t elapsed) {
+    if (job.expectedMs == 0)
+      return 0;
+    uint32_t interval = (elapsed < job.expectedMs)
+                            ? (job.expectedMs - elapsed) / 2
+                            : job.expectedMs / 32;
+    if (interval < OPUP_JOB_POLL_MIN_MS)
+      interval = OPUP_JOB_POLL_MIN_MS;
+    if (interval > OPUP_JOB_POLL_MAX_MS)
+      interval = OPUP_JOB_POLL_MAX_MS;
+    return interval;
+  }
+
+  bool finish(OPUPJob &job, OPUPJobStatus status, OPUPJobEvent &event) {
+    // Completion event: [JobId:1][Status:1][ElapsedMs:4]
+    uint32_t elapsed = millis() - job.startMs;
+    eventBuf[0] = job.id;
+    eventBuf[1] = static_cast<uint8_t>(status);
+    memcpy(&eventBuf[2], &elapsed, 4);
+    event.len = 6;
+    event.error = status != OPUPJobStatus::OK;
+    event.final = true;
+
+    job.driver->endJob(job);
+    job.id = 0;
+    return true;
+  }
+};
@@ -3,10 +3,135 @@
 #include "../OPUP.h"
 #include "../OPUPDriver.h"
 
+// I2C_SCAN flags
+#define I2C_SCAN_QUICK 0x01 // PIO probe, address ACK only, short timeout
+
+// I2C_EEPROM_WRITE flags
+#define I2C_EEPROM_VERIFY 0x01 // Read every page back after its write cycle
+
+// I2C_BATCH
+#define I2C_BATCH_MAX_OPS 64
+#define I2C_BATCH_CONTINUE 0x01 // Run the remaining ops after a failure
+// DELAY and POLL waits block the main loop (jobs, JOB_ABORT): their sum
+// over a batch, and so every single wait, is capped
+#define I2C_BATCH_MAX_WAIT_US 1000000
+
+// I2C_BATCH operations
+enum class I2CBatchOp : uint8_t {
+  WRITE = 0x00,      // [Addr][WLen:1][Data:WLen]
+  READ = 0x01,       // [Addr][RLen:2]
+  WRITE_READ = 0x02, // [Addr][WLen:1][Data:WLen][RLen:2] (repeated start)
+  DELAY = 0x03,      // [Us:4]
+  POLL = 0x04        // [Addr][WLen:1][Data:WLen][Mask][Value][TimeoutMs:2]
+};
+
+// I2C_BATCH per-op status
+enum class I2CBatchStatus : uint8_t {
+  OK = 0,
+  NAK = 1,     // Address or data not acknowledged (or short read)
+  TIMEOUT = 2, // POLL value not reached
+  SKIPPED = 3  // Not run after an earlier failure
+};
+
 class OPUP_I2C : public OPUPDriver {
 private:
   I2CDriver &i2c;
 
+  struct BatchOp {
+    I2CBatchOp type;
+    uint8_t addr;
+    const uint8_t *wdata;
+    uint8_t wlen;
+    uint16_t rlen; // Bytes this op adds to the response (POLL: 1)
+    uint32_t delayUs;
+    uint8_t mask, value;
+    uint16_t timeoutMs;
+  };
+
+  // Decode the op at pos, advancing pos
+  static bool parseOp(const uint8_t *p, uint16_t len, uint16_t &pos,
+                      BatchOp &op) {
+    if (pos >= len)
+      return false;
+    op = BatchOp();
+    op.type = static_cast<I2CBatchOp>(p[pos++]);
+
+    if (op.type == I2CBatchOp::DELAY) {
+      if (pos + 4 > len)
+        return false;
+      memcpy(&op.delayUs, &p[pos], 4);
+      pos += 4;
+      return op.delayUs <= I2C_BATCH_MAX_WAIT_US;
+    }
+    if (op.type > I2CBatchOp::POLL || pos >= len)
+      return false;
+    op.addr = p[pos++];
+
+    if (op.type != I2CBatchOp::READ) {
+      if (pos >= len || pos + 1 + p[pos] > len)
+        return false;
+      op.wlen = p[pos++];
+      op.wdata = &p[pos];
+      pos += op.wlen;
+    }
+    if (op.type == I2CBatchOp::READ || op.type == I2CBatchOp::WRITE_READ) {
+      if (pos + 2 > len)
+        return false;
+      op.rlen = p[pos] | (p[pos + 1] << 8);
+      pos += 2;
+    }
+    if (op.type == I2CBatchOp::POLL) {
+      if (pos + 4 > len)
+        return false;
+      op.mask = p[pos];
+      op.value = p[pos + 1];
+      op.timeoutMs = p[pos + 2] | (p[pos + 3] << 8);
+      op.rlen = 1;
+      pos += 4;
+      if ((uint32_t)op.timeoutMs * 1000 > I2C_BATCH_MAX_WAIT_US)
+        return false;
+    }
+    return true;
+  }
+
+  // Longest time the op may wait on purpose (DELAY, POLL timeout)
+  static uint32_t waitUs(const BatchOp &op) {
+    if (op.type == I2CBatchOp::DELAY)
+      return op.delayUs;
+    if (op.type == I2CBatchOp::POLL)
+      return (uint32_t)op.timeoutMs * 1000;
+    return 0;
+  }
+
+  I2CBatchStatus runOp(const BatchOp &op, uint8_t *data) {
+    bool timedOut = false;
+    bool ok = false;
+    switch (op.type) {
+    case I2CBatchOp::WRITE:
+      ok = i2c.write(op.addr, const_cast<uint8_t *>(op.wdata), op.wlen);
+      break;
+    case I2CBatchOp::READ:
+      ok = i2c.read(op.addr, op.rlen, data);
+      break;
+    case I2CBatchOp::WRITE_READ:
+      ok = i2c.writeRead(op.addr, op.wdata, op.wlen, data, op.rlen);
+      break;
+    case I2CBatchOp::DELAY:
+      if (op.delayUs >= 1000)
+        delay(op.delayUs / 1000);
+      delayMicroseconds(op.delayUs % 1000);
+      ok = true;
+      break;
+    case I2CBatchOp::POLL:
+      ok = i2c.pollValue(op.addr, op.wdata, op.wlen, op.mask, op.value,
+                         op.timeoutMs, data[0], timedOut);
+      break;
+    }
+    if (ok)
+      return I2CBatchStatus::OK;
+    return timedOut ? I2CBatchStatus::TIMEOUT : I2CBatchStatus::NAK;
+  }
+
 public:
   OPUP_I2C(I2CDriver &driver) : i2c(driver) {}
 
@@ -19,9 +144,10 @@ public:
     switch (cmd) {
     case OpupCmd::I2C_SCAN: {
       uint8_t count = 0;
+      bool quick = len >= 1 && (payload[0] & I2C_SCAN_QUICK);
       // Scan fills addresses starting at respData[1], count is returned by
       // reference
-      i2c.scan(respData + 1, count);
+      i2c.scan(respData + 1, count, quick);
       // First byte of response is the count
       respData[0] = count;
       // Response length is 1 (count byte) + number of addresses found
@@ -35,10 +161,11 @@ public:
       uint16_t readLen = payload[1] | (payload[2] << 8);
 
       // Safety check
-      if (readLen > 4096)
-        readLen = 4096;
+      if (readLen > OPUP_MAX_PAYLOAD)
+        readLen = OPUP_MAX_PAYLOAD;
 
-      i2c.read(addr, readLen, respData);
+      if (!i2c.read(addr, readLen, respData))
+        return false;
       respLen = readLen;
       return true;
     }
@@ -50,6 +177,144 @@ public:
       respLen = 0;
       return true;
     }
+
+    // ============================================
+    // 0x13: I2C_EEPROM_WRITE
+    // Request: [Addr:1][AddrWidth:1][PageSize:2][MemAddr:4][Flags:1][Data:N]
+    // Response: [Status:1][Written:2][Pages:2][TwrMin:2][TwrAvg:2][TwrMax:2]
+    //   Status: 0 = OK, 1 = NAK, 2 = write cycle timeout, 3 = verify failed
+    //   Twr*: write cycle time in us (ACK polling)
+    // ============================================
+    case OpupCmd::I2C_EEPROM_WRITE: {
+      if (len < 10)
+        return false;
+      uint8_t addrWidth = payload[1];
+      uint16_t pageSize = payload[2] | (payload[3] << 8);
+      uint32_t memAddr;
+      memcpy(&memAddr, &payload[4], 4);
+      if ((addrWidth != 1 && addrWidth != 2) || pageSize == 0)
+        return false;
+
+      I2CEepromResult result;
+      i2c.eepromWrite(payload[0], addrWidth, pageSize, memAddr, &payload[9],
+                      len - 9, payload[8] & I2C_EEPROM_VERIFY, result);
+
+      uint16_t twrAvg = result.pages ? result.twrTotalUs / result.pages : 0;
+      respData[0] = static_cast<uint8_t>(result.status);
+      memcpy(&respData[1], &result.written, 2);
+      memcpy(&respData[3], &result.pages, 2);
+      memcpy(&respData[5], &result.twrMinUs, 2);
+      memcpy(&respData[7], &twrAvg, 2);
+      memcpy(&respData[9], &result.twrMaxUs, 2);
+      respLen = 11;
+      return true;
+    }
+    // ============================================
+    // 0x14: I2C_WRITE_READ
+    // Request: [Addr:1][AddrWidth:1][MemAddr:4][Len:2]
+    //   AddrWidth: 0 (current address), 1 or 2 memory address bytes
+    // Response: [Data:Len] (Len up to OPUP_MAX_PAYLOAD)
+    // ============================================
+    case OpupCmd::I2C_WRITE_READ: {
+      if (len < 8)
+        return false;
+      uint8_t addrWidth = payload[1];
+      uint32_t memAddr;
+      memcpy(&memAddr, &payload[2], 4);
+      uint16_t readLen = payload[6] | (payload[7] << 8);
+      if (addrWidth > 2 || readLen > OPUP_MAX_PAYLOAD)
+        return false;
+
+      if (!i2c.readMem(payload[0], addrWidth, memAddr, respData, readLen))
+        return false;
+      respLen = readLen;
+      return true;
+    }
+
+    // ============================================
+    // 0x15: I2C_SET_SPEED
+    // Request: [Hz:4] (empty: query only)
+    // Response: [Hz:4] (current SCL frequency)
+    // ============================================
+    case OpupCmd::I2C_SET_SPEED: {
+      if (len >= 4) {
+        uint32_t hz;
+        memcpy(&hz, payload, 4);
+        if (!i2c.setClock(hz))
+          return false;
+      }
+      uint32_t hz = i2c.getClock();
+      memcpy(respData, &hz, 4);
+      respLen = 4;
+      return true;
+    }
+
+    // ============================================
+    // 0x16: I2C_BATCH
+    // Request: [Flags:1][Op...] (see I2CBatchOp, up to I2C_BATCH_MAX_OPS,
+    //          DELAY + POLL timeouts up to I2C_BATCH_MAX_WAIT_US in total)
+    // Response: [Count:1][Status:1]*Count[Data...]
+    //   Data: READ / WRITE_READ bytes and the last POLL byte, in op order
+    //   (0xFF for ops that failed or were skipped)
+    // ============================================
+    case OpupCmd::I2C_BATCH: {
+      if (len < 1)
+        return false;
+      bool keepGoing = payload[0] & I2C_BATCH_CONTINUE;
+
+      // Validate the whole list before touching the bus
+      BatchOp op;
+      uint16_t pos = 1;
+      uint8_t count = 0;
+      uint32_t dataLen = 0;
+      uint32_t wait = 0;
+      while (pos < len) {
+        if (count == I2C_BATCH_MAX_OPS || !parseOp(payload, len, pos, op))
+          return false;
+        count++;
+        dataLen += op.rlen;
+        wait += waitUs(op);
+      }
+      if (1 + count + dataLen > OPUP_MAX_PAYLOAD ||
+          wait > I2C_BATCH_MAX_WAIT_US)
+        return false;
+
+      respData[0] = count;
+      respLen = 1 + count;
+      bool failed = false;
+      pos = 1;
+      for (uint8_t i = 0; i < count; i++) {
+        parseOp(payload, len, pos, op);
+        uint8_t *data = &respData[respLen];
+        I2CBatchStatus status = I2CBatchStatus::SKIPPED;
+        if (!failed || keepGoing)
+          status = runOp(op, data);
+        if (status != I2CBatchStatus::OK) {
+          memset(data, 0xFF, op.rlen);
+          failed = true;
+        }
+        respData[1 + i] = static_cast<uint8_t>(status);
+        respLen += op.rlen;
+      }
+      return true;
+    }
+
+    // ============================================
+    // 0x17: I2C_SET_ENGINE
+    // Request: [Engine:1] (0 = Wire, 1 = PIO; empty: query only)
+    // Response: [Engine:1]
+    // ============================================
+    case OpupCmd::I2C_SET_ENGINE: {
+      if (len >= 1) {
+        if (payload[0] > static_cast<uint8_t>(I2CEngine::PIO) ||
+            !i2c.setEngine(static_cast<I2CEngine>(payload[0])))
+          return false;
+      }
+      respData[0] = static_cast<uint8_t>(i2c.getEngine());
+      respLen = 1;
+      return true;
+    }
+
     default:
       return false;
     }
@@ -3,10 +3,24 @@
 #include "../OPUP.h"
 #include "../OPUPDriver.h"
 
+// ISP_PROGRAM_PAGE flags
+#define ISP_PROGRAM_SKIP_BLANK 0x01 // Skip all-0xFF pages (chip erased)
+
+// ISP_VERIFY_MEMORY reads the target in blocks of this size
+#define ISP_VERIFY_CHUNK 256
+
 class OPUP_ISP : public OPUPDriver {
 private:
   ISPDriver &isp;
 
+  static bool isBlank(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+      if (data[i] != 0xFF)
+        return false;
+    }
+    return true;
+  }
+
 public:
   OPUP_ISP(ISPDriver &driver) : isp(driver) {}
 
@@ -17,9 +31,24 @@ public:
   bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                      uint8_t *respData, uint16_t &respLen) override {
     switch (cmd) {
+    // ============================================
+    // 0x30: ISP_ENTER
+    // Request: [Sck:4] (optional; pins SCK for this and later enters,
+    //          0 = negotiate again)
+    // Response: [Success:1][Sck:4] (SCK in use)
+    // ============================================
     case OpupCmd::ISP_ENTER: {
+      if (len >= 4) {
+        uint32_t hz;
+        memcpy(&hz, payload, 4);
+        if (!isp.setFixedClock(hz))
+          return false;
+      }
       if (isp.enterProgrammingMode()) {
-        respLen = 0;
+        uint32_t sck = isp.getClock();
+        respData[0] = 1;
+        memcpy(&respData[1], &sck, 4);
+        respLen = 5;
         return true;
       }
       return false;
@@ -36,6 +65,109 @@ public:
       respLen = 0;
       return true;
     }
+    // ============================================
+    // 0x33: ISP_PROGRAM_PAGE
+    // Request: [Flags:1][PageSize:2][Addr:4][Data:N]
+    //   Addr: byte address (page aligned), Data: one or more pages (N even)
+    // Response: [Status:1][Pages:2][Skipped:2][BusyMaxUs:2]
+    //   Status: 0 = OK, 1 = RDY/BSY timeout at page Pages + Skipped
+    // ============================================
+    case OpupCmd::ISP_PROGRAM_PAGE: {
+      if (len < 7)
+        return false;
+      uint16_t pageSize = payload[1] | (payload[2] << 8);
+      uint32_t addr;
+      memcpy(&addr, &payload[3], 4);
+      uint16_t dataLen = len - 7;
+      if (pageSize == 0 || (pageSize & 1) || (addr % pageSize) ||
+          (dataLen & 1))
+        return false;
+
+      const uint8_t *data = &payload[7];
+      uint16_t pages = 0, skipped = 0, busyMax = 0;
+      uint8_t status = 0;
+      for (uint16_t off = 0; off < dataLen; off += pageSize) {
+        uint16_t n = dataLen - off < pageSize ? dataLen - off : pageSize;
+        if ((payload[0] & ISP_PROGRAM_SKIP_BLANK) && isBlank(&data[off], n)) {
+          skipped++;
+          continue;
+        }
+        uint32_t busyUs;
+        if (!isp.programPage(addr + off, &data[off], n, busyUs)) {
+          status = 1;
+          break;
+        }
+        if (busyUs > busyMax)
+          busyMax = busyUs;
+        pages++;
+      }
+
+      respData[0] = status;
+      memcpy(&respData[1], &pages, 2);
+      memcpy(&respData[3], &skipped, 2);
+      memcpy(&respData[5], &busyMax, 2);
+      respLen = 7;
+      return true;
+    }
+
+    // ============================================
+    // 0x34: ISP_READ_MEMORY
+    // Request: [Type:1][Addr:4][Len:2] (Type: see AvrMemory)
+    // Response: [Data:Len] (Len up to OPUP_MAX_PAYLOAD)
+    // ============================================
+    case OpupCmd::ISP_READ_MEMORY: {
+      if (len < 7 || payload[0] > static_cast<uint8_t>(AvrMemory::SIGNATURE))
+        return false;
+      uint32_t addr;
+      memcpy(&addr, &payload[1], 4);
+      uint16_t readLen = payload[5] | (payload[6] << 8);
+      if (readLen > OPUP_MAX_PAYLOAD ||
+          !isp.readMemory(static_cast<AvrMemory>(payload[0]), addr, respData,
+                          readLen))
+        return false;
+      respLen = readLen;
+      return true;
+    }
+
+    // ============================================
+    // 0x35: ISP_VERIFY_MEMORY
+    // Request: [Type:1][Addr:4][Data:N]
+    // Response: [Mismatches:2][Offset:2]* (offsets into Data, the first
+    //           (OPUP_MAX_PAYLOAD - 2) / 2 mismatches)
+    // ============================================
+    case OpupCmd::ISP_VERIFY_MEMORY: {
+      if (len < 5 || payload[0] > static_cast<uint8_t>(AvrMemory::SIGNATURE))
+        return false;
+      AvrMemory mem = static_cast<AvrMemory>(payload[0]);
+      uint32_t addr;
+      memcpy(&addr, &payload[1], 4);
+      const uint8_t *expect = &payload[5];
+      uint16_t dataLen = len - 5;
+
+      uint8_t chunk[ISP_VERIFY_CHUNK];
+      uint16_t count = 0;
+      respLen = 2;
+      for (uint16_t off = 0; off < dataLen; off += sizeof(chunk)) {
+        uint16_t n = dataLen - off;
+        if (n > sizeof(chunk))
+          n = sizeof(chunk);
+        if (!isp.readMemory(mem, addr + off, chunk, n))
+          return false;
+        for (uint16_t i = 0; i < n; i++) {
+          if (chunk[i] == expect[off + i])
+            continue;
+          uint16_t o = off + i;
+          if (respLen + 2 <= OPUP_MAX_PAYLOAD) {
+            memcpy(&respData[respLen], &o, 2);
+            respLen += 2;
+          }
+          count++;
+        }
+      }
+      memcpy(&respData[0], &count, 2);
+      return true;
+    }
+
     default:
       return false;
     }
@@ -0,0 +1,249 @@
+#pragma once
+#include "../../spi_nand.h"
+#include "../OPUP.h"
+#include "../OPUPDriver.h"
+
+// NAND_INFO flags
+#define NAND_INFO_RESCAN 0x01 // Identify again and rebuild the bad block table
+#define NAND_INFO_SINGLE 0x02 // 1-1-1 data phases (no 0x6B/0x32)
+
+// NAND_READ flags
+#define NAND_READ_RAW 0x01   // Physical pages, bad blocks not skipped
+#define NAND_READ_SPARE 0x02 // Append the spare area to each page
+
+// NAND_PROGRAM flags
+#define NAND_PROGRAM_ERASE 0x01 // Erase the block before its first page
+
+// Blocks erased by one NAND_ERASE (tBERS max 10ms each)
+#define NAND_ERASE_MAX 64
+
+/**
+ * @brief OPUP SPI NAND Driver
+ * Serves the NAND engine (0x70 - 0x7F) on the QSPI bus
+ */
+class OPUP_NAND : public OPUPDriver {
+private:
+  SPINand &nand;
+  bool jobActive = false;
+
+public:
+  OPUP_NAND(SPINand &engine) : nand(engine) {}
+
+  void begin() override {
+    // QSPI initialized in main, the chip is identified by NAND_INFO
+  }
+
+  // Another driver is about to use the bus: drop the pipeline, a running
+  // read resumes with a fresh page load
+  void release() override { nand.interrupt(); }
+
+  // ============================================
+  // Background jobs (FLAGS.ASYNC)
+  //   NAND_READ: [Page:4][Count:4][Flags:1], DATA events of up to 1KB
+  // ============================================
+  bool startJob(uint8_t cmd, uint8_t *payload, uint16_t len,
+                OPUPJob &job) override {
+    if (jobActive || cmd != OpupCmd::NAND_READ || len < 9)
+      return false;
+
+    uint32_t page, count;
+    memcpy(&page, &payload[0], 4);
+    memcpy(&count, &payload[4], 4);
+    if (!nand.startRead(page, count, payload[8] & NAND_READ_RAW,
+                        payload[8] & NAND_READ_SPARE))
+      return false;
+
+    job.total = count * nand.getReadPageLen();
+    job.timeoutMs = count * NAND_TIMEOUT_READ_MS * 4 + 1000;
+    job.priority = OPUPJobPriority::BULK;
+    jobActive = true;
+    return true;
+  }
+
+  OPUPJobState stepJob(OPUPJob &job, uint8_t *data,
+                       uint16_t &dataLen) override {
+    if (job.progress >= job.total)
+      return OPUPJobState::DONE;
+
+    // Never more than one page per step: the next page load overlaps the
+    // transfer of this chunk to the host
+    dataLen = nand.readNext(data, OPUP_JOB_DATA_MAX);
+    if (dataLen == 0)
+      return OPUPJobState::FAILED;
+    job.progress += dataLen;
+    return OPUPJobState::RUNNING;
+  }
+
+  void abortJob(OPUPJob &job) override { nand.endRead(); }
+
+  void endJob(OPUPJob &job) override {
+    nand.endRead();
+    jobActive = false;
+  }
+
+  bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
+                     uint8_t *respData, uint16_t &respLen) override {
+    respLen = 0;
+    // A streamed read owns the chip until it completes
+    if (jobActive && cmd != OpupCmd::NAND_BBT && cmd != OpupCmd::NAND_STATS)
+      return false;
+
+    switch (cmd) {
+
+    // ============================================
+    // 0x70: NAND_INFO
+    // Request: [Flags:1] (optional)
+    // Response: [Mfg:1][Dev:2][PageSize:2][SpareSize:2][PagesPerBlock:2]
+    //           [Blocks:2][Planes:1][ChipFlags:1][BadBlocks:2]
+    // ============================================
+    case OpupCmd::NAND_INFO: {
+      uint8_t flags = len >= 1 ? payload[0] : 0;
+      nand.setQuad(!(flags & NAND_INFO_SINGLE));
+      bool rescan = !nand.getChip() || (flags & NAND_INFO_RESCAN);
+      if (rescan && !nand.identify())
+        return false; // No known SPI NAND
+
+      const NandChip *chip = nand.getChip();
+      uint16_t bad = nand.getBadCount();
+      respData[0] = nand.getId()[0];
+      respData[1] = nand.getId()[1];
+      respData[2] = nand.getId()[2];
+      memcpy(&respData[3], &chip->pageSize, 2);
+      memcpy(&respData[5], &chip->spareSize, 2);
+      memcpy(&respData[7], &chip->pagesPerBlock, 2);
+      memcpy(&respData[9], &chip->blocks, 2);
+      respData[11] = chip->planes;
+      respData[12] = chip->flags;
+      memcpy(&respData[13], &bad, 2);
+      respLen = 15;
+      return true;
+    }
+
+    // ============================================
+    // 0x71: NAND_READ
+    // Request: [Page:4][Count:4][Flags:1]
+    // Response: [Data:Count * PageLen] (must fit one frame; use FLAGS.ASYNC
+    //           to stream dumps)
+    // ============================================
+    case OpupCmd::NAND_READ: {
+      if (len < 9)
+        return false;
+      uint32_t page, count;
+      memcpy(&page, &payload[0], 4);
+      memcpy(&count, &payload[4], 4);
+      if (!nand.startRead(page, count, payload[8] & NAND_READ_RAW,
+                          payload[8] & NAND_READ_SPARE))
+        return false;
+      if (count * nand.getReadPageLen() > OPUP_MAX_PAYLOAD) {
+        nand.endRead();
+        return false;
+      }
+
+      uint16_t n;
+      do {
+        n = nand.readNext(&respData[respLen], OPUP_MAX_PAYLOAD - respLen);
+        respLen += n;
+      } while (n);
+      nand.endRead();
+      return respLen == count * nand.getReadPageLen();
+    }
+
+    // ============================================
+    // 0x72: NAND_PROGRAM
+    // Request: [Flags:1][Page:4][Data:N] (N up to page + spare size)
+    // Response: [Status:1][Block:2][BadBlocks:2]
+    //   Status: 0 = programmed, 1 = blank page skipped,
+    //           2 = block retired, resend the block from its first page
+    // ============================================
+    case OpupCmd::NAND_PROGRAM: {
+      const NandChip *chip = nand.getChip();
+      if (!chip || len < 6 || len - 5 > chip->pageSize + chip->spareSize)
+        return false;
+      uint32_t page;
+      memcpy(&page, &payload[1], 4);
+
+      NandProgramStatus status;
+      uint16_t block;
+      if (!nand.programLogical(page, &payload[5], len - 5,
+                               payload[0] & NAND_PROGRAM_ERASE, status, block))
+        return false; // Out of good blocks
+
+      uint16_t bad = nand.getBadCount();
+      respData[0] = static_cast<uint8_t>(status);
+      memcpy(&respData[1], &block, 2);
+      memcpy(&respData[3], &bad, 2);
+      respLen = 5;
+      return true;
+    }
+
+    // ============================================
+    // 0x73: NAND_ERASE
+    // Request: [Block:2][Count:2] (logical blocks, Count default 1)
+    // Response: [Erased:2][NewBad:2] (Erased < Count: out of good blocks)
+    // ============================================
+    case OpupCmd::NAND_ERASE: {
+      if (!nand.getChip() || len < 2)
+        return false;
+      uint16_t block = payload[0] | (payload[1] << 8);
+      uint16_t count = len >= 4 ? payload[2] | (payload[3] << 8) : 1;
+      if (count == 0 || count > NAND_ERASE_MAX)
+        return false;
+
+      uint16_t newBad;
+      uint16_t erased = nand.eraseLogical(block, count, newBad);
+      memcpy(&respData[0], &erased, 2);
+      memcpy(&respData[2], &newBad, 2);
+      respLen = 4;
+      return true;
+    }
+
+    // ============================================
+    // 0x74: NAND_BBT
+    // Response: [Count:2][Block:2]*Count (physical blocks)
+    // ============================================
+    case OpupCmd::NAND_BBT: {
+      const NandChip *chip = nand.getChip();
+      if (!chip)
+        return false;
+      uint16_t count = 0;
+      respLen = 2;
+      for (uint16_t block = 0; block < chip->blocks; block++) {
+        if (!nand.isBad(block))
+          continue;
+        if (respLen + 2 > OPUP_MAX_PAYLOAD)
+          break;
+        memcpy(&respData[respLen], &block, 2);
+        respLen += 2;
+        count++;
+      }
+      memcpy(&respData[0], &count, 2);
+      return true;
+    }
+
+    // ============================================
+    // 0x75: NAND_STATS
+    // Request: [Flags:1] (optional, bit0: reset after reading)
+    // Response: [PagesRead:4][Pipelined:4][Corrected:4][Uncorrectable:4]
+    //           [Programmed:4][Erased:4][NewBad:4]
+    // ============================================
+    case OpupCmd::NAND_STATS: {
+      const NandStats &stats = nand.getStats();
+      memcpy(&respData[0], &stats.pagesRead, 4);
+      memcpy(&respData[4], &stats.pipelined, 4);
+      memcpy(&respData[8], &stats.corrected, 4);
+      memcpy(&respData[12], &stats.uncorrectable, 4);
+      memcpy(&respData[16], &stats.programmed, 4);
+      memcpy(&respData[20], &stats.erased, 4);
+      memcpy(&respData[24], &stats.newBad, 4);
+      respLen = 28;
+      if (len >= 1 && (payload[0] & 0x01))
+        nand.resetStats();
+      return true;
+    }
+
+    default:
+      respLen = 0;
+      return false;
+    }
+  }
+};
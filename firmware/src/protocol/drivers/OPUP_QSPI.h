@@ -1,8 +1,17 @@
 #pragma once
+#include "../../clock_tuner.h"
 #include "../../qspi_driver.h"
+#include "../../spi_flash.h"
 #include "../OPUP.h"
 #include "../OPUPDriver.h"
 
+// Bytes read per step of a background QSPI_FAST_READ stream
+#define QSPI_JOB_READ_CHUNK 512
+
+// QSPI_PROBE_MODES region (default and largest length, half of jobBuf)
+#define QSPI_PROBE_DEFAULT 1024
+#define QSPI_PROBE_MAX (OPUP_MAX_PAYLOAD / 2)
+
 /**
  * @brief OPUP QSPI Driver
  * Handles Quad SPI commands for Serial Flash (W25Qxx, etc.)
@@ -11,14 +20,185 @@
 class OPUP_QSPI : public OPUPDriver {
 private:
   QSPIDriver &qspi;
+  SPIFlash &flash;
+  ClockTuner &tuner;
+
+  // Background job state (one flash job at a time)
+  bool jobActive = false;
+  bool jobTrim = false;     // FLASH_PROGRAM: trim trailing 0xFF
+  bool jobPageBusy = false; // FLASH_PROGRAM: page in tPP
+  uint32_t jobAddr = 0;
+  uint8_t jobBuf[OPUP_MAX_PAYLOAD]; // FLASH_PROGRAM data
+
+  /**
+   * @brief Decode a FLASH_ERASE request: [Type:1][Addr:4]
+   */
+  static bool parseErase(const uint8_t *payload, uint16_t len,
+                         FlashEraseType &type, uint32_t &addr) {
+    if (len < 1 || payload[0] > static_cast<uint8_t>(FlashEraseType::CHIP))
+      return false; // Invalid erase type
+    if (payload[0] != static_cast<uint8_t>(FlashEraseType::CHIP) && len < 5)
+      return false; // Address required
+
+    type = static_cast<FlashEraseType>(payload[0]);
+    addr = 0;
+    if (len >= 5) {
+      addr = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
+             ((uint32_t)payload[4] << 24);
+    }
+    return true;
+  }
 
 public:
-  OPUP_QSPI(QSPIDriver &driver) : qspi(driver) {}
+  OPUP_QSPI(QSPIDriver &driver, SPIFlash &flashEngine, ClockTuner &clockTuner)
+      : qspi(driver), flash(flashEngine), tuner(clockTuner) {}
 
   void begin() override { qspi.begin(); }
 
+  // Another driver is about to use the shared pins: close any held read,
+  // stop prefetching behind its back and take the chip out of QPI (left
+  // there by QSPI_PROBE_MODES), since the SPI driver talks 1-1-1 on CS 17
+  void release() override {
+    flash.invalidateReadAhead();
+    qspi.endStream();
+    if (qspi.isQPIActive())
+      qspi.exitQPI(); // Bus mode is Standard afterwards
+  }
+
+  /**
+   * @brief Plain array reads (0x03/0x0B and 4-byte variants) return the
+   * same data as the engine's fast read, so they share the read-ahead
+   */
+  static bool isArrayRead(uint8_t opcode) {
+    return opcode == 0x03 || opcode == 0x0B || opcode == 0x13 ||
+           opcode == 0x0C;
+  }
+
+  // ============================================
+  // Background jobs (FLAGS.ASYNC)
+  //   FLASH_ERASE:    [Type:1][Addr:4], polled until BUSY clears
+  //   FLASH_PROGRAM:  [Flags:1][Addr:4][Data:N], one page per step
+  //   QSPI_FAST_READ: [Addr:4][Length:4], DATA events of 512 bytes
+  // ============================================
+  bool startJob(uint8_t cmd, uint8_t *payload, uint16_t len,
+                OPUPJob &job) override {
+    if (jobActive)
+      return false; // One flash job at a time
+
+    switch (cmd) {
+    case OpupCmd::FLASH_ERASE: {
+      FlashEraseType type;
+      if (!parseErase(payload, len, type, jobAddr) ||
+          !flash.startErase(type, jobAddr, job.expectedMs, job.timeoutMs))
+        return false;
+      job.priority = OPUPJobPriority::NORMAL;
+      break;
+    }
+
+    case OpupCmd::FLASH_PROGRAM: {
+      if (len < 6)
+        return false;
+      jobTrim = payload[0] & 0x01;
+      jobAddr = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
+                ((uint32_t)payload[4] << 24);
+      job.total = len - 5;
+      memcpy(jobBuf, &payload[5], job.total);
+      jobPageBusy = false;
+
+      uint32_t pages = job.total / FLASH_PAGE_SIZE + 2;
+      job.timeoutMs = pages * FLASH_TIMEOUT_PAGE_MS + 1000;
+      job.priority = OPUPJobPriority::BULK;
+      break;
+    }
+
+    case OpupCmd::QSPI_FAST_READ: {
+      if (len < 8)
+        return false;
+      jobAddr = payload[0] | (payload[1] << 8) | (payload[2] << 16) |
+                ((uint32_t)payload[3] << 24);
+      memcpy(&job.total, &payload[4], 4);
+      job.priority = OPUPJobPriority::BULK;
+      break;
+    }
+
+    default:
+      return false;
+    }
+
+    jobActive = true;
+    return true;
+  }
+
+  OPUPJobState stepJob(OPUPJob &job, uint8_t *data,
+                       uint16_t &dataLen) override {
+    switch (job.cmd) {
+    case OpupCmd::FLASH_ERASE:
+      return flash.isBusy() ? OPUPJobState::RUNNING : OPUPJobState::DONE;
+
+    case OpupCmd::FLASH_PROGRAM:
+      if (jobPageBusy) {
+        if (flash.isBusy())
+          return OPUPJobState::RUNNING;
+        jobPageBusy = false;
+      }
+
+      // Start the next non-blank page, then yield during tPP
+      while (job.progress < job.total) {
+        uint32_t addr = jobAddr + job.progress;
+        uint16_t chunk = FLASH_PAGE_SIZE - (addr % FLASH_PAGE_SIZE);
+        if (chunk > job.total - job.progress)
+          chunk = job.total - job.progress;
+
+        const uint8_t *page = &jobBuf[job.progress];
+        uint16_t used = SPIFlash::usedLength(page, chunk);
+        job.progress += chunk;
+        if (used == 0)
+          continue;
+
+        if (!flash.startProgramPage(addr, page, jobTrim ? used : chunk))
+          return OPUPJobState::FAILED;
+        jobPageBusy = true;
+        return OPUPJobState::RUNNING;
+      }
+      return OPUPJobState::DONE;
+
+    case OpupCmd::QSPI_FAST_READ: {
+      if (job.progress >= job.total)
+        return OPUPJobState::DONE;
+
+      uint32_t chunk = job.total - job.progress;
+      if (chunk > QSPI_JOB_READ_CHUNK)
+        chunk = QSPI_JOB_READ_CHUNK;
+      // Contiguous chunks continue the held read stream
+      flash.fastRead(jobAddr + job.progress, data, chunk);
+      job.progress += chunk;
+      dataLen = chunk;
+      return OPUPJobState::RUNNING;
+    }
+
+    default:
+      return OPUPJobState::FAILED;
+    }
+  }
+
+  // A running erase or page program finishes on the chip; only the bus is
+  // released here
+  void abortJob(OPUPJob &job) override {
+    qspi.endStream();
+    qspi.csHigh();
+  }
+
+  void endJob(OPUPJob &job) override { jobActive = false; }
+
   bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                      uint8_t *respData, uint16_t &respLen) override {
+    // A background erase/program/stream owns the chip (and the chip
+    // selection) until it completes
+    if (jobActive && cmd != OpupCmd::QSPI_STATS) {
+      respLen = 0;
+      return false;
+    }
+
     switch (cmd) {
 
     // ============================================
@@ -38,6 +218,9 @@ public:
         return false; // Invalid mode
       }
 
+      flash.invalidateReadAhead();
+      if (qspi.isQPIActive() && mode != static_cast<uint8_t>(QSPIMode::QPI))
+        qspi.exitQPI(); // Chip was put in QPI by QSPI_PROBE_MODES
       qspi.setMode(static_cast<QSPIMode>(mode));
       respData[0] = static_cast<uint8_t>(qspi.getMode());
       respLen = 1;
@@ -71,6 +254,11 @@ public:
       if (readLen > 4096)
         readLen = 4096;
 
+      respLen = readLen;
+      bool arrayRead = isArrayRead(flashCmd);
+      if (arrayRead && flash.readAheadHit(addr, respData, readLen))
+        return true;
+
       // Execute read sequence
       qspi.csLow();
       qspi.sendCommand(flashCmd);
@@ -79,7 +267,8 @@ public:
       qspi.readData(respData, readLen);
       qspi.csHigh();
 
-      respLen = readLen;
+      if (arrayRead)
+        flash.armReadAhead(addr + readLen, readLen);
       return true;
     }
 
@@ -105,6 +294,7 @@ public:
 
       uint16_t dataOffset = 2 + addrLen;
       uint16_t dataLen = len - dataOffset;
+      flash.invalidateReadAhead(); // May program, erase or reconfigure
 
       // Execute write sequence
       qspi.csLow();
@@ -119,7 +309,7 @@ public:
 
     // ============================================
     // 0x28: QSPI_FAST_READ (Optimized page read)
-    // Request: [Addr:3][PageCount:1]
+    // Request: [Addr:3][PageCount:1] or [Addr:4][PageCount:1]
     // Response: [Data:256*PageCount]
     // ============================================
     case OpupCmd::QSPI_FAST_READ: {
@@ -128,53 +318,21 @@ public:
         return false;
       }
 
-      uint32_t addr = payload[0] | (payload[1] << 8) | (payload[2] << 16);
-      uint8_t pageCount = payload[3];
+      // A 5-byte payload carries a 32-bit address for >16MB parts
+      uint8_t addrLen = (len >= 5) ? 4 : 3;
+      uint32_t addr = 0;
+      for (uint8_t i = 0; i < addrLen; i++) {
+        addr |= ((uint32_t)payload[i] << (i * 8));
+      }
+
+      uint8_t pageCount = payload[addrLen];
       if (pageCount > 16)
         pageCount = 16; // Max 4KB
 
       uint16_t totalLen = pageCount * 256;
 
-      // Use appropriate fast read command based on mode
-      uint8_t fastReadCmd;
-      uint8_t dummyCycles;
-
-      switch (qspi.getMode()) {
-      case QSPIMode::STANDARD:
-        fastReadCmd = 0x0B; // Fast Read
-        dummyCycles = 8;
-        break;
-      case QSPIMode::DUAL_OUT:
-        fastReadCmd = 0x3B; // Fast Read Dual Output
-        dummyCycles = 8;
-        break;
-      case QSPIMode::DUAL_IO:
-        fastReadCmd = 0xBB; // Fast Read Dual I/O
-        dummyCycles = 4;
-        break;
-      case QSPIMode::QUAD_OUT:
-        fastReadCmd = 0x6B; // Fast Read Quad Output
-        dummyCycles = 8;
-        break;
-      case QSPIMode::QUAD_IO:
-        fastReadCmd = 0xEB; // Fast Read Quad I/O
-        dummyCycles = 6;
-        break;
-      case QSPIMode::QPI:
-        fastReadCmd = 0xEB; // Fast Read in QPI
-        dummyCycles = 6;
-        break;
-      default:
-        fastReadCmd = 0x03; // Normal read
-        dummyCycles = 0;
-      }
-
-      qspi.csLow();
-      qspi.sendCommand(fastReadCmd);
-      qspi.sendAddress(addr, 3);
-      qspi.sendDummyCycles(dummyCycles);
-      qspi.readData(respData, totalLen);
-      qspi.csHigh();
+      // Opcode, dummy cycles and 3/4-byte addressing chosen by the engine
+      flash.fastRead(addr, respData, totalLen);
 
       respLen = totalLen;
       return true;
@@ -197,6 +355,13 @@ public:
       if (txLen > 64)
         txLen = 64;
 
+      // Raw status writes or resets may change QE behind the engine's back
+      if (flashCmd == 0x01 || flashCmd == 0x31 || flashCmd == 0x11 ||
+          flashCmd == 0x99 || flashCmd == 0xE9) {
+        flash.invalidate();
+      }
+      flash.invalidateReadAhead();
+
       qspi.csLow();
       qspi.sendCommand(flashCmd);
 
@@ -216,6 +381,334 @@ public:
       return true;
     }
 
+    // ============================================
+    // 0x2A: QSPI_STATS (Fast read chaining and read-ahead counters)
+    // Request: [Reset:1] (optional, non-zero clears counters after reply)
+    // Response: [Full:4][Continuous:4][Chained:4][ClocksSaved:4]
+    //           [AheadHits:4][AheadMisses:4][AheadBytes:4]
+    // ============================================
+    case OpupCmd::QSPI_STATS: {
+      const FlashReadStats &stats = flash.getReadStats();
+      memcpy(&respData[0], &stats.full, 4);
+      memcpy(&respData[4], &stats.continuous, 4);
+      memcpy(&respData[8], &stats.chained, 4);
+      memcpy(&respData[12], &stats.clocksSaved, 4);
+      memcpy(&respData[16], &stats.aheadHits, 4);
+      memcpy(&respData[20], &stats.aheadMisses, 4);
+      memcpy(&respData[24], &stats.aheadBytes, 4);
+      respLen = 28;
+
+      if (len >= 1 && payload[0]) {
+        flash.resetReadStats();
+      }
+      return true;
+    }
+
+    // ============================================
+    // 0x2B: QSPI_AUTOTUNE
+    // Request: [Flags:1][ModeMask:1][Addr:4][Len:2] (all optional)
+    //   Flags bit0: re-tune even if the chip's profile is cached
+    //   ModeMask: bit n = QSPIMode n (default: current mode)
+    // Response: [ChipId:3][Cached:1][Tuned:1]
+    //           ([ClockDelay:1][SampleDelay:1][Window:1]) * 6 modes
+    // ============================================
+    case OpupCmd::QSPI_AUTOTUNE: {
+      respLen = 0;
+      bool force = len >= 1 && (payload[0] & 0x01);
+      uint8_t modeMask = 1 << static_cast<uint8_t>(qspi.getMode());
+      uint32_t addr = 0;
+      uint16_t checkLen = TUNE_REGION_DEFAULT;
+      if (len >= 2 && payload[1])
+        modeMask = payload[1] & ((1 << QSPI_MODE_COUNT) - 1);
+      if (len >= 6)
+        memcpy(&addr, &payload[2], 4);
+      if (len >= 8)
+        checkLen = payload[6] | (payload[7] << 8);
+      if (checkLen > TUNE_REGION_MAX)
+        return false;
+
+      bool cached;
+      const ClockProfile *profile =
+          tuner.tuneQSPI(modeMask, addr, checkLen, force, cached);
+      if (!profile)
+        return false; // No chip answered the JEDEC ID
+
+      respData[0] = (profile->chipId >> 16) & 0xFF;
+      respData[1] = (profile->chipId >> 8) & 0xFF;
+      respData[2] = profile->chipId & 0xFF;
+      respData[3] = cached ? 1 : 0;
+      respData[4] = profile->qspiTuned;
+      respLen = 5;
+      for (uint8_t m = 0; m < QSPI_MODE_COUNT; m++) {
+        respData[respLen++] = profile->qspi[m].clockDelay;
+        respData[respLen++] = profile->qspi[m].sampleDelay;
+        respData[respLen++] = profile->window[m];
+      }
+      return true;
+    }
+
+    // ============================================
+    // 0x2C: QSPI_PROBE_MODES
+    // Request: [Addr:4][Len:2] (optional, default 0 / 1024)
+    // Response: [Best:1] ([Ok:1][BytesPerSec:4]) * 6 modes
+    //   Best: selected (now active) mode, 0xFF if none read back
+    // ============================================
+    case OpupCmd::QSPI_PROBE_MODES: {
+      respLen = 0;
+      uint32_t addr = 0;
+      uint16_t probeLen = QSPI_PROBE_DEFAULT;
+      if (len >= 4)
+        memcpy(&addr, &payload[0], 4);
+      if (len >= 6)
+        probeLen = payload[4] | (payload[5] << 8);
+      if (probeLen < 2 || probeLen > QSPI_PROBE_MAX)
+        return false; // jobBuf holds the reference and read-back
+
+      FlashModeProbe results[QSPI_MODE_COUNT];
+      int8_t best = flash.probeModes(addr, probeLen, jobBuf,
+                                     &jobBuf[QSPI_PROBE_MAX], results);
+      if (best == -2)
+        return false; // Blank region, pick one with data
+
+      respData[0] = best < 0 ? 0xFF : best;
+      respLen = 1;
+      for (uint8_t m = 0; m < QSPI_MODE_COUNT; m++) {
+        respData[respLen++] = results[m].ok ? 1 : 0;
+        memcpy(&respData[respLen], &results[m].bytesPerSec, 4);
+        respLen += 4;
+      }
+      return true;
+    }
+
+    // ============================================
+    // 0x60: FLASH_PATCH (Sector read-modify-write)
+    // Request: [Addr:4][Len:2][Data:Len] repeated
+    // Response: [Sectors:2][Erased:2][Pages:2]
+    // ============================================
+    case OpupCmd::FLASH_PATCH: {
+      if (len < 6) {
+        respLen = 0;
+        return false;
+      }
+
+      FlashPatchResult result;
+      if (!flash.patch(payload, len, result)) {
+        respLen = 0;
+        return false;
+      }
+
+      respData[0] = result.sectors & 0xFF;
+      respData[1] = (result.sectors >> 8) & 0xFF;
+      respData[2] = result.erased & 0xFF;
+      respData[3] = (result.erased >> 8) & 0xFF;
+      respData[4] = result.pages & 0xFF;
+      respData[5] = (result.pages >> 8) & 0xFF;
+      respLen = 6;
+      return true;
+    }
+
+    // ============================================
+    // 0x61: FLASH_PROGRAM (Program with blank skipping)
+    // Request: [Flags:1][Addr:4][Data:N]
+    //   Flags bit0: also trim trailing 0xFF bytes within each page
+    // Response: [Pages:2][Skipped:2][Trimmed:2][Quad:1][XferUs:4][BusyUs:4]
+    // ============================================
+    case OpupCmd::FLASH_PROGRAM: {
+      if (len < 6) {
+        respLen = 0;
+        return false;
+      }
+
+      bool trimTail = payload[0] & 0x01;
+      uint32_t addr = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
+                      ((uint32_t)payload[4] << 24);
+
+      FlashProgramResult result;
+      if (!flash.program(addr, &payload[5], len - 5, trimTail, result)) {
+        respLen = 0;
+        return false;
+      }
+
+      respData[0] = result.pages & 0xFF;
+      respData[1] = (result.pages >> 8) & 0xFF;
+      respData[2] = result.skipped & 0xFF;
+      respData[3] = (result.skipped >> 8) & 0xFF;
+      respData[4] = result.trimmed & 0xFF;
+      respData[5] = (result.trimmed >> 8) & 0xFF;
+      respData[6] = result.quad ? 1 : 0;
+      memcpy(&respData[7], &result.xferUs, 4);
+      memcpy(&respData[11], &result.busyUs, 4);
+      respLen = 15;
+      return true;
+    }
+
+    // ============================================
+    // 0x62: FLASH_CONFIG
+    // Request: [QuadWrite:1][AddrMode:1][ReadChain:1][ReadAhead:1]
+    //   (all optional, empty = query only)
+    // Response: [QuadWrite:1][QEState:1][AddrMode:1][ReadChain:1]
+    //           [ReadAhead:1]
+    // ============================================
+    case OpupCmd::FLASH_CONFIG: {
+      if (len >= 1) {
+        flash.setQuadWrites(payload[0] != 0);
+      }
+      if (len >= 2) {
+        if (payload[1] > static_cast<uint8_t>(FlashAddrMode::EN4B)) {
+          respLen = 0;
+          return false; // Invalid address mode
+        }
+        flash.setAddrMode(static_cast<FlashAddrMode>(payload[1]));
+      }
+      if (len >= 3) {
+        flash.setReadChaining(payload[2] != 0);
+      }
+      if (len >= 4) {
+        flash.setReadAhead(payload[3] != 0);
+      }
+
+      respData[0] = flash.getQuadWrites() ? 1 : 0;
+      respData[1] = static_cast<uint8_t>(flash.getQEState());
+      respData[2] = static_cast<uint8_t>(flash.getAddrMode());
+      respData[3] = flash.getReadChaining() ? 1 : 0;
+      respData[4] = flash.getReadAhead() ? 1 : 0;
+      respLen = 5;
+      return true;
+    }
+
+    // ============================================
+    // 0x63: FLASH_ERASE
+    // Request: [Type:1][Addr:4]
+    //   Type: 0=4KB sector, 1=32KB block, 2=64KB block, 3=chip
+    // Response: Empty on success
+    //   With FLAGS.ASYNC: [JobId:1][ExpectedMs:4], then an ASYNC event
+    //   [JobId:1][Status:1][ElapsedMs:4] when BUSY clears (see startJob)
+    // ============================================
+    case OpupCmd::FLASH_ERASE: {
+      FlashEraseType type;
+      uint32_t addr;
+      respLen = 0;
+      if (!parseErase(payload, len, type, addr))
+        return false;
+      return flash.erase(type, addr);
+    }
+
+    // ============================================
+    // 0x64: FLASH_GANG_CONFIG
+    // Request: [Select:1][Count:1][Pin:1]*Count (optional, [Select] alone
+    //   only changes the selection)
+    //   Select: chip used by all non-gang commands (one bit at most)
+    // Response: [Select:1][Count:1][Pin:1]*Count
+    // ============================================
+    case OpupCmd::FLASH_GANG_CONFIG: {
+      if (len >= 1 && (payload[0] & (payload[0] - 1))) {
+        respLen = 0;
+        return false; // Reads and status polls would see every chip on IO1
+      }
+      if (len >= 2) {
+        uint8_t count = payload[1];
+        if (len < 2 + count || !qspi.setChipSelects(&payload[2], count)) {
+          respLen = 0;
+          return false; // Reserved/duplicate pin or too many chips
+        }
+      }
+      if (len >= 1) {
+        qspi.selectChips(payload[0]);
+        flash.invalidate(); // Cached chip state belongs to the old selection
+      }
+
+      uint8_t count = qspi.getChipSelectCount();
+      respData[0] = qspi.getSelectedChips();
+      respData[1] = count;
+      for (uint8_t i = 0; i < count; i++) {
+        respData[2 + i] = qspi.getChipSelectPin(i);
+      }
+      respLen = 2 + count;
+      return true;
+    }
+
+    // ============================================
+    // 0x65: FLASH_GANG_ERASE
+    // Request: [Mask:1][Type:1][Addr:4]
+    // Response: [Done:1][Count:1][Status:1]*Count
+    //   Done: mask of chips that completed, Status: FlashGangStatus
+    // ============================================
+    case OpupCmd::FLASH_GANG_ERASE: {
+      if (len < 2 || (payload[1] != 3 && len < 6) ||
+          payload[1] > static_cast<uint8_t>(FlashEraseType::CHIP)) {
+        respLen = 0;
+        return false;
+      }
+
+      uint32_t addr = 0;
+      if (len >= 6) {
+        addr = payload[2] | (payload[3] << 8) | (payload[4] << 16) |
+               ((uint32_t)payload[5] << 24);
+      }
+
+      FlashGangResult result;
+      respData[0] = flash.gangErase(static_cast<FlashEraseType>(payload[1]),
+                                    addr, payload[0], result);
+      respData[1] = result.chips;
+      memcpy(&respData[2], result.status, result.chips);
+      respLen = 2 + result.chips;
+      return true;
+    }
+
+    // ============================================
+    // 0x66: FLASH_GANG_PROGRAM
+    // Request: [Mask:1][Addr:4][Data:N]
+    // Response: [Done:1][Pages:2][Skipped:2][Count:1][Status:1]*Count
+    // ============================================
+    case OpupCmd::FLASH_GANG_PROGRAM: {
+      if (len < 6) {
+        respLen = 0;
+        return false;
+      }
+
+      uint32_t addr = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
+                      ((uint32_t)payload[4] << 24);
+
+      FlashGangResult result;
+      respData[0] =
+          flash.gangProgram(addr, &payload[5], len - 5, payload[0], result);
+      respData[1] = result.pages & 0xFF;
+      respData[2] = (result.pages >> 8) & 0xFF;
+      respData[3] = result.skipped & 0xFF;
+      respData[4] = (result.skipped >> 8) & 0xFF;
+      respData[5] = result.chips;
+      memcpy(&respData[6], result.status, result.chips);
+      respLen = 6 + result.chips;
+      return true;
+    }
+
+    // ============================================
+    // 0x67: FLASH_GANG_VERIFY
+    // Request: [Mask:1][Addr:4][Data:N]
+    // Response: [Done:1][Count:1]([Status:1][Mismatch:4])*Count
+    // ============================================
+    case OpupCmd::FLASH_GANG_VERIFY: {
+      if (len < 6) {
+        respLen = 0;
+        return false;
+      }
+
+      uint32_t addr = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
+                      ((uint32_t)payload[4] << 24);
+
+      FlashGangResult result;
+      respData[0] =
+          flash.gangVerify(addr, &payload[5], len - 5, payload[0], result);
+      respData[1] = result.chips;
+      respLen = 2;
+      for (uint8_t i = 0; i < result.chips; i++) {
+        respData[respLen] = result.status[i];
+        memcpy(&respData[respLen + 1], &result.mismatch[i], 4);
+        respLen += 5;
+      }
+      return true;
+    }
+
     default:
       return false;
     }
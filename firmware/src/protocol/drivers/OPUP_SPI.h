@@ -1,22 +1,31 @@
 #pragma once
+#include "../../clock_tuner.h"
 #include "../../spi_driver.h"
 #include "../OPUP.h"
 #include "../OPUPDriver.h"
 
-// SPI CS Pin
-#define SPI_CS_PIN 17
+// SPI_XFER_EX flags
+#define SPI_XFER_TX_ONLY 0x01 // Discard RX, empty response
+#define SPI_XFER_RX_FILL 0x02 // [Len:2][Fill:1] instead of TX data
+#define SPI_XFER_CS_KEEP 0x04 // Leave CS asserted for the next frame
+#define SPI_XFER_CS_RELEASE 0x08 // End a held transaction before this frame
 
 class OPUP_SPI : public OPUPDriver {
 private:
   SPIDriver &spi;
+  ClockTuner &tuner;
 
 public:
-  OPUP_SPI(SPIDriver &driver) : spi(driver) {}
+  OPUP_SPI(SPIDriver &driver, ClockTuner &clockTuner)
+      : spi(driver), tuner(clockTuner) {}
 
   void begin() override {
     // SPI initialized in main
   }
 
+  // Another driver is about to use the pins: end the held transaction
+  void release() override { spi.release(); }
+
   bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                      uint8_t *respData, uint16_t &respLen) override {
     switch (cmd) {
@@ -51,20 +60,103 @@ public:
       return true;
     }
     case OpupCmd::SPI_XFER: {
-      // Copy payload to response buffer
-      memcpy(respData, payload, len);
-      // Use hardware SPI with correct CS pin
-      spi.transfer(SPI_CS_PIN, respData, len);
+      // Always a complete CS cycle, never part of a held transaction
+      spi.releaseCs();
+      spi.takeCsExpired();
+      // DMA straight from the request into the response buffer
+      spi.transfer(SPI_CS_PIN, payload, respData, len);
       respLen = len;
       return true;
     }
+    // ============================================
+    // 0x23: SPI_XFER_EX (Transfer with direction and CS flags)
+    // Request: [Flags:1][Data:N], or [Flags:1][Len:2][Fill:1] with RX_FILL
+    //   CS_KEEP: CS stays asserted, the next frame continues the transaction
+    //   CS_RELEASE: deassert a held CS first ([Flags] alone only releases)
+    // Response: [Data:N] (empty with TX_ONLY)
+    //   Fails if the CS watchdog ended the held transaction, unless
+    //   CS_RELEASE is set
+    // ============================================
+    case OpupCmd::SPI_XFER_EX: {
+      respLen = 0;
+      if (len < 1)
+        return false;
+
+      uint8_t flags = payload[0];
+      bool keepCs = flags & SPI_XFER_CS_KEEP;
+      if (flags & SPI_XFER_CS_RELEASE) {
+        spi.releaseCs();
+        spi.takeCsExpired();
+        if (len == 1 && !(flags & SPI_XFER_RX_FILL))
+          return true;
+      } else if (spi.takeCsExpired()) {
+        return false; // Continuation of a transaction that timed out
+      }
+
+      if (flags & SPI_XFER_RX_FILL) {
+        if (len < 4 || (flags & SPI_XFER_TX_ONLY))
+          return false;
+        uint16_t rxLen = payload[1] | (payload[2] << 8);
+        if (rxLen > OPUP_MAX_PAYLOAD)
+          return false;
+        spi.read(SPI_CS_PIN, respData, rxLen, payload[3], keepCs);
+        respLen = rxLen;
+      } else if (flags & SPI_XFER_TX_ONLY) {
+        spi.write(SPI_CS_PIN, &payload[1], len - 1, keepCs);
+      } else {
+        spi.transfer(SPI_CS_PIN, &payload[1], respData, len - 1, keepCs);
+        respLen = len - 1;
+      }
+      return true;
+    }
+    // ============================================
+    // 0x24: SPI_AUTOTUNE
+    // Request: [Flags:1][Addr:4][Len:2] (all optional)
+    //   Flags bit0: re-tune even if the chip's profile is cached
+    // Response: [ChipId:3][Cached:1][Hz:4]
+    // ============================================
+    case OpupCmd::SPI_AUTOTUNE: {
+      respLen = 0;
+      bool force = len >= 1 && (payload[0] & 0x01);
+      uint32_t addr = 0;
+      uint16_t checkLen = TUNE_REGION_DEFAULT;
+      if (len >= 5)
+        memcpy(&addr, &payload[1], 4);
+      if (len >= 7)
+        checkLen = payload[5] | (payload[6] << 8);
+      if (checkLen > TUNE_REGION_MAX)
+        return false;
+
+      bool cached;
+      const ClockProfile *profile =
+          tuner.tuneSPI(addr, checkLen, force, cached);
+      if (!profile)
+        return false; // No chip, or unstable at the slowest rate
+
+      respData[0] = (profile->chipId >> 16) & 0xFF;
+      respData[1] = (profile->chipId >> 8) & 0xFF;
+      respData[2] = profile->chipId & 0xFF;
+      respData[3] = cached ? 1 : 0;
+      memcpy(&respData[4], &profile->spiHz, 4);
+      respLen = 8;
+      return true;
+    }
     case OpupCmd::SPI_CONFIG: {
       // Configure SPI speed and mode
+      // Request: [Mode:1][Speed:4][SetupNs:2][HoldNs:2][CsTimeoutMs:2]
+      //   (CS timing and watchdog optional, CsTimeoutMs 0 = off)
       if (len >= 5) {
         uint8_t mode = payload[0];
         uint32_t freq = payload[1] | (payload[2] << 8) | (payload[3] << 16) |
                         (payload[4] << 24);
         spi.configure(freq, mode);
+        if (len >= 9) {
+          spi.setCsTiming(payload[5] | (payload[6] << 8),
+                          payload[7] | (payload[8] << 8));
+        }
+        if (len >= 11) {
+          spi.setCsTimeout(payload[9] | (payload[10] << 8));
+        }
         respData[0] = 1; // Success
         respLen = 1;
       } else {
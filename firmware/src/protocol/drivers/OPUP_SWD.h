@@ -1,35 +1,162 @@
 #pragma once
+#include "../../stm32_loader.h"
 #include "../../swd_driver.h"
 #include "../OPUP.h"
 #include "../OPUPDriver.h"
 
+// STM32_FLASH_BEGIN flags
+#define STM32_FLASH_MASS_ERASE 0x01
+
 class OPUP_SWD : public OPUPDriver {
 private:
   SWDDriver &swd;
+  STM32Loader &loader;
 
 public:
-  OPUP_SWD(SWDDriver &driver) : swd(driver) {}
+  OPUP_SWD(SWDDriver &driver, STM32Loader &stm32)
+      : swd(driver), loader(stm32) {}
 
   void begin() override {
-    // SWD initialized in main
+    // SWD initialized on demand by SWD_INIT
   }
 
   bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                      uint8_t *respData, uint16_t &respLen) override {
+    respLen = 0;
     switch (cmd) {
+
+    // ============================================
+    // 0x40: SWD_INIT
+    // Request: [ClockHz:4] (optional, default SWD_CLOCK_DEFAULT)
+    // Response: [IDCODE:4]
+    // ============================================
     case OpupCmd::SWD_INIT: {
-      swd.begin();
-      respLen = 0;
+      if (len >= 4) {
+        uint32_t hz;
+        memcpy(&hz, payload, 4);
+        if (!swd.setClock(hz))
+          return false;
+      }
+      uint32_t idcode = swd.init();
+      if (idcode == 0)
+        return false; // No target
+      memcpy(respData, &idcode, 4);
+      respLen = 4;
       return true;
     }
+
+    // ============================================
+    // 0x41: SWD_READ
+    // Request: [APnDP:1][Addr:4]
+    //   Addr: DP register (0x0 - 0xC), or AP register with the bank in
+    //         bits 7:4 and APSEL in bits 31:24
+    // Response: [Data:4]
+    // ============================================
     case OpupCmd::SWD_READ: {
-      // TODO: Implement full SWD read
-      return false;
+      if (len < 5)
+        return false;
+      uint32_t addr, data;
+      memcpy(&addr, &payload[1], 4);
+      bool ok = payload[0] ? swd.readAP(addr >> 24, addr & 0xFF, &data)
+                           : swd.readDP(addr & 0x0C, &data);
+      if (!ok)
+        return false;
+      memcpy(respData, &data, 4);
+      respLen = 4;
+      return true;
     }
+
+    // ============================================
+    // 0x42: SWD_WRITE
+    // Request: [APnDP:1][Addr:4][Data:4] (Addr as SWD_READ)
+    // ============================================
     case OpupCmd::SWD_WRITE: {
-      // TODO: Implement full SWD write
-      return false;
+      if (len < 9)
+        return false;
+      uint32_t addr, data;
+      memcpy(&addr, &payload[1], 4);
+      memcpy(&data, &payload[5], 4);
+      return payload[0] ? swd.writeAP(addr >> 24, addr & 0xFF, data)
+                        : swd.writeDP(addr & 0x0C, data);
     }
+
+    // ============================================
+    // 0x43: SWD_MEM_READ
+    // Request: [Addr:4][Len:2][Size:1] (Size optional: 1, 2 or 4, default 4)
+    // Response: [Data...] (Len bytes)
+    // ============================================
+    case OpupCmd::SWD_MEM_READ: {
+      if (len < 6)
+        return false;
+      uint32_t addr;
+      uint16_t count;
+      memcpy(&addr, payload, 4);
+      memcpy(&count, &payload[4], 2);
+      uint8_t size = len >= 7 ? payload[6] : 4;
+      if (count > OPUP_MAX_PAYLOAD)
+        return false;
+      if (!swd.memRead(addr, respData, count, size))
+        return false;
+      respLen = count;
+      return true;
+    }
+
+    // ============================================
+    // 0x44: SWD_MEM_WRITE
+    // Request: [Addr:4][Size:1][Data...]
+    // ============================================
+    case OpupCmd::SWD_MEM_WRITE: {
+      if (len < 5)
+        return false;
+      uint32_t addr;
+      memcpy(&addr, payload, 4);
+      return swd.memWrite(addr, &payload[5], len - 5, payload[4]);
+    }
+
+    // ============================================
+    // 0x45: STM32_FLASH_BEGIN
+    // Request: [Flags:1] (optional, STM32_FLASH_MASS_ERASE)
+    // Response: [Status:1][DevId:2][FlashKB:2]
+    //   Status: see Stm32LoaderStatus
+    // ============================================
+    case OpupCmd::STM32_FLASH_BEGIN: {
+      bool erase = len >= 1 && (payload[0] & STM32_FLASH_MASS_ERASE);
+      Stm32LoaderStatus status = loader.begin(erase);
+      uint16_t devId = loader.getDeviceId();
+      uint16_t kb = loader.getFlashSize() / 1024;
+      respData[0] = static_cast<uint8_t>(status);
+      memcpy(&respData[1], &devId, 2);
+      memcpy(&respData[3], &kb, 2);
+      respLen = 5;
+      return true;
+    }
+
+    // ============================================
+    // 0x46: STM32_FLASH_WRITE
+    // Request: [Addr:4][Data...] (word aligned, length multiple of 4)
+    // Acknowledged once the data is in a target buffer
+    // ============================================
+    case OpupCmd::STM32_FLASH_WRITE: {
+      if (len < 8)
+        return false;
+      uint32_t addr;
+      memcpy(&addr, payload, 4);
+      return loader.write(addr, &payload[4], len - 4);
+    }
+
+    // ============================================
+    // 0x47: STM32_FLASH_END
+    // Response: [Sr:4] (flash SR error bits, 0 = success)
+    // ============================================
+    case OpupCmd::STM32_FLASH_END: {
+      uint32_t sr;
+      if (!loader.end(sr))
+        return false;
+      memcpy(respData, &sr, 4);
+      respLen = 4;
+      return true;
+    }
+
     default:
       return false;
     }
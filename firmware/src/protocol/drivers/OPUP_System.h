@@ -4,11 +4,19 @@
 #include <Arduino.h>
 
 class OPUP_System : public OPUPDriver {
+private:
+  OPUPScheduler &scheduler;
+
 public:
+  OPUP_System(OPUPScheduler &jobScheduler) : scheduler(jobScheduler) {}
+
   void begin() override {
     // Nothing to init for system commands
   }
 
+  // GPIO_TEST only reads the pins
+  bool sharesPins() const override { return false; }
+
   bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
                      uint8_t *respData, uint16_t &respLen) override {
     switch (cmd) {
@@ -26,7 +34,7 @@ public:
       return true;
     }
     case OpupCmd::SYS_GET_STATUS: {
-      respData[0] = 0; // Idle
+      respData[0] = scheduler.busy() ? 1 : 0; // Busy while a job runs
       uint32_t uptime = millis();
       memcpy(&respData[1], &uptime, 4);
       respLen = 5;
@@ -47,6 +55,44 @@ public:
       respLen = 6;
       return true;
     }
+    // ============================================
+    // 0x06: JOB_STATUS
+    // Request: Empty
+    // Response: [Count:1] then per job
+    //   [JobId:1][Cmd:1][Priority:1][ElapsedMs:4][Progress:4][Total:4]
+    // ============================================
+    case OpupCmd::JOB_STATUS: {
+      uint8_t count = 0;
+      respLen = 1;
+      for (uint8_t i = 0; i < OPUP_MAX_JOBS; i++) {
+        const OPUPJob &job = scheduler.slot(i);
+        if (job.id == 0 || job.aborted)
+          continue;
+        uint32_t elapsed = millis() - job.startMs;
+        respData[respLen++] = job.id;
+        respData[respLen++] = job.cmd;
+        respData[respLen++] = static_cast<uint8_t>(job.priority);
+        memcpy(&respData[respLen], &elapsed, 4);
+        memcpy(&respData[respLen + 4], &job.progress, 4);
+        memcpy(&respData[respLen + 8], &job.total, 4);
+        respLen += 12;
+        count++;
+      }
+      respData[0] = count;
+      return true;
+    }
+
+    // ============================================
+    // 0x07: JOB_ABORT
+    // Request: [JobId:1] (0 or empty = all jobs)
+    // Response: [Aborted:1]
+    // ============================================
+    case OpupCmd::JOB_ABORT: {
+      respData[0] = scheduler.abort(len >= 1 ? payload[0] : 0);
+      respLen = 1;
+      return true;
+    }
+
     case OpupCmd::BOOTLOADER: {
       // Send ACK before rebooting
       respLen = 0;
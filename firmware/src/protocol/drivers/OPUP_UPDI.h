@@ -0,0 +1,145 @@
+#pragma once
+#include "../../updi_driver.h"
+#include "../OPUP.h"
+#include "../OPUPDriver.h"
+
+// UPDI_PROGRAM flags
+#define UPDI_PROGRAM_SKIP_BLANK 0x01 // Skip all-0xFF pages (chip erased)
+#define UPDI_PROGRAM_EEPROM 0x02     // EEPROM erase-write instead of flash
+#define UPDI_PROGRAM_ERASE 0x04      // Erase each flash page before writing
+
+/**
+ * @brief OPUP UPDI Driver
+ * Serves the UPDI engine (0x38 - 0x3F) on UART1
+ */
+class OPUP_UPDI : public OPUPDriver {
+private:
+  UPDIDriver &updi;
+
+  static bool isBlank(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+      if (data[i] != 0xFF)
+        return false;
+    }
+    return true;
+  }
+
+public:
+  OPUP_UPDI(UPDIDriver &driver) : updi(driver) {}
+
+  void begin() override {
+    // UPDI initialized in main, the link is opened by UPDI_ENTER
+  }
+
+  bool handleCommand(uint8_t cmd, uint8_t *payload, uint16_t len,
+                     uint8_t *respData, uint16_t &respLen) override {
+    respLen = 0;
+    switch (cmd) {
+
+    // ============================================
+    // 0x38: UPDI_ENTER
+    // Request: [Baud:4] (optional, default UPDI_BAUD_DEFAULT)
+    // Response: [Status:1][Nvm:1][Sib:16]
+    //   Status: see UpdiEnterStatus (2 = locked: UPDI_CHIP_ERASE)
+    //   Nvm: 0 = unknown (read only), 1 = tinyAVR / megaAVR 0, 2 = AVR Dx
+    // ============================================
+    case OpupCmd::UPDI_ENTER: {
+      uint32_t baud = UPDI_BAUD_DEFAULT;
+      if (len >= 4)
+        memcpy(&baud, payload, 4);
+      if (baud < UPDI_BAUD_MIN || baud > UPDI_BAUD_MAX)
+        return false;
+
+      UpdiEnterStatus status = updi.enterProgrammingMode(baud);
+      respData[0] = static_cast<uint8_t>(status);
+      respData[1] = static_cast<uint8_t>(updi.getNvm());
+      memcpy(&respData[2], updi.getSib(), 16);
+      respLen = 18;
+      return true;
+    }
+
+    case OpupCmd::UPDI_EXIT: {
+      updi.endProgrammingMode();
+      return true;
+    }
+
+    // ============================================
+    // 0x3A: UPDI_READ
+    // Request: [Addr:4][Len:2] (data-space address, Len up to
+    //          OPUP_MAX_PAYLOAD)
+    // Response: [Data:Len]
+    // ============================================
+    case OpupCmd::UPDI_READ: {
+      if (len < 6)
+        return false;
+      uint32_t addr;
+      uint16_t n;
+      memcpy(&addr, &payload[0], 4);
+      memcpy(&n, &payload[4], 2);
+      if (n > OPUP_MAX_PAYLOAD || !updi.read(addr, respData, n))
+        return false;
+      respLen = n;
+      return true;
+    }
+
+    // ============================================
+    // 0x3B: UPDI_PROGRAM
+    // Request: [Flags:1][PageSize:2][Addr:4][Data:N]
+    //   Addr: data-space address (page aligned), Data: one or more pages
+    // Response: [Status:1][Pages:2][Skipped:2][BusyMaxUs:2]
+    //   Status: 0 = OK, 1 = NVM error or timeout at page Pages + Skipped
+    // ============================================
+    case OpupCmd::UPDI_PROGRAM: {
+      if (len < 7 || !updi.isActive())
+        return false;
+      uint8_t flags = payload[0];
+      uint16_t pageSize = payload[1] | (payload[2] << 8);
+      uint32_t addr;
+      memcpy(&addr, &payload[3], 4);
+      uint16_t dataLen = len - 7;
+      bool eeprom = flags & UPDI_PROGRAM_EEPROM;
+      if (pageSize == 0 || pageSize > UPDI_PAGE_MAX || (addr % pageSize) ||
+          (!eeprom && (pageSize & 1)))
+        return false;
+
+      const uint8_t *data = &payload[7];
+      uint16_t pages = 0, skipped = 0, busyMax = 0;
+      uint8_t status = 0;
+      for (uint16_t off = 0; off < dataLen; off += pageSize) {
+        uint16_t n = dataLen - off < pageSize ? dataLen - off : pageSize;
+        if ((flags & UPDI_PROGRAM_SKIP_BLANK) && isBlank(&data[off], n)) {
+          skipped++;
+          continue;
+        }
+        uint32_t busyUs;
+        if (!updi.writePage(addr + off, &data[off], n, eeprom,
+                            flags & UPDI_PROGRAM_ERASE, busyUs)) {
+          status = 1;
+          break;
+        }
+        if (busyUs > busyMax)
+          busyMax = busyUs > 0xFFFF ? 0xFFFF : busyUs;
+        pages++;
+      }
+
+      respData[0] = status;
+      memcpy(&respData[1], &pages, 2);
+      memcpy(&respData[3], &skipped, 2);
+      memcpy(&respData[5], &busyMax, 2);
+      respLen = 7;
+      return true;
+    }
+
+    // ============================================
+    // 0x3C: UPDI_CHIP_ERASE
+    // Erases flash, EEPROM and lock bits, then enters NVM programming
+    // (after UPDI_ENTER, also when it reported a locked part)
+    // ============================================
+    case OpupCmd::UPDI_CHIP_ERASE:
+      return updi.chipErase();
+
+    default:
+      return false;
+    }
+  }
+};
@@ -9,20 +9,27 @@
 #include <hardware/gpio.h>
 #include <hardware/sync.h>
 
-// Inline delay for clock timing (can be adjusted for speed)
-#define QSPI_CLOCK_DELAY() delayMicroseconds(0)
+static inline void delayCycles(uint32_t cycles) {
+  if (cycles)
+    busy_wait_at_least_cycles(cycles);
+}
+
+// Per-mode delays chosen by clock autotuning (see setTiming)
+#define QSPI_CLOCK_DELAY() delayCycles(_clockDelay)
+#define QSPI_SAMPLE_DELAY() delayCycles(_sampleDelay)
 
 QSPIDriver::QSPIDriver()
-    : _mode(QSPIMode::STANDARD), csPin(Board::PIN_SPI_CS),
-      clkPin(Board::PIN_SPI_SCK), mosiPin(Board::PIN_SPI_MOSI),
-      misoPin(Board::PIN_SPI_MISO) {}
+    : _mode(QSPIMode::STANDARD), clkPin(Board::PIN_SPI_SCK),
+      mosiPin(Board::PIN_SPI_MOSI), misoPin(Board::PIN_SPI_MISO) {
+  _csPins[0] = Board::PIN_SPI_CS;
+}
 
 void QSPIDriver::begin() {
   LOG_INFO(TAG, "Initializing QSPI Driver");
 
   // Initialize standard SPI pins
-  pinMode(csPin, OUTPUT);
-  digitalWrite(csPin, HIGH);
+  pinMode(_csPins[0], OUTPUT);
+  digitalWrite(_csPins[0], HIGH);
 
   pinMode(clkPin, OUTPUT);
   digitalWrite(clkPin, LOW);
@@ -38,7 +45,12 @@ void QSPIDriver::begin() {
 }
 
 void QSPIDriver::setMode(QSPIMode mode) {
+  // Pin roles change with the mode, so finish any pending read first
+  if (mode != _mode)
+    endStream();
   _mode = mode;
+  _clockDelay = _timing[static_cast<uint8_t>(mode)].clockDelay;
+  _sampleDelay = _timing[static_cast<uint8_t>(mode)].sampleDelay;
 
   if (mode == QSPIMode::STANDARD || mode == QSPIMode::DUAL_OUT ||
       mode == QSPIMode::DUAL_IO) {
@@ -50,6 +62,14 @@ void QSPIDriver::setMode(QSPIMode mode) {
   }
 }
 
+void QSPIDriver::setTiming(QSPIMode mode, QSPITiming timing) {
+  _timing[static_cast<uint8_t>(mode)] = timing;
+  if (mode == _mode) {
+    _clockDelay = timing.clockDelay;
+    _sampleDelay = timing.sampleDelay;
+  }
+}
+
 void QSPIDriver::setStandardMode() {
   // IO0 = output (MOSI), IO1 = input (MISO)
   pinMode(QSPI_PIN_IO0, OUTPUT);
@@ -94,9 +114,86 @@ void QSPIDriver::setIO01Input() {
   pinMode(QSPI_PIN_IO1, INPUT);
 }
 
-void QSPIDriver::csLow() { digitalWrite(QSPI_PIN_CS, LOW); }
+void QSPIDriver::csLow(bool continuous) {
+  if (continuous) {
+    // Keep continuous-read mode, but a held stream is at the wrong address
+    if (_streamHeld) {
+      gpio_set_mask(_csGpioMask);
+      _streamHeld = false;
+    }
+  } else {
+    endStream();
+  }
+  // All selected chips are asserted in the same cycle
+  gpio_clr_mask(_csGpioMask);
+}
+
+void QSPIDriver::csHigh() {
+  gpio_set_mask(_csGpioMask);
+  _streamHeld = false;
+}
+
+// ============== CHIP SELECT SET (GANG MODE) ==============
+
+bool QSPIDriver::isValidChipSelect(uint8_t pin) {
+  // Bus, ISP, UPDI, SWD, I2C, LED and IO2/IO3 pins are taken; USB serial leaves
+  // GP0/GP1 free. GP24 is the user button on the YD-RP2040.
+  if (pin == Board::PIN_SPI_CS)
+    return true;
+  if (pin > 28 || pin == 24 || pin == Board::PIN_SPI_MISO ||
+      pin == Board::PIN_SPI_SCK || pin == Board::PIN_SPI_MOSI ||
+      pin == Board::PIN_QSPI_IO2 || pin == Board::PIN_QSPI_IO3 ||
+      pin == Board::PIN_AVR_RESET ||
+      pin == Board::PIN_UPDI_TX || pin == Board::PIN_UPDI_RX ||
+      pin == Board::PIN_SWD_CLK || pin == Board::PIN_SWD_DIO ||
+      pin == Board::PIN_I2C_SDA || pin == Board::PIN_I2C_SCL ||
+      pin == Board::PIN_LED_WS2812 || pin == Board::PIN_LED_ACTIVITY)
+    return false;
+  return true;
+}
+
+bool QSPIDriver::setChipSelects(const uint8_t *pins, uint8_t count) {
+  if (count == 0) {
+    // Back to the single on-board chip select
+    static const uint8_t defaultCs = Board::PIN_SPI_CS;
+    return setChipSelects(&defaultCs, 1);
+  }
+  if (count > QSPI_MAX_CS)
+    return false;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (!isValidChipSelect(pins[i]))
+      return false;
+    for (uint8_t j = 0; j < i; j++) {
+      if (pins[j] == pins[i])
+        return false; // Duplicate
+    }
+  }
+
+  endStream();
+  for (uint8_t i = 0; i < count; i++) {
+    _csPins[i] = pins[i];
+    pinMode(pins[i], OUTPUT);
+    digitalWrite(pins[i], HIGH);
+  }
+  _csCount = count;
+  selectChips(0x01);
+  return true;
+}
+
+void QSPIDriver::selectChips(uint8_t mask) {
+  // Continuous-read state belongs to the chips selected so far
+  endStream();
 
-void QSPIDriver::csHigh() { digitalWrite(QSPI_PIN_CS, HIGH); }
+  mask &= (uint8_t)((1u << _csCount) - 1);
+  uint32_t gpioMask = 0;
+  for (uint8_t i = 0; i < _csCount; i++) {
+    if (mask & (1u << i))
+      gpioMask |= (1ul << _csPins[i]);
+  }
+  _csSelected = mask;
+  _csGpioMask = gpioMask;
+}
 
 void QSPIDriver::clockPulse() {
   QSPI_CLOCK_DELAY();
@@ -116,6 +213,7 @@ uint8_t QSPIDriver::readBitStandard() {
   uint8_t bit;
   QSPI_CLOCK_DELAY();
   digitalWrite(QSPI_PIN_CLK, HIGH);
+  QSPI_SAMPLE_DELAY();
   bit = digitalRead(QSPI_PIN_IO1);
   QSPI_CLOCK_DELAY();
   digitalWrite(QSPI_PIN_CLK, LOW);
@@ -150,6 +248,7 @@ uint8_t QSPIDriver::readBitsDual() {
   uint8_t bits;
   QSPI_CLOCK_DELAY();
   digitalWrite(QSPI_PIN_CLK, HIGH);
+  QSPI_SAMPLE_DELAY();
   bits = (digitalRead(QSPI_PIN_IO0) ? 0x01 : 0) |
          (digitalRead(QSPI_PIN_IO1) ? 0x02 : 0);
   QSPI_CLOCK_DELAY();
@@ -191,6 +290,7 @@ uint8_t QSPIDriver::readNibbleQuad() {
   uint8_t nibble;
   QSPI_CLOCK_DELAY();
   digitalWrite(QSPI_PIN_CLK, HIGH);
+  QSPI_SAMPLE_DELAY();
   nibble = (digitalRead(QSPI_PIN_IO0) ? 0x01 : 0) |
            (digitalRead(QSPI_PIN_IO1) ? 0x02 : 0) |
            (digitalRead(QSPI_PIN_IO2) ? 0x04 : 0) |
@@ -235,7 +335,8 @@ void QSPIDriver::sendAddress(uint32_t addr, uint8_t len) {
     // Address on single wire
     if (len >= 4)
       writeByteStandard((addr >> 24) & 0xFF);
-    writeByteStandard((addr >> 16) & 0xFF);
+    if (len >= 3)
+      writeByteStandard((addr >> 16) & 0xFF);
     writeByteStandard((addr >> 8) & 0xFF);
     writeByteStandard(addr & 0xFF);
     break;
@@ -244,7 +345,8 @@ void QSPIDriver::sendAddress(uint32_t addr, uint8_t len) {
     // Address on 2 wires
     if (len >= 4)
       writeByteDual((addr >> 24) & 0xFF);
-    writeByteDual((addr >> 16) & 0xFF);
+    if (len >= 3)
+      writeByteDual((addr >> 16) & 0xFF);
     writeByteDual((addr >> 8) & 0xFF);
     writeByteDual(addr & 0xFF);
     break;
@@ -254,13 +356,29 @@ void QSPIDriver::sendAddress(uint32_t addr, uint8_t len) {
     // Address on 4 wires
     if (len >= 4)
       writeByteQuad((addr >> 24) & 0xFF);
-    writeByteQuad((addr >> 16) & 0xFF);
+    if (len >= 3)
+      writeByteQuad((addr >> 16) & 0xFF);
     writeByteQuad((addr >> 8) & 0xFF);
     writeByteQuad(addr & 0xFF);
     break;
   }
 }
 
+uint8_t QSPIDriver::sendModeBits(uint8_t bits) {
+  switch (_mode) {
+  case QSPIMode::DUAL_IO:
+    writeByteDual(bits);
+    return 4;
+  case QSPIMode::QUAD_IO:
+  case QSPIMode::QPI:
+    writeByteQuad(bits);
+    return 2;
+  default:
+    writeByteStandard(bits);
+    return 8;
+  }
+}
+
 void QSPIDriver::sendDummyCycles(uint8_t cycles) {
   setIOsInput(); // Tri-state during dummy cycles
   for (uint8_t i = 0; i < cycles; i++) {
@@ -332,6 +450,7 @@ void QSPIDriver::transfer(const uint8_t *txData, uint8_t *rxData,
       digitalWrite(QSPI_PIN_IO0, (txByte >> b) & 1);
       QSPI_CLOCK_DELAY();
       digitalWrite(QSPI_PIN_CLK, HIGH);
+      QSPI_SAMPLE_DELAY();
       rxByte |= (digitalRead(QSPI_PIN_IO1) << b);
       QSPI_CLOCK_DELAY();
       digitalWrite(QSPI_PIN_CLK, LOW);
@@ -343,18 +462,67 @@ void QSPIDriver::transfer(const uint8_t *txData, uint8_t *rxData,
   }
 }
 
-void QSPIDriver::enterQPI() {
-  // Standard command to enter QPI mode (0x38)
-  // Must be sent in standard SPI mode
-  QSPIMode prevMode = _mode;
+// ============== READ CHAINING ==============
+
+void QSPIDriver::holdRead(uint32_t nextAddr) {
+  _streamHeld = true;
+  _streamAddr = nextAddr;
+  _streamTime = millis();
+}
+
+void QSPIDriver::endStream() {
+  if (_streamHeld) {
+    gpio_set_mask(_csGpioMask);
+    _streamHeld = false;
+  }
+
+  if (_continuousRead) {
+    _continuousRead = false;
+
+    // Continuous Read Mode Reset: FFFFh on all IOs covers Dual/Quad I/O
+    // with 3- or 4-byte addresses
+    setIOsOutput();
+    digitalWrite(QSPI_PIN_IO0, HIGH);
+    digitalWrite(QSPI_PIN_IO1, HIGH);
+    digitalWrite(QSPI_PIN_IO2, HIGH);
+    digitalWrite(QSPI_PIN_IO3, HIGH);
+    gpio_clr_mask(_csGpioMask);
+    for (uint8_t i = 0; i < 16; i++) {
+      clockPulse();
+    }
+    gpio_set_mask(_csGpioMask);
+
+    // Restore pin roles of the current mode
+    if (_mode == QSPIMode::STANDARD || _mode == QSPIMode::DUAL_OUT ||
+        _mode == QSPIMode::DUAL_IO) {
+      setStandardMode();
+    } else {
+      setQuadMode();
+    }
+  }
+}
+
+void QSPIDriver::update() {
+  // Chip stays in continuous-read mode, only CS is released
+  if (_streamHeld && millis() - _streamTime > QSPI_STREAM_IDLE_MS) {
+    gpio_set_mask(_csGpioMask);
+    _streamHeld = false;
+  }
+}
+
+void QSPIDriver::enterQPI(uint8_t opcode, uint8_t exitOpcode) {
+  // Enter command must be sent in standard SPI mode
   setMode(QSPIMode::STANDARD);
 
   csLow();
-  sendCommand(0x38); // Enter QPI command
+  sendCommand(opcode);
   csHigh();
 
   // Now switch driver to QPI mode
   setMode(QSPIMode::QPI);
+  _qpiActive = true;
+  _qpiEnterOpcode = opcode;
+  _qpiExitOpcode = exitOpcode;
 }
 
 void QSPIDriver::exitQPI() {
@@ -362,9 +530,10 @@ void QSPIDriver::exitQPI() {
   setMode(QSPIMode::QPI);
 
   csLow();
-  sendCommand(0xFF); // Exit QPI command
+  sendCommand(_qpiExitOpcode);
   csHigh();
 
   // Switch back to standard mode
   setMode(QSPIMode::STANDARD);
+  _qpiActive = false;
 }
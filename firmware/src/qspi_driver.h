@@ -10,6 +10,12 @@
 #define QSPI_PIN_IO2 21 // /WP / IO2
 #define QSPI_PIN_IO3 22 // /HOLD / IO3
 
+// Gang programming: up to 8 chips share CLK/IO, each on its own CS
+#define QSPI_MAX_CS 8
+
+// Held read streams are released if the host goes quiet this long
+#define QSPI_STREAM_IDLE_MS 50
+
 /**
  * @brief QSPI Operating Modes
  * Format notation: CMD-ADDR-DATA (number of IO lines used)
@@ -23,6 +29,16 @@ enum class QSPIMode : uint8_t {
   QPI = 5       // 4-4-4: Full QPI (cmd+addr+data on IO0-IO3)
 };
 
+#define QSPI_MODE_COUNT 6
+
+/**
+ * @brief Bit-bang timing of one QSPIMode, in CPU cycles
+ */
+struct QSPITiming {
+  uint8_t clockDelay = 0;  // Extra delay per clock half period
+  uint8_t sampleDelay = 0; // Rising CLK edge to input sample
+};
+
 /**
  * @brief Universal QSPI Driver with bit-banged implementation
  * Supports all standard SPI Flash operating modes including Dual, Quad, and QPI
@@ -47,6 +63,15 @@ public:
    */
   QSPIMode getMode() const { return _mode; }
 
+  /**
+   * @brief Set the clock/sample delays used while mode is active
+   * Untuned modes run with no extra delay.
+   */
+  void setTiming(QSPIMode mode, QSPITiming timing);
+  QSPITiming getTiming(QSPIMode mode) const {
+    return _timing[static_cast<uint8_t>(mode)];
+  }
+
   /**
    * @brief Send command byte (respects current mode)
    * @param cmd Command byte to send
@@ -55,11 +80,18 @@ public:
 
   /**
    * @brief Send address bytes (respects current mode for address phase)
-   * @param addr 24-bit or 32-bit address
-   * @param len Address length (3 or 4 bytes)
+   * @param addr 16-bit NAND column, 24-bit or 32-bit address
+   * @param len Address length (2, 3 or 4 bytes)
    */
   void sendAddress(uint32_t addr, uint8_t len = 3);
 
+  /**
+   * @brief Send continuous-read mode bits M7-M0 (uses address-phase width)
+   * @param bits Mode byte, e.g. 0xA0 to stay in continuous read, 0xFF to exit
+   * @return Number of clock cycles consumed
+   */
+  uint8_t sendModeBits(uint8_t bits);
+
   /**
    * @brief Send dummy clock cycles (for fast read commands)
    * @param cycles Number of dummy cycles
@@ -90,26 +122,97 @@ public:
 
   /**
    * @brief Assert chip select (active low)
+   * @param continuous true if this transaction relies on continuous-read
+   * mode (address first, no opcode). Otherwise any held read stream is
+   * closed and continuous-read mode is exited before CS is asserted.
    */
-  void csLow();
+  void csLow(bool continuous = false);
 
   /**
    * @brief Deassert chip select
    */
   void csHigh();
 
+  /**
+   * @brief Configure the chip-select GPIOs for gang programming
+   *
+   * Chip n is driven by pins[n]. Pins must be free GPIOs (or the on-board
+   * CS). count = 0 restores the single on-board CS. Chip 0 is selected.
+   * @return false if a pin is reserved, duplicated or count is too large
+   */
+  bool setChipSelects(const uint8_t *pins, uint8_t count);
+  uint8_t getChipSelectCount() const { return _csCount; }
+  uint8_t getChipSelectPin(uint8_t index) const { return _csPins[index]; }
+
+  /**
+   * @brief Choose which chips csLow() asserts
+   *
+   * Several chips may be selected for broadcast writes (WREN, program,
+   * erase); reads and status polls must select exactly one chip since all
+   * chips drive IO1.
+   * @param mask Bit n selects chip n
+   */
+  void selectChips(uint8_t mask);
+  uint8_t getSelectedChips() const { return _csSelected; }
+
+  /**
+   * @brief Check whether a GPIO is free to be used as a chip select
+   */
+  static bool isValidChipSelect(uint8_t pin);
+
+  /**
+   * @brief Keep CS asserted after a read so a contiguous follow-up read can
+   * simply clock out more data
+   * @param nextAddr Address the chip will output next
+   */
+  void holdRead(uint32_t nextAddr);
+
+  /**
+   * @brief Check whether a held read stream is positioned at addr
+   */
+  bool isStreamAt(uint32_t addr) const {
+    return _streamHeld && _streamAddr == addr;
+  }
+
+  /**
+   * @brief Mark the chip as being in continuous-read (XIP) mode
+   */
+  void setContinuousRead(bool active) { _continuousRead = active; }
+  bool isContinuousRead() const { return _continuousRead; }
+
+  /**
+   * @brief Close a held read stream and exit continuous-read mode
+   * Sends the Continuous Read Mode Reset (16 clocks with IO0-IO3 high).
+   */
+  void endStream();
+
+  /**
+   * @brief Release CS of a held read stream after QSPI_STREAM_IDLE_MS
+   * Call from loop().
+   */
+  void update();
+
   /**
    * @brief Enter QPI mode on the flash chip
-   * Sends the standard Enter QPI command (0x38)
+   * @param opcode Enter command sent in 1-1-1 (0x38, Macronix EQIO 0x35)
+   * @param exitOpcode Exit command later sent by exitQPI() in 4-4-4
+   * (0xFF, Macronix RSTQIO 0xF5)
    */
-  void enterQPI();
+  void enterQPI(uint8_t opcode = 0x38, uint8_t exitOpcode = 0xFF);
 
   /**
    * @brief Exit QPI mode on the flash chip
-   * Sends Exit QPI command (0xFF) in QPI mode
+   * Sends the exit command given to enterQPI() in QPI mode
    */
   void exitQPI();
 
+  /**
+   * @brief Check whether the chip was put in QPI mode by enterQPI()
+   */
+  bool isQPIActive() const { return _qpiActive; }
+  uint8_t getQPIEnterOpcode() const { return _qpiEnterOpcode; }
+  uint8_t getQPIExitOpcode() const { return _qpiExitOpcode; }
+
   /**
    * @brief Configure IO2/IO3 for standard SPI (pulled HIGH)
    * This disables /WP and /HOLD functions
@@ -123,7 +226,20 @@ public:
 
 private:
   QSPIMode _mode = QSPIMode::STANDARD;
-  uint32_t _clockDelay = 0; // For timing control
+  QSPITiming _timing[QSPI_MODE_COUNT];
+  uint32_t _clockDelay = 0;  // Active half-period delay (cycles)
+  uint32_t _sampleDelay = 0; // Active CLK-to-sample delay (cycles)
+
+  // Chip-side QPI state
+  bool _qpiActive = false;
+  uint8_t _qpiEnterOpcode = 0x38;
+  uint8_t _qpiExitOpcode = 0xFF;
+
+  // Read chaining state
+  bool _streamHeld = false;     // CS still asserted after a read
+  bool _continuousRead = false; // Chip expects address without opcode
+  uint32_t _streamAddr = 0;     // Next address of the held stream
+  uint32_t _streamTime = 0;     // millis() when the stream was held
 
   // Low-level bit-bang primitives
   void clockPulse();
@@ -148,9 +264,44 @@ private:
   void setIO01Output();
   void setIO01Input();
 
+  // Chip select set
+  uint8_t _csPins[QSPI_MAX_CS];
+  uint8_t _csCount = 1;
+  uint8_t _csSelected = 0x01;               // Chips asserted by csLow()
+  uint32_t _csGpioMask = 1ul << QSPI_PIN_CS; // GPIO mask of selected chips
+
   // Pin definitions
-  uint8_t csPin;
   uint8_t clkPin;
   uint8_t mosiPin;
   uint8_t misoPin;
 };
+
+/**
+ * @brief Switch the bus mode for the lifetime of a flash operation (RAII)
+ *
+ * A chip left in QPI mode (see enterQPI) is taken out of QPI for the
+ * operation and put back afterwards.
+ */
+class QSPIModeGuard {
+public:
+  QSPIModeGuard(QSPIDriver &driver, QSPIMode mode = QSPIMode::STANDARD)
+      : qspi(driver), prev(driver.getMode()),
+        qpi(driver.isQPIActive() && mode != QSPIMode::QPI) {
+    if (qpi)
+      qspi.exitQPI();
+    if (qspi.getMode() != mode)
+      qspi.setMode(mode);
+  }
+  ~QSPIModeGuard() {
+    if (qpi) {
+      qspi.enterQPI(qspi.getQPIEnterOpcode(), qspi.getQPIExitOpcode());
+    } else if (qspi.getMode() != prev) {
+      qspi.setMode(prev);
+    }
+  }
+
+private:
+  QSPIDriver &qspi;
+  QSPIMode prev;
+  bool qpi; // Chip was in QPI mode
+};
@@ -1,5 +1,12 @@
 #include "spi_driver.h"
 #include "Board.h"
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/spi.h>
+
+// GP16/18/19 belong to the SPI0 peripheral
+#define SPI_HW spi0
 
 // RP2040 SPI Pin Definitions are now in Board.h
 
@@ -33,6 +40,10 @@ void SPIDriver::begin() {
 
   // Default settings: 1MHz, Mode 0 (CPOL=0, CPHA=0)
   _settings = SPISettings(1000000, MSBFIRST, SPI_MODE0);
+  setCsTiming(_setupNs, _holdNs);
+
+  _dmaTx = dma_claim_unused_channel(true);
+  _dmaRx = dma_claim_unused_channel(true);
 }
 
 void SPIDriver::configure(uint32_t freq, uint8_t mode) {
@@ -45,28 +56,174 @@ void SPIDriver::configure(uint32_t freq, uint8_t mode) {
     dataMode = SPI_MODE3;
 
   _settings = SPISettings(freq, MSBFIRST, dataMode);
+  _freq = freq;
+  _mode = mode;
+  release(); // New settings are applied by the next transfer (ends a held CS)
+}
+
+void SPIDriver::setCsTiming(uint16_t setupNs, uint16_t holdNs) {
+  uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+  _setupNs = setupNs;
+  _holdNs = holdNs;
+  _setupCycles = (setupNs * mhz + 999) / 1000;
+  _holdCycles = (holdNs * mhz + 999) / 1000;
+}
+
+void SPIDriver::release() {
+  if (_csHeld) {
+    // Ended under the host's feet: the next continuation frame must fail
+    _csExpired = true;
+    _csExpiredCount++;
+  }
+  releaseCs();
+  if (_claimed) {
+    SPI.endTransaction();
+    _claimed = false;
+
+    // Hand the pins back to SIO with the idle levels the bit-banged QSPI,
+    // NAND and tuner paths expect (they never re-mux them)
+    gpio_set_function(Board::PIN_SPI_SCK, GPIO_FUNC_SIO);
+    gpio_set_function(Board::PIN_SPI_MOSI, GPIO_FUNC_SIO);
+    gpio_set_function(Board::PIN_SPI_MISO, GPIO_FUNC_SIO);
+    pinMode(Board::PIN_SPI_SCK, OUTPUT);
+    digitalWrite(Board::PIN_SPI_SCK, LOW);
+    pinMode(Board::PIN_SPI_MOSI, OUTPUT);
+    digitalWrite(Board::PIN_SPI_MOSI, LOW);
+    pinMode(Board::PIN_SPI_MISO, INPUT_PULLUP);
+  }
 }
 
-void SPIDriver::transfer(uint8_t cs_pin, uint8_t *data, uint16_t len) {
-  // Ensure CS pin is configured
+void SPIDriver::claim() {
+  if (_claimed)
+    return;
+
+  // QSPI and bit-bang transfers leave the pins on SIO; the settings are
+  // applied once and kept until another driver takes the bus
+  gpio_set_function(Board::PIN_SPI_MISO, GPIO_FUNC_SPI);
+  gpio_set_function(Board::PIN_SPI_SCK, GPIO_FUNC_SPI);
+  gpio_set_function(Board::PIN_SPI_MOSI, GPIO_FUNC_SPI);
+  SPI.beginTransaction(_settings);
+  _csPin = 0xFF;
+  _claimed = true;
+}
+
+void SPIDriver::select(uint8_t cs_pin) {
+  claim();
+  if (cs_pin != _csPin) {
+    pinMode(cs_pin, OUTPUT);
+    digitalWrite(cs_pin, HIGH);
+    _csPin = cs_pin;
+  }
+  gpio_put(cs_pin, 0);
+  if (_setupCycles)
+    busy_wait_at_least_cycles(_setupCycles);
+}
+
+void SPIDriver::deselect(uint8_t cs_pin) {
+  if (_holdCycles)
+    busy_wait_at_least_cycles(_holdCycles);
+  gpio_put(cs_pin, 1);
+}
+
+void SPIDriver::run(const uint8_t *tx, uint8_t *rx, uint16_t len,
+                    uint8_t fill) {
+  if (len < SPI_DMA_MIN_LEN) {
+    if (tx && rx)
+      spi_write_read_blocking(SPI_HW, tx, rx, len);
+    else if (tx)
+      spi_write_blocking(SPI_HW, tx, len);
+    else
+      spi_read_blocking(SPI_HW, fill, rx, len);
+    return;
+  }
+
+  // Both channels are paced by the SPI DREQs. RX is always drained (into a
+  // sink for TX-only) so the FIFO never overruns; it completes last, once
+  // the final byte has been clocked.
+  spi_hw_t *hw = spi_get_hw(SPI_HW);
+  while (spi_is_readable(SPI_HW))
+    (void)hw->dr;
+  _dmaFill = fill;
+
+  dma_channel_config c = dma_channel_get_default_config(_dmaTx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_dreq(&c, spi_get_dreq(SPI_HW, true));
+  channel_config_set_read_increment(&c, tx != nullptr);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(_dmaTx, &c, &hw->dr, tx ? tx : &_dmaFill, len, false);
+
+  c = dma_channel_get_default_config(_dmaRx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_dreq(&c, spi_get_dreq(SPI_HW, false));
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, rx != nullptr);
+  dma_channel_configure(_dmaRx, &c, rx ? rx : &_dmaSink, &hw->dr, len, false);
+
+  dma_start_channel_mask((1u << _dmaTx) | (1u << _dmaRx));
+  dma_channel_wait_for_finish_blocking(_dmaRx);
+}
+
+void SPIDriver::startFrame(uint8_t &cs_pin) {
   if (cs_pin == 0) {
     cs_pin = Board::PIN_SPI_CS; // Default to GP17 if 0 is passed
   }
+  if (_csHeld && cs_pin == _csPin)
+    return; // Continue the held transaction
+  releaseCs();
+  select(cs_pin);
+}
 
-  SPI.beginTransaction(_settings);
+void SPIDriver::endFrame(uint8_t cs_pin, bool keepCs) {
+  if (keepCs) {
+    _csHeld = true;
+    _csTime = millis();
+  } else {
+    _csHeld = false;
+    deselect(cs_pin);
+  }
+}
 
-  pinMode(cs_pin, OUTPUT);
-  digitalWrite(cs_pin, LOW);
-  delayMicroseconds(5); // Give flash chip time to recognize CS
+void SPIDriver::releaseCs() {
+  if (_csHeld) {
+    _csHeld = false;
+    deselect(_csPin);
+  }
+}
 
-  // Transfer each byte
-  for (uint16_t i = 0; i < len; i++) {
-    data[i] = SPI.transfer(data[i]);
+void SPIDriver::update() {
+  if (_csHeld && _csTimeoutMs && millis() - _csTime > _csTimeoutMs) {
+    // Host stalled mid-transaction: don't leave the device selected
+    releaseCs();
+    _csExpired = true;
+    _csExpiredCount++;
   }
+}
 
-  delayMicroseconds(1);
-  digitalWrite(cs_pin, HIGH);
-  SPI.endTransaction();
+void SPIDriver::transfer(uint8_t cs_pin, uint8_t *data, uint16_t len,
+                         bool keepCs) {
+  // TX reads each byte before RX overwrites it, so in place is safe
+  transfer(cs_pin, data, data, len, keepCs);
+}
+
+void SPIDriver::transfer(uint8_t cs_pin, const uint8_t *tx, uint8_t *rx,
+                         uint16_t len, bool keepCs) {
+  startFrame(cs_pin);
+  run(tx, rx, len, 0);
+  endFrame(cs_pin, keepCs);
+}
+
+void SPIDriver::write(uint8_t cs_pin, const uint8_t *tx, uint16_t len,
+                      bool keepCs) {
+  startFrame(cs_pin);
+  run(tx, nullptr, len, 0);
+  endFrame(cs_pin, keepCs);
+}
+
+void SPIDriver::read(uint8_t cs_pin, uint8_t *rx, uint16_t len, uint8_t fill,
+                     bool keepCs) {
+  startFrame(cs_pin);
+  run(nullptr, rx, len, fill);
+  endFrame(cs_pin, keepCs);
 }
 
 // Alternative bit-bang transfer for debugging
@@ -97,6 +254,7 @@ void SPIDriver::bitbangTransfer(uint8_t cs_pin, uint8_t *data, uint16_t len) {
   if (cs_pin == 0) {
     cs_pin = Board::PIN_SPI_CS;
   }
+  release();
 
   // Set pins for bit-bang mode
   pinMode(Board::PIN_SPI_MOSI, OUTPUT);
@@ -113,7 +271,5 @@ void SPIDriver::bitbangTransfer(uint8_t cs_pin, uint8_t *data, uint16_t len) {
   }
 
   digitalWrite(cs_pin, HIGH);
-
-  // Restore hardware SPI
-  SPI.begin();
+  // The pins stay on SIO: claim() muxes them for the next hardware transfer
 }
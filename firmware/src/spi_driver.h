@@ -3,14 +3,132 @@
 #include <SPI.h>
 #include <stdint.h>
 
+// SPI CS Pin (GP17, shared with the QSPI CS)
+#define SPI_CS_PIN 17
+
+// Transfers shorter than this go through the FIFO directly, since setting
+// up the two DMA channels costs more than clocking a few bytes
+#define SPI_DMA_MIN_LEN 16
+
+// Default CS setup (CS low -> first SCK edge) and hold (last SCK edge ->
+// CS high) times. Covers tSLCH/tCHSH of common SPI NOR, EEPROM and ADCs.
+#define SPI_CS_SETUP_NS 100
+#define SPI_CS_HOLD_NS 100
+
+// CS held across frames is released if the host sends nothing for this long
+#define SPI_CS_WATCHDOG_MS 100
+
 class SPIDriver {
 public:
   void begin();
   void configure(uint32_t freq, uint8_t mode);
-  void transfer(uint8_t cs_pin, uint8_t *data, uint16_t len);
+  uint32_t getFrequency() const { return _freq; }
+  uint8_t getMode() const { return _mode; }
+
+  /**
+   * @brief Set CS setup and hold times (rounded up to whole CPU cycles)
+   */
+  void setCsTiming(uint16_t setupNs, uint16_t holdNs);
+  uint16_t getCsSetupNs() const { return _setupNs; }
+  uint16_t getCsHoldNs() const { return _holdNs; }
+
+  /**
+   * @brief Release a CS held across frames after timeoutMs of inactivity
+   * @param timeoutMs 0 disables the watchdog
+   */
+  void setCsTimeout(uint16_t timeoutMs) { _csTimeoutMs = timeoutMs; }
+  uint16_t getCsTimeout() const { return _csTimeoutMs; }
+
+  /*
+   * Transfers assert CS unless it is still held for the same pin by a
+   * previous keepCs transfer, and release it afterwards unless keepCs is
+   * set. A logical transaction can so span any number of frames.
+   */
+
+  /**
+   * @brief Full-duplex transfer, RX data replaces TX data in place
+   */
+  void transfer(uint8_t cs_pin, uint8_t *data, uint16_t len,
+                bool keepCs = false);
+
+  /**
+   * @brief Full-duplex transfer between separate buffers (DMA)
+   */
+  void transfer(uint8_t cs_pin, const uint8_t *tx, uint8_t *rx, uint16_t len,
+                bool keepCs = false);
+
+  /**
+   * @brief TX-only transfer, received bytes are discarded
+   */
+  void write(uint8_t cs_pin, const uint8_t *tx, uint16_t len,
+             bool keepCs = false);
+
+  /**
+   * @brief RX-only transfer, fill is clocked out for every byte
+   */
+  void read(uint8_t cs_pin, uint8_t *rx, uint16_t len, uint8_t fill = 0xFF,
+            bool keepCs = false);
+
+  /**
+   * @brief Deassert a CS held across frames
+   */
+  void releaseCs();
+  bool isCsHeld() const { return _csHeld; }
+
+  /**
+   * @brief Check (and clear) whether the watchdog or release() ended a held
+   * CS since the last call
+   */
+  bool takeCsExpired() {
+    bool expired = _csExpired;
+    _csExpired = false;
+    return expired;
+  }
+  uint32_t getCsExpiredCount() const { return _csExpiredCount; }
+
+  /**
+   * @brief CS watchdog, call from loop()
+   */
+  void update();
+
+  /**
+   * @brief End the held bus transaction so another driver can use the pins
+   * (a held CS is reported like a watchdog expiry)
+   */
+  void release();
+
   void bitbangTransfer(uint8_t cs_pin, uint8_t *data, uint16_t len);
   uint8_t bitbangTransferByte(uint8_t txByte);
 
 private:
   SPISettings _settings;
+  uint32_t _freq = 1000000;
+  uint8_t _mode = 0;
+  bool _claimed = false; // Transaction open and pins muxed to SPI0
+  uint8_t _csPin = 0xFF; // CS pin configured as output
+
+  // DMA channels claimed in begin()
+  int _dmaTx = -1;
+  int _dmaRx = -1;
+  uint8_t _dmaFill = 0xFF; // TX source for RX-only transfers
+  uint8_t _dmaSink = 0;    // RX destination for TX-only transfers
+
+  uint16_t _setupNs = SPI_CS_SETUP_NS;
+  uint16_t _holdNs = SPI_CS_HOLD_NS;
+  uint32_t _setupCycles = 0;
+  uint32_t _holdCycles = 0;
+
+  // CS held across frames
+  bool _csHeld = false;
+  bool _csExpired = false;     // Watchdog or release(), reported once
+  uint32_t _csTime = 0;        // millis() of the last held frame
+  uint16_t _csTimeoutMs = SPI_CS_WATCHDOG_MS;
+  uint32_t _csExpiredCount = 0;
+
+  void claim();
+  void select(uint8_t cs_pin);
+  void deselect(uint8_t cs_pin);
+  void run(const uint8_t *tx, uint8_t *rx, uint16_t len, uint8_t fill);
+  void startFrame(uint8_t &cs_pin);
+  void endFrame(uint8_t cs_pin, bool keepCs);
 };
@@ -0,0 +1,929 @@
+#include "spi_flash.h"
+#include "Logger.h"
+#include <cstring>
+
+// Define Trace Tag
+#define TAG "FLASH"
+
+// SPI NOR command set (1-1-1)
+#define FLASH_CMD_WRITE_ENABLE 0x06
+#define FLASH_CMD_READ_SR1 0x05
+#define FLASH_CMD_READ 0x03
+#define FLASH_CMD_PAGE_PROGRAM 0x02
+#define FLASH_CMD_SECTOR_ERASE 0x20
+#define FLASH_CMD_READ_JEDEC 0x9F
+#define FLASH_CMD_READ_SR2 0x35
+#define FLASH_CMD_WRITE_SR1 0x01
+#define FLASH_CMD_WRITE_SR2 0x31
+#define FLASH_CMD_QUAD_PROGRAM 0x32    // 1-1-4 (Winbond, GigaDevice, ...)
+#define FLASH_CMD_QUAD_PROGRAM_MX 0x38 // 1-4-4 4PP (Macronix)
+
+#define FLASH_SR1_BUSY 0x01
+#define FLASH_SR1_WEL 0x02
+#define FLASH_SR1_QE_MX 0x40 // Macronix: QE is SR1 bit 6
+#define FLASH_SR2_QE 0x02    // Winbond/GigaDevice: QE is SR2 bit 1
+
+#define FLASH_CMD_BLOCK_ERASE_32K 0x52
+#define FLASH_CMD_BLOCK_ERASE_64K 0xD8
+#define FLASH_CMD_CHIP_ERASE 0xC7
+#define FLASH_CMD_ENTER_4B 0xB7
+#define FLASH_CMD_EXIT_4B 0xE9
+
+#define JEDEC_MFG_MACRONIX 0xC2
+#define JEDEC_MFG_WINBOND 0xEF
+#define JEDEC_MFG_GIGADEVICE 0xC8
+
+// QPI entry/exit (Winbond/GigaDevice 0x38/0xFF, Macronix EQIO/RSTQIO)
+#define FLASH_CMD_ENTER_QPI 0x38
+#define FLASH_CMD_EXIT_QPI 0xFF
+#define FLASH_CMD_ENTER_QPI_MX 0x35
+#define FLASH_CMD_EXIT_QPI_MX 0xF5
+
+/**
+ * @brief Map a 3-byte address opcode to its dedicated 4-byte variant
+ */
+static uint8_t opcode4B(uint8_t opcode) {
+  switch (opcode) {
+  case 0x03: return 0x13; // Read
+  case 0x0B: return 0x0C; // Fast Read
+  case 0x3B: return 0x3C; // Fast Read Dual Output
+  case 0xBB: return 0xBC; // Fast Read Dual I/O
+  case 0x6B: return 0x6C; // Fast Read Quad Output
+  case 0xEB: return 0xEC; // Fast Read Quad I/O
+  case 0x02: return 0x12; // Page Program
+  case 0x32: return 0x34; // Quad Page Program
+  case 0x38: return 0x3E; // Macronix 4PP
+  case 0x20: return 0x21; // Sector Erase 4KB
+  case 0x52: return 0x5C; // Block Erase 32KB
+  case 0xD8: return 0xDC; // Block Erase 64KB
+  default: return opcode;
+  }
+}
+
+uint8_t SPIFlash::readStatus(uint8_t cmd) {
+  QSPIModeGuard guard(qspi);
+  uint8_t sr = 0;
+  qspi.csLow();
+  qspi.sendCommand(cmd);
+  qspi.readData(&sr, 1);
+  qspi.csHigh();
+  return sr;
+}
+
+bool SPIFlash::writeEnable() {
+  // Every erase, program and status write starts here
+  invalidateReadAhead();
+  QSPIModeGuard guard(qspi);
+  qspi.csLow();
+  qspi.sendCommand(FLASH_CMD_WRITE_ENABLE);
+  qspi.csHigh();
+  return (readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_WEL) != 0;
+}
+
+bool SPIFlash::waitReady(uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_BUSY) {
+    if (millis() - start > timeoutMs) {
+      LOG_ERROR(TAG, "Timeout waiting for BUSY to clear");
+      return false;
+    }
+  }
+  return true;
+}
+
+// ============== ADDRESSING ==============
+
+void SPIFlash::setAddrMode(FlashAddrMode mode) {
+  if (addrMode == FlashAddrMode::EN4B && mode != FlashAddrMode::EN4B &&
+      in4ByteMode) {
+    QSPIModeGuard guard(qspi);
+    qspi.csLow();
+    qspi.sendCommand(FLASH_CMD_EXIT_4B);
+    qspi.csHigh();
+    in4ByteMode = false;
+  }
+  addrMode = mode;
+  invalidateReadAhead();
+}
+
+uint8_t SPIFlash::resolveAddress(uint8_t &opcode, uint32_t addr,
+                                 uint32_t len) {
+  switch (addrMode) {
+  case FlashAddrMode::EN4B:
+    if (!in4ByteMode) {
+      qspi.csLow();
+      qspi.sendCommand(FLASH_CMD_ENTER_4B); // Honours QPI if active
+      qspi.csHigh();
+      in4ByteMode = true;
+    }
+    return 4;
+
+  case FlashAddrMode::OPCODES_4B:
+    opcode = opcode4B(opcode);
+    return 4;
+
+  case FlashAddrMode::AUTO:
+  default:
+    if (addr + len <= FLASH_3B_LIMIT)
+      return 3;
+    opcode = opcode4B(opcode);
+    return 4;
+  }
+}
+
+void SPIFlash::read(uint32_t addr, uint8_t *data, uint32_t len) {
+  QSPIModeGuard guard(qspi);
+  uint8_t opcode = FLASH_CMD_READ;
+  uint8_t addrLen = resolveAddress(opcode, addr, len);
+
+  qspi.csLow();
+  qspi.sendCommand(opcode);
+  qspi.sendAddress(addr, addrLen);
+  qspi.readData(data, len);
+  qspi.csHigh();
+}
+
+void SPIFlash::setReadChaining(bool enable) {
+  if (!enable)
+    qspi.endStream();
+  readChaining = enable;
+}
+
+bool SPIFlash::setBusMode(QSPIMode mode) {
+  invalidateReadAhead();
+  if (qspi.getMode() == mode)
+    return true;
+  if (qspi.isQPIActive())
+    qspi.exitQPI(); // Leaves the bus in Standard mode
+
+  bool quad = mode == QSPIMode::QUAD_OUT || mode == QSPIMode::QUAD_IO ||
+              mode == QSPIMode::QPI;
+  if (quad && !ensureQuadEnable()) {
+    qspi.setMode(QSPIMode::STANDARD);
+    return false;
+  }
+
+  if (mode == QSPIMode::QPI) {
+    bool macronix = readManufacturer() == JEDEC_MFG_MACRONIX;
+    qspi.enterQPI(macronix ? FLASH_CMD_ENTER_QPI_MX : FLASH_CMD_ENTER_QPI,
+                  macronix ? FLASH_CMD_EXIT_QPI_MX : FLASH_CMD_EXIT_QPI);
+  } else {
+    qspi.setMode(mode);
+  }
+  return true;
+}
+
+int8_t SPIFlash::probeModes(uint32_t addr, uint16_t len, uint8_t *ref,
+                            uint8_t *buf, FlashModeProbe *results) {
+  QSPIMode prevMode = qspi.getMode();
+  bool prevAhead = readAhead;
+  bool prevChain = readChaining;
+  // Every read pays its full opcode/address/dummy cost
+  setReadAhead(false);
+  setReadChaining(false);
+
+  setBusMode(QSPIMode::STANDARD);
+  read(addr, ref, len);
+
+  // A blank (or stuck) region reads the same on floating lines
+  bool uniform = true;
+  for (uint16_t i = 1; i < len && uniform; i++)
+    uniform = ref[i] == ref[0];
+
+  int8_t best = -1;
+  for (uint8_t m = 0; m < QSPI_MODE_COUNT && !uniform; m++) {
+    results[m] = FlashModeProbe();
+    if (!setBusMode(static_cast<QSPIMode>(m)))
+      continue; // Quad mode without QE
+
+    // First read checks the mode, the second one is timed
+    fastRead(addr, buf, len);
+    if (memcmp(buf, ref, len) != 0)
+      continue;
+    uint32_t t0 = micros();
+    fastRead(addr, buf, len);
+    uint32_t us = micros() - t0;
+    if (memcmp(buf, ref, len) != 0)
+      continue;
+
+    results[m].ok = true;
+    results[m].bytesPerSec = us ? (uint64_t)len * 1000000 / us : 0;
+    if (best < 0 || results[m].bytesPerSec > results[best].bytesPerSec)
+      best = m;
+  }
+
+  setBusMode(best >= 0 ? static_cast<QSPIMode>(best) : prevMode);
+  setReadChaining(prevChain);
+  setReadAhead(prevAhead);
+  return uniform ? -2 : best;
+}
+
+// ============== READ-AHEAD ==============
+
+void SPIFlash::setReadAhead(bool enable) {
+  invalidateReadAhead();
+  readAhead = enable;
+}
+
+bool SPIFlash::readAheadHit(uint32_t addr, uint8_t *data, uint32_t len) {
+  if (!readAhead)
+    return false;
+  if (addr < aheadAddr || addr + len > aheadAddr + aheadLen) {
+    readStats.aheadMisses++;
+    return false;
+  }
+
+  memcpy(data, &aheadBuf[addr - aheadAddr], len);
+  readStats.aheadHits++;
+
+  // Keep what was prefetched beyond this read at the front of the buffer
+  uint32_t end = addr + len;
+  uint32_t keep = aheadAddr + aheadLen - end;
+  if (keep)
+    memmove(aheadBuf, &aheadBuf[end - aheadAddr], keep);
+  aheadAddr = end;
+  aheadLen = keep;
+  aheadTarget = (len < FLASH_READAHEAD_SIZE) ? len : FLASH_READAHEAD_SIZE;
+  if (aheadTarget < keep)
+    aheadTarget = keep;
+  return true;
+}
+
+void SPIFlash::armReadAhead(uint32_t addr, uint32_t len) {
+  if (!readAhead)
+    return;
+  aheadAddr = addr;
+  aheadLen = 0;
+  aheadTarget = (len < FLASH_READAHEAD_SIZE) ? len : FLASH_READAHEAD_SIZE;
+}
+
+void SPIFlash::update() {
+  if (aheadLen >= aheadTarget)
+    return;
+
+  // One chunk per loop, so an unrelated request waits at most this long.
+  // The held stream sits at aheadAddr + aheadLen, so chunks only clock data.
+  uint32_t chunk = aheadTarget - aheadLen;
+  if (chunk > FLASH_READAHEAD_CHUNK)
+    chunk = FLASH_READAHEAD_CHUNK;
+  fastReadBus(aheadAddr + aheadLen, &aheadBuf[aheadLen], chunk);
+  aheadLen += chunk;
+  readStats.aheadBytes += chunk;
+}
+
+void SPIFlash::fastRead(uint32_t addr, uint8_t *data, uint32_t len) {
+  if (readAheadHit(addr, data, len))
+    return;
+
+  // A read overlapping the window still uses its buffered head; the tail
+  // then continues the held stream behind the prefetched bytes
+  uint32_t served = 0;
+  if (readAhead && addr >= aheadAddr && addr < aheadAddr + aheadLen) {
+    served = aheadAddr + aheadLen - addr;
+    memcpy(data, &aheadBuf[addr - aheadAddr], served);
+  }
+  fastReadBus(addr + served, data + served, len - served);
+  armReadAhead(addr + len, len);
+}
+
+void SPIFlash::fastReadBus(uint32_t addr, uint8_t *data, uint32_t len) {
+  QSPIMode mode = qspi.getMode();
+
+  // Use appropriate fast read command based on mode
+  uint8_t opcode;
+  uint8_t dummyCycles;   // Total clocks between address and data
+  uint8_t addrLines = 1; // Width of the address phase
+  bool modeBits = false; // Dummy phase starts with M7-M0
+
+  switch (mode) {
+  case QSPIMode::STANDARD:
+    opcode = 0x0B; // Fast Read
+    dummyCycles = 8;
+    break;
+  case QSPIMode::DUAL_OUT:
+    opcode = 0x3B; // Fast Read Dual Output
+    dummyCycles = 8;
+    break;
+  case QSPIMode::DUAL_IO:
+    opcode = 0xBB; // Fast Read Dual I/O
+    dummyCycles = 4;
+    addrLines = 2;
+    modeBits = true;
+    break;
+  case QSPIMode::QUAD_OUT:
+    opcode = 0x6B; // Fast Read Quad Output
+    dummyCycles = 8;
+    break;
+  case QSPIMode::QUAD_IO:
+  case QSPIMode::QPI:
+    opcode = 0xEB; // Fast Read Quad I/O (also valid in QPI)
+    dummyCycles = 6;
+    addrLines = 4;
+    modeBits = true;
+    break;
+  default:
+    opcode = FLASH_CMD_READ; // Normal read
+    dummyCycles = 0;
+  }
+
+  uint8_t addrLen = resolveAddress(opcode, addr, len);
+  uint8_t opcodeClocks = (mode == QSPIMode::QPI) ? 2 : 8;
+  uint8_t addrClocks = addrLen * 8 / addrLines;
+
+  // 1. Contiguous with the held stream: just keep clocking data
+  if (readChaining && qspi.isStreamAt(addr)) {
+    qspi.readData(data, len);
+    qspi.holdRead(addr + len);
+    readStats.chained++;
+    readStats.clocksSaved += opcodeClocks + addrClocks + dummyCycles;
+    return;
+  }
+
+  // Mode bits that keep the chip in continuous-read mode, 0xFF = exit.
+  // Winbond/GigaDevice want M5-4 = 10 (0xA0); Macronix wants P7-4 != P3-0.
+  uint8_t bits = 0xFF;
+  if (readChaining && modeBits) {
+    switch (readManufacturer()) {
+    case JEDEC_MFG_WINBOND:
+    case JEDEC_MFG_GIGADEVICE:
+      bits = 0xA0;
+      break;
+    case JEDEC_MFG_MACRONIX:
+      bits = 0xA5;
+      break;
+    }
+  }
+
+  // 2. Chip in continuous-read mode for this opcode: skip the opcode
+  bool continuous = readChaining && modeBits && qspi.isContinuousRead() &&
+                    continuousOpcode == opcode && continuousAddrLen == addrLen;
+
+  if (continuous) {
+    qspi.csLow(true);
+    readStats.continuous++;
+    readStats.clocksSaved += opcodeClocks;
+  } else {
+    qspi.csLow();
+    qspi.sendCommand(opcode);
+    readStats.full++;
+  }
+  qspi.sendAddress(addr, addrLen);
+
+  if (modeBits) {
+    qspi.sendDummyCycles(dummyCycles - qspi.sendModeBits(bits));
+    qspi.setContinuousRead(bits != 0xFF);
+    continuousOpcode = opcode;
+    continuousAddrLen = addrLen;
+  } else {
+    qspi.sendDummyCycles(dummyCycles);
+  }
+
+  qspi.readData(data, len);
+
+  if (readChaining) {
+    qspi.holdRead(addr + len);
+  } else {
+    qspi.csHigh();
+  }
+}
+
+/**
+ * @brief Opcode, region size and typical/worst-case time of an erase type
+ * @return false for an unknown type
+ */
+static bool eraseParams(FlashEraseType type, uint8_t &opcode, uint32_t &size,
+                        uint32_t &expectedMs, uint32_t &timeoutMs) {
+  switch (type) {
+  case FlashEraseType::SECTOR_4K:
+    opcode = FLASH_CMD_SECTOR_ERASE;
+    size = FLASH_SECTOR_SIZE;
+    expectedMs = FLASH_TYPICAL_SECTOR_MS;
+    timeoutMs = FLASH_TIMEOUT_SECTOR_MS;
+    return true;
+  case FlashEraseType::BLOCK_32K:
+    opcode = FLASH_CMD_BLOCK_ERASE_32K;
+    size = 32 * 1024;
+    expectedMs = FLASH_TYPICAL_BLOCK32_MS;
+    timeoutMs = FLASH_TIMEOUT_BLOCK32_MS;
+    return true;
+  case FlashEraseType::BLOCK_64K:
+    opcode = FLASH_CMD_BLOCK_ERASE_64K;
+    size = 64 * 1024;
+    expectedMs = FLASH_TYPICAL_BLOCK64_MS;
+    timeoutMs = FLASH_TIMEOUT_BLOCK64_MS;
+    return true;
+  case FlashEraseType::CHIP:
+    opcode = FLASH_CMD_CHIP_ERASE;
+    size = 0;
+    expectedMs = FLASH_TYPICAL_CHIP_MS_PER_MB * 16; // Refined by capacity
+    timeoutMs = FLASH_TIMEOUT_CHIP_MS;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SPIFlash::erase(FlashEraseType type, uint32_t addr) {
+  uint32_t expectedMs;
+  uint32_t timeoutMs;
+
+  if (!startErase(type, addr, expectedMs, timeoutMs))
+    return false;
+  return waitReady(timeoutMs);
+}
+
+bool SPIFlash::startErase(FlashEraseType type, uint32_t addr,
+                          uint32_t &expectedMs, uint32_t &timeoutMs) {
+  uint8_t opcode;
+  uint32_t size;
+
+  if (!eraseParams(type, opcode, size, expectedMs, timeoutMs))
+    return false;
+
+  // tCE scales with the part size (JEDEC capacity byte = log2 of bytes)
+  if (type == FlashEraseType::CHIP && readManufacturer() &&
+      capacityLog2 >= 20 && capacityLog2 <= 28) {
+    expectedMs = FLASH_TYPICAL_CHIP_MS_PER_MB << (capacityLog2 - 20);
+  }
+
+  if (!writeEnable())
+    return false;
+
+  {
+    QSPIModeGuard guard(qspi);
+    uint8_t addrLen = 0;
+    if (size) {
+      addr &= ~(size - 1);
+      addrLen = resolveAddress(opcode, addr);
+    }
+
+    qspi.csLow();
+    qspi.sendCommand(opcode);
+    if (addrLen)
+      qspi.sendAddress(addr, addrLen);
+    qspi.csHigh();
+  }
+  return true;
+}
+
+bool SPIFlash::isBusy() {
+  return (readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_BUSY) != 0;
+}
+
+bool SPIFlash::programPage(uint32_t addr, const uint8_t *data, uint16_t len,
+                           FlashProgramResult *stats) {
+  if (!startProgramPage(addr, data, len, stats))
+    return false;
+
+  uint32_t t1 = micros();
+  bool ok = waitReady(FLASH_TIMEOUT_PAGE_MS);
+  if (stats)
+    stats->busyUs += micros() - t1;
+  return ok;
+}
+
+bool SPIFlash::startProgramPage(uint32_t addr, const uint8_t *data,
+                                uint16_t len, FlashProgramResult *stats) {
+  // QE handling does its own WREN, so resolve it before ours
+  bool quad = quadWrites && ensureQuadEnable();
+  bool macronix = mfgId == JEDEC_MFG_MACRONIX;
+
+  if (!writeEnable())
+    return false;
+
+  uint32_t t0 = micros();
+  {
+    // 0x32 is 1-1-4 (QUAD_OUT), Macronix 4PP 0x38 is 1-4-4 (QUAD_IO)
+    QSPIModeGuard guard(qspi, !quad    ? QSPIMode::STANDARD
+                          : macronix ? QSPIMode::QUAD_IO
+                                     : QSPIMode::QUAD_OUT);
+    uint8_t opcode = !quad      ? FLASH_CMD_PAGE_PROGRAM
+                     : macronix ? FLASH_CMD_QUAD_PROGRAM_MX
+                                : FLASH_CMD_QUAD_PROGRAM;
+    uint8_t addrLen = resolveAddress(opcode, addr);
+
+    qspi.csLow();
+    qspi.sendCommand(opcode);
+    qspi.sendAddress(addr, addrLen);
+    qspi.writeData(data, len);
+    qspi.csHigh();
+  }
+
+  if (stats) {
+    stats->quad = quad;
+    stats->xferUs += micros() - t0;
+  }
+  return true;
+}
+
+// ============== QUAD ENABLE MANAGEMENT ==============
+
+uint8_t SPIFlash::readManufacturer() {
+  if (mfgId == 0) {
+    QSPIModeGuard guard(qspi);
+    uint8_t id[3] = {0};
+    qspi.csLow();
+    qspi.sendCommand(FLASH_CMD_READ_JEDEC);
+    qspi.readData(id, 3);
+    qspi.csHigh();
+    if (id[0] != 0x00 && id[0] != 0xFF) {
+      mfgId = id[0];
+      capacityLog2 = id[2];
+    }
+  }
+  return mfgId;
+}
+
+bool SPIFlash::qeBitSet() {
+  if (readManufacturer() == JEDEC_MFG_MACRONIX)
+    return readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_QE_MX;
+  return readStatus(FLASH_CMD_READ_SR2) & FLASH_SR2_QE;
+}
+
+bool SPIFlash::ensureQuadEnable() {
+  if (qeState != FlashQEState::UNKNOWN)
+    return qeState == FlashQEState::SET;
+
+  if (readManufacturer() == 0) {
+    return false; // No chip answering, retry next time
+  }
+
+  if (!qeBitSet()) {
+    QSPIModeGuard guard(qspi);
+    uint8_t sr1 = readStatus(FLASH_CMD_READ_SR1);
+    uint8_t sr2 = readStatus(FLASH_CMD_READ_SR2);
+
+    if (mfgId == JEDEC_MFG_MACRONIX) {
+      // Macronix: QE lives in SR1, written with 0x01
+      uint8_t value = sr1 | FLASH_SR1_QE_MX;
+      if (writeEnable()) {
+        qspi.csLow();
+        qspi.sendCommand(FLASH_CMD_WRITE_SR1);
+        qspi.writeData(&value, 1);
+        qspi.csHigh();
+        waitReady(FLASH_TIMEOUT_STATUS_MS);
+      }
+    } else {
+      // Winbond/GigaDevice: Write SR2 (0x31) with QE set
+      uint8_t value = sr2 | FLASH_SR2_QE;
+      if (writeEnable()) {
+        qspi.csLow();
+        qspi.sendCommand(FLASH_CMD_WRITE_SR2);
+        qspi.writeData(&value, 1);
+        qspi.csHigh();
+        waitReady(FLASH_TIMEOUT_STATUS_MS);
+      }
+
+      // Older parts lack 0x31: write SR1+SR2 together with 0x01
+      if (!qeBitSet() && writeEnable()) {
+        uint8_t regs[2] = {sr1, value};
+        qspi.csLow();
+        qspi.sendCommand(FLASH_CMD_WRITE_SR1);
+        qspi.writeData(regs, 2);
+        qspi.csHigh();
+        waitReady(FLASH_TIMEOUT_STATUS_MS);
+      }
+    }
+  }
+
+  qeState = qeBitSet() ? FlashQEState::SET : FlashQEState::UNSUPPORTED;
+  LOG_VAL(TAG, "QE", static_cast<uint8_t>(qeState));
+  return qeState == FlashQEState::SET;
+}
+
+uint16_t SPIFlash::usedLength(const uint8_t *data, uint16_t len) {
+  // Scan backwards: unaligned tail bytes first, then whole words
+  while (len > 0 && ((uintptr_t)(data + len) & 3)) {
+    if (data[len - 1] != 0xFF)
+      return len;
+    len--;
+  }
+
+  while (len >= 4) {
+    uint32_t word;
+    memcpy(&word, data + len - 4, 4);
+    if (word != 0xFFFFFFFF)
+      break;
+    len -= 4;
+  }
+
+  while (len > 0 && data[len - 1] == 0xFF)
+    len--;
+  return len;
+}
+
+bool SPIFlash::program(uint32_t addr, const uint8_t *data, uint16_t len,
+                       bool trimTail, FlashProgramResult &result) {
+  while (len > 0) {
+    uint16_t chunk = FLASH_PAGE_SIZE - (addr % FLASH_PAGE_SIZE);
+    if (chunk > len)
+      chunk = len;
+
+    uint16_t used = usedLength(data, chunk);
+    if (used == 0) {
+      result.skipped++;
+    } else {
+      uint16_t sendLen = trimTail ? used : chunk;
+      if (!programPage(addr, data, sendLen, &result))
+        return false;
+      result.pages++;
+      result.trimmed += chunk - sendLen;
+    }
+
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+// ============== SECTOR READ-MODIFY-WRITE ==============
+
+bool SPIFlash::loadSector(uint32_t addr, FlashPatchResult &result) {
+  if (sectorLoaded && sectorAddr == addr)
+    return true;
+
+  if (!flushSector(result))
+    return false;
+
+  read(addr, sectorBuf, FLASH_SECTOR_SIZE);
+  sectorAddr = addr;
+  sectorLoaded = true;
+  dirtyPages = 0;
+  needsErase = false;
+  result.sectors++;
+  return true;
+}
+
+bool SPIFlash::flushSector(FlashPatchResult &result) {
+  if (!sectorLoaded)
+    return true;
+  sectorLoaded = false;
+
+  if (dirtyPages == 0)
+    return true; // Edits matched existing contents
+
+  if (needsErase) {
+    // At least one bit goes 0->1: erase, then rewrite every non-blank page
+    if (!eraseSector(sectorAddr))
+      return false;
+    result.erased++;
+  }
+
+  for (uint8_t p = 0; p < FLASH_PAGES_PER_SECTOR; p++) {
+    const uint8_t *page = &sectorBuf[p * FLASH_PAGE_SIZE];
+    bool program = needsErase ? usedLength(page, FLASH_PAGE_SIZE) != 0
+                              : (dirtyPages & (1 << p)) != 0;
+    if (!program)
+      continue;
+
+    if (!programPage(sectorAddr + p * FLASH_PAGE_SIZE, page, FLASH_PAGE_SIZE))
+      return false;
+    result.pages++;
+  }
+  return true;
+}
+
+bool SPIFlash::patch(const uint8_t *edits, uint16_t len,
+                     FlashPatchResult &result) {
+  uint16_t pos = 0;
+  sectorLoaded = false;
+
+  while (pos < len) {
+    if (len - pos < 6)
+      return false; // Truncated edit header
+
+    uint32_t addr = edits[pos] | (edits[pos + 1] << 8) |
+                    (edits[pos + 2] << 16) | ((uint32_t)edits[pos + 3] << 24);
+    uint16_t editLen = edits[pos + 4] | (edits[pos + 5] << 8);
+    pos += 6;
+
+    if (editLen > len - pos)
+      return false; // Data runs past end of payload
+
+    const uint8_t *data = &edits[pos];
+    pos += editLen;
+
+    // Apply edit, splitting at sector boundaries
+    while (editLen > 0) {
+      uint32_t base = addr & ~(uint32_t)(FLASH_SECTOR_SIZE - 1);
+      uint16_t offset = addr - base;
+      uint16_t chunk = FLASH_SECTOR_SIZE - offset;
+      if (chunk > editLen)
+        chunk = editLen;
+
+      if (!loadSector(base, result))
+        return false;
+
+      for (uint16_t i = 0; i < chunk; i++) {
+        uint8_t oldByte = sectorBuf[offset + i];
+        uint8_t newByte = data[i];
+        if (oldByte == newByte)
+          continue;
+
+        // NOR can only clear bits without an erase
+        if (newByte & ~oldByte)
+          needsErase = true;
+        dirtyPages |= 1 << ((offset + i) / FLASH_PAGE_SIZE);
+        sectorBuf[offset + i] = newByte;
+      }
+
+      addr += chunk;
+      data += chunk;
+      editLen -= chunk;
+    }
+  }
+
+  return flushSector(result);
+}
+
+// ============== GANG PROGRAMMING ==============
+
+uint8_t SPIFlash::gangWriteEnable(uint8_t mask, FlashGangResult &result) {
+  invalidateReadAhead();
+  qspi.selectChips(mask);
+  qspi.csLow();
+  qspi.sendCommand(FLASH_CMD_WRITE_ENABLE);
+  qspi.csHigh();
+
+  // WEL must be confirmed chip by chip: all chips drive IO1 on a read
+  for (uint8_t i = 0; i < QSPI_MAX_CS; i++) {
+    uint8_t bit = 1 << i;
+    if (!(mask & bit))
+      continue;
+    qspi.selectChips(bit);
+    if (!(readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_WEL)) {
+      result.status[i] = static_cast<uint8_t>(FlashGangStatus::WEL_FAIL);
+      mask &= ~bit;
+    }
+  }
+  return mask;
+}
+
+uint8_t SPIFlash::gangWaitReady(uint8_t mask, uint32_t timeoutMs,
+                                FlashGangResult &result) {
+  uint8_t pending = mask;
+  uint32_t start = millis();
+
+  while (pending) {
+    for (uint8_t i = 0; i < QSPI_MAX_CS; i++) {
+      uint8_t bit = 1 << i;
+      if (!(pending & bit))
+        continue;
+      qspi.selectChips(bit);
+      if (!(readStatus(FLASH_CMD_READ_SR1) & FLASH_SR1_BUSY))
+        pending &= ~bit;
+    }
+
+    if (pending && millis() - start > timeoutMs) {
+      for (uint8_t i = 0; i < QSPI_MAX_CS; i++) {
+        if (pending & (1 << i))
+          result.status[i] = static_cast<uint8_t>(FlashGangStatus::TIMEOUT);
+      }
+      LOG_ERROR(TAG, "Gang: timeout waiting for BUSY to clear");
+      return mask & ~pending;
+    }
+  }
+  return mask;
+}
+
+uint8_t SPIFlash::gangStart(uint8_t mask, FlashGangResult &result) {
+  result.chips = qspi.getChipSelectCount();
+  mask &= (uint8_t)((1u << result.chips) - 1);
+  for (uint8_t i = 0; i < QSPI_MAX_CS; i++) {
+    result.status[i] =
+        static_cast<uint8_t>((mask & (1 << i)) ? FlashGangStatus::OK
+                                               : FlashGangStatus::SKIPPED);
+  }
+  return mask;
+}
+
+uint8_t SPIFlash::gangErase(FlashEraseType type, uint32_t addr, uint8_t mask,
+                            FlashGangResult &result) {
+  uint8_t opcode;
+  uint32_t size;
+  uint32_t expectedMs;
+  uint32_t timeoutMs;
+
+  if (!eraseParams(type, opcode, size, expectedMs, timeoutMs))
+    return 0;
+
+  uint8_t prevSelect = qspi.getSelectedChips();
+  QSPIModeGuard guard(qspi);
+  mask = gangWriteEnable(gangStart(mask, result), result);
+
+  if (mask) {
+    uint8_t addrLen = 0;
+    if (size) {
+      addr &= ~(size - 1);
+      addrLen = gangAddress(opcode, addr, 1);
+    }
+
+    qspi.selectChips(mask);
+    qspi.csLow();
+    qspi.sendCommand(opcode);
+    if (addrLen)
+      qspi.sendAddress(addr, addrLen);
+    qspi.csHigh();
+
+    mask = gangWaitReady(mask, timeoutMs, result);
+  }
+
+  qspi.selectChips(prevSelect);
+  return mask;
+}
+
+uint8_t SPIFlash::gangProgram(uint32_t addr, const uint8_t *data, uint16_t len,
+                              uint8_t mask, FlashGangResult &result) {
+  uint8_t prevSelect = qspi.getSelectedChips();
+  QSPIModeGuard guard(qspi);
+  mask = gangStart(mask, result);
+
+  while (len > 0 && mask) {
+    uint16_t chunk = FLASH_PAGE_SIZE - (addr % FLASH_PAGE_SIZE);
+    if (chunk > len)
+      chunk = len;
+
+    uint16_t used = usedLength(data, chunk);
+    if (used == 0) {
+      result.skipped++;
+    } else {
+      mask = gangWriteEnable(mask, result);
+      if (!mask)
+        break;
+
+      uint8_t opcode = FLASH_CMD_PAGE_PROGRAM;
+      uint8_t addrLen = gangAddress(opcode, addr, used);
+
+      // One data transfer programs every selected chip
+      qspi.selectChips(mask);
+      qspi.csLow();
+      qspi.sendCommand(opcode);
+      qspi.sendAddress(addr, addrLen);
+      qspi.writeData(data, used);
+      qspi.csHigh();
+
+      mask = gangWaitReady(mask, FLASH_TIMEOUT_PAGE_MS, result);
+      result.pages++;
+    }
+
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+
+  qspi.selectChips(prevSelect);
+  return mask;
+}
+
+uint8_t SPIFlash::gangVerify(uint32_t addr, const uint8_t *data, uint16_t len,
+                             uint8_t mask, FlashGangResult &result) {
+  uint8_t prevSelect = qspi.getSelectedChips();
+  QSPIModeGuard guard(qspi);
+  mask = gangStart(mask, result);
+
+  for (uint8_t i = 0; i < QSPI_MAX_CS; i++) {
+    uint8_t bit = 1 << i;
+    if (!(mask & bit))
+      continue;
+
+    uint8_t opcode = FLASH_CMD_READ;
+    uint8_t addrLen = gangAddress(opcode, addr, len);
+
+    qspi.selectChips(bit);
+    qspi.csLow();
+    qspi.sendCommand(opcode);
+    qspi.sendAddress(addr, addrLen);
+
+    // Compare in page-sized pieces of a single read
+    uint8_t buf[FLASH_PAGE_SIZE];
+    for (uint16_t pos = 0; pos < len; pos += sizeof(buf)) {
+      uint16_t chunk = len - pos;
+      if (chunk > sizeof(buf))
+        chunk = sizeof(buf);
+      qspi.readData(buf, chunk);
+
+      if (memcmp(buf, data + pos, chunk) != 0) {
+        uint16_t j = 0;
+        while (buf[j] == data[pos + j])
+          j++;
+        result.status[i] = static_cast<uint8_t>(FlashGangStatus::MISMATCH);
+        result.mismatch[i] = addr + pos + j;
+        mask &= ~bit;
+        break;
+      }
+    }
+    qspi.csHigh();
+  }
+
+  qspi.selectChips(prevSelect);
+  return mask;
+}
+
+uint8_t SPIFlash::gangAddress(uint8_t &opcode, uint32_t addr, uint32_t len) {
+  // EN4B state is per chip, so gang operations always use 4-byte opcodes
+  if (addrMode == FlashAddrMode::AUTO && addr + len <= FLASH_3B_LIMIT)
+    return 3;
+  opcode = opcode4B(opcode);
+  return 4;
+}
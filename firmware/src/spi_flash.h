@@ -0,0 +1,429 @@
+#pragma once
+#include "qspi_driver.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+// SPI NOR geometry (common to W25Q/GD25Q/MX25L families)
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+// Worst-case operation times (datasheet tPP / tSE max plus margin)
+#define FLASH_TIMEOUT_PAGE_MS 10
+#define FLASH_TIMEOUT_SECTOR_MS 2000
+#define FLASH_TIMEOUT_STATUS_MS 50
+#define FLASH_TIMEOUT_BLOCK32_MS 4000
+#define FLASH_TIMEOUT_BLOCK64_MS 6000
+#define FLASH_TIMEOUT_CHIP_MS 400000
+
+// Typical operation times (datasheet tSE / tBE / tCE typ), used to pace
+// completion polling of background erases
+#define FLASH_TYPICAL_SECTOR_MS 45
+#define FLASH_TYPICAL_BLOCK32_MS 120
+#define FLASH_TYPICAL_BLOCK64_MS 150
+#define FLASH_TYPICAL_CHIP_MS_PER_MB 2500
+
+// Parts above 16MB need 4-byte addressing
+#define FLASH_3B_LIMIT 0x1000000UL
+
+// Sequential read-ahead: buffer size (largest QSPI_FAST_READ) and the
+// amount prefetched per update() call
+#define FLASH_READAHEAD_SIZE 4096
+#define FLASH_READAHEAD_CHUNK 512
+
+/**
+ * @brief Erase granularities understood by SPIFlash::erase
+ */
+enum class FlashEraseType : uint8_t {
+  SECTOR_4K = 0, // 0x20 / 0x21
+  BLOCK_32K = 1, // 0x52 / 0x5C
+  BLOCK_64K = 2, // 0xD8 / 0xDC
+  CHIP = 3       // 0xC7
+};
+
+/**
+ * @brief How addresses above 16MB are reached
+ */
+enum class FlashAddrMode : uint8_t {
+  AUTO = 0,       // 3-byte below 16MB, dedicated 4-byte opcodes above
+  OPCODES_4B = 1, // Always use 4-byte opcodes (0x13/0x0C/0x12/0x21/...)
+  EN4B = 2        // Enter 4-byte mode (0xB7) and use legacy opcodes
+};
+
+/**
+ * @brief Cached state of the status register Quad Enable bit
+ */
+enum class FlashQEState : uint8_t {
+  UNKNOWN = 0,    // Not checked since boot / last raw status write
+  SET = 1,        // QE set, quad page program available
+  UNSUPPORTED = 2 // QE could not be set, fall back to 1-1-1 programming
+};
+
+/**
+ * @brief Result counters for a FLASH_PATCH run
+ */
+struct FlashPatchResult {
+  uint16_t sectors = 0; // Sectors read into RAM and compared
+  uint16_t erased = 0;  // Sectors that required an erase cycle
+  uint16_t pages = 0;   // Pages actually programmed
+};
+
+/**
+ * @brief Result counters for a FLASH_PROGRAM run
+ */
+struct FlashProgramResult {
+  uint16_t pages = 0;   // Pages sent to the chip
+  uint16_t skipped = 0; // All-0xFF pages skipped entirely
+  uint16_t trimmed = 0; // Trailing 0xFF bytes not clocked out
+  bool quad = false;    // Data phase used Quad Page Program
+  uint32_t xferUs = 0;  // Time spent clocking command/address/data
+  uint32_t busyUs = 0;  // Time spent waiting for tPP
+};
+
+/**
+ * @brief Fast read chaining counters (reported by QSPI_STATS)
+ */
+struct FlashReadStats {
+  uint32_t full = 0;        // Reads with opcode + address + dummies
+  uint32_t continuous = 0;  // Reads that skipped the opcode (mode bits)
+  uint32_t chained = 0;     // Reads served from a held CS stream
+  uint32_t clocksSaved = 0; // Command/address/dummy clocks not sent
+  uint32_t aheadHits = 0;   // Reads answered entirely from the read-ahead
+  uint32_t aheadMisses = 0; // Reads that had to touch the bus
+  uint32_t aheadBytes = 0;  // Bytes prefetched in the background
+};
+
+/**
+ * @brief Result of one mode in SPIFlash::probeModes
+ */
+struct FlashModeProbe {
+  bool ok = false;          // Read back the reference
+  uint32_t bytesPerSec = 0; // Measured fast read throughput
+};
+
+/**
+ * @brief Per-chip outcome of a gang operation
+ */
+enum class FlashGangStatus : uint8_t {
+  OK = 0,       // Operation completed / data matches
+  SKIPPED = 1,  // Chip not in the request mask
+  WEL_FAIL = 2, // Write Enable not confirmed
+  TIMEOUT = 3,  // BUSY did not clear in time
+  MISMATCH = 4  // Verify found different data
+};
+
+/**
+ * @brief Result of a gang erase/program/verify run
+ */
+struct FlashGangResult {
+  uint8_t chips = 0;                   // Configured chip selects
+  uint8_t status[QSPI_MAX_CS] = {};    // FlashGangStatus per chip
+  uint32_t mismatch[QSPI_MAX_CS] = {}; // First differing address (verify)
+  uint16_t pages = 0;                  // Pages broadcast to the chips
+  uint16_t skipped = 0;                // All-0xFF pages skipped
+};
+
+/**
+ * @brief Device-side SPI NOR Flash algorithms built on top of QSPIDriver
+ *
+ * Keeps erase/program/poll sequences on the RP2040 so the host only ships
+ * data, not individual status-poll frames. Command phases run in 1-1-1 mode
+ * (the data phase of page program may use Quad) and the previous QSPIDriver
+ * mode is restored when done.
+ */
+class SPIFlash {
+public:
+  SPIFlash(QSPIDriver &driver) : qspi(driver) {}
+
+  /**
+   * @brief Read Status Register (0x05 = SR1, 0x35 = SR2, 0x15 = SR3)
+   */
+  uint8_t readStatus(uint8_t cmd = 0x05);
+
+  /**
+   * @brief Send Write Enable (0x06) and confirm the WEL bit
+   * @return true if WEL is set
+   */
+  bool writeEnable();
+
+  /**
+   * @brief Poll SR1 until BUSY clears
+   * @param timeoutMs Maximum wait time
+   * @return true if the chip became ready in time
+   */
+  bool waitReady(uint32_t timeoutMs);
+
+  /**
+   * @brief Normal read (0x03 / 0x13)
+   */
+  void read(uint32_t addr, uint8_t *data, uint32_t len);
+
+  /**
+   * @brief Fast read using the opcode and dummy cycles of the current mode
+   *
+   * The bus stays in the caller's QSPIMode (Dual/Quad/QPI data phases).
+   * With read chaining enabled, CS is held after the read so a contiguous
+   * follow-up read only clocks data. In Dual/Quad I/O and QPI the
+   * continuous-read mode bits are set, so a non-contiguous follow-up read
+   * skips the opcode. Any other command ends the chain. Buffered
+   * read-ahead data is used first (see setReadAhead).
+   */
+  void fastRead(uint32_t addr, uint8_t *data, uint32_t len);
+
+  /**
+   * @brief Switch the bus to mode, including the chip-side transitions
+   *
+   * Sets QE for the quad modes and enters/exits QPI (0x38 / 0xFF) as
+   * needed.
+   * @return false if a quad mode was requested but QE could not be set
+   * (the bus is left in Standard mode)
+   */
+  bool setBusMode(QSPIMode mode);
+
+  /**
+   * @brief Try every QSPIMode against a Standard-mode reference read
+   *
+   * Each mode is entered with setBusMode (QPI included), must read the
+   * region back twice and the second read is timed. The fastest correct
+   * mode is left active; otherwise the previous mode is restored.
+   * @param ref,buf Scratch buffers of len bytes
+   * @param results QSPI_MODE_COUNT entries
+   * @return Selected mode, -1 if none matched, -2 if the region is blank
+   * or uniform (useless as a reference)
+   */
+  int8_t probeModes(uint32_t addr, uint16_t len, uint8_t *ref, uint8_t *buf,
+                    FlashModeProbe *results);
+
+  /**
+   * @brief Enable or disable read chaining / continuous-read mode
+   */
+  void setReadChaining(bool enable);
+  bool getReadChaining() const { return readChaining; }
+
+  /**
+   * @brief Enable or disable the sequential read-ahead buffer
+   *
+   * After a read of [addr, addr+n) the next n bytes (up to
+   * FLASH_READAHEAD_SIZE) are prefetched from update(), so a contiguous
+   * follow-up read is answered from RAM. Anything that may change the
+   * array contents or the bus setup drops the buffer.
+   */
+  void setReadAhead(bool enable);
+  bool getReadAhead() const { return readAhead; }
+
+  /**
+   * @brief Serve a read from the read-ahead buffer
+   * @return false (nothing copied) unless the whole range is buffered
+   */
+  bool readAheadHit(uint32_t addr, uint8_t *data, uint32_t len);
+
+  /**
+   * @brief Start prefetching len bytes at addr (after a raw read)
+   */
+  void armReadAhead(uint32_t addr, uint32_t len);
+
+  /**
+   * @brief Drop buffered data and stop prefetching
+   */
+  void invalidateReadAhead() {
+    aheadLen = 0;
+    aheadTarget = 0;
+  }
+
+  /**
+   * @brief Prefetch one FLASH_READAHEAD_CHUNK of the read-ahead window
+   * Call from loop().
+   */
+  void update();
+
+  const FlashReadStats &getReadStats() const { return readStats; }
+  void resetReadStats() { readStats = FlashReadStats(); }
+
+  /**
+   * @brief Erase a sector, block or the whole chip and wait for completion
+   */
+  bool erase(FlashEraseType type, uint32_t addr);
+
+  /**
+   * @brief Send Write Enable and the erase command without waiting for BUSY
+   * @param expectedMs Typical duration of the erase
+   * @param timeoutMs Worst-case duration of the erase
+   * @return false if the type is invalid or WEL could not be set
+   */
+  bool startErase(FlashEraseType type, uint32_t addr, uint32_t &expectedMs,
+                  uint32_t &timeoutMs);
+
+  /**
+   * @brief Check the SR1 BUSY bit
+   */
+  bool isBusy();
+
+  /**
+   * @brief Erase one 4KB sector (0x20 / 0x21) and wait for completion
+   */
+  bool eraseSector(uint32_t addr) {
+    return erase(FlashEraseType::SECTOR_4K, addr);
+  }
+
+  /**
+   * @brief Program up to one page and wait for completion
+   *
+   * Uses Quad Page Program (0x32, or 0x38 4PP on Macronix) when quad writes
+   * are enabled and the QE bit can be set, otherwise Page Program (0x02).
+   * @note Data must not cross a page boundary
+   */
+  bool programPage(uint32_t addr, const uint8_t *data, uint16_t len,
+                   FlashProgramResult *stats = nullptr);
+
+  /**
+   * @brief Like programPage, but return as soon as the data is clocked out
+   *
+   * The caller polls isBusy() for tPP completion.
+   */
+  bool startProgramPage(uint32_t addr, const uint8_t *data, uint16_t len,
+                        FlashProgramResult *stats = nullptr);
+
+  /**
+   * @brief Make sure the status register QE bit is set (vendor-specific)
+   *
+   * Result is cached, so the status register is only touched once per chip.
+   * @return true if quad data phases can be used
+   */
+  bool ensureQuadEnable();
+
+  /**
+   * @brief Enable or disable quad page programming
+   */
+  void setQuadWrites(bool enable) { quadWrites = enable; }
+  bool getQuadWrites() const { return quadWrites; }
+  FlashQEState getQEState() const { return qeState; }
+
+  /**
+   * @brief Select how >16MB addresses are handled
+   * Leaving EN4B mode sends Exit 4-Byte Address Mode (0xE9).
+   */
+  void setAddrMode(FlashAddrMode mode);
+  FlashAddrMode getAddrMode() const { return addrMode; }
+
+  /**
+   * @brief Forget cached chip state (after raw status writes or reset)
+   */
+  void invalidate() {
+    invalidateReadAhead();
+    qeState = FlashQEState::UNKNOWN;
+    mfgId = 0;
+    capacityLog2 = 0;
+    in4ByteMode = false;
+  }
+
+  /**
+   * @brief Program an arbitrary range, splitting on page boundaries
+   *
+   * Pages that are entirely 0xFF are skipped (the target range must already
+   * be erased). With trimTail set, trailing 0xFF bytes of each page are not
+   * sent either, which shortens the transfer and tPP.
+   */
+  bool program(uint32_t addr, const uint8_t *data, uint16_t len,
+               bool trimTail, FlashProgramResult &result);
+
+  /**
+   * @brief Length of data once trailing 0xFF bytes are removed
+   * @return 0 if the buffer is blank
+   */
+  static uint16_t usedLength(const uint8_t *data, uint16_t len);
+
+  /**
+   * @brief Apply a list of in-place edits using a sector read-modify-write
+   *
+   * Edit list format: repeated [Addr:4][Len:2][Data:Len] (little-endian).
+   * Each affected sector is read into RAM and patched. If the edits only
+   * clear bits (1->0) the dirty pages are programmed directly without an
+   * erase; otherwise the sector is erased and only non-blank pages are
+   * reprogrammed.
+   *
+   * @return false on malformed edit list or flash timeout
+   */
+  bool patch(const uint8_t *edits, uint16_t len, FlashPatchResult &result);
+
+  /**
+   * @brief Gang erase: WREN and erase broadcast to every chip in mask
+   *
+   * Chips share CLK/IO and are selected by the QSPIDriver chip-select set.
+   * WEL and BUSY are checked chip by chip; failing chips drop out.
+   * @param mask Bit n selects chip n
+   * @return Mask of chips that completed successfully
+   */
+  uint8_t gangErase(FlashEraseType type, uint32_t addr, uint8_t mask,
+                    FlashGangResult &result);
+
+  /**
+   * @brief Gang program: each page is clocked out once for all chips
+   *
+   * Uses Page Program (0x02 / 0x12) in 1-1-1, blank pages are skipped.
+   * @return Mask of chips that completed successfully
+   */
+  uint8_t gangProgram(uint32_t addr, const uint8_t *data, uint16_t len,
+                      uint8_t mask, FlashGangResult &result);
+
+  /**
+   * @brief Read back each chip in mask and compare against data
+   * @return Mask of chips whose contents match
+   */
+  uint8_t gangVerify(uint32_t addr, const uint8_t *data, uint16_t len,
+                     uint8_t mask, FlashGangResult &result);
+
+private:
+  QSPIDriver &qspi;
+
+  // Cached chip state
+  bool quadWrites = true;
+  FlashQEState qeState = FlashQEState::UNKNOWN;
+  uint8_t mfgId = 0;        // JEDEC manufacturer, 0 = not read yet
+  uint8_t capacityLog2 = 0; // JEDEC capacity byte (log2 of size in bytes)
+  FlashAddrMode addrMode = FlashAddrMode::AUTO;
+  bool in4ByteMode = false; // EN4B issued since last invalidate
+
+  // Read chaining
+  bool readChaining = true;
+  uint8_t continuousOpcode = 0; // Opcode the chip's continuous mode serves
+  uint8_t continuousAddrLen = 0;
+  FlashReadStats readStats;
+
+  // Read-ahead window: aheadBuf holds [aheadAddr, aheadAddr + aheadLen)
+  // and is filled up to aheadTarget bytes
+  bool readAhead = true;
+  uint8_t aheadBuf[FLASH_READAHEAD_SIZE];
+  uint32_t aheadAddr = 0;
+  uint32_t aheadLen = 0;
+  uint32_t aheadTarget = 0;
+
+  void fastReadBus(uint32_t addr, uint8_t *data, uint32_t len);
+
+  uint8_t readManufacturer();
+  bool qeBitSet();
+
+  /**
+   * @brief Pick opcode and address width for an access at addr
+   * @param opcode 3-byte opcode, replaced by its 4-byte variant if needed
+   * @param len Access length (a 3-byte read must not run past 16MB)
+   * @return Number of address bytes (3 or 4)
+   */
+  uint8_t resolveAddress(uint8_t &opcode, uint32_t addr, uint32_t len = 1);
+
+  // Gang helpers
+  uint8_t gangStart(uint8_t mask, FlashGangResult &result);
+  uint8_t gangWriteEnable(uint8_t mask, FlashGangResult &result);
+  uint8_t gangWaitReady(uint8_t mask, uint32_t timeoutMs,
+                        FlashGangResult &result);
+  uint8_t gangAddress(uint8_t &opcode, uint32_t addr, uint32_t len);
+
+  // Sector read-modify-write state
+  uint8_t sectorBuf[FLASH_SECTOR_SIZE];
+  uint32_t sectorAddr = 0;
+  uint16_t dirtyPages = 0; // One bit per page in sectorBuf
+  bool sectorLoaded = false;
+  bool needsErase = false;
+
+  bool loadSector(uint32_t addr, FlashPatchResult &result);
+  bool flushSector(FlashPatchResult &result);
+};
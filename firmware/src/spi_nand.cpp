@@ -0,0 +1,514 @@
+#include "spi_nand.h"
+#include "Logger.h"
+#include <cstring>
+
+// Define Trace Tag
+#define TAG "NAND"
+
+// SPI NAND commands (common to W25N, GD5F and MT29F)
+#define NAND_CMD_RESET 0xFF
+#define NAND_CMD_READ_ID 0x9F
+#define NAND_CMD_GET_FEATURE 0x0F
+#define NAND_CMD_SET_FEATURE 0x1F
+#define NAND_CMD_WRITE_ENABLE 0x06
+#define NAND_CMD_PAGE_READ 0x13     // Array -> cache
+#define NAND_CMD_CACHE_SEQ 0x31     // Cache <- next page, load the one after
+#define NAND_CMD_CACHE_END 0x3F     // Cache <- last loaded page
+#define NAND_CMD_READ_CACHE 0x0B    // Fast read from cache
+#define NAND_CMD_READ_CACHE_X4 0x6B // 1-1-4 read from cache
+#define NAND_CMD_PROGRAM_LOAD 0x02
+#define NAND_CMD_PROGRAM_LOAD_X4 0x32
+#define NAND_CMD_PROGRAM_EXECUTE 0x10
+#define NAND_CMD_BLOCK_ERASE 0xD8
+
+// Feature registers
+#define NAND_REG_PROTECT 0xA0
+#define NAND_REG_CONFIG 0xB0
+#define NAND_REG_STATUS 0xC0
+
+#define NAND_CFG_ECC_EN 0x10
+#define NAND_CFG_BUF 0x08 // Winbond: 1 = buffer read, 0 = continuous read
+#define NAND_CFG_QE 0x01  // GigaDevice
+
+#define NAND_SR_BUSY 0x01 // Operation in progress
+#define NAND_SR_E_FAIL 0x04
+#define NAND_SR_P_FAIL 0x08
+#define NAND_SR_ECC_SHIFT 4
+#define NAND_SR_CRBSY 0x80 // Micron: next page still loading after 0x31
+
+// Continuous read (BUF = 0) has no column: four dummy bytes
+#define NAND_CONTINUOUS_DUMMY 32
+
+static const NandChip nandChips[] = {
+    // Name, Mfg, Dev, Page, Spare, Pages/Block, Blocks, Planes, Flags
+    {"W25N01GV", 0xEF, {0xAA, 0x21}, 2048, 64, 64, 1024, 1,
+     NAND_FLAG_CONTINUOUS | NAND_FLAG_ECC3_FAIL},
+    {"W25N02KV", 0xEF, {0xAA, 0x22}, 2048, 128, 64, 2048, 1,
+     NAND_FLAG_CONTINUOUS | NAND_FLAG_ECC3_FAIL},
+    {"GD5F1GQ4U", 0xC8, {0xB1, 0}, 2048, 128, 64, 1024, 1, NAND_FLAG_QE},
+    {"GD5F2GQ4U", 0xC8, {0xB2, 0}, 2048, 128, 64, 2048, 1, NAND_FLAG_QE},
+    {"GD5F1GQ5U", 0xC8, {0x51, 0}, 2048, 128, 64, 1024, 1, NAND_FLAG_QE},
+    {"MT29F1G01ABAFD", 0x2C, {0x14, 0}, 2048, 128, 64, 1024, 1,
+     NAND_FLAG_CACHE_SEQ},
+    {"MT29F2G01ABAGD", 0x2C, {0x24, 0}, 2048, 128, 64, 2048, 2,
+     NAND_FLAG_CACHE_SEQ},
+};
+#define NAND_CHIP_COUNT (sizeof(nandChips) / sizeof(nandChips[0]))
+
+// ============== REGISTERS ==============
+
+uint8_t SPINand::getFeature(uint8_t reg) {
+  uint8_t value = 0;
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_GET_FEATURE);
+  qspi.writeData(&reg, 1);
+  qspi.readData(&value, 1);
+  qspi.csHigh();
+  return value;
+}
+
+void SPINand::setFeature(uint8_t reg, uint8_t value) {
+  uint8_t data[2] = {reg, value};
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_SET_FEATURE);
+  qspi.writeData(data, 2);
+  qspi.csHigh();
+}
+
+void SPINand::writeEnable() {
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_WRITE_ENABLE);
+  qspi.csHigh();
+}
+
+bool SPINand::waitReady(uint32_t timeoutMs, uint8_t &status,
+                        uint8_t busyMask) {
+  uint32_t start = millis();
+  while ((status = getFeature(NAND_REG_STATUS)) & busyMask) {
+    if (millis() - start > timeoutMs) {
+      LOG_ERROR(TAG, "Timeout waiting for OIP to clear");
+      return false;
+    }
+  }
+  return true;
+}
+
+NandEcc SPINand::checkEcc(uint8_t status) {
+  uint8_t ecc = (status >> NAND_SR_ECC_SHIFT) & 0x03;
+  if (ecc == 0)
+    return NandEcc::OK;
+  if (ecc == 2 || (ecc == 3 && (chip->flags & NAND_FLAG_ECC3_FAIL))) {
+    stats.uncorrectable++;
+    return NandEcc::FAILED;
+  }
+  stats.corrected++;
+  return NandEcc::CORRECTED;
+}
+
+void SPINand::setBufMode(bool buf) {
+  if (!(chip->flags & NAND_FLAG_CONTINUOUS) || buf == bufMode)
+    return;
+  uint8_t cfg = getFeature(NAND_REG_CONFIG);
+  setFeature(NAND_REG_CONFIG,
+             buf ? (cfg | NAND_CFG_BUF) : (cfg & ~NAND_CFG_BUF));
+  bufMode = buf;
+}
+
+// ============== IDENTIFY ==============
+
+bool SPINand::identify() {
+  endRead();
+  chip = nullptr;
+  // A QPI state left by a NOR session does not apply to this chip
+  if (qspi.isQPIActive())
+    qspi.exitQPI();
+  QSPIModeGuard guard(qspi);
+
+  uint8_t status;
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_RESET);
+  qspi.csHigh();
+  waitReady(NAND_TIMEOUT_RESET_MS, status);
+
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_READ_ID);
+  qspi.sendDummyCycles(8);
+  qspi.readData(id, 3);
+  qspi.csHigh();
+
+  for (uint8_t i = 0; i < NAND_CHIP_COUNT; i++) {
+    const NandChip &c = nandChips[i];
+    if (c.mfgId == id[0] && c.devId[0] == id[1] &&
+        (c.devId[1] == 0 || c.devId[1] == id[2])) {
+      chip = &c;
+      break;
+    }
+  }
+  if (!chip) {
+    LOG_ERROR(TAG, "No known SPI NAND answered the ID read");
+    return false;
+  }
+  LOG_INFO(TAG, chip->name);
+
+  // Unlock all blocks, on-die ECC on, buffer (page) read mode
+  setFeature(NAND_REG_PROTECT, 0x00);
+  uint8_t cfg = getFeature(NAND_REG_CONFIG) | NAND_CFG_ECC_EN;
+  if (chip->flags & NAND_FLAG_QE)
+    cfg |= NAND_CFG_QE;
+  if (chip->flags & NAND_FLAG_CONTINUOUS)
+    cfg |= NAND_CFG_BUF;
+  setFeature(NAND_REG_CONFIG, cfg);
+  bufMode = true;
+
+  scanBadBlocks();
+  return true;
+}
+
+// ============== BAD BLOCKS ==============
+
+uint16_t SPINand::scanBadBlocks() {
+  memset(badMap, 0, sizeof(badMap));
+  badCount = 0;
+  if (!chip)
+    return 0;
+
+  QSPIModeGuard guard(qspi);
+  setBufMode(true);
+  for (uint16_t block = 0; block < chip->blocks; block++) {
+    uint8_t status;
+    uint8_t marker = 0x00; // No answer counts as bad
+    if (loadPage((uint32_t)block * chip->pagesPerBlock, status))
+      readCache(planeColumn(block) + chip->pageSize, &marker, 1);
+    if (marker != 0xFF) {
+      badMap[block >> 3] |= 1 << (block & 7);
+      badCount++;
+    }
+  }
+  return badCount;
+}
+
+void SPINand::markBad(uint16_t block) {
+  if (isBad(block))
+    return;
+  badMap[block >> 3] |= 1 << (block & 7);
+  badCount++;
+  stats.newBad++;
+  LOG_WARN(TAG, "Block retired");
+
+  // Best effort: the marker keeps the block out of the next scan
+  static const uint8_t marker = 0x00;
+  if (programPage((uint32_t)block * chip->pagesPerBlock, &marker, 1,
+                  chip->pageSize))
+    stats.programmed--; // Not user data
+}
+
+int32_t SPINand::mapBlock(uint16_t logical) const {
+  if (!chip)
+    return -1;
+  for (uint16_t block = 0; block < chip->blocks; block++) {
+    if (isBad(block))
+      continue;
+    if (logical-- == 0)
+      return block;
+  }
+  return -1;
+}
+
+// ============== PAGE ACCESS ==============
+
+bool SPINand::loadPage(uint32_t row, uint8_t &status) {
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_PAGE_READ);
+  qspi.sendAddress(row, 3);
+  qspi.csHigh();
+  return waitReady(NAND_TIMEOUT_READ_MS, status);
+}
+
+bool SPINand::cacheOp(uint8_t cmd, uint8_t &status) {
+  qspi.csLow();
+  qspi.sendCommand(cmd);
+  qspi.csHigh();
+  return waitReady(NAND_TIMEOUT_READ_MS, status);
+}
+
+void SPINand::readCache(uint16_t col, uint8_t *buf, uint16_t len) {
+  // Opcode, column and dummy byte on IO0; data on 4 wires in 1-1-4
+  QSPIModeGuard guard(qspi, quad ? QSPIMode::QUAD_OUT : QSPIMode::STANDARD);
+  qspi.csLow();
+  qspi.sendCommand(quad ? NAND_CMD_READ_CACHE_X4 : NAND_CMD_READ_CACHE);
+  qspi.sendAddress(col, 2);
+  qspi.sendDummyCycles(8);
+  qspi.readData(buf, len);
+  qspi.csHigh();
+}
+
+NandEcc SPINand::readPage(uint32_t page, uint8_t *buf, uint16_t len,
+                          uint16_t col) {
+  QSPIModeGuard guard(qspi);
+  setBufMode(true);
+  uint8_t status;
+  if (!loadPage(page, status)) {
+    memset(buf, 0xFF, len);
+    return NandEcc::FAILED;
+  }
+  stats.pagesRead++;
+  NandEcc ecc = checkEcc(status);
+  readCache(planeColumn(page / chip->pagesPerBlock) + col, buf, len);
+  return ecc;
+}
+
+bool SPINand::programPage(uint32_t page, const uint8_t *data, uint16_t len,
+                          uint16_t col) {
+  QSPIModeGuard guard(qspi);
+  col += planeColumn(page / chip->pagesPerBlock);
+  writeEnable();
+  {
+    // Program Load clears the cache to 0xFF, so only len bytes change
+    QSPIModeGuard load(qspi, quad ? QSPIMode::QUAD_OUT : QSPIMode::STANDARD);
+    qspi.csLow();
+    qspi.sendCommand(quad ? NAND_CMD_PROGRAM_LOAD_X4 : NAND_CMD_PROGRAM_LOAD);
+    qspi.sendAddress(col, 2);
+    qspi.writeData(data, len);
+    qspi.csHigh();
+  }
+
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_PROGRAM_EXECUTE);
+  qspi.sendAddress(page, 3);
+  qspi.csHigh();
+
+  uint8_t status;
+  if (!waitReady(NAND_TIMEOUT_PROGRAM_MS, status) ||
+      (status & NAND_SR_P_FAIL)) {
+    LOG_ERROR(TAG, "Program failed");
+    return false;
+  }
+  stats.programmed++;
+  return true;
+}
+
+bool SPINand::eraseBlock(uint16_t block) {
+  QSPIModeGuard guard(qspi);
+  writeEnable();
+  qspi.csLow();
+  qspi.sendCommand(NAND_CMD_BLOCK_ERASE);
+  qspi.sendAddress((uint32_t)block * chip->pagesPerBlock, 3);
+  qspi.csHigh();
+
+  uint8_t status;
+  if (!waitReady(NAND_TIMEOUT_ERASE_MS, status) ||
+      (status & NAND_SR_E_FAIL)) {
+    LOG_ERROR(TAG, "Erase failed");
+    return false;
+  }
+  stats.erased++;
+  return true;
+}
+
+// ============== PIPELINED READ ==============
+
+bool SPINand::startRead(uint32_t page, uint32_t count, bool raw,
+                        bool spare) {
+  endRead();
+  if (!chip || count == 0)
+    return false;
+  uint32_t blocks = raw ? chip->blocks : chip->blocks - badCount;
+  uint32_t pages = blocks * chip->pagesPerBlock;
+  if (page >= pages || count > pages - page)
+    return false;
+
+  rd = ReadState();
+  rd.active = true;
+  rd.raw = raw;
+  rd.spare = spare;
+  rd.page = page;
+  rd.end = page + count;
+  rd.pageLen = chip->pageSize + (spare ? chip->spareSize : 0);
+  return true;
+}
+
+bool SPINand::startPage() {
+  uint8_t status;
+  if (!rd.reload && rd.pipe == Pipe::CONTINUOUS) {
+    // The chip already moved on to this page under the held CS
+    stats.pagesRead++;
+    stats.pipelined++;
+    return true;
+  }
+
+  if (!rd.reload && rd.pipe == Pipe::CACHE_SEQ) {
+    // Cache <- loaded page; the one after it loads unless this is the last
+    QSPIModeGuard guard(qspi);
+    bool last = rd.page + 1 >= rd.blockEnd;
+    if (!cacheOp(last ? NAND_CMD_CACHE_END : NAND_CMD_CACHE_SEQ, status))
+      return false;
+    if (last)
+      rd.pipe = Pipe::NONE;
+    stats.pagesRead++;
+    stats.pipelined++;
+    checkEcc(status);
+    return true;
+  }
+
+  // Fresh page load: first page, new block or resume after interrupt()
+  endPipeline();
+  uint32_t block = rd.page / chip->pagesPerBlock;
+  int32_t phys = rd.raw ? (int32_t)block : mapBlock(block);
+  if (phys < 0 || phys >= chip->blocks)
+    return false;
+  rd.column = planeColumn(phys);
+  rd.blockEnd = (block + 1) * chip->pagesPerBlock;
+  if (rd.blockEnd > rd.end)
+    rd.blockEnd = rd.end;
+  uint32_t row =
+      (uint32_t)phys * chip->pagesPerBlock + rd.page % chip->pagesPerBlock;
+
+  // Pipeline the rest of the block (a resumed page is read from the cache)
+  bool more = rd.offset == 0 && rd.page + 1 < rd.blockEnd;
+  bool continuous = more && !rd.spare && (chip->flags & NAND_FLAG_CONTINUOUS);
+  {
+    QSPIModeGuard guard(qspi);
+    setBufMode(!continuous);
+    if (!loadPage(row, status))
+      return false;
+    if (more && (chip->flags & NAND_FLAG_CACHE_SEQ)) {
+      if (!cacheOp(NAND_CMD_CACHE_SEQ, status))
+        return false;
+      rd.pipe = Pipe::CACHE_SEQ;
+    }
+  }
+  stats.pagesRead++;
+  checkEcc(status);
+  rd.reload = false;
+
+  if (continuous) {
+    // Data phase stays open across readNext calls until the block ends
+    rd.prevMode = qspi.getMode();
+    qspi.setMode(quad ? QSPIMode::QUAD_OUT : QSPIMode::STANDARD);
+    qspi.csLow();
+    qspi.sendCommand(quad ? NAND_CMD_READ_CACHE_X4 : NAND_CMD_READ_CACHE);
+    qspi.sendDummyCycles(NAND_CONTINUOUS_DUMMY);
+    rd.pipe = Pipe::CONTINUOUS;
+  }
+  return true;
+}
+
+uint16_t SPINand::readNext(uint8_t *buf, uint16_t maxLen) {
+  if (!rd.active || rd.page >= rd.end)
+    return 0;
+  if ((rd.offset == 0 || rd.reload) && !startPage()) {
+    endRead();
+    return 0;
+  }
+
+  uint16_t n = rd.pageLen - rd.offset;
+  if (n > maxLen)
+    n = maxLen;
+  if (rd.pipe == Pipe::CONTINUOUS)
+    qspi.readData(buf, n);
+  else
+    readCache(rd.column + rd.offset, buf, n);
+
+  rd.offset += n;
+  if (rd.offset == rd.pageLen) {
+    rd.offset = 0;
+    rd.page++;
+    if (rd.page >= rd.blockEnd)
+      endContinuous();
+  }
+  return n;
+}
+
+void SPINand::endContinuous() {
+  if (rd.pipe != Pipe::CONTINUOUS)
+    return;
+  qspi.csHigh();
+  qspi.setMode(rd.prevMode);
+  rd.pipe = Pipe::NONE;
+
+  // Status covers every page streamed since the page load
+  QSPIModeGuard guard(qspi);
+  checkEcc(getFeature(NAND_REG_STATUS));
+}
+
+void SPINand::endPipeline() {
+  endContinuous();
+  if (rd.pipe == Pipe::CACHE_SEQ) {
+    // Let the page loading in the background finish
+    QSPIModeGuard guard(qspi);
+    uint8_t status;
+    waitReady(NAND_TIMEOUT_READ_MS, status, NAND_SR_BUSY | NAND_SR_CRBSY);
+  }
+  rd.pipe = Pipe::NONE;
+}
+
+void SPINand::endRead() {
+  endPipeline();
+  rd.active = false;
+}
+
+void SPINand::interrupt() {
+  if (!rd.active)
+    return;
+  endPipeline();
+  rd.reload = true;
+}
+
+// ============== LOGICAL PROGRAM / ERASE ==============
+
+bool SPINand::programLogical(uint32_t page, const uint8_t *data, uint16_t len,
+                             bool autoErase, NandProgramStatus &status,
+                             uint16_t &block) {
+  if (!chip)
+    return false;
+  uint16_t logical = page / chip->pagesPerBlock;
+  uint16_t index = page % chip->pagesPerBlock;
+  bool blank = true;
+  for (uint16_t i = 0; i < len && blank; i++)
+    blank = data[i] == 0xFF;
+
+  for (;;) {
+    int32_t phys = mapBlock(logical);
+    if (phys < 0)
+      return false; // Out of good blocks
+    block = phys;
+
+    if (autoErase && index == 0 && !eraseBlock(block)) {
+      markBad(block);
+      continue;
+    }
+    if (blank) {
+      status = NandProgramStatus::BLANK;
+      return true;
+    }
+    if (programPage((uint32_t)block * chip->pagesPerBlock + index, data, len)) {
+      status = NandProgramStatus::OK;
+      return true;
+    }
+
+    // The logical block now maps to the next good one
+    markBad(block);
+    if (index != 0) {
+      status = NandProgramStatus::RETRY_BLOCK;
+      return true;
+    }
+  }
+}
+
+uint16_t SPINand::eraseLogical(uint16_t block, uint16_t count,
+                               uint16_t &newBad) {
+  uint16_t erased = 0;
+  newBad = 0;
+  while (erased < count) {
+    int32_t phys = mapBlock(block + erased);
+    if (phys < 0)
+      break;
+    if (eraseBlock(phys)) {
+      erased++;
+    } else {
+      markBad(phys);
+      newBad++;
+    }
+  }
+  return erased;
+}
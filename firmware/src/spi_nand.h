@@ -0,0 +1,242 @@
+#pragma once
+#include "qspi_driver.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+// Largest supported part: 4096 blocks (bad block table is a bitmap)
+#define NAND_MAX_BLOCKS 4096
+
+// Worst-case operation times (datasheet tRST / tRD / tPROG / tBERS max plus
+// margin)
+#define NAND_TIMEOUT_RESET_MS 5
+#define NAND_TIMEOUT_READ_MS 2
+#define NAND_TIMEOUT_PROGRAM_MS 5
+#define NAND_TIMEOUT_ERASE_MS 20
+
+// NandChip::flags
+#define NAND_FLAG_CACHE_SEQ 0x01  // Page Read Cache Sequential (0x31/0x3F)
+#define NAND_FLAG_CONTINUOUS 0x02 // Continuous read across pages (BUF = 0)
+#define NAND_FLAG_QE 0x04         // x4 commands need QE in the config reg
+#define NAND_FLAG_ECC3_FAIL 0x08  // ECC status 11b means uncorrectable
+
+/**
+ * @brief Geometry and capabilities of a known SPI NAND part
+ */
+struct NandChip {
+  const char *name;
+  uint8_t mfgId;
+  uint8_t devId[2]; // devId[1] == 0: one-byte device ID
+  uint16_t pageSize;
+  uint16_t spareSize;
+  uint16_t pagesPerBlock;
+  uint16_t blocks;
+  uint8_t planes; // 2: plane select is column bit 12 (= block bit 0)
+  uint8_t flags;
+};
+
+/**
+ * @brief On-die ECC result of a page moved into the cache
+ */
+enum class NandEcc : uint8_t {
+  OK = 0,        // No bit errors
+  CORRECTED = 1, // Bit errors corrected
+  FAILED = 2     // Uncorrectable, cache holds raw data
+};
+
+/**
+ * @brief Outcome of SPINand::programLogical
+ */
+enum class NandProgramStatus : uint8_t {
+  OK = 0,         // Page programmed
+  BLANK = 1,      // All-0xFF page skipped (block erased if requested)
+  RETRY_BLOCK = 2 // Block went bad after earlier pages: resend its pages
+};
+
+/**
+ * @brief NAND engine counters (reported by NAND_STATS)
+ */
+struct NandStats {
+  uint32_t pagesRead = 0;     // Pages moved into the cache
+  uint32_t pipelined = 0;     // ... while the next page was loading
+  uint32_t corrected = 0;     // Reads with corrected bit errors
+  uint32_t uncorrectable = 0; // Reads the ECC could not fix
+  uint32_t programmed = 0;    // Pages programmed
+  uint32_t erased = 0;        // Blocks erased
+  uint32_t newBad = 0;        // Blocks marked bad after a failed operation
+};
+
+/**
+ * @brief Device-side SPI NAND algorithms built on top of QSPIDriver
+ *
+ * Reads stream logical pages with factory and runtime bad blocks skipped:
+ * within a block, the next page is loaded into the data register while the
+ * host drains the cache (Cache Read Sequential), or the whole block is
+ * clocked out under one CS (Winbond continuous read). Program and erase
+ * failures mark the block bad and move on to the next good one. Command
+ * phases run in 1-1-1 mode, data phases in 1-1-4 unless quad is off, and
+ * the previous QSPIDriver mode is restored when done.
+ */
+class SPINand {
+public:
+  SPINand(QSPIDriver &driver) : qspi(driver) {}
+
+  /**
+   * @brief Reset, identify and configure the chip, then scan bad blocks
+   *
+   * Block protection is cleared and the on-die ECC enabled.
+   * @return false if no known SPI NAND answered (see getId)
+   */
+  bool identify();
+
+  const NandChip *getChip() const { return chip; }
+  const uint8_t *getId() const { return id; }
+
+  /**
+   * @brief Use 1-1-4 cache read (0x6B) and program load (0x32)
+   */
+  void setQuad(bool enable) { quad = enable; }
+  bool getQuad() const { return quad; }
+
+  // ============== BAD BLOCKS ==============
+
+  /**
+   * @brief Rebuild the bad block table from the factory markers
+   * (first spare byte of the first page != 0xFF)
+   * @return Number of bad blocks
+   */
+  uint16_t scanBadBlocks();
+
+  bool isBad(uint16_t block) const {
+    return badMap[block >> 3] & (1 << (block & 7));
+  }
+  uint16_t getBadCount() const { return badCount; }
+
+  /**
+   * @brief Record a block as bad and write its marker
+   */
+  void markBad(uint16_t block);
+
+  /**
+   * @brief Physical block of a logical block (bad blocks skipped)
+   * @return -1 past the last good block
+   */
+  int32_t mapBlock(uint16_t logical) const;
+
+  // ============== PAGE ACCESS (PHYSICAL) ==============
+
+  /**
+   * @brief Read part of a page (main area from column 0, spare after it)
+   */
+  NandEcc readPage(uint32_t page, uint8_t *buf, uint16_t len,
+                   uint16_t col = 0);
+
+  /**
+   * @brief Program part of a page (len may run into the spare area)
+   */
+  bool programPage(uint32_t page, const uint8_t *data, uint16_t len,
+                   uint16_t col = 0);
+
+  bool eraseBlock(uint16_t block);
+
+  // ============== LOGICAL ACCESS ==============
+
+  /**
+   * @brief Start a pipelined read of count pages
+   * @param raw Physical pages, bad blocks are not skipped
+   * @param spare Append the spare area to every page
+   */
+  bool startRead(uint32_t page, uint32_t count, bool raw, bool spare);
+
+  /**
+   * @brief Continue the read started by startRead
+   * @return Bytes stored (at most maxLen, never past a page end), 0 when
+   * done or if the chip stopped answering
+   */
+  uint16_t readNext(uint8_t *buf, uint16_t maxLen);
+
+  /**
+   * @brief Bytes per page delivered by readNext
+   */
+  uint16_t getReadPageLen() const { return rd.pageLen; }
+
+  /**
+   * @brief Close the read (releases a held continuous-read CS)
+   */
+  void endRead();
+
+  /**
+   * @brief The bus was used by another driver: resume with a fresh page
+   * load on the next readNext
+   */
+  void interrupt();
+
+  /**
+   * @brief Program a logical page, skipping and retiring bad blocks
+   * @param autoErase Erase the block before its first page
+   * @param block Physical block used
+   * @return false if no good block is left
+   */
+  bool programLogical(uint32_t page, const uint8_t *data, uint16_t len,
+                      bool autoErase, NandProgramStatus &status,
+                      uint16_t &block);
+
+  /**
+   * @brief Erase count logical blocks (failing blocks are retired)
+   * @return Blocks erased
+   */
+  uint16_t eraseLogical(uint16_t block, uint16_t count, uint16_t &newBad);
+
+  const NandStats &getStats() const { return stats; }
+  void resetStats() { stats = NandStats(); }
+
+private:
+  QSPIDriver &qspi;
+  const NandChip *chip = nullptr;
+  uint8_t id[3] = {0};
+  bool quad = true;
+  bool bufMode = true; // Winbond BUF bit (false = continuous read)
+
+  uint8_t badMap[NAND_MAX_BLOCKS / 8] = {0};
+  uint16_t badCount = 0;
+  NandStats stats;
+
+  // Pipeline of a running read
+  enum class Pipe : uint8_t {
+    NONE,      // Every page is loaded with 0x13
+    CACHE_SEQ, // Next page loading in the data register (0x31)
+    CONTINUOUS // CS held, the chip streams pages of the block
+  };
+  struct ReadState {
+    bool active = false;
+    bool raw = false;
+    bool spare = false;
+    bool reload = false; // Bus was lost: reload the current page
+    Pipe pipe = Pipe::NONE;
+    uint32_t page = 0;     // Logical page being delivered
+    uint32_t end = 0;      // First page not to deliver
+    uint32_t blockEnd = 0; // First page past the current block
+    uint16_t offset = 0;   // Byte offset in the current page
+    uint16_t pageLen = 0;  // Main area (+ spare)
+    uint16_t column = 0;   // Plane select of the current block
+    QSPIMode prevMode = QSPIMode::STANDARD; // Restored by endContinuous
+  } rd;
+
+  uint8_t getFeature(uint8_t reg);
+  void setFeature(uint8_t reg, uint8_t value);
+  void writeEnable();
+  bool waitReady(uint32_t timeoutMs, uint8_t &status,
+                 uint8_t busyMask = 0x01); // OIP
+  NandEcc checkEcc(uint8_t status);
+  void setBufMode(bool buf);
+
+  bool loadPage(uint32_t row, uint8_t &status);
+  bool cacheOp(uint8_t cmd, uint8_t &status);
+  void readCache(uint16_t col, uint8_t *buf, uint16_t len);
+  bool startPage();
+  void endContinuous();
+  void endPipeline();
+
+  uint16_t planeColumn(uint16_t block) const {
+    return (chip->planes > 1 && (block & 1)) ? 0x1000 : 0;
+  }
+};
@@ -0,0 +1,364 @@
+#include "stm32_loader.h"
+
+// Cortex-M debug registers
+#define CM_AIRCR 0xE000ED0C
+#define CM_DHCSR 0xE000EDF0
+#define CM_DCRSR 0xE000EDF4
+#define CM_DCRDR 0xE000EDF8
+#define CM_DEMCR 0xE000EDFC
+
+#define CM_DBGKEY 0xA05F0000
+#define CM_C_DEBUGEN 0x01
+#define CM_C_HALT 0x02
+#define CM_S_REGRDY (1u << 16)
+#define CM_S_HALT (1u << 17)
+#define CM_DCRSR_WRITE (1u << 16)
+#define CM_VC_CORERESET 0x01
+#define CM_SYSRESETREQ 0x05FA0004
+
+// Core register numbers (DCRSR REGSEL)
+#define CM_REG_R0 0
+#define CM_REG_SP 13
+#define CM_REG_PC 15
+#define CM_REG_XPSR 16
+#define CM_XPSR_THUMB 0x01000000
+
+// DBGMCU_IDCODE (DEV_ID in bits 11:0), same address on F1 and F4
+#define STM32_DBGMCU_IDCODE 0xE0042000
+
+// Flash interface (offsets from Stm32FlashAlgo::regBase)
+#define STM32_FLASH_KEYR 0x04
+#define STM32_FLASH_SR 0x0C
+#define STM32_FLASH_CR 0x10
+#define STM32_FLASH_KEY1 0x45670123
+#define STM32_FLASH_KEY2 0xCDEF89AB
+
+// Mailbox (offsets from STM32_LOADER_MAILBOX, the stub's r0)
+#define STM32_MB_SR_ADDR 0x00
+#define STM32_MB_BUSY 0x04
+#define STM32_MB_ERROR 0x08
+#define STM32_MB_WIDTH 0x0C
+#define STM32_MB_DESC 0x10 // Two descriptors, 16 bytes each
+
+// Descriptor: [Dest:4][Len:4][Src:4][State:4], state written last
+#define STM32_DESC_SIZE 0x10
+#define STM32_DESC_STATE 0x0C
+#define STM32_STATE_EMPTY 0
+#define STM32_STATE_FULL 1
+#define STM32_STATE_ERROR 0x80000000 // | SR error bits, stub halted
+
+// ============================================
+// Loader stub (Thumb-1, runs on Cortex-M3 and M4)
+//
+// Entry: r0 = mailbox. Descriptors are served in turn; the mailbox is
+// 64-byte aligned so EOR 0x30 switches between them. Any state other than
+// EMPTY / FULL stops the stub.
+// ============================================
+static const uint16_t stm32_stub[] = {
+    0x68c4, // 00: start: ldr  r4, [r0, #12]  (width)
+    0x2510, // 02:        movs r5, #16
+    0x182d, // 04:        adds r5, r5, r0     (descriptor 0)
+    0x68ea, // 06: wait:  ldr  r2, [r5, #12]  (state)
+    0x2a00, // 08:        cmp  r2, #0
+    0xd0fc, // 0a:        beq  wait
+    0x2a01, // 0c:        cmp  r2, #1
+    0xd11d, // 0e:        bne  exit
+    0x682e, // 10:        ldr  r6, [r5, #0]   (dest)
+    0x686f, // 12:        ldr  r7, [r5, #4]   (len)
+    0x68a9, // 14:        ldr  r1, [r5, #8]   (src)
+    0x2c02, // 16: copy:  cmp  r4, #2
+    0xd102, // 18:        bne  word
+    0x880a, // 1a:        ldrh r2, [r1]
+    0x8032, // 1c:        strh r2, [r6]
+    0xe001, // 1e:        b    busy
+    0x680a, // 20: word:  ldr  r2, [r1]
+    0x6032, // 22:        str  r2, [r6]
+    0x6803, // 24: busy:  ldr  r3, [r0, #0]   (SR address)
+    0x681a, // 26:        ldr  r2, [r3]
+    0x6843, // 28:        ldr  r3, [r0, #4]   (busy mask)
+    0x421a, // 2a:        tst  r2, r3
+    0xd1fa, // 2c:        bne  busy
+    0x6883, // 2e:        ldr  r3, [r0, #8]   (error mask)
+    0x401a, // 30:        ands r2, r3
+    0xd107, // 32:        bne  error
+    0x1909, // 34:        adds r1, r1, r4
+    0x1936, // 36:        adds r6, r6, r4
+    0x1b3f, // 38:        subs r7, r7, r4
+    0xd1ec, // 3a:        bne  copy
+    0x60ef, // 3c:        str  r7, [r5, #12]  (EMPTY)
+    0x2330, // 3e:        movs r3, #0x30
+    0x405d, // 40:        eors r5, r3         (other descriptor)
+    0xe7e0, // 42:        b    wait
+    0x2301, // 44: error: movs r3, #1
+    0x07db, // 46:        lsls r3, r3, #31
+    0x431a, // 48:        orrs r2, r3
+    0x60ea, // 4a:        str  r2, [r5, #12]  (ERROR | SR bits)
+    0xbe00, // 4c: exit:  bkpt #0
+    0xe7fd, // 4e:        b    exit
+};
+
+static_assert(sizeof(stm32_stub) <= STM32_LOADER_MAILBOX,
+              "Loader stub overlaps the mailbox");
+
+// ============================================
+// Flash algorithms
+// ============================================
+
+// STM32F1: halfword programming, BSY in SR bit 0
+static const Stm32FlashAlgo stm32f1 = {
+    0x40022000, // regBase
+    0x00000001, // srBusy: BSY
+    0x00000014, // srError: WRPRTERR | PGERR
+    0x00000001, // crProgram: PG
+    0x00000004, // crMassErase: MER
+    0x00000000, // crMassEraseLarge
+    0x00000040, // crStart: STRT
+    0x00000080, // crLock: LOCK
+    0x1FFFF7E0, // flashSizeReg
+    1024,       // bufferSize (fits 6KB SRAM parts)
+    2,          // width
+};
+
+// STM32F4: word programming (PSIZE x32, VDD 2.7 - 3.6 V), BSY in SR bit 16
+static const Stm32FlashAlgo stm32f4 = {
+    0x40023C00, // regBase
+    0x00010000, // srBusy: BSY
+    0x000000F2, // srError: PGSERR | PGPERR | PGAERR | WRPERR | OPERR
+    0x00000201, // crProgram: PSIZE x32 | PG
+    0x00000204, // crMassErase: PSIZE x32 | MER
+    0x00008000, // crMassEraseLarge: MER1
+    0x00010000, // crStart: STRT
+    0x80000000, // crLock: LOCK
+    0x1FFF7A22, // flashSizeReg
+    4096,       // bufferSize
+    4,          // width
+};
+
+static const Stm32FlashAlgo *findAlgo(uint16_t devId) {
+  switch (devId) {
+  case 0x412: // F10x low density
+  case 0x410: // F10x medium density
+  case 0x414: // F10x high density
+  case 0x418: // F105/107
+  case 0x420: // F100 low / medium density
+  case 0x428: // F100 high density
+    return &stm32f1;
+  case 0x413: // F405/407/415/417
+  case 0x419: // F42x/43x
+  case 0x423: // F401xB/C
+  case 0x433: // F401xD/E
+  case 0x431: // F411
+  case 0x434: // F469/479
+  case 0x421: // F446
+  case 0x441: // F412
+  case 0x458: // F410
+  case 0x463: // F413/423
+    return &stm32f4;
+  default:
+    // XL-density F1 (0x430) has a second bank interface: not supported
+    return nullptr;
+  }
+}
+
+// ============================================
+// Target access
+// ============================================
+
+bool STM32Loader::readWord(uint32_t addr, uint32_t &value) {
+  return _swd.memRead(addr, reinterpret_cast<uint8_t *>(&value), 4, 4);
+}
+
+bool STM32Loader::writeWord(uint32_t addr, uint32_t value) {
+  return _swd.memWrite(addr, reinterpret_cast<const uint8_t *>(&value), 4,
+                       4);
+}
+
+bool STM32Loader::writeCoreReg(uint8_t reg, uint32_t value) {
+  if (!writeWord(CM_DCRDR, value) || !writeWord(CM_DCRSR, CM_DCRSR_WRITE | reg))
+    return false;
+  uint32_t start = micros();
+  uint32_t dhcsr;
+  do {
+    if (!readWord(CM_DHCSR, dhcsr))
+      return false;
+    if (dhcsr & CM_S_REGRDY)
+      return true;
+  } while (micros() - start < STM32_TIMEOUT_HALT_US);
+  return false;
+}
+
+bool STM32Loader::resetHalt() {
+  // Vector catch: the core stops before the first instruction after reset
+  if (!writeWord(CM_DHCSR, CM_DBGKEY | CM_C_DEBUGEN | CM_C_HALT) ||
+      !writeWord(CM_DEMCR, CM_VC_CORERESET))
+    return false;
+  writeWord(CM_AIRCR, CM_SYSRESETREQ); // Response may be lost in the reset
+
+  uint32_t start = micros();
+  uint32_t dhcsr;
+  bool halted;
+  do {
+    // Accesses fail while the system is held in reset
+    halted = readWord(CM_DHCSR, dhcsr) && (dhcsr & CM_S_HALT);
+  } while (!halted && micros() - start < STM32_TIMEOUT_HALT_US);
+  return halted && writeWord(CM_DEMCR, 0);
+}
+
+bool STM32Loader::flashWait(uint32_t timeoutUs) {
+  uint32_t start = micros();
+  uint32_t sr;
+  do {
+    if (!readWord(_algo->regBase + STM32_FLASH_SR, sr))
+      return false;
+    if (!(sr & _algo->srBusy))
+      return !(sr & _algo->srError);
+  } while (micros() - start < timeoutUs);
+  return false;
+}
+
+uint32_t STM32Loader::descAddr(uint8_t desc) const {
+  return STM32_LOADER_RAM + STM32_LOADER_MAILBOX + STM32_MB_DESC +
+         desc * STM32_DESC_SIZE;
+}
+
+uint32_t STM32Loader::bufferAddr(uint8_t desc) const {
+  return STM32_LOADER_RAM + STM32_LOADER_BUFFERS + desc * _algo->bufferSize;
+}
+
+bool STM32Loader::loadStub() {
+  // Mailbox header, both descriptors EMPTY
+  uint32_t mailbox[(STM32_MB_DESC + 2 * STM32_DESC_SIZE) / 4] = {0};
+  mailbox[STM32_MB_SR_ADDR / 4] = _algo->regBase + STM32_FLASH_SR;
+  mailbox[STM32_MB_BUSY / 4] = _algo->srBusy;
+  mailbox[STM32_MB_ERROR / 4] = _algo->srError;
+  mailbox[STM32_MB_WIDTH / 4] = _algo->width;
+
+  uint32_t base = STM32_LOADER_RAM + STM32_LOADER_MAILBOX;
+  return _swd.memWrite(STM32_LOADER_RAM,
+                       reinterpret_cast<const uint8_t *>(stm32_stub),
+                       sizeof(stm32_stub), 4) &&
+         _swd.memWrite(base, reinterpret_cast<const uint8_t *>(mailbox),
+                       sizeof(mailbox), 4) &&
+         writeCoreReg(CM_REG_R0, base) &&
+         writeCoreReg(CM_REG_SP, bufferAddr(2) + STM32_LOADER_STACK) &&
+         writeCoreReg(CM_REG_PC, STM32_LOADER_RAM) &&
+         writeCoreReg(CM_REG_XPSR, CM_XPSR_THUMB) &&
+         writeWord(CM_DHCSR, CM_DBGKEY | CM_C_DEBUGEN); // Run
+}
+
+bool STM32Loader::waitEmpty(uint8_t desc) {
+  uint32_t start = micros();
+  uint32_t state;
+  do {
+    if (!readWord(descAddr(desc) + STM32_DESC_STATE, state))
+      return false;
+    if (state == STM32_STATE_EMPTY)
+      return true;
+    if (state & STM32_STATE_ERROR) {
+      _error = state & ~STM32_STATE_ERROR;
+      return false;
+    }
+  } while (micros() - start < STM32_TIMEOUT_BUFFER_US);
+  return false;
+}
+
+// ============================================
+// Programming session
+// ============================================
+
+Stm32LoaderStatus STM32Loader::begin(bool massErase) {
+  _running = false;
+  _next = 0;
+  _error = 0;
+  _devId = 0;
+  _flashSize = 0;
+  if (!_swd.isActive())
+    return Stm32LoaderStatus::NO_LINK;
+  if (!resetHalt())
+    return Stm32LoaderStatus::NO_HALT;
+
+  uint32_t idcode;
+  if (!readWord(STM32_DBGMCU_IDCODE, idcode))
+    return Stm32LoaderStatus::FAILED;
+  _devId = idcode & 0xFFF;
+  _algo = findAlgo(_devId);
+  if (!_algo)
+    return Stm32LoaderStatus::UNSUPPORTED;
+  uint16_t kb;
+  if (!_swd.memRead(_algo->flashSizeReg, reinterpret_cast<uint8_t *>(&kb), 2,
+                    2))
+    return Stm32LoaderStatus::FAILED;
+  _flashSize = (uint32_t)kb * 1024;
+
+  // Locked after the reset: unlock, then clear stale error flags
+  uint32_t base = _algo->regBase;
+  uint32_t cr;
+  if (!writeWord(base + STM32_FLASH_KEYR, STM32_FLASH_KEY1) ||
+      !writeWord(base + STM32_FLASH_KEYR, STM32_FLASH_KEY2) ||
+      !readWord(base + STM32_FLASH_CR, cr))
+    return Stm32LoaderStatus::FAILED;
+  if (cr & _algo->crLock)
+    return Stm32LoaderStatus::LOCKED;
+  if (!writeWord(base + STM32_FLASH_SR, _algo->srError))
+    return Stm32LoaderStatus::FAILED;
+
+  if (massErase) {
+    uint32_t mer = _algo->crMassErase;
+    if (_flashSize > 1024 * 1024)
+      mer |= _algo->crMassEraseLarge;
+    if (!writeWord(base + STM32_FLASH_CR, mer) ||
+        !writeWord(base + STM32_FLASH_CR, mer | _algo->crStart) ||
+        !flashWait(STM32_TIMEOUT_ERASE_US))
+      return Stm32LoaderStatus::ERASE_FAILED;
+  }
+
+  // PG stays set while the stub runs: it only writes the data
+  if (!writeWord(base + STM32_FLASH_CR, _algo->crProgram) || !loadStub())
+    return Stm32LoaderStatus::FAILED;
+  _running = true;
+  return Stm32LoaderStatus::OK;
+}
+
+bool STM32Loader::write(uint32_t addr, const uint8_t *data, uint16_t len) {
+  if (!_running || _error || ((addr | len) & 3) || addr < STM32_FLASH_BASE ||
+      addr - STM32_FLASH_BASE + len > _flashSize)
+    return false;
+
+  while (len) {
+    uint16_t n = len < _algo->bufferSize ? len : _algo->bufferSize;
+    // The stub programs the other buffer meanwhile
+    if (!waitEmpty(_next))
+      return false;
+    uint32_t desc[STM32_DESC_SIZE / 4] = {addr, n, bufferAddr(_next),
+                                          STM32_STATE_FULL};
+    if (!_swd.memWrite(bufferAddr(_next), data, n, 4) ||
+        !_swd.memWrite(descAddr(_next),
+                       reinterpret_cast<const uint8_t *>(desc), sizeof(desc),
+                       4))
+      return false;
+    _next ^= 1;
+    addr += n;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool STM32Loader::end(uint32_t &sr) {
+  sr = 0;
+  if (!_running)
+    return false;
+  _running = false;
+
+  // Oldest buffer first (the stub serves them in order)
+  bool drained = _error || (waitEmpty(_next) && waitEmpty(_next ^ 1));
+
+  // Stop the stub, lock the flash and run the application
+  bool ok = writeWord(CM_DHCSR, CM_DBGKEY | CM_C_DEBUGEN | CM_C_HALT) &&
+            writeWord(_algo->regBase + STM32_FLASH_CR, _algo->crLock) &&
+            writeWord(CM_DHCSR, CM_DBGKEY);
+  if (ok)
+    writeWord(CM_AIRCR, CM_SYSRESETREQ);
+  sr = _error;
+  return (drained || _error) && ok;
+}
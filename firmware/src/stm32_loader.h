@@ -0,0 +1,111 @@
+#pragma once
+#include "swd_driver.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+// Main flash of every supported part
+#define STM32_FLASH_BASE 0x08000000
+
+// Loader layout in target SRAM (offsets from STM32_LOADER_RAM): stub code,
+// mailbox (64-byte aligned, see stm32_loader.cpp), two data buffers and a
+// small stack above them
+#define STM32_LOADER_RAM 0x20000000
+#define STM32_LOADER_MAILBOX 0x080
+#define STM32_LOADER_BUFFERS 0x100
+#define STM32_LOADER_STACK 0x100
+
+// Timeouts
+#define STM32_TIMEOUT_HALT_US 100000    // Reset until the core halts
+#define STM32_TIMEOUT_BUFFER_US 1000000 // One buffer programmed by the stub
+#define STM32_TIMEOUT_ERASE_US 40000000 // Mass erase (2MB F4 at x32: 32s)
+
+/**
+ * @brief Flash algorithm descriptor (one per flash interface generation)
+ */
+struct Stm32FlashAlgo {
+  uint32_t regBase;          // FLASH interface registers
+  uint32_t srBusy;           // SR: operation in progress
+  uint32_t srError;          // SR: programming / protection errors (rc_w1)
+  uint32_t crProgram;        // CR while the stub programs (PG, PSIZE)
+  uint32_t crMassErase;      // CR for a mass erase, without STRT
+  uint32_t crMassEraseLarge; // Added above 1MB (second bank)
+  uint32_t crStart;
+  uint32_t crLock;
+  uint32_t flashSizeReg; // Flash size in KB (uint16)
+  uint16_t bufferSize;   // Bytes per SRAM buffer
+  uint8_t width;         // Program unit: 2 (halfword) or 4 (word)
+};
+
+/**
+ * @brief Outcome of STM32Loader::begin
+ */
+enum class Stm32LoaderStatus : uint8_t {
+  OK = 0,
+  NO_HALT = 1,     // Core did not halt after the reset
+  UNSUPPORTED = 2, // DEV_ID without a flash algorithm
+  LOCKED = 3,      // Flash interface did not unlock
+  ERASE_FAILED = 4,
+  FAILED = 5,  // SWD error while loading the stub
+  NO_LINK = 6  // SWD not initialised (SWDDriver::init not run)
+};
+
+/**
+ * @brief STM32 flash programming through a RAM-resident loader
+ *
+ * The core is reset and halted on its reset vector, the flash interface is
+ * unlocked and left in program mode, and a small Thumb stub is copied into
+ * SRAM through the MEM-AP. The stub serves two buffer descriptors in turn:
+ * it waits for a descriptor's state word to read FULL, programs the buffer
+ * polling SR.BSY, and writes the state back to EMPTY (or to the SR error
+ * bits with bit 31 set, then halts). The host fills one buffer while the
+ * stub programs the other, so the SWD link and the flash work in parallel.
+ * Requires SWDDriver::init first.
+ */
+class STM32Loader {
+public:
+  STM32Loader(SWDDriver &swd) : _swd(swd) {}
+
+  /**
+   * @brief Reset and halt the target, select the algorithm from DBGMCU
+   * DEV_ID, unlock the flash (mass erase optional) and start the stub
+   */
+  Stm32LoaderStatus begin(bool massErase);
+
+  /**
+   * @brief Queue data for programming (returns once it is in a buffer)
+   * @param addr Flash address, word aligned
+   * @param len Multiple of 4, inside the flash
+   */
+  bool write(uint32_t addr, const uint8_t *data, uint16_t len);
+
+  /**
+   * @brief Wait for both buffers, lock the flash and reset the target into
+   * its application
+   * @param sr Error bits reported by the stub (0: every write succeeded)
+   * @return false if the stub stopped answering or SWD failed
+   */
+  bool end(uint32_t &sr);
+
+  uint16_t getDeviceId() const { return _devId; }
+  uint32_t getFlashSize() const { return _flashSize; }
+
+private:
+  SWDDriver &_swd;
+  const Stm32FlashAlgo *_algo = nullptr;
+  uint16_t _devId = 0;
+  uint32_t _flashSize = 0;
+  bool _running = false;
+  uint8_t _next = 0;   // Descriptor the host fills next
+  uint32_t _error = 0; // SR error bits reported by the stub
+
+  bool readWord(uint32_t addr, uint32_t &value);
+  bool writeWord(uint32_t addr, uint32_t value);
+  bool writeCoreReg(uint8_t reg, uint32_t value);
+  bool resetHalt();
+  bool flashWait(uint32_t timeoutUs);
+  bool loadStub();
+  bool waitEmpty(uint8_t desc);
+
+  uint32_t descAddr(uint8_t desc) const;
+  uint32_t bufferAddr(uint8_t desc) const;
+};
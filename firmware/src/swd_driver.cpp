@@ -1,195 +1,335 @@
 #include "swd_driver.h"
 #include "Board.h"
 
+// Transfer request bits (see PIOSWD::transfer)
+#define SWD_REQ_AP 0x01
+#define SWD_REQ_READ 0x02
+
+// ABORT: DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR
+#define SWD_ABORT_ALL 0x1F
+#define SWD_ABORT_CLEAR 0x1E
+
+// CTRL/STAT
+#define SWD_CSYSPWRUPREQ (1u << 30)
+#define SWD_CDBGPWRUPREQ (1u << 28)
+#define SWD_CSYSPWRUPACK (1u << 31)
+#define SWD_CDBGPWRUPACK (1u << 29)
+
+#define SWD_STICKYERR (1u << 5)
+
+// Posted writes complete during these idle cycles
+#define SWD_IDLE_CYCLES 8
+
+// CSW fields
+#define SWD_CSW_INC_SINGLE 0x10 // TAR += access size
+#define SWD_CSW_INC_PACKED 0x20 // Several narrow accesses per DRW
+#define SWD_CSW_INC_MASK 0x30
+
 void SWDDriver::begin() {
-  pinMode(Board::PIN_SWD_CLK, OUTPUT);
-  pinMode(Board::PIN_SWD_DIO, OUTPUT);
-  digitalWrite(Board::PIN_SWD_CLK, LOW);
-}
-
-// Basic bit-banging implementation (simplified for prototype)
-// Real SWD requires strict timing and parity checks
-
-void SWDDriver::writeBits(uint32_t data, uint8_t bits) {
-  pinMode(Board::PIN_SWD_DIO, OUTPUT);
-  for (int i = 0; i < bits; i++) {
-    digitalWrite(Board::PIN_SWD_DIO, (data >> i) & 1);
-    digitalWrite(Board::PIN_SWD_CLK, LOW);
-    delayMicroseconds(1);
-    digitalWrite(Board::PIN_SWD_CLK, HIGH);
-    delayMicroseconds(1);
+  if (!phy.isActive())
+    phy.begin(Board::PIN_SWD_CLK, Board::PIN_SWD_DIO, clockHz);
+}
+
+bool SWDDriver::setClock(uint32_t hz) {
+  if (hz < SWD_CLOCK_MIN || hz > SWD_CLOCK_MAX)
+    return false;
+  clockHz = hz;
+  phy.setClock(hz);
+  return true;
+}
+
+void SWDDriver::lineReset() {
+  // At least 50 clocks with SWDIO high
+  phy.write(0xFFFFFFFF, 32);
+  phy.write(0xFFFFFFFF, 24);
+}
+
+uint32_t SWDDriver::init() {
+  begin();
+  if (!phy.isActive())
+    return 0;
+  invalidate();
+  packedSupport = -1;
+
+  // Line reset, JTAG-to-SWD switching sequence (0xE79E), line reset, idle
+  lineReset();
+  phy.write(0xE79E, 16);
+  lineReset();
+  phy.idle(SWD_IDLE_CYCLES);
+
+  // IDCODE must be the first read after a line reset
+  uint32_t idcode;
+  if (!readDP(SWD_DP_IDCODE, &idcode))
+    return 0;
+
+  // Clear sticky errors, request debug and system power-up
+  if (!writeDP(SWD_DP_ABORT, SWD_ABORT_CLEAR) ||
+      !writeDP(SWD_DP_CTRL_STAT, SWD_CSYSPWRUPREQ | SWD_CDBGPWRUPREQ))
+    return 0;
+  uint32_t start = micros();
+  uint32_t status;
+  do {
+    if (!readDP(SWD_DP_CTRL_STAT, &status))
+      return 0;
+    if ((status & (SWD_CSYSPWRUPACK | SWD_CDBGPWRUPACK)) ==
+        (SWD_CSYSPWRUPACK | SWD_CDBGPWRUPACK))
+      return idcode;
+  } while (micros() - start < SWD_POWERUP_TIMEOUT_US);
+  return 0;
+}
+
+bool SWDDriver::transfer(uint8_t request, uint32_t &data) {
+  // No state machine yet: SWD_INIT has not run
+  if (!phy.isActive()) {
+    lastAck = SwdAck::NO_RESPONSE;
+    return false;
   }
+  uint32_t start = micros();
+  SwdAck ack;
+  do {
+    ack = phy.transfer(request, data);
+  } while (ack == SwdAck::WAIT && micros() - start < SWD_WAIT_TIMEOUT_US);
+
+  lastAck = ack;
+  if (ack == SwdAck::OK)
+    return true;
+  // The failed access may have left SELECT / CSW / TAR anywhere
+  invalidate();
+  if (ack == SwdAck::WAIT || ack == SwdAck::FAULT) {
+    // ABORT is accepted even while the DP answers WAIT / FAULT
+    uint32_t abort =
+        ack == SwdAck::WAIT ? SWD_ABORT_ALL : SWD_ABORT_CLEAR;
+    phy.transfer(SWD_DP_ABORT, abort);
+    phy.idle(SWD_IDLE_CYCLES);
+  }
+  return false;
 }
 
-uint32_t SWDDriver::readBits(uint8_t bits) {
-  pinMode(Board::PIN_SWD_DIO, INPUT);
-  uint32_t data = 0;
-  for (int i = 0; i < bits; i++) {
-    digitalWrite(Board::PIN_SWD_CLK, LOW);
-    delayMicroseconds(1);
-    if (digitalRead(Board::PIN_SWD_DIO)) {
-      data |= (1 << i);
-    }
-    digitalWrite(Board::PIN_SWD_CLK, HIGH);
-    delayMicroseconds(1);
+bool SWDDriver::readDP(uint8_t addr, uint32_t *data) {
+  return transfer(SWD_REQ_READ | (addr & 0x0C), *data);
+}
+
+bool SWDDriver::writeDP(uint8_t addr, uint32_t data) {
+  if (!transfer(addr & 0x0C, data))
+    return false;
+  if ((addr & 0x0C) == SWD_DP_SELECT) {
+    selectCache = data;
+    selectValid = true;
   }
-  return data;
+  phy.idle(SWD_IDLE_CYCLES);
+  return true;
 }
 
-void SWDDriver::turnAround() {
-  pinMode(Board::PIN_SWD_DIO, INPUT);
-  digitalWrite(Board::PIN_SWD_CLK, LOW);
-  delayMicroseconds(1);
-  digitalWrite(Board::PIN_SWD_CLK, HIGH);
-  delayMicroseconds(1);
+bool SWDDriver::select(uint8_t ap, uint32_t addr) {
+  uint32_t sel = ((uint32_t)ap << 24) | (addr & 0xF0);
+  if (selectValid && sel == selectCache)
+    return true;
+  if (!transfer(SWD_DP_SELECT, sel))
+    return false;
+  selectCache = sel;
+  selectValid = true;
+  return true;
 }
 
-uint32_t SWDDriver::init() {
-  // 1. Line Reset (50+ clocks with SWDIO high)
-  writeBits(0xFFFFFFFF, 32);
-  writeBits(0xFFFFFFFF, 32);
+bool SWDDriver::readAP(uint8_t ap, uint32_t addr, uint32_t *data) {
+  // Posted AP read, result from RDBUFF
+  uint32_t posted;
+  if (!select(ap, addr) ||
+      !transfer(SWD_REQ_AP | SWD_REQ_READ | (addr & 0x0C), posted) ||
+      !readDP(SWD_DP_RDBUFF, data))
+    return false;
+  if (ap == SWD_MEM_AP && (addr & 0xFF) == SWD_AP_DRW)
+    tarValid = false; // Auto-increment
+  return true;
+}
 
-  // 2. JTAG-to-SWD switching sequence (0xE79E)
-  writeBits(0xE79E, 16);
+bool SWDDriver::writeAP(uint8_t ap, uint32_t addr, uint32_t data) {
+  if (!select(ap, addr) || !transfer(SWD_REQ_AP | (addr & 0x0C), data))
+    return false;
+  phy.idle(SWD_IDLE_CYCLES);
+
+  // Keep the memory access state in step with raw MEM-AP writes
+  if (ap == SWD_MEM_AP) {
+    if ((addr & 0xFF) == SWD_AP_CSW) {
+      cswCache = data;
+      cswValid = true;
+    } else if ((addr & 0xFF) == SWD_AP_TAR) {
+      tarCache = data;
+      tarValid = true;
+    } else if ((addr & 0xFF) == SWD_AP_DRW) {
+      tarValid = false;
+    }
+  }
+  return true;
+}
 
-  // 3. Line Reset again
-  writeBits(0xFFFFFFFF, 32);
-  writeBits(0xFFFFFFFF, 32);
+// ============== MEMORY ACCESS ==============
 
-  // 4. Idle cycles
-  writeBits(0x00, 8);
+bool SWDDriver::setCsw(uint32_t csw) {
+  if (cswValid && csw == cswCache)
+    return true;
+  if (!select(SWD_MEM_AP, SWD_AP_CSW) ||
+      !transfer(SWD_REQ_AP | SWD_AP_CSW, csw))
+    return false;
+  cswCache = csw;
+  cswValid = true;
+  return true;
+}
 
-  // 5. Read IDCODE (DP Register 0)
-  // Header: Start(1) | APnDP(0) | RnW(1) | A[2:3](00) | Parity(1) | Stop(0) |
-  // Park(1) 1 0 1 00 1 0 1 = 0xA5
-  writeBits(0xA5, 8);
-  turnAround();
+bool SWDDriver::setTar(uint32_t addr) {
+  if (tarValid && addr == tarCache)
+    return true;
+  if (!select(SWD_MEM_AP, SWD_AP_TAR) ||
+      !transfer(SWD_REQ_AP | SWD_AP_TAR, addr))
+    return false;
+  tarCache = addr;
+  tarValid = true;
+  return true;
+}
 
-  // ACK (3 bits) + Data (32 bits) + Parity (1 bit)
-  uint8_t ack = readBits(3);
-  if (ack != 1)
-    return 0; // Expect OK (001)
+bool SWDDriver::packed() {
+  // Packed transfers are optional: an AP without them does not keep
+  // AddrInc = 0b10
+  if (packedSupport < 0) {
+    uint32_t csw = SWD_CSW_DEFAULT | SWD_CSW_INC_PACKED;
+    uint32_t posted, readBack;
+    if (!setCsw(csw) ||
+        !transfer(SWD_REQ_AP | SWD_REQ_READ | SWD_AP_CSW, posted) ||
+        !readDP(SWD_DP_RDBUFF, &readBack))
+      return false;
+    packedSupport = (readBack & SWD_CSW_INC_MASK) == SWD_CSW_INC_PACKED;
+    cswValid = false; // Written value may not be what the AP holds
+  }
+  return packedSupport == 1;
+}
 
-  uint32_t idcode = readBits(32);
-  readBits(1); // Parity
-  turnAround();
+uint8_t SWDDriver::runMode(uint32_t addr, uint16_t len, uint8_t size,
+                           uint16_t &count) {
+  // Access size field: 1 -> 0, 2 -> 1, 4 -> 2
+  uint32_t csw = SWD_CSW_DEFAULT | (size >> 1);
+  uint8_t step;
+  uint16_t bytes = len;
+  if (size == 4) {
+    step = 4;
+    csw |= SWD_CSW_INC_SINGLE;
+  } else if (!(addr & 3) && len >= 4 && packed()) {
+    step = 4; // 4 / size transfers per DRW access
+    csw |= SWD_CSW_INC_PACKED;
+    bytes &= ~3;
+  } else {
+    step = size;
+    csw |= SWD_CSW_INC_SINGLE;
+    // Narrow accesses only up to the next word when packing is possible
+    if ((addr & 3) && bytes > 4 - (addr & 3) && packed())
+      bytes = 4 - (addr & 3);
+  }
 
-  return idcode;
+  // Stay inside the auto-increment block
+  uint32_t room = SWD_TAR_BLOCK - (addr & (SWD_TAR_BLOCK - 1));
+  if (bytes > room)
+    bytes = room;
+  count = bytes / step;
+  return setCsw(csw) ? step : 0;
 }
 
-// Helper to calculate parity
-bool checkParity(uint32_t val) {
-  uint32_t p = 0;
-  for (int i = 0; i < 32; i++) {
-    if (val & (1 << i))
-      p++;
+bool SWDDriver::readRun(uint32_t addr, uint8_t *buf, uint16_t count,
+                        uint8_t step) {
+  if (!setTar(addr))
+    return false;
+
+  // Each DRW read returns the previous access; the last one from RDBUFF
+  uint32_t value;
+  if (!transfer(SWD_REQ_AP | SWD_REQ_READ | SWD_AP_DRW, value))
+    return false;
+  for (uint16_t i = 0; i < count; i++) {
+    bool ok = i + 1 < count
+                  ? transfer(SWD_REQ_AP | SWD_REQ_READ | SWD_AP_DRW, value)
+                  : readDP(SWD_DP_RDBUFF, &value);
+    if (!ok)
+      return false;
+    // Narrow accesses use the byte lanes of their address
+    uint32_t a = addr + i * step;
+    if (step < 4)
+      value >>= (a & 3) * 8;
+    memcpy(&buf[i * step], &value, step);
   }
-  return (p & 1);
+
+  // TAR[9:0] wraps at the block end: the next run sets it again
+  tarCache = addr + count * step;
+  tarValid = tarCache & (SWD_TAR_BLOCK - 1);
+  return true;
 }
 
-// DP/AP Register Access
-// Packet: Start(1) | APnDP(1) | RnW(1) | A[2:3](2) | Parity(1) | Stop(0) |
-// Park(1)
+bool SWDDriver::writeRun(uint32_t addr, const uint8_t *data, uint16_t count,
+                         uint8_t step) {
+  if (!setTar(addr))
+    return false;
 
-bool SWDDriver::writeAP(uint8_t ap, uint32_t addr, uint32_t data) {
-  // 1. Select AP Bank (if needed) - simplified, assuming Bank 0 for now
-  // Write DP Select (0x08)
-  // Header: 1 0 0 10 0 0 1 = 0x89 (Write DP Reg 8 - SELECT)
-  writeBits(0x89, 8);
-  turnAround();
-  if (readBits(3) != 1)
-    return false; // ACK
-  turnAround();
-  writeBits(0x00000000 | (ap << 24), 32); // Select AP and Bank 0
-  writeBits(checkParity(0x00000000 | (ap << 24)), 1);
-
-  // 2. Write AP Register
-  // Header construction:
-  // Start=1, APnDP=1, RnW=0, A[2:3]=(addr>>2)&3, Parity, Stop=0, Park=1
-  uint8_t a23 = (addr >> 2) & 0x03;
-  uint8_t header = 0x81 | (a23 << 2);
-  if (checkParity(header))
-    header |= 0x20; // Parity bit position in header byte? No, header is 8 bits.
-  // Actually, SWD header is 8 bits:
-  // Start(1) | APnDP(1) | RnW(1) | A[2:3](2) | Parity(1) | Stop(0) | Park(1)
-  // Let's use a lookup or calc.
-  // Write AP: APnDP=1, RnW=0.
-
-  uint8_t req = 0x81 | (1 << 5) | (0 << 2) |
-                (a23 << 3); // Start(1) | Park(1) | Stop(0) | Parity(?) | A3 |
-                            // A2 | RnW | APnDP
-  // Wait, standard order LSB first:
-  // Start(1), APnDP, RnW, A2, A3, Parity, Stop(0), Park(1)
-
-  req = 1;           // Start
-  req |= (1 << 1);   // APnDP = 1
-  req |= (0 << 2);   // RnW = 0
-  req |= (a23 << 3); // A[2:3]
-
-  // Parity of (APnDP + RnW + A2 + A3)
-  int p = 1 + 0 + ((a23 >> 0) & 1) + ((a23 >> 1) & 1);
-  if (p & 1)
-    req |= (1 << 5);
-
-  req |= (0 << 6); // Stop
-  req |= (1 << 7); // Park
-
-  writeBits(req, 8);
-  turnAround();
-  if (readBits(3) != 1)
-    return false; // ACK
-  turnAround();
-
-  writeBits(data, 32);
-  writeBits(checkParity(data), 1);
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t value = 0;
+    memcpy(&value, &data[i * step], step);
+    uint32_t a = addr + i * step;
+    if (step < 4)
+      value <<= (a & 3) * 8;
+    if (!transfer(SWD_REQ_AP | SWD_AP_DRW, value))
+      return false;
+  }
 
+  tarCache = addr + count * step;
+  tarValid = tarCache & (SWD_TAR_BLOCK - 1);
   return true;
 }
 
-bool SWDDriver::readAP(uint8_t ap, uint32_t addr, uint32_t *data) {
-  // 1. Select AP Bank
-  // Write DP Select (0x08) -> 0x89
-  writeBits(0x89, 8);
-  turnAround();
-  if (readBits(3) != 1)
+bool SWDDriver::checkSticky() {
+  // A bus error on the last (posted) access of a block is only reported
+  // in CTRL/STAT: RDBUFF and the final DRW write were ACKed OK
+  uint32_t status;
+  if (!readDP(SWD_DP_CTRL_STAT, &status))
     return false;
-  turnAround();
-  writeBits(0x00000000 | (ap << 24), 32);
-  writeBits(checkParity(0x00000000 | (ap << 24)), 1);
-
-  // 2. Read AP Register
-  // APnDP=1, RnW=1
-  uint8_t a23 = (addr >> 2) & 0x03;
-  uint8_t req = 1;   // Start
-  req |= (1 << 1);   // APnDP = 1
-  req |= (1 << 2);   // RnW = 1
-  req |= (a23 << 3); // A[2:3]
-
-  int p = 1 + 1 + ((a23 >> 0) & 1) + ((a23 >> 1) & 1);
-  if (p & 1)
-    req |= (1 << 5);
-
-  req |= (0 << 6); // Stop
-  req |= (1 << 7); // Park
-
-  writeBits(req, 8);
-  turnAround();
-  if (readBits(3) != 1)
-    return false; // ACK
-
-  *data = readBits(32);
-  readBits(1); // Parity
-  turnAround();
-
-  // Read RDBUFF to get actual data (pipelined)
-  // Read DP RDBUFF (0x0C) -> 0xBD (Start=1, APnDP=0, RnW=1, A=3, P=1, S=0, P=1)
-  writeBits(0xBD, 8);
-  turnAround();
-  if (readBits(3) != 1)
+  if (!(status & SWD_STICKYERR))
+    return true;
+  invalidate();
+  uint32_t abort = SWD_ABORT_CLEAR;
+  phy.transfer(SWD_DP_ABORT, abort);
+  phy.idle(SWD_IDLE_CYCLES);
+  lastAck = SwdAck::FAULT;
+  return false;
+}
+
+bool SWDDriver::memRead(uint32_t addr, uint8_t *buf, uint16_t len,
+                        uint8_t size) {
+  if (!phy.isActive() || (size != 1 && size != 2 && size != 4) ||
+      (addr % size) || (len % size))
     return false;
-  *data = readBits(32);
-  readBits(1);
-  turnAround();
+  while (len) {
+    uint16_t count;
+    uint8_t step = runMode(addr, len, size, count);
+    if (!step || !readRun(addr, buf, count, step))
+      return false;
+    uint16_t n = count * step;
+    addr += n;
+    buf += n;
+    len -= n;
+  }
+  return checkSticky();
+}
 
-  return true;
+bool SWDDriver::memWrite(uint32_t addr, const uint8_t *data, uint16_t len,
+                         uint8_t size) {
+  if (!phy.isActive() || (size != 1 && size != 2 && size != 4) ||
+      (addr % size) || (len % size))
+    return false;
+  while (len) {
+    uint16_t count;
+    uint8_t step = runMode(addr, len, size, count);
+    if (!step || !writeRun(addr, data, count, step))
+      return false;
+    uint16_t n = count * step;
+    addr += n;
+    data += n;
+    len -= n;
+  }
+  // Let the last posted write reach the bus
+  phy.idle(SWD_IDLE_CYCLES);
+  return checkSticky();
 }
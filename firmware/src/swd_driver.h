@@ -1,24 +1,125 @@
 #ifndef SWD_DRIVER_H
 #define SWD_DRIVER_H
 
+#include "pio_swd.h"
 #include <Arduino.h>
 
+// WAIT responses are retried for this long, then the transfer is aborted
+#define SWD_WAIT_TIMEOUT_US 10000
+
+// CTRL/STAT power-up handshake (CSYSPWRUPACK / CDBGPWRUPACK)
+#define SWD_POWERUP_TIMEOUT_US 100000
+
+// DP registers (A[3:2] << 2)
+#define SWD_DP_IDCODE 0x00 // Read
+#define SWD_DP_ABORT 0x00  // Write
+#define SWD_DP_CTRL_STAT 0x04
+#define SWD_DP_SELECT 0x08
+#define SWD_DP_RDBUFF 0x0C
+
+// MEM-AP used for memory access (AHB-AP of Cortex-M targets) and its
+// registers
+#define SWD_MEM_AP 0
+#define SWD_AP_CSW 0x00
+#define SWD_AP_TAR 0x04
+#define SWD_AP_DRW 0x0C
+
+// CSW: HPROT data access, privileged (DbgSwEnable left as reset)
+#define SWD_CSW_DEFAULT 0x23000000
+
+// TAR auto-increment is only guaranteed inside a 1KB block
+#define SWD_TAR_BLOCK 0x400
+
+/**
+ * @brief ARM Serial Wire Debug host on the PIO PHY
+ *
+ * WAIT acknowledges are retried for SWD_WAIT_TIMEOUT_US; a FAULT (or a WAIT
+ * that never clears) writes ABORT to clear the sticky flags so the next
+ * access starts clean. The ACK of the last transfer is kept for reporting.
+ *
+ * Memory access keeps the last SELECT, CSW and TAR written so they are only
+ * sent when they change, streams DRW with TAR auto-increment (reads are
+ * pipelined: each AP read returns the previous result, RDBUFF is read once
+ * at the end) and splits blocks at the 1KB auto-increment boundary. Any
+ * failed transfer drops the cached state. CTRL/STAT is read after every
+ * block so a bus error on its last posted access is not lost.
+ *
+ * Until begin (or init) has claimed the PIO, every access fails with
+ * SwdAck::NO_RESPONSE and nothing reaches the state machine.
+ */
 class SWDDriver {
 public:
   void begin();
-  uint32_t init(); // Returns IDCODE
+
+  /**
+   * @brief Line reset, JTAG-to-SWD switch, IDCODE read, sticky flags
+   * cleared and debug / system power-up requested
+   * @return IDCODE, 0 if no target answered
+   */
+  uint32_t init();
+
+  /**
+   * @brief Set SWCLK (SWD_CLOCK_MIN .. SWD_CLOCK_MAX)
+   */
+  bool setClock(uint32_t hz);
+  uint32_t getClock() const { return clockHz; }
+  bool isActive() const { return phy.isActive(); }
+
+  bool readDP(uint8_t addr, uint32_t *data);
+  bool writeDP(uint8_t addr, uint32_t data);
+
+  /**
+   * @brief AP register access
+   * @param addr Register address, bank in bits 7:4 (written to SELECT)
+   */
   bool readAP(uint8_t ap, uint32_t addr, uint32_t *data);
   bool writeAP(uint8_t ap, uint32_t addr, uint32_t data);
 
+  /**
+   * @brief Read target memory through SWD_MEM_AP
+   * @param size Access width 1, 2 or 4 (addr and len aligned to it); 8 and
+   * 16-bit accesses are packed four bytes per DRW access when the MEM-AP
+   * supports it
+   */
+  bool memRead(uint32_t addr, uint8_t *buf, uint16_t len, uint8_t size);
+
+  /**
+   * @brief Write target memory through SWD_MEM_AP (see memRead)
+   */
+  bool memWrite(uint32_t addr, const uint8_t *data, uint16_t len,
+                uint8_t size);
+
+  SwdAck getLastAck() const { return lastAck; }
+
 private:
-  const uint8_t PIN_SWCLK = 2;
-  const uint8_t PIN_SWDIO = 3;
-
-  void sendSequence(uint8_t *seq, uint16_t bits);
-  void writeBits(uint32_t data, uint8_t bits);
-  uint32_t readBits(uint8_t bits);
-  void turnAround();
-  bool getAck();
+  PIOSWD phy;
+  uint32_t clockHz = SWD_CLOCK_DEFAULT;
+  SwdAck lastAck = SwdAck::OK;
+
+  // Cached DP / MEM-AP state (valid flags cleared by any failure)
+  bool selectValid = false;
+  bool cswValid = false;
+  bool tarValid = false;
+  uint32_t selectCache = 0;
+  uint32_t cswCache = 0;
+  uint32_t tarCache = 0;
+  int8_t packedSupport = -1; // -1: not probed yet
+
+  bool transfer(uint8_t request, uint32_t &data);
+  void lineReset();
+  void invalidate() { selectValid = cswValid = tarValid = false; }
+  bool select(uint8_t ap, uint32_t addr);
+  bool setCsw(uint32_t csw);
+  bool setTar(uint32_t addr);
+  bool packed();
+  bool checkSticky();
+
+  // One run of DRW accesses inside a 1KB block (step: bytes per access)
+  bool readRun(uint32_t addr, uint8_t *buf, uint16_t count, uint8_t step);
+  bool writeRun(uint32_t addr, const uint8_t *data, uint16_t count,
+                uint8_t step);
+  uint8_t runMode(uint32_t addr, uint16_t len, uint8_t size,
+                  uint16_t &count);
 };
 
 #endif
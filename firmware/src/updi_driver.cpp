@@ -0,0 +1,384 @@
+#include "updi_driver.h"
+#include "Board.h"
+#include <hardware/gpio.h>
+
+// Instructions (each starts with SYNCH)
+#define UPDI_SYNCH 0x55
+#define UPDI_ACK 0x40
+#define UPDI_LDS 0x00
+#define UPDI_STS 0x40
+#define UPDI_LD 0x20
+#define UPDI_ST 0x60
+#define UPDI_LDCS 0x80
+#define UPDI_STCS 0xC0
+#define UPDI_REPEAT 0xA0
+#define UPDI_KEY 0xE0
+#define UPDI_SIB 0xE5 // KEY | SIB | 128 bits
+
+#define UPDI_PTR_INC 0x04  // *(ptr++)
+#define UPDI_PTR_ADDR 0x08 // ptr
+#define UPDI_WORD 0x01     // Data size (address size in LDS/STS bits 3:2)
+
+// Control / status registers
+#define UPDI_CS_STATUSA 0x00
+#define UPDI_CS_CTRLA 0x02
+#define UPDI_CS_CTRLB 0x03
+#define UPDI_ASI_KEY_STATUS 0x07
+#define UPDI_ASI_RESET_REQ 0x08
+#define UPDI_ASI_CTRLA 0x09
+#define UPDI_ASI_SYS_STATUS 0x0B
+
+#define UPDI_CTRLA_IBDLY 0x80 // Inter-byte delay on target replies
+#define UPDI_CTRLA_RSD 0x08   // No ACK after ST: burst writes
+#define UPDI_CTRLB_UPDIDIS 0x04
+#define UPDI_CTRLB_CCDETDIS 0x08
+#define UPDI_KEY_NVMPROG 0x10
+#define UPDI_KEY_CHIPERASE 0x08
+#define UPDI_SYS_LOCKSTATUS 0x01
+#define UPDI_SYS_NVMPROG 0x08
+#define UPDI_SYS_RSTSYS 0x20
+#define UPDI_RESET_SIGNATURE 0x59
+#define UPDI_CLKSEL_16MHZ 0x01 // ASI_CTRLA.UPDICLKSEL (0x03 = 4 MHz default)
+#define UPDI_CLKSEL_8MHZ 0x02
+
+// NVM controller (same address on every generation)
+#define NVMCTRL_CTRLA 0x1000
+#define NVMCTRL_STATUS 0x1002
+#define NVMCTRL_BUSY 0x03 // FBUSY | EEBUSY
+#define NVMCTRL_V0_WRERROR 0x04
+#define NVMCTRL_V2_ERROR 0x70
+
+// V0 commands (page buffer)
+#define NVM_V0_WP 0x01   // Write page
+#define NVM_V0_ERWP 0x03 // Erase and write page
+#define NVM_V0_PBC 0x04  // Page buffer clear
+
+// V2 commands (stay active until NOCMD)
+#define NVM_V2_NOCMD 0x00
+#define NVM_V2_FLWR 0x02   // Flash write
+#define NVM_V2_FLPER 0x08  // Flash page erase
+#define NVM_V2_EEERWR 0x13 // EEPROM erase and write
+
+// Bytes sent before their echoes are collected (RX FIFO holds 32)
+#define UPDI_ECHO_WINDOW 16
+
+// Double break: 24.6 ms low covers the slowest UPDI baud
+#define UPDI_BREAK_MS 25
+
+void UPDIDriver::begin() {
+  gpio_init(Board::PIN_UPDI_TX);
+  gpio_init(Board::PIN_UPDI_RX);
+}
+
+// ============== LINK LAYER ==============
+
+void UPDIDriver::setBaud(uint32_t baud) {
+  _baud = uart_init(_uart, baud);
+  uart_set_format(_uart, 8, 2, UART_PARITY_EVEN);
+  uart_set_fifo_enabled(_uart, true);
+  gpio_set_function(Board::PIN_UPDI_TX, GPIO_FUNC_UART);
+  gpio_set_function(Board::PIN_UPDI_RX, GPIO_FUNC_UART);
+  _byteUs = 12000000 / _baud + 1;
+  _linkOpen = true;
+}
+
+bool UPDIDriver::raiseClock(uint32_t baud) {
+  // The UPDI samples the line with its own clock: raise it before the
+  // host side speeds up, then check the link at the new rate
+  uint8_t clksel = baud > UPDI_BAUD_8MHZ ? UPDI_CLKSEL_16MHZ : UPDI_CLKSEL_8MHZ;
+  if (!stcs(UPDI_ASI_CTRLA, clksel))
+    return false;
+  setBaud(baud);
+  uint8_t status;
+  return ldcs(UPDI_CS_STATUSA, status) && status != 0;
+}
+
+void UPDIDriver::doubleBreak() {
+  for (uint8_t i = 0; i < 2; i++) {
+    uart_set_break(_uart, true);
+    delay(UPDI_BREAK_MS);
+    uart_set_break(_uart, false);
+    delay(1);
+  }
+  flushRx(); // Break characters seen by RX
+}
+
+void UPDIDriver::flushRx() {
+  while (uart_is_readable(_uart))
+    uart_getc(_uart);
+}
+
+bool UPDIDriver::send(const uint8_t *data, uint16_t len) {
+  // Keep a window of bytes in flight and check every echo
+  uint16_t sent = 0, echoed = 0;
+  uint32_t last = micros();
+  while (echoed < len) {
+    if (sent < len && sent - echoed < UPDI_ECHO_WINDOW &&
+        uart_is_writable(_uart))
+      uart_putc_raw(_uart, data[sent++]);
+    if (uart_is_readable(_uart)) {
+      if ((uint8_t)uart_getc(_uart) != data[echoed++])
+        return false; // Collision: the target drove the line
+      last = micros();
+    } else if (micros() - last >
+               UPDI_TIMEOUT_US + UPDI_ECHO_WINDOW * _byteUs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool UPDIDriver::receive(uint8_t *data, uint16_t len) {
+  uint32_t last = micros();
+  for (uint16_t i = 0; i < len;) {
+    if (uart_is_readable(_uart)) {
+      data[i++] = uart_getc(_uart);
+      last = micros();
+    } else if (micros() - last > UPDI_TIMEOUT_US) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool UPDIDriver::ack() {
+  uint8_t b;
+  return receive(&b, 1) && b == UPDI_ACK;
+}
+
+// ============== INSTRUCTIONS ==============
+
+bool UPDIDriver::ldcs(uint8_t reg, uint8_t &value) {
+  const uint8_t cmd[] = {UPDI_SYNCH, (uint8_t)(UPDI_LDCS | reg)};
+  return send(cmd, 2) && receive(&value, 1);
+}
+
+bool UPDIDriver::stcs(uint8_t reg, uint8_t value) {
+  const uint8_t cmd[] = {UPDI_SYNCH, (uint8_t)(UPDI_STCS | reg), value};
+  return send(cmd, 3);
+}
+
+bool UPDIDriver::lds(uint32_t addr, uint8_t &value) {
+  uint8_t a = addrSize(addr);
+  const uint8_t cmd[] = {UPDI_SYNCH, (uint8_t)(UPDI_LDS | (a << 2)),
+                         (uint8_t)addr, (uint8_t)(addr >> 8),
+                         (uint8_t)(addr >> 16)};
+  return send(cmd, 3 + a) && receive(&value, 1);
+}
+
+bool UPDIDriver::sts(uint32_t addr, uint8_t value) {
+  uint8_t a = addrSize(addr);
+  const uint8_t cmd[] = {UPDI_SYNCH, (uint8_t)(UPDI_STS | (a << 2)),
+                         (uint8_t)addr, (uint8_t)(addr >> 8),
+                         (uint8_t)(addr >> 16)};
+  return send(cmd, 3 + a) && ack() && send(&value, 1) && ack();
+}
+
+bool UPDIDriver::setPointer(uint32_t addr) {
+  uint8_t a = addrSize(addr);
+  const uint8_t cmd[] = {UPDI_SYNCH, (uint8_t)(UPDI_ST | UPDI_PTR_ADDR | a),
+                         (uint8_t)addr, (uint8_t)(addr >> 8),
+                         (uint8_t)(addr >> 16)};
+  return send(cmd, 3 + a) && ack();
+}
+
+bool UPDIDriver::repeat(uint16_t count) {
+  const uint8_t cmd[] = {UPDI_SYNCH, UPDI_REPEAT, (uint8_t)(count - 1)};
+  return send(cmd, 3);
+}
+
+bool UPDIDriver::key(const char *k) {
+  // 64-bit key, sent last character first
+  uint8_t cmd[10] = {UPDI_SYNCH, UPDI_KEY};
+  for (uint8_t i = 0; i < 8; i++)
+    cmd[2 + i] = k[7 - i];
+  return send(cmd, sizeof(cmd));
+}
+
+bool UPDIDriver::readSib() {
+  const uint8_t cmd[] = {UPDI_SYNCH, UPDI_SIB};
+  if (!send(cmd, 2) || !receive(_sib, sizeof(_sib)))
+    return false;
+  // "P:n" at offset 8: NVM controller version
+  _nvm = UpdiNvm::UNKNOWN;
+  if (_sib[8] == 'P' && _sib[9] == ':') {
+    if (_sib[10] == '0')
+      _nvm = UpdiNvm::V0;
+    else if (_sib[10] == '2')
+      _nvm = UpdiNvm::V2;
+  }
+  return true;
+}
+
+// ============== SYSTEM ==============
+
+bool UPDIDriver::resetTarget() {
+  return stcs(UPDI_ASI_RESET_REQ, UPDI_RESET_SIGNATURE) &&
+         stcs(UPDI_ASI_RESET_REQ, 0x00) &&
+         waitSysStatus(UPDI_SYS_RSTSYS, false, UPDI_TIMEOUT_RESET_US);
+}
+
+bool UPDIDriver::waitSysStatus(uint8_t mask, bool set, uint32_t timeoutUs) {
+  uint32_t start = micros();
+  uint8_t status;
+  do {
+    if (!ldcs(UPDI_ASI_SYS_STATUS, status))
+      return false;
+    if (((status & mask) != 0) == set)
+      return true;
+  } while (micros() - start < timeoutUs);
+  return false;
+}
+
+bool UPDIDriver::enterNvmProg() {
+  uint8_t status;
+  if (!key("NVMProg ") || !ldcs(UPDI_ASI_KEY_STATUS, status) ||
+      !(status & UPDI_KEY_NVMPROG))
+    return false;
+  if (!resetTarget() ||
+      !waitSysStatus(UPDI_SYS_NVMPROG, true, UPDI_TIMEOUT_RESET_US))
+    return false;
+  _active = true;
+  return true;
+}
+
+UpdiEnterStatus UPDIDriver::enterProgrammingMode(uint32_t baud) {
+  _active = false;
+  // Wake the UPDI at a rate its 4 MHz reset clock can follow
+  setBaud(baud < UPDI_BAUD_4MHZ ? baud : UPDI_BAUD_4MHZ);
+  doubleBreak();
+
+  // Collision detection off, guard time on target replies; STATUSA holds
+  // the UPDI revision (never 0)
+  uint8_t status;
+  if (!stcs(UPDI_CS_CTRLB, UPDI_CTRLB_CCDETDIS) ||
+      !stcs(UPDI_CS_CTRLA, UPDI_CTRLA_IBDLY) ||
+      !ldcs(UPDI_CS_STATUSA, status) || status == 0)
+    return UpdiEnterStatus::NO_LINK;
+  if ((baud > UPDI_BAUD_4MHZ && !raiseClock(baud)) || !readSib())
+    return UpdiEnterStatus::NO_LINK;
+
+  if (!ldcs(UPDI_ASI_SYS_STATUS, status))
+    return UpdiEnterStatus::NO_LINK;
+  if (status & UPDI_SYS_LOCKSTATUS)
+    return UpdiEnterStatus::LOCKED;
+  if (status & UPDI_SYS_NVMPROG) {
+    _active = true; // Still in NVM programming from a previous session
+    return UpdiEnterStatus::OK;
+  }
+  return enterNvmProg() ? UpdiEnterStatus::OK : UpdiEnterStatus::FAILED;
+}
+
+void UPDIDriver::endProgrammingMode() {
+  // UART1 is not set up before UPDI_ENTER nor after a previous exit
+  if (!_linkOpen)
+    return;
+  // Reset into the application, then release the line (target pull-up)
+  resetTarget();
+  stcs(UPDI_CS_CTRLB, UPDI_CTRLB_UPDIDIS | UPDI_CTRLB_CCDETDIS);
+  uart_tx_wait_blocking(_uart);
+  uart_deinit(_uart);
+  gpio_init(Board::PIN_UPDI_TX);
+  gpio_init(Board::PIN_UPDI_RX);
+  _active = false;
+  _linkOpen = false;
+}
+
+bool UPDIDriver::chipErase() {
+  uint8_t status;
+  if (!_linkOpen)
+    return false;
+  if (!key("NVMErase") || !ldcs(UPDI_ASI_KEY_STATUS, status) ||
+      !(status & UPDI_KEY_CHIPERASE))
+    return false;
+  // Erase runs during reset; the lock bits clear when done
+  if (!resetTarget() || !waitSysStatus(UPDI_SYS_LOCKSTATUS, false,
+                                       UPDI_TIMEOUT_CHIP_ERASE_US))
+    return false;
+  return enterNvmProg();
+}
+
+// ============== MEMORY ==============
+
+bool UPDIDriver::read(uint32_t addr, uint8_t *buf, uint16_t len) {
+  if (!_active || !setPointer(addr))
+    return false;
+  // Word bursts: up to 512 bytes per REPEAT, a trailing odd byte alone
+  while (len) {
+    uint16_t count = len >= 2 ? min(len / 2, UPDI_BURST_MAX) : 1;
+    uint16_t n = len >= 2 ? count * 2 : 1;
+    uint8_t size = len >= 2 ? UPDI_WORD : 0;
+    const uint8_t ld[] = {UPDI_SYNCH,
+                          (uint8_t)(UPDI_LD | UPDI_PTR_INC | size)};
+    if ((count > 1 && !repeat(count)) || !send(ld, 2) || !receive(buf, n))
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool UPDIDriver::burstWrite(uint32_t addr, const uint8_t *data,
+                            uint16_t len) {
+  // No ACK per word: the page streams at line rate, errors show up in the
+  // NVM controller status
+  if (!setPointer(addr) ||
+      !stcs(UPDI_CS_CTRLA, UPDI_CTRLA_IBDLY | UPDI_CTRLA_RSD))
+    return false;
+  bool ok = true;
+  while (ok && len) {
+    uint16_t count = len >= 2 ? min(len / 2, UPDI_BURST_MAX) : 1;
+    uint16_t n = len >= 2 ? count * 2 : 1;
+    uint8_t size = len >= 2 ? UPDI_WORD : 0;
+    const uint8_t st[] = {UPDI_SYNCH,
+                          (uint8_t)(UPDI_ST | UPDI_PTR_INC | size)};
+    ok = (count == 1 || repeat(count)) && send(st, 2) && send(data, n);
+    data += n;
+    len -= n;
+  }
+  return stcs(UPDI_CS_CTRLA, UPDI_CTRLA_IBDLY) && ok;
+}
+
+bool UPDIDriver::nvmCommand(uint8_t cmd) { return sts(NVMCTRL_CTRLA, cmd); }
+
+bool UPDIDriver::nvmWait(uint32_t timeoutUs, uint32_t &elapsedUs) {
+  uint32_t start = micros();
+  uint8_t status;
+  do {
+    if (!lds(NVMCTRL_STATUS, status))
+      return false;
+  } while ((status & NVMCTRL_BUSY) && micros() - start < timeoutUs);
+  elapsedUs = micros() - start;
+  uint8_t error =
+      _nvm == UpdiNvm::V2 ? NVMCTRL_V2_ERROR : NVMCTRL_V0_WRERROR;
+  return !(status & (NVMCTRL_BUSY | error));
+}
+
+bool UPDIDriver::writePage(uint32_t addr, const uint8_t *data, uint16_t len,
+                           bool eeprom, bool erase, uint32_t &busyUs) {
+  if (!_active || len == 0 || len > UPDI_PAGE_MAX)
+    return false;
+  uint32_t us;
+
+  if (_nvm == UpdiNvm::V0) {
+    // Fill the page buffer, then write (or erase and write) it
+    return nvmWait(UPDI_TIMEOUT_NVM_US, us) && nvmCommand(NVM_V0_PBC) &&
+           burstWrite(addr, data, len) &&
+           nvmCommand((eeprom || erase) ? NVM_V0_ERWP : NVM_V0_WP) &&
+           nvmWait(UPDI_TIMEOUT_NVM_US, busyUs);
+  }
+
+  if (_nvm == UpdiNvm::V2) {
+    // Page erase is started by a dummy write into the page
+    if (!eeprom && erase &&
+        !(nvmCommand(NVM_V2_FLPER) && sts(addr, 0xFF) &&
+          nvmWait(UPDI_TIMEOUT_NVM_US, us) && nvmCommand(NVM_V2_NOCMD)))
+      return false;
+    bool ok = nvmCommand(eeprom ? NVM_V2_EEERWR : NVM_V2_FLWR) &&
+              burstWrite(addr, data, len) &&
+              nvmWait(UPDI_TIMEOUT_NVM_US, busyUs);
+    return nvmCommand(NVM_V2_NOCMD) && ok;
+  }
+
+  return false; // Unknown NVM controller
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <Arduino.h>
+#include <hardware/uart.h>
+#include <stdint.h>
+
+// Link speed. The UPDI clock is 4 MHz after reset, good for 225 kbaud;
+// faster links raise ASI_CTRLA.UPDICLKSEL first (8 MHz up to 450 kbaud,
+// 16 MHz up to 900 kbaud)
+#define UPDI_BAUD_DEFAULT 225000
+#define UPDI_BAUD_MIN 4800
+#define UPDI_BAUD_MAX 900000
+#define UPDI_BAUD_4MHZ 225000
+#define UPDI_BAUD_8MHZ 450000
+
+// Target response guard time plus margin (the first byte of a reply, echoes)
+#define UPDI_TIMEOUT_US 2000
+
+// NVM controller and system timeouts
+#define UPDI_TIMEOUT_NVM_US 100000   // Page write / erase-write
+#define UPDI_TIMEOUT_RESET_US 100000 // Reset until NVMPROG is reported
+#define UPDI_TIMEOUT_CHIP_ERASE_US 1000000
+
+// REPEAT takes an 8-bit count: 256 bytes or words per burst
+#define UPDI_BURST_MAX 256
+
+// Largest page of a supported part (AVR Dx)
+#define UPDI_PAGE_MAX 512
+
+/**
+ * @brief NVM controller generation (System Information Block "P:n")
+ */
+enum class UpdiNvm : uint8_t {
+  UNKNOWN = 0,
+  V0 = 1, // tinyAVR 0/1/2, megaAVR 0: page buffer, 16-bit addresses
+  V2 = 2  // AVR DA/DB/DD: word writes, flash at 0x800000 (24-bit)
+};
+
+/**
+ * @brief Outcome of UPDIDriver::enterProgrammingMode
+ */
+enum class UpdiEnterStatus : uint8_t {
+  OK = 0,
+  NO_LINK = 1, // No answer after the double break
+  LOCKED = 2,  // Lock bits set: chip erase first
+  FAILED = 3   // NVMPROG key refused or not reported after reset
+};
+
+/**
+ * @brief Single-wire UPDI programmer on UART1 (half duplex)
+ *
+ * TX drives the UPDI line through a series resistor and RX sits on the line
+ * itself, so every byte sent is echoed and checked (a mismatch is a bus
+ * collision). Memory is moved with REPEAT plus ST/LD *(ptr++) bursts: with
+ * the ACK disabled (CTRLA.RSD) a whole flash page goes out in one
+ * instruction, and completion is polled on the NVM controller status.
+ * Addresses are UPDI data-space addresses (flash at 0x8000 / 0x4000 on V0
+ * parts, 0x800000 on V2).
+ */
+class UPDIDriver {
+public:
+  void begin();
+
+  /**
+   * @brief Wake the UPDI (double break), read the SIB and enter NVM
+   * programming with the NVMPROG key and a reset
+   *
+   * The link comes up at UPDI_BAUD_4MHZ at most. A faster baud is set only
+   * after UPDICLKSEL has raised the UPDI clock.
+   * @param baud Link speed (UPDI_BAUD_MIN .. UPDI_BAUD_MAX)
+   */
+  UpdiEnterStatus enterProgrammingMode(uint32_t baud);
+
+  /**
+   * @brief Reset the target into its application and disable the UPDI
+   * (no-op while the link is closed)
+   */
+  void endProgrammingMode();
+
+  /**
+   * @brief Erase flash, EEPROM and lock bits with the NVMErase key, then
+   * enter NVM programming. Works on a locked part (the link must be up:
+   * call enterProgrammingMode first, false otherwise)
+   */
+  bool chipErase();
+
+  /**
+   * @brief System Information Block (16 ASCII bytes, e.g. "tinyAVR P:0D:0")
+   */
+  const uint8_t *getSib() const { return _sib; }
+  UpdiNvm getNvm() const { return _nvm; }
+  bool isActive() const { return _active; }
+
+  /**
+   * @brief Read len bytes of the data space in REPEAT / LD *(ptr++) bursts
+   */
+  bool read(uint32_t addr, uint8_t *buf, uint16_t len);
+
+  /**
+   * @brief Write one flash or EEPROM page and wait for the NVM controller
+   * @param addr Data-space address of the page (page aligned)
+   * @param len At most UPDI_PAGE_MAX, even for flash
+   * @param eeprom Use the EEPROM erase-write command
+   * @param erase Erase the flash page first (not needed after chipErase)
+   * @param busyUs Time until the NVM controller reported ready
+   */
+  bool writePage(uint32_t addr, const uint8_t *data, uint16_t len,
+                 bool eeprom, bool erase, uint32_t &busyUs);
+
+private:
+  uart_inst_t *_uart = uart1;
+  uint32_t _baud = UPDI_BAUD_DEFAULT;
+  uint32_t _byteUs = 53; // One 8E2 frame (12 bits)
+  bool _active = false;
+  bool _linkOpen = false; // UART1 set up by enterProgrammingMode
+  uint8_t _sib[16] = {0};
+  UpdiNvm _nvm = UpdiNvm::UNKNOWN;
+
+  // Link layer
+  void setBaud(uint32_t baud);
+  bool raiseClock(uint32_t baud);
+  void doubleBreak();
+  void flushRx();
+  bool send(const uint8_t *data, uint16_t len);
+  bool receive(uint8_t *data, uint16_t len);
+  bool ack();
+
+  // Instructions
+  bool ldcs(uint8_t reg, uint8_t &value);
+  bool stcs(uint8_t reg, uint8_t value);
+  bool lds(uint32_t addr, uint8_t &value);
+  bool sts(uint32_t addr, uint8_t value);
+  bool setPointer(uint32_t addr);
+  bool repeat(uint16_t count);
+  bool key(const char *k);
+  bool readSib();
+
+  // System
+  bool enterNvmProg();
+  bool resetTarget();
+  bool waitSysStatus(uint8_t mask, bool set, uint32_t timeoutUs);
+  bool nvmCommand(uint8_t cmd);
+  bool nvmWait(uint32_t timeoutUs, uint32_t &elapsedUs);
+  bool burstWrite(uint32_t addr, const uint8_t *data, uint16_t len);
+  uint8_t addrSize(uint32_t addr) const { return addr > 0xFFFF ? 2 : 1; }
+};
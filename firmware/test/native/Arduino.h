@@ -0,0 +1,111 @@
+#pragma once
+// Arduino core subset for the native test build (see sim.h)
+#include "sim.h"
+#include <hardware/gpio.h>
+#include <deque>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define HEX 16
+#define DEC 10
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+template <class T, class L>
+auto min(const T &a, const L &b) -> decltype(a < b ? a : b) {
+  return (b < a) ? b : a;
+}
+template <class T, class L>
+auto max(const T &a, const L &b) -> decltype(a < b ? a : b) {
+  return (a < b) ? b : a;
+}
+
+// ============== TIME ==============
+
+inline unsigned long micros() {
+  sim::advance(1);
+  return (uint32_t)sim::nowUs;
+}
+inline unsigned long millis() {
+  sim::advance(1);
+  return (uint32_t)(sim::nowUs / 1000);
+}
+inline uint64_t time_us_64() {
+  sim::advance(1);
+  return sim::nowUs;
+}
+inline void delay(unsigned long ms) { sim::advance(ms * 1000ULL); }
+inline void delayMicroseconds(unsigned int us) { sim::advance(us); }
+inline void sleep_us(uint64_t us) { sim::advance(us); }
+inline void busy_wait_us_32(uint32_t us) { sim::advance(us); }
+inline void busy_wait_at_least_cycles(uint32_t) {}
+inline void yield() { sim::tick(); }
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// ============== PINS ==============
+
+inline void pinMode(int pin, int mode) {
+  sim::Pins &p = sim::pins();
+  if (pin < 0 || pin >= sim::NUM_PINS)
+    return;
+  p.output[pin] = mode == OUTPUT;
+  p.pullUp[pin] = mode == INPUT_PULLUP;
+}
+inline void digitalWrite(int pin, int level) { sim::setPin(pin, level); }
+inline int digitalRead(int pin) { return sim::getPin(pin); }
+
+// ============== SERIAL ==============
+
+/**
+ * @brief USB CDC port: the test queues host bytes in rx and collects the
+ * device output from tx
+ */
+struct SerialClass {
+  std::deque<uint8_t> rx;
+  std::vector<uint8_t> tx;
+
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+  int available() { return (int)rx.size(); }
+  int read() {
+    if (rx.empty())
+      return -1;
+    uint8_t b = rx.front();
+    rx.pop_front();
+    return b;
+  }
+  size_t write(uint8_t b) {
+    tx.push_back(b);
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) {
+    tx.insert(tx.end(), data, data + len);
+    return len;
+  }
+  void flush() {}
+  template <class T> void print(T, int = 0) {}
+  template <class T> void println(T, int = 0) {}
+  void println() {}
+};
+inline SerialClass Serial;
+
+struct RP2040Class {
+  void rebootToBootloader() {}
+  uint32_t f_cpu() { return 133000000; }
+  int getFreeHeap() { return 200000; }
+};
+inline RP2040Class rp2040;
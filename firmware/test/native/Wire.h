@@ -0,0 +1,20 @@
+#pragma once
+// Wire with nothing on the bus: the PIO engine is the one under test
+#include <Arduino.h>
+
+struct TwoWire {
+  void setSDA(int) {}
+  void setSCL(int) {}
+  void begin() {}
+  void end() {}
+  void setClock(uint32_t) {}
+  void setTimeout(int, bool = false) {}
+  void beginTransmission(uint8_t) {}
+  uint8_t endTransmission(bool = true) { return 2; } // Address NAK
+  size_t requestFrom(uint8_t, size_t, bool = true) { return 0; }
+  size_t write(const uint8_t *, size_t len) { return len; }
+  size_t write(uint8_t) { return 1; }
+  int available() { return 0; }
+  int read() { return -1; }
+};
+inline TwoWire Wire;
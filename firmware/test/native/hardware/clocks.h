@@ -0,0 +1,7 @@
+#pragma once
+// Clock subset for the native test build
+#include <stdint.h>
+
+enum clock_index { clk_gpout0 = 0, clk_ref = 4, clk_sys = 5, clk_peri = 6 };
+
+inline uint32_t clock_get_hz(enum clock_index) { return 125000000; }
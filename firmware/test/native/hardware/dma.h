@@ -0,0 +1,130 @@
+#pragma once
+// DMA subset for the native test build: channels paced by the PIO model's
+// FIFOs, one transfer per channel on every sim::tick
+#include "../sim.h"
+#include "pio.h"
+#include <stdint.h>
+#include <string.h>
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+  uint8_t size = DMA_SIZE_8;
+  bool readIncrement = true;
+  bool writeIncrement = false;
+} dma_channel_config;
+
+namespace sim {
+
+struct DmaChannel {
+  bool claimed = false;
+  bool busy = false;
+  dma_channel_config config;
+  volatile void *write = nullptr;
+  const volatile void *read = nullptr;
+  uint32_t count = 0;
+};
+
+inline DmaChannel *dmaChannels() {
+  static DmaChannel ch[12];
+  return ch;
+}
+
+inline void dmaStep() {
+  PioModel *pio = pioModel();
+  for (unsigned i = 0; i < 12; i++) {
+    DmaChannel &c = dmaChannels()[i];
+    if (!c.busy)
+      continue;
+    unsigned bytes = 1u << c.config.size;
+    bool fromRx = pioRxfSm(c.read) >= 0;
+    bool toTx = pioTxfSm(c.write) >= 0;
+    if ((fromRx && (!pio || pio->rx.empty())) || (toTx && (!pio || pio->txFull())))
+      continue; // DREQ not asserted
+    uint32_t value = 0;
+    if (fromRx)
+      value = pio->pop();
+    else
+      memcpy(&value, (const void *)c.read, bytes);
+    if (toTx)
+      pio->push(value);
+    else
+      memcpy((void *)c.write, &value, bytes);
+    if (c.config.readIncrement && !fromRx)
+      c.read = (const volatile uint8_t *)c.read + bytes;
+    if (c.config.writeIncrement && !toTx)
+      c.write = (volatile uint8_t *)c.write + bytes;
+    if (--c.count == 0)
+      c.busy = false;
+  }
+}
+
+inline void dmaReset() {
+  for (unsigned i = 0; i < 12; i++)
+    dmaChannels()[i] = DmaChannel();
+}
+
+inline const bool dmaRegistered = addPeripheral(dmaStep, dmaReset);
+
+} // namespace sim
+
+inline int dma_claim_unused_channel(bool) {
+  for (int i = 0; i < 12; i++) {
+    if (!sim::dmaChannels()[i].claimed) {
+      sim::dmaChannels()[i] = sim::DmaChannel();
+      sim::dmaChannels()[i].claimed = true;
+      return i;
+    }
+  }
+  return -1;
+}
+inline void dma_channel_unclaim(unsigned ch) {
+  sim::dmaChannels()[ch].claimed = false;
+}
+inline dma_channel_config dma_channel_get_default_config(unsigned) {
+  dma_channel_config c;
+  c.size = DMA_SIZE_32;
+  c.readIncrement = true;
+  c.writeIncrement = false;
+  return c;
+}
+inline void channel_config_set_transfer_data_size(
+    dma_channel_config *c, enum dma_channel_transfer_size size) {
+  c->size = size;
+}
+inline void channel_config_set_dreq(dma_channel_config *, unsigned) {}
+inline void channel_config_set_read_increment(dma_channel_config *c,
+                                              bool inc) {
+  c->readIncrement = inc;
+}
+inline void channel_config_set_write_increment(dma_channel_config *c,
+                                               bool inc) {
+  c->writeIncrement = inc;
+}
+inline void dma_channel_configure(unsigned ch, const dma_channel_config *c,
+                                  volatile void *write,
+                                  const volatile void *read, unsigned count,
+                                  bool trigger) {
+  sim::DmaChannel &d = sim::dmaChannels()[ch];
+  d.config = *c;
+  d.write = write;
+  d.read = read;
+  d.count = count;
+  d.busy = trigger && count;
+}
+inline void dma_start_channel_mask(uint32_t mask) {
+  for (unsigned i = 0; i < 12; i++)
+    if ((mask & (1u << i)) && sim::dmaChannels()[i].count)
+      sim::dmaChannels()[i].busy = true;
+}
+inline bool dma_channel_is_busy(unsigned ch) {
+  sim::tick();
+  return sim::dmaChannels()[ch].busy;
+}
+inline void dma_channel_wait_for_finish_blocking(unsigned ch) {
+  while (sim::dmaChannels()[ch].busy)
+    sim::tick();
+}
+inline void dma_channel_abort(unsigned ch) {
+  sim::dmaChannels()[ch].busy = false;
+}
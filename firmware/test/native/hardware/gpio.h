@@ -0,0 +1,68 @@
+#pragma once
+// GPIO subset for the native test build: levels live in sim::pins()
+#include "../sim.h"
+#include <stdint.h>
+
+enum gpio_function {
+  GPIO_FUNC_SPI = 1,
+  GPIO_FUNC_UART = 2,
+  GPIO_FUNC_SIO = 5,
+  GPIO_FUNC_PIO0 = 6,
+  GPIO_FUNC_PIO1 = 7,
+  GPIO_FUNC_NULL = 0x1f
+};
+enum gpio_override {
+  GPIO_OVERRIDE_NORMAL = 0,
+  GPIO_OVERRIDE_INVERT = 1,
+  GPIO_OVERRIDE_LOW = 2,
+  GPIO_OVERRIDE_HIGH = 3
+};
+
+inline void gpio_init(unsigned pin) {
+  if (pin < sim::NUM_PINS) {
+    sim::pins().output[pin] = false;
+    sim::pins().level[pin] = false;
+  }
+}
+inline void gpio_set_function(unsigned, enum gpio_function) {}
+inline void gpio_set_oeover(unsigned, unsigned) {}
+inline void gpio_pull_up(unsigned pin) {
+  if (pin < sim::NUM_PINS)
+    sim::pins().pullUp[pin] = true;
+}
+inline void gpio_disable_pulls(unsigned pin) {
+  if (pin < sim::NUM_PINS)
+    sim::pins().pullUp[pin] = false;
+}
+inline void gpio_put(unsigned pin, bool level) { sim::setPin(pin, level); }
+inline bool gpio_get(unsigned pin) { return sim::getPin(pin); }
+inline void gpio_set_dir(unsigned pin, bool out) {
+  if (pin < sim::NUM_PINS)
+    sim::pins().output[pin] = out;
+}
+inline void gpio_set_mask(uint32_t mask) {
+  for (uint8_t pin = 0; pin < sim::NUM_PINS; pin++)
+    if (mask & (1u << pin))
+      sim::setPin(pin, true);
+}
+inline void gpio_clr_mask(uint32_t mask) {
+  for (uint8_t pin = 0; pin < sim::NUM_PINS; pin++)
+    if (mask & (1u << pin))
+      sim::setPin(pin, false);
+}
+inline void gpio_put_masked(uint32_t mask, uint32_t value) {
+  for (uint8_t pin = 0; pin < sim::NUM_PINS; pin++)
+    if (mask & (1u << pin))
+      sim::setPin(pin, value & (1u << pin));
+}
+inline void gpio_set_dir_masked(uint32_t mask, uint32_t value) {
+  for (uint8_t pin = 0; pin < sim::NUM_PINS; pin++)
+    if (mask & (1u << pin))
+      sim::pins().output[pin] = value & (1u << pin);
+}
+inline uint32_t gpio_get_all() {
+  uint32_t all = 0;
+  for (uint8_t pin = 0; pin < sim::NUM_PINS; pin++)
+    all |= (uint32_t)sim::getPin(pin) << pin;
+  return all;
+}
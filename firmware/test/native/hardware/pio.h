@@ -0,0 +1,258 @@
+#pragma once
+// PIO subset for the native test build: one state machine, run by a model
+#include "../sim.h"
+#include "gpio.h"
+#include <deque>
+#include <stdint.h>
+
+typedef struct {
+  const uint16_t *instructions;
+  uint8_t length;
+  int8_t origin;
+} pio_program_t;
+
+typedef struct {
+  float clkdiv = 1.0f;
+  bool outShiftRight = true;
+  bool autopull = false;
+  uint8_t pullThreshold = 32;
+  bool inShiftRight = true;
+  bool autopush = false;
+  uint8_t pushThreshold = 32;
+} pio_sm_config;
+
+namespace sim {
+
+/**
+ * @brief Model of the program loaded on a state machine
+ *
+ * The firmware side (FIFO writes and reads, FDEBUG, IRQ flags, exec) is
+ * handled here; step() runs the program for one unit of work (a record, a
+ * phase) and is called on every sim::tick while the machine is enabled.
+ */
+struct PioModel {
+  static constexpr unsigned FIFO_DEPTH = 4;
+
+  std::deque<uint32_t> tx, rx;
+  pio_sm_config config;
+  bool enabled = false;
+  bool txStall = false; // FDEBUG.TXSTALL: sticky, write 1 to clear
+  bool irq = false;     // IRQ flag raised by the program
+  unsigned txOverflows = 0;
+  unsigned rxUnderflows = 0;
+
+  virtual ~PioModel() {}
+  virtual void step() = 0;
+  virtual void exec(uint16_t instr) { (void)instr; }
+
+  bool txFull() const { return tx.size() >= FIFO_DEPTH; }
+  bool rxFull() const { return rx.size() >= FIFO_DEPTH; }
+
+  void push(uint32_t v) {
+    if (txFull())
+      txOverflows++; // Dropped, as FSTAT.TXOVER
+    else
+      tx.push_back(v);
+  }
+  uint32_t pop() {
+    if (rx.empty()) {
+      rxUnderflows++;
+      return 0;
+    }
+    uint32_t v = rx.front();
+    rx.pop_front();
+    return v;
+  }
+};
+
+inline PioModel *&pioModel() {
+  static PioModel *m = nullptr;
+  return m;
+}
+
+inline void attachPio(PioModel &m) {
+  pioModel() = &m;
+  models().push_back([&m] {
+    if (m.enabled)
+      m.step();
+  });
+}
+
+inline void pioReset() { pioModel() = nullptr; }
+inline const bool pioRegistered = addPeripheral(nullptr, pioReset);
+
+} // namespace sim
+
+// FIFO registers: writing TXF pushes, indexing RXF pops (so the discarded
+// read in `(void)pio->rxf[sm]` still drains). Taking &rxf[sm] for a DMA
+// source pops as well: only do it with the RX FIFO empty, as the firmware
+// does.
+struct pio_txf_reg {
+  void operator=(uint32_t v) {
+    if (sim::pioModel())
+      sim::pioModel()->push(v);
+  }
+};
+struct pio_rxf_reg {
+  uint32_t value = 0;
+  operator uint32_t() const { return value; }
+};
+struct pio_txf_array {
+  pio_txf_reg reg[4];
+  pio_txf_reg &operator[](unsigned sm) { return reg[sm & 3]; }
+};
+struct pio_rxf_array {
+  pio_rxf_reg reg[4];
+  pio_rxf_reg &operator[](unsigned sm) {
+    sim::PioModel *m = sim::pioModel();
+    if (m && !m->rx.empty())
+      reg[sm & 3].value = m->pop();
+    return reg[sm & 3];
+  }
+};
+struct pio_fdebug_reg {
+  void operator=(uint32_t v) {
+    if (sim::pioModel() && (v & (0xFu << 24)))
+      sim::pioModel()->txStall = false;
+  }
+  operator uint32_t() const {
+    sim::tick();
+    sim::PioModel *m = sim::pioModel();
+    return m && m->txStall ? 0xFu << 24 : 0;
+  }
+};
+
+typedef struct {
+  pio_fdebug_reg fdebug;
+  pio_txf_array txf;
+  pio_rxf_array rxf;
+} pio_hw_t;
+typedef pio_hw_t *PIO;
+
+inline pio_hw_t pio_hw_instances[2];
+inline PIO pio0 = &pio_hw_instances[0];
+inline PIO pio1 = &pio_hw_instances[1];
+
+#define PIO_FDEBUG_TXSTALL_LSB 24
+
+enum pio_interrupt_source { pis_interrupt0 = 8 };
+
+namespace sim {
+// DMA helpers: which FIFO register an address is (-1: memory)
+inline int pioTxfSm(const volatile void *addr) {
+  for (pio_hw_t &p : pio_hw_instances)
+    for (unsigned sm = 0; sm < 4; sm++)
+      if (addr == &p.txf.reg[sm])
+        return sm;
+  return -1;
+}
+inline int pioRxfSm(const volatile void *addr) {
+  for (pio_hw_t &p : pio_hw_instances)
+    for (unsigned sm = 0; sm < 4; sm++)
+      if (addr == &p.rxf.reg[sm])
+        return sm;
+  return -1;
+}
+} // namespace sim
+
+// ============== PROGRAM / STATE MACHINE ==============
+
+inline bool pio_can_add_program(PIO, const pio_program_t *) { return true; }
+inline unsigned pio_add_program(PIO, const pio_program_t *) { return 0; }
+inline int pio_claim_unused_sm(PIO, bool) { return 0; }
+inline void pio_gpio_init(PIO, unsigned) {}
+
+inline pio_sm_config pio_get_default_sm_config() { return pio_sm_config(); }
+inline void sm_config_set_wrap(pio_sm_config *, unsigned, unsigned) {}
+inline void sm_config_set_sideset(pio_sm_config *, unsigned, bool, bool) {}
+inline void sm_config_set_out_pins(pio_sm_config *, unsigned, unsigned) {}
+inline void sm_config_set_set_pins(pio_sm_config *, unsigned, unsigned) {}
+inline void sm_config_set_in_pins(pio_sm_config *, unsigned) {}
+inline void sm_config_set_sideset_pins(pio_sm_config *, unsigned) {}
+inline void sm_config_set_jmp_pin(pio_sm_config *, unsigned) {}
+inline void sm_config_set_out_shift(pio_sm_config *c, bool right,
+                                    bool autopull, unsigned threshold) {
+  c->outShiftRight = right;
+  c->autopull = autopull;
+  c->pullThreshold = threshold;
+}
+inline void sm_config_set_in_shift(pio_sm_config *c, bool right,
+                                   bool autopush, unsigned threshold) {
+  c->inShiftRight = right;
+  c->autopush = autopush;
+  c->pushThreshold = threshold;
+}
+inline void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+  c->clkdiv = div;
+}
+
+inline void pio_sm_init(PIO, unsigned, unsigned, const pio_sm_config *c) {
+  if (sim::PioModel *m = sim::pioModel()) {
+    m->config = *c;
+    m->tx.clear();
+    m->rx.clear();
+    m->irq = false;
+  }
+}
+inline void pio_sm_set_enabled(PIO, unsigned, bool enabled) {
+  if (sim::pioModel())
+    sim::pioModel()->enabled = enabled;
+}
+inline void pio_sm_set_clkdiv(PIO, unsigned, float div) {
+  if (sim::pioModel())
+    sim::pioModel()->config.clkdiv = div;
+}
+inline void pio_sm_set_pins_with_mask(PIO, unsigned, uint32_t, uint32_t) {}
+inline void pio_sm_set_pindirs_with_mask(PIO, unsigned, uint32_t, uint32_t) {}
+inline void pio_set_irq0_source_enabled(PIO, enum pio_interrupt_source,
+                                        bool) {}
+inline void pio_set_irq1_source_enabled(PIO, enum pio_interrupt_source,
+                                        bool) {}
+inline unsigned pio_get_dreq(PIO, unsigned sm, bool tx) {
+  return (tx ? 0 : 4) + sm;
+}
+inline unsigned pio_encode_jmp(unsigned addr) { return addr; }
+
+inline void pio_sm_exec(PIO, unsigned, unsigned instr) {
+  if (sim::pioModel())
+    sim::pioModel()->exec(instr);
+}
+
+// ============== FIFOS / FLAGS ==============
+
+inline bool pio_interrupt_get(PIO, unsigned) {
+  return sim::pioModel() && sim::pioModel()->irq;
+}
+inline void pio_interrupt_clear(PIO, unsigned) {
+  if (sim::pioModel())
+    sim::pioModel()->irq = false;
+}
+inline bool pio_sm_is_tx_fifo_full(PIO, unsigned) {
+  return sim::pioModel() && sim::pioModel()->txFull();
+}
+inline bool pio_sm_is_rx_fifo_empty(PIO, unsigned) {
+  return !sim::pioModel() || sim::pioModel()->rx.empty();
+}
+inline void pio_sm_drain_tx_fifo(PIO, unsigned) {
+  if (sim::pioModel())
+    sim::pioModel()->tx.clear();
+}
+inline void pio_sm_clear_fifos(PIO, unsigned) {
+  if (sim::PioModel *m = sim::pioModel()) {
+    m->tx.clear();
+    m->rx.clear();
+  }
+}
+inline void pio_sm_put_blocking(PIO, unsigned, uint32_t v) {
+  sim::PioModel *m = sim::pioModel();
+  while (m && m->txFull())
+    sim::tick();
+  if (m)
+    m->push(v);
+}
+inline uint32_t pio_sm_get_blocking(PIO, unsigned) {
+  sim::PioModel *m = sim::pioModel();
+  while (m && m->rx.empty())
+    sim::tick();
+  return m ? m->pop() : 0;
+}
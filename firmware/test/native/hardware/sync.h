@@ -0,0 +1,6 @@
+#pragma once
+// Interrupt masking is a no-op in the single-threaded native test build
+#include <stdint.h>
+
+inline uint32_t save_and_disable_interrupts() { return 0; }
+inline void restore_interrupts(uint32_t) {}
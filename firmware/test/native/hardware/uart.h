@@ -0,0 +1,205 @@
+#pragma once
+// UART subset for the native test build: FIFOs moved over a simulated line
+// at the configured baud rate, with a device model on the other end
+#include "../sim.h"
+#include <deque>
+#include <stdint.h>
+
+typedef struct uart_inst {
+  unsigned index;
+} uart_inst_t;
+
+inline uart_inst_t uart_instances[2] = {{0}, {1}};
+inline uart_inst_t *uart0 = &uart_instances[0];
+inline uart_inst_t *uart1 = &uart_instances[1];
+
+enum uart_parity_t { UART_PARITY_NONE, UART_PARITY_EVEN, UART_PARITY_ODD };
+
+namespace sim {
+
+/**
+ * @brief Device on a UART line. Bytes sent by the host arrive in received()
+ * when their frame ends; bytes queued in reply go out as soon as the line
+ * is free.
+ */
+struct UartDevice {
+  std::deque<uint8_t> reply;
+  unsigned baud = 0; // Line rate of the byte passed to received()
+
+  virtual ~UartDevice() {}
+  virtual void received(uint8_t b) = 0;
+  virtual void lineBreak(bool on) { (void)on; }
+  virtual void step() {}
+};
+
+struct UartState {
+  static constexpr unsigned FIFO_DEPTH = 32;
+
+  UartDevice *device = nullptr;
+  bool loopback = false; // Half duplex: RX sees every host byte
+
+  bool enabled = false;
+  unsigned baud = 0;
+  unsigned dataBits = 8, stopBits = 1;
+  uart_parity_t parity = UART_PARITY_NONE;
+  bool breakOn = false;
+  std::deque<uint8_t> tx, rx;
+
+  // Frame on the line: ends at lineFreeUs
+  bool inFlight = false;
+  bool fromHost = false;
+  uint8_t frame = 0;
+  uint64_t lineFreeUs = 0;
+
+  unsigned collisions = 0;     // Host and device on the line together
+  unsigned overruns = 0;       // RX FIFO full
+  unsigned writesDisabled = 0; // Host writes while not initialised
+
+  unsigned frameUs() const {
+    unsigned bits = 1 + dataBits + (parity != UART_PARITY_NONE) + stopBits;
+    return baud ? (bits * 1000000 + baud - 1) / baud : 1;
+  }
+
+  void toRx(uint8_t b) {
+    if (rx.size() >= FIFO_DEPTH)
+      overruns++;
+    else
+      rx.push_back(b);
+  }
+
+  void step() {
+    if (device)
+      device->step();
+    while (enabled && !breakOn && nowUs >= lineFreeUs) {
+      if (inFlight) {
+        inFlight = false;
+        if (fromHost) {
+          if (loopback)
+            toRx(frame);
+          if (device) {
+            device->baud = baud;
+            device->received(frame);
+          }
+        } else {
+          toRx(frame);
+        }
+      }
+      bool host = !tx.empty();
+      bool dev = device && !device->reply.empty();
+      if (!host && !dev)
+        break;
+      if (host && dev)
+        collisions++;
+      fromHost = host;
+      if (host) {
+        frame = tx.front();
+        tx.pop_front();
+      } else {
+        frame = device->reply.front();
+        device->reply.pop_front();
+      }
+      inFlight = true;
+      lineFreeUs = (lineFreeUs > nowUs ? lineFreeUs : nowUs) + frameUs();
+    }
+  }
+};
+
+inline UartState *uartStates() {
+  static UartState u[2];
+  return u;
+}
+
+inline UartState &uartState(uart_inst_t *uart) {
+  return uartStates()[uart->index & 1];
+}
+
+inline void attachUart(uart_inst_t *uart, UartDevice &device,
+                       bool loopback) {
+  uartState(uart).device = &device;
+  uartState(uart).loopback = loopback;
+}
+
+inline void uartStep() {
+  for (unsigned i = 0; i < 2; i++)
+    uartStates()[i].step();
+}
+
+inline void uartReset() {
+  for (unsigned i = 0; i < 2; i++)
+    uartStates()[i] = UartState();
+}
+
+inline const bool uartRegistered = addPeripheral(uartStep, uartReset);
+
+} // namespace sim
+
+inline unsigned uart_init(uart_inst_t *uart, unsigned baud) {
+  sim::UartState &u = sim::uartState(uart);
+  u.enabled = true;
+  u.baud = baud;
+  u.tx.clear();
+  u.rx.clear();
+  u.inFlight = false;
+  return baud;
+}
+inline void uart_deinit(uart_inst_t *uart) {
+  sim::UartState &u = sim::uartState(uart);
+  u.enabled = false;
+  u.tx.clear();
+  u.rx.clear();
+  u.inFlight = false;
+}
+inline unsigned uart_set_baudrate(uart_inst_t *uart, unsigned baud) {
+  sim::uartState(uart).baud = baud;
+  return baud;
+}
+inline void uart_set_format(uart_inst_t *uart, unsigned dataBits,
+                            unsigned stopBits, uart_parity_t parity) {
+  sim::UartState &u = sim::uartState(uart);
+  u.dataBits = dataBits;
+  u.stopBits = stopBits;
+  u.parity = parity;
+}
+inline void uart_set_fifo_enabled(uart_inst_t *, bool) {}
+inline void uart_set_break(uart_inst_t *uart, bool on) {
+  sim::UartState &u = sim::uartState(uart);
+  if (!u.enabled)
+    u.writesDisabled++;
+  u.breakOn = on;
+  if (u.device)
+    u.device->lineBreak(on);
+  if (!on && u.loopback)
+    u.toRx(0); // The break reads back as a NUL with a framing error
+  u.lineFreeUs = sim::nowUs;
+}
+inline bool uart_is_readable(uart_inst_t *uart) {
+  return !sim::uartState(uart).rx.empty();
+}
+inline bool uart_is_writable(uart_inst_t *uart) {
+  return sim::uartState(uart).tx.size() < sim::UartState::FIFO_DEPTH;
+}
+inline void uart_putc_raw(uart_inst_t *uart, char c) {
+  sim::UartState &u = sim::uartState(uart);
+  if (!u.enabled) {
+    u.writesDisabled++;
+    return;
+  }
+  while (u.tx.size() >= sim::UartState::FIFO_DEPTH)
+    sim::advance(1);
+  u.tx.push_back((uint8_t)c);
+}
+inline char uart_getc(uart_inst_t *uart) {
+  sim::UartState &u = sim::uartState(uart);
+  while (u.enabled && u.rx.empty())
+    sim::advance(1);
+  if (u.rx.empty())
+    return 0;
+  uint8_t b = u.rx.front();
+  u.rx.pop_front();
+  return (char)b;
+}
+inline void uart_tx_wait_blocking(uart_inst_t *uart) {
+  sim::UartState &u = sim::uartState(uart);
+  while (u.enabled && (!u.tx.empty() || (u.inFlight && u.fromHost)))
+    sim::advance(1);
+}
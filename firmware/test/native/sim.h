@@ -0,0 +1,108 @@
+#pragma once
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Simulated time and pins for the native test build
+ *
+ * Firmware only sees time move when it asks for it: every micros() call
+ * advances the clock by 1 us, delay() by the requested amount. Hardware
+ * models register a step function that runs whenever time advances or the
+ * firmware polls a peripheral, so every polling loop makes progress and
+ * every timeout eventually expires.
+ */
+namespace sim {
+
+inline uint64_t nowUs = 0;
+
+inline std::vector<std::function<void()>> &models() {
+  static std::vector<std::function<void()>> m;
+  return m;
+}
+
+/**
+ * @brief Built-in peripherals (DMA, UART FIFOs): stepped after the models,
+ * cleared by reset()
+ */
+struct Peripheral {
+  void (*step)();
+  void (*reset)();
+};
+
+inline std::vector<Peripheral> &peripherals() {
+  static std::vector<Peripheral> p;
+  return p;
+}
+
+inline bool addPeripheral(void (*step)(), void (*reset)()) {
+  peripherals().push_back({step, reset});
+  return true;
+}
+
+inline void tick() {
+  for (auto &step : models())
+    step();
+  for (auto &p : peripherals())
+    if (p.step)
+      p.step();
+}
+
+inline void advance(uint64_t us) {
+  nowUs += us;
+  tick();
+}
+
+// ============== PINS ==============
+
+constexpr uint8_t NUM_PINS = 30;
+
+struct Pins {
+  bool level[NUM_PINS] = {};  // Output latch
+  bool output[NUM_PINS] = {}; // Direction
+  bool pullUp[NUM_PINS] = {};
+
+  // Models watching the bus see every change of an output; read supplies
+  // the level of a pin they drive (-1: not driven)
+  std::function<void(uint8_t pin, bool level)> written;
+  std::function<int(uint8_t pin)> read;
+};
+
+inline Pins &pins() {
+  static Pins p;
+  return p;
+}
+
+inline void setPin(uint8_t pin, bool level) {
+  Pins &p = pins();
+  if (pin >= NUM_PINS)
+    return;
+  bool changed = p.level[pin] != level;
+  p.level[pin] = level;
+  if (changed && p.output[pin] && p.written)
+    p.written(pin, level);
+}
+
+inline bool getPin(uint8_t pin) {
+  Pins &p = pins();
+  if (pin >= NUM_PINS)
+    return false;
+  if (p.output[pin])
+    return p.level[pin];
+  int driven = p.read ? p.read(pin) : -1;
+  return driven < 0 ? p.pullUp[pin] : driven != 0;
+}
+
+/**
+ * @brief Start a test from power-on: time 0, no models, pins floating
+ */
+inline void reset() {
+  nowUs = 0;
+  models().clear();
+  pins() = Pins();
+  for (auto &p : peripherals())
+    if (p.reset)
+      p.reset();
+}
+
+} // namespace sim
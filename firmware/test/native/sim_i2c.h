@@ -0,0 +1,194 @@
+#pragma once
+#include <hardware/pio.h>
+#include <stdint.h>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief 24Cxx-style slave: two address bytes set the pointer, then data is
+ * stored / returned at pointer++ (wrapping at the memory size)
+ */
+struct I2cMemory {
+  uint8_t address;
+  std::vector<uint8_t> mem;
+  uint16_t pointer = 0;
+  uint16_t ackLimit = 0xFFFF; // Data bytes ACKed per write (then NAK)
+  unsigned stretchTicks = 0;  // SCL held low before every byte
+
+  // Bytes received in each write transaction (pointer bytes included)
+  std::vector<std::vector<uint8_t>> writes;
+
+  I2cMemory(uint8_t addr, size_t size) : address(addr), mem(size, 0xFF) {}
+};
+
+/**
+ * @brief PIO I2C program model (see pio_i2c.cpp) on a bus of I2cMemory
+ * slaves
+ *
+ * Records are taken from the TX FIFO one per step: an instruction header
+ * and the instructions after it (SET pindirs with SCL side-set, decoded to
+ * START / STOP), or a byte record. A byte record needs room in the RX FIFO
+ * when autopush is on: with the FIFO full the machine stalls mid-byte and
+ * never reports TXSTALL. A NAK on a record without NakOk raises the IRQ
+ * flag and stops the machine until the firmware jumps it back (exec).
+ */
+class PioI2cBus : public PioModel {
+public:
+  std::vector<I2cMemory *> devices;
+
+  unsigned starts = 0;
+  unsigned stops = 0;
+  unsigned errors = 0; // Byte records outside START..STOP, bad instructions
+  std::vector<uint8_t> addressed; // Address bytes seen after each START
+
+  bool idle() const { return phase == Phase::IDLE && sda && scl; }
+
+  void exec(uint16_t) override {
+    // Only ever a jump back to the entry point
+    halted = false;
+    execLeft = 0;
+  }
+
+  void step() override {
+    if (halted)
+      return;
+    if (tx.empty()) {
+      txStall = true;
+      return;
+    }
+    uint16_t rec = tx.front() >> 16;
+    if (execLeft) {
+      tx.pop_front();
+      execLeft--;
+      instruction(rec);
+      return;
+    }
+    unsigned icount = rec >> 10;
+    if (icount) {
+      tx.pop_front();
+      execLeft = icount + 1;
+      return;
+    }
+    if (current && current->stretchTicks && stretched < current->stretchTicks) {
+      stretched++;
+      return; // Slave holds SCL low: the machine waits on the pin
+    }
+    if (config.autopush && rxFull())
+      return; // Stalled on the autopush of the 8th bit
+    tx.pop_front();
+    stretched = 0;
+    byteRecord(rec);
+  }
+
+private:
+  enum class Phase { IDLE, ADDRESS, WRITE, READ, IGNORE };
+  Phase phase = Phase::IDLE;
+  bool sda = true, scl = true;
+  bool halted = false;
+  unsigned execLeft = 0;
+  unsigned stretched = 0;
+  I2cMemory *current = nullptr;
+  unsigned received = 0; // Bytes of the current write
+
+  void instruction(uint16_t instr) {
+    // set pindirs, <sda> side <scl>: 111 1 s ddd 100 0000d
+    if ((instr & 0xF0FE) != 0xF080) {
+      errors++;
+      return;
+    }
+    bool newSda = instr & 1;
+    bool newScl = instr & 0x0800;
+    if (scl && newScl && sda != newSda) {
+      if (newSda)
+        stop();
+      else
+        start();
+    }
+    sda = newSda;
+    scl = newScl;
+  }
+
+  void start() {
+    starts++;
+    phase = Phase::ADDRESS;
+    current = nullptr;
+  }
+
+  void stop() {
+    stops++;
+    phase = Phase::IDLE;
+    current = nullptr;
+  }
+
+  void byteRecord(uint16_t rec) {
+    uint8_t out = rec >> 1;
+    bool ackOut = rec & 1;
+    bool nakOk = rec & 0x200;
+    if (phase == Phase::IDLE) {
+      errors++;
+      finish(0xFF, ackOut, true, nakOk);
+      return;
+    }
+
+    // Data bits: wired AND of the master and a transmitting slave
+    uint8_t line = out;
+    if (phase == Phase::READ)
+      line &= current->mem[current->pointer % current->mem.size()];
+
+    bool slaveAck = false;
+    switch (phase) {
+    case Phase::ADDRESS:
+      addressed.push_back(line);
+      for (I2cMemory *d : devices)
+        if (d->address == line >> 1)
+          current = d;
+      if (!current) {
+        phase = Phase::IGNORE;
+        break;
+      }
+      slaveAck = true;
+      if (line & 1) {
+        phase = Phase::READ;
+      } else {
+        phase = Phase::WRITE;
+        current->writes.emplace_back();
+        received = 0;
+      }
+      break;
+    case Phase::WRITE:
+      current->writes.back().push_back(line);
+      if (received < 2) {
+        current->pointer = received ? (current->pointer & 0xFF00) | line
+                                    : line << 8;
+      } else if (received - 2 < current->ackLimit) {
+        current->mem[current->pointer++ % current->mem.size()] = line;
+      }
+      slaveAck = received < 2 || received - 2 < current->ackLimit;
+      received++;
+      break;
+    case Phase::READ:
+      current->pointer++;
+      if (ackOut)
+        phase = Phase::IGNORE; // Master NAK: the slave lets go of SDA
+      break;
+    default:
+      break;
+    }
+    finish(line, ackOut, ackOut && !slaveAck, nakOk);
+  }
+
+  void finish(uint8_t line, bool ackOut, bool nak, bool nakOk) {
+    if (config.autopush)
+      rx.push_back(line);
+    // SCL low after the ACK clock, SDA as the master left it
+    scl = false;
+    sda = ackOut;
+    if (nak && !nakOk) {
+      irq = true;
+      halted = true;
+    }
+  }
+};
+
+} // namespace sim
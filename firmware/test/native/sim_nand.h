@@ -0,0 +1,500 @@
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief SPI NAND on the bit-banged QSPI pins (CS 17, CLK 18, IO0 19,
+ * IO1 16, IO2 21, IO3 22), decoded edge by edge
+ *
+ * Inputs are sampled and outputs presented on the rising CLK edge, so the
+ * driver reads them while CLK is high. The opcode and address go on IO0;
+ * data phases of the x4 opcodes (0x6B, 0x32) use all four wires. A wire
+ * the host still drives while the chip outputs is counted as contention.
+ *
+ * Two personalities: WINBOND (W25N01GV) with the BUF bit, where a cache
+ * read with BUF = 0 has no column and streams the main area of page after
+ * page under one CS; MICRON (MT29F1G01ABAFD) with Page Read Cache
+ * Sequential, where 0x31 moves the data register to the cache and loads
+ * the next row while CRBSY is set. Array effects are immediate, busy
+ * (OIP / CRBSY) is reported for readUs / progUs / eraseUs. Commands other
+ * than Get Feature and Reset while OIP is set, or anything but a cache
+ * read while CRBSY is set, are violations, as is a program or erase
+ * without WEL or with blocks still protected.
+ *
+ * Pages are stored sparsely (unwritten pages read as 0xFF). Programming
+ * only clears bits; rows in failRows and blocks in failBlocks report
+ * P_FAIL / E_FAIL and stay unchanged.
+ *
+ * The bit-banged bus itself takes no simulated time unless clockNs is set:
+ * every CLK cycle then moves the clock on by that much (without stepping
+ * the models), the way a transfer delays everything else on the core.
+ */
+class SpiNand {
+public:
+  enum class Vendor { WINBOND, MICRON };
+
+  static constexpr uint8_t PIN_CS = 17, PIN_CLK = 18;
+  static constexpr uint8_t PIN_IO[4] = {19, 16, 21, 22};
+
+  static constexpr uint16_t PAGE = 2048, PAGES_PER_BLOCK = 64;
+  static constexpr uint16_t BLOCKS = 1024;
+
+  static constexpr uint8_t SR_OIP = 0x01, SR_WEL = 0x02, SR_E_FAIL = 0x04,
+                           SR_P_FAIL = 0x08, SR_CRBSY = 0x80;
+  static constexpr uint8_t CFG_BUF = 0x08;
+
+  const Vendor vendor;
+  const uint16_t spare;
+  uint32_t readUs = 25, cacheUs = 3, progUs = 250, eraseUs = 2000,
+           resetUs = 100;
+  uint32_t clockNs = 0; // Bus time per CLK cycle
+
+  std::set<uint32_t> failRows;   // Program Execute fails
+  std::set<uint16_t> failBlocks; // Block Erase fails
+
+  uint8_t protect = 0x7C; // All blocks locked after power-up
+  uint8_t config;
+
+  // Observations
+  unsigned violations = 0;
+  unsigned contention = 0;
+  unsigned programs = 0; // Successful Program Execute
+  unsigned erases = 0;   // Successful Block Erase
+  struct Stream {
+    uint32_t row;   // First row of a continuous read
+    uint32_t bytes; // Bytes clocked out before CS went high
+  };
+  std::vector<Stream> streams;
+
+  SpiNand(Vendor v)
+      : vendor(v), spare(v == Vendor::WINBOND ? 64 : 128),
+        config(v == Vendor::WINBOND ? 0x18 : 0x10), cache(PAGE + spare, 0xFF) {
+    pins().written = [this](uint8_t pin, bool level) { edge(pin, level); };
+    pins().read = [this](uint8_t pin) { return drive(pin); };
+  }
+
+  uint16_t pageLen() const { return PAGE + spare; }
+
+  /**
+   * @brief Page contents (main + spare), created erased on first use
+   */
+  std::vector<uint8_t> &page(uint32_t row) {
+    auto it = array.find(row);
+    if (it == array.end())
+      it = array.emplace(row, std::vector<uint8_t>(pageLen(), 0xFF)).first;
+    return it->second;
+  }
+
+  bool isErased(uint32_t row) const { return !array.count(row); }
+
+  /**
+   * @brief Factory bad block: first spare byte of its first page is 0x00
+   */
+  void markFactoryBad(uint16_t block) {
+    page((uint32_t)block * PAGES_PER_BLOCK)[PAGE] = 0x00;
+  }
+
+  bool selected() const { return cs; }
+
+  uint8_t status() const {
+    uint8_t sr = fail | (wel ? SR_WEL : 0);
+    if (nowUs < oipUntil)
+      sr |= SR_OIP;
+    if (vendor == Vendor::MICRON && nowUs < crbsyUntil)
+      sr |= SR_CRBSY;
+    return sr;
+  }
+
+private:
+  enum Phase { OPCODE, ADDR, DUMMY, DATA_IN, DATA_OUT, IGNORE };
+
+  std::map<uint32_t, std::vector<uint8_t>> array;
+  std::vector<uint8_t> cache;
+  uint32_t dataRow = 0; // Row in the data register (Micron pipeline)
+  bool wel = false;
+  uint8_t fail = 0; // E_FAIL / P_FAIL of the last operation
+  uint64_t oipUntil = 0, crbsyUntil = 0;
+  uint32_t busNs = 0; // clockNs not yet added to nowUs
+
+  // Transaction state
+  bool cs = false, clk = false;
+  uint8_t opcode = 0;
+  Phase phase = IGNORE;
+  bool rejected = false;    // Opcode not accepted in the busy state
+  unsigned pendingDummy = 0;
+  unsigned phaseClocks = 0; // Clocks left in ADDR / DUMMY
+  unsigned wires = 1;       // Data phase width
+  uint32_t addr = 0;
+  uint8_t shift = 0, shiftBits = 0;
+  uint8_t out = 0, outBits = 0;
+  uint8_t driven = 0; // Levels presented on IO0..IO3
+  bool driving = false;
+  std::vector<uint8_t> dataIn;
+  uint16_t column = 0;
+  bool continuous = false;
+
+  bool busy() const { return nowUs < oipUntil; }
+  bool cacheBusy() const { return nowUs < crbsyUntil; }
+
+  void load(uint32_t row) {
+    auto it = array.find(row);
+    if (it == array.end())
+      std::fill(cache.begin(), cache.end(), 0xFF);
+    else
+      cache = it->second;
+  }
+
+  int drive(uint8_t pin) const {
+    if (!driving)
+      return -1;
+    for (unsigned i = 0; i < 4; i++)
+      if (PIN_IO[i] == pin && (wires == 4 || i == 1))
+        return (driven >> i) & 1;
+    return -1;
+  }
+
+  void edge(uint8_t pin, bool level) {
+    if (pin == PIN_CS) {
+      if (!level && !cs)
+        select();
+      else if (level && cs)
+        deselect();
+      cs = !level;
+    } else if (pin == PIN_CLK) {
+      if (level && !clk && cs) {
+        busNs += clockNs;
+        nowUs += busNs / 1000;
+        busNs %= 1000;
+        rising();
+      }
+      clk = level;
+    }
+  }
+
+  void select() {
+    opcode = 0;
+    phase = OPCODE;
+    rejected = false;
+    phaseClocks = 8;
+    wires = 1;
+    addr = 0;
+    shift = shiftBits = 0;
+    outBits = 0;
+    driving = false;
+    dataIn.clear();
+    continuous = false;
+  }
+
+  bool sample(unsigned bit) {
+    uint8_t p = PIN_IO[bit];
+    if (!pins().output[p]) {
+      violations++; // Nobody drives the wire
+      return false;
+    }
+    return pins().level[p];
+  }
+
+  void rising() {
+    switch (phase) {
+    case OPCODE:
+    case ADDR: {
+      shift = (shift << 1) | sample(0);
+      if (++shiftBits == 8) {
+        if (phase == OPCODE)
+          opcode = shift;
+        else
+          addr = (addr << 8) | shift;
+        shiftBits = 0;
+      }
+      if (--phaseClocks == 0) {
+        if (phase == OPCODE)
+          command();
+        else
+          next();
+      }
+      break;
+    }
+    case DUMMY:
+      if (--phaseClocks == 0)
+        next();
+      break;
+    case DATA_IN: {
+      uint8_t bits = 0;
+      for (unsigned i = 0; i < wires; i++)
+        bits |= sample(i) << i;
+      shift = (shift << wires) | bits;
+      shiftBits += wires;
+      if (shiftBits == 8) {
+        dataIn.push_back(shift);
+        shiftBits = 0;
+      }
+      break;
+    }
+    case DATA_OUT: {
+      for (unsigned i = 0; i < 4; i++)
+        if ((wires == 4 || i == 1) && pins().output[PIN_IO[i]])
+          contention++;
+      if (outBits == 0) {
+        out = produce();
+        outBits = 8;
+      }
+      outBits -= wires;
+      driven = (out >> outBits) & ((1u << wires) - 1);
+      if (wires == 1)
+        driven <<= 1; // IO1
+      driving = true;
+      break;
+    }
+    case IGNORE:
+      break;
+    }
+  }
+
+  // Address / dummy layout of each opcode, checked against the busy state
+  void command() {
+    bool allowed = !busy() || opcode == 0x0F || opcode == 0xFF;
+    if (allowed && cacheBusy())
+      allowed = opcode == 0x0F || opcode == 0xFF || opcode == 0x0B ||
+                opcode == 0x6B || opcode == 0x31 || opcode == 0x3F;
+    if (!allowed) {
+      violations++;
+      rejected = true;
+      phase = IGNORE;
+      return;
+    }
+    unsigned a = 0, dummy = 0;
+    switch (opcode) {
+    case 0x9F: // Read ID
+      dummy = 8;
+      break;
+    case 0x0F: // Get Feature
+    case 0x1F: // Set Feature
+      a = 8;
+      break;
+    case 0x13: // Page Read
+    case 0x10: // Program Execute
+    case 0xD8: // Block Erase
+      a = 24;
+      break;
+    case 0x0B:
+    case 0x6B:
+      continuous = vendor == Vendor::WINBOND && !(config & CFG_BUF);
+      if (continuous) {
+        dummy = 32;
+      } else {
+        a = 16;
+        dummy = 8;
+      }
+      break;
+    case 0x02:
+    case 0x32:
+      a = 16;
+      break;
+    }
+    if (a) {
+      phase = ADDR;
+      phaseClocks = a;
+    } else if (dummy) {
+      phase = DUMMY;
+      phaseClocks = dummy;
+    } else {
+      next();
+      return;
+    }
+    pendingDummy = a ? dummy : 0;
+  }
+
+  // Address phase done (or none): dummy clocks, then the data phase
+  void next() {
+    if (phase == ADDR && pendingDummy) {
+      phase = DUMMY;
+      phaseClocks = pendingDummy;
+      pendingDummy = 0;
+      return;
+    }
+    shiftBits = 0;
+    switch (opcode) {
+    case 0x9F:
+    case 0x0F:
+      phase = DATA_OUT;
+      wires = 1;
+      column = 0;
+      break;
+    case 0x0B:
+    case 0x6B:
+      phase = DATA_OUT;
+      wires = opcode == 0x6B ? 4 : 1;
+      column = continuous ? 0 : (addr & 0x0FFF);
+      if (continuous)
+        streams.push_back({dataRow, 0});
+      break;
+    case 0x1F:
+    case 0x02:
+    case 0x32:
+      phase = DATA_IN;
+      wires = opcode == 0x32 ? 4 : 1;
+      if (opcode != 0x1F) {
+        // Program Load: cache back to 0xFF, data from the column
+        std::fill(cache.begin(), cache.end(), 0xFF);
+        column = addr & 0x0FFF;
+      }
+      break;
+    default:
+      phase = IGNORE;
+      break;
+    }
+  }
+
+  uint8_t produce() {
+    switch (opcode) {
+    case 0x9F: {
+      static const uint8_t winbond[] = {0xEF, 0xAA, 0x21};
+      static const uint8_t micron[] = {0x2C, 0x14, 0x00};
+      const uint8_t *id = vendor == Vendor::WINBOND ? winbond : micron;
+      unsigned i = column++;
+      return i < 3 ? id[i] : 0xFF;
+    }
+    case 0x0F:
+      switch (addr & 0xFF) {
+      case 0xA0:
+        return protect;
+      case 0xB0:
+        return config;
+      case 0xC0:
+        return status();
+      }
+      return 0;
+    default: // Cache read
+      if (!continuous)
+        return column < cache.size() ? cache[column++] : 0xFF;
+      streams.back().bytes++;
+      {
+        uint8_t b = cache[column++];
+        if (column == PAGE) {
+          // Main area only: the next row follows without a busy phase
+          load(++dataRow);
+          column = 0;
+        }
+        return b;
+      }
+    }
+  }
+
+  // CS high: commands without a data phase and data-in commands take effect
+  void deselect() {
+    driving = false;
+    if (rejected || (phase == OPCODE && phaseClocks == 8))
+      return;
+    if (phase == OPCODE || phase == ADDR || phase == DUMMY) {
+      violations++; // Cut short
+      return;
+    }
+    switch (opcode) {
+    case 0xFF: // Reset
+      wel = false;
+      fail = 0;
+      crbsyUntil = 0;
+      oipUntil = nowUs + resetUs;
+      break;
+    case 0x06:
+      wel = true;
+      break;
+    case 0x04:
+      wel = false;
+      break;
+    case 0x1F:
+      if (dataIn.size() != 1) {
+        violations++;
+        break;
+      }
+      switch (addr & 0xFF) {
+      case 0xA0:
+        protect = dataIn[0];
+        break;
+      case 0xB0:
+        config = dataIn[0];
+        break;
+      }
+      break;
+    case 0x13:
+      dataRow = addr & 0xFFFFFF;
+      load(dataRow);
+      oipUntil = nowUs + readUs;
+      break;
+    case 0x31:
+    case 0x3F: {
+      if (vendor != Vendor::MICRON) {
+        violations++;
+        break;
+      }
+      // Data register -> cache once the row in flight has arrived
+      uint64_t start = crbsyUntil > nowUs ? crbsyUntil : nowUs;
+      load(dataRow);
+      oipUntil = start + cacheUs;
+      if (opcode == 0x31) {
+        dataRow++;
+        crbsyUntil = oipUntil + readUs;
+      }
+      break;
+    }
+    case 0x02:
+    case 0x32:
+      if (!wel)
+        violations++;
+      for (uint8_t b : dataIn)
+        if (column < cache.size())
+          cache[column++] = b;
+      break;
+    case 0x10:
+      execute(addr & 0xFFFFFF);
+      break;
+    case 0xD8:
+      erase(addr & 0xFFFFFF);
+      break;
+    }
+  }
+
+  void execute(uint32_t row) {
+    if (!wel || protect) {
+      violations++;
+      return;
+    }
+    wel = false;
+    oipUntil = nowUs + progUs;
+    fail = 0;
+    if (row / PAGES_PER_BLOCK >= BLOCKS || failRows.count(row)) {
+      fail = SR_P_FAIL;
+      return;
+    }
+    std::vector<uint8_t> &p = page(row);
+    for (unsigned i = 0; i < p.size(); i++)
+      p[i] &= cache[i];
+    programs++;
+  }
+
+  void erase(uint32_t row) {
+    if (!wel || protect) {
+      violations++;
+      return;
+    }
+    wel = false;
+    oipUntil = nowUs + eraseUs;
+    fail = 0;
+    uint16_t block = row / PAGES_PER_BLOCK;
+    if (block >= BLOCKS || failBlocks.count(block)) {
+      fail = SR_E_FAIL;
+      return;
+    }
+    for (uint32_t r = 0; r < PAGES_PER_BLOCK; r++)
+      array.erase((uint32_t)block * PAGES_PER_BLOCK + r);
+    erases++;
+  }
+};
+
+} // namespace sim
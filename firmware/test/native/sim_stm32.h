@@ -0,0 +1,472 @@
+#pragma once
+#include "sim_swd.h"
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief STM32F1 / F4 behind the MEM-AP: SRAM, main flash with its flash
+ * interface, the Cortex-M debug registers and a Thumb-1 core
+ *
+ * The flash interface follows the reference manuals closely enough for the
+ * loader: KEY1 / KEY2 unlock CR (a wrong key locks it until reset), PG
+ * programs one unit per write (halfword on F1, PSIZE on F4) after progUs
+ * of BSY, MER + STRT mass-erases after eraseUs. A write of the wrong width,
+ * into the write-protected range or (F1) over a halfword that is not
+ * erased sets the SR error bits instead. A system reset (AIRCR) holds the
+ * bus for resetUs, re-locks the flash and either halts on the reset vector
+ * (DEMCR.VC_CORERESET with C_DEBUGEN) or starts the application.
+ *
+ * The core executes the Thumb-1 subset the loader stub uses from SRAM on
+ * every tick while it runs; BKPT halts it. Anything else (an unknown
+ * opcode, a bus error, running without the Thumb bit) is a core fault and
+ * stops it.
+ */
+class Stm32Target : public SwdMemory {
+public:
+  enum class Family { F1, F4 };
+
+  static constexpr uint32_t FLASH_BASE = 0x08000000;
+  static constexpr uint32_t SRAM_BASE = 0x20000000, SRAM_SIZE = 0x10000;
+
+  Family family;
+  uint16_t devId;
+  std::vector<uint8_t> flash, sram;
+  uint32_t wrpStart = 0, wrpEnd = 0; // Write-protected flash offsets
+
+  uint32_t progUs = 40;
+  uint32_t eraseUs = 20000;
+  uint32_t resetUs = 300;
+  unsigned instructionsPerTick = 4;
+
+  // Observations
+  unsigned programmed = 0; // Flash units written
+  unsigned massErases = 0;
+  unsigned coreFaults = 0;
+  unsigned violations = 0; // Debug / flash accesses a real part would reject
+  unsigned appStarts = 0;
+  bool halted = true;
+  bool appRunning = false;
+  uint32_t reg[17] = {0}; // r0 - r15, xPSR (flags only)
+  std::vector<uint32_t> hostReads; // SRAM word addresses read over SWD
+
+  Stm32Target(Family f, uint32_t flashKb)
+      : family(f), devId(f == Family::F1 ? 0x410 : 0x413),
+        flash(flashKb * 1024, 0xFF), sram(SRAM_SIZE, 0),
+        flashKb(flashKb) {
+    flashReset();
+  }
+
+  uint32_t flashCr() const { return cr; }
+  uint32_t flashSr() const { return sr; }
+
+  // Run the core (register with sim::models)
+  void step() {
+    if (resetEndUs && nowUs >= resetEndUs)
+      resetDone();
+    if (busyEndUs && nowUs >= busyEndUs)
+      flashDone();
+    for (unsigned i = 0; i < instructionsPerTick && !halted && !appRunning &&
+                         !resetEndUs;
+         i++)
+      execute();
+  }
+
+  bool read(uint32_t addr, uint8_t size, uint32_t &lanes) override {
+    uint32_t v;
+    if (!load(addr, size, v, true))
+      return false;
+    lanes = v << (addr & 3) * 8;
+    return true;
+  }
+
+  bool write(uint32_t addr, uint8_t size, uint32_t lanes) override {
+    uint32_t v = lanes >> (addr & 3) * 8;
+    if (size < 4)
+      v &= (1u << size * 8) - 1;
+    return store(addr, size, v, true);
+  }
+
+private:
+  uint32_t flashKb;
+
+  // Debug
+  bool debugEn = false;
+  bool vcCoreReset = false;
+  bool regReady = true;
+  uint32_t dcrdr = 0;
+  uint64_t resetEndUs = 0;
+
+  // Flash interface
+  uint32_t cr = 0, sr = 0;
+  unsigned keyStep = 0;
+  bool keyLockout = false;
+  uint64_t busyEndUs = 0;
+  bool eraseAll = false;
+  uint32_t pendingOffset = 0, pendingValue = 0;
+  uint8_t pendingSize = 0;
+
+  bool f1() const { return family == Family::F1; }
+  uint32_t regBase() const { return f1() ? 0x40022000 : 0x40023C00; }
+  uint32_t srBusy() const { return f1() ? 0x01 : 0x10000; }
+  uint32_t srEop() const { return f1() ? 0x20 : 0x01; }
+  uint32_t srPgErr() const { return 0x04; } // F1 PGERR
+  uint32_t srWrpErr() const { return 0x10; }
+  uint32_t srWidthErr() const { return f1() ? 0x04 : 0x40; } // PGPERR
+  uint32_t srErrors() const { return f1() ? 0x14 : 0xF2; }
+  uint32_t crLock() const { return f1() ? 0x80 : 0x80000000; }
+  uint32_t crStart() const { return f1() ? 0x40 : 0x10000; }
+  uint8_t programWidth() const {
+    return f1() ? 2 : 1 << (cr >> 8 & 3); // PSIZE
+  }
+
+  // ============== RESET ==============
+
+  void flashReset() {
+    cr = crLock();
+    sr = 0;
+    keyStep = 0;
+    keyLockout = false;
+    busyEndUs = 0;
+  }
+
+  void systemReset() {
+    resetEndUs = nowUs + resetUs;
+    flashReset();
+    halted = false;
+    appRunning = false;
+  }
+
+  void resetDone() {
+    resetEndUs = 0;
+    if (debugEn && vcCoreReset) {
+      halted = true;
+    } else {
+      appRunning = true;
+      appStarts++;
+    }
+  }
+
+  // ============== FLASH INTERFACE ==============
+
+  void flashDone() {
+    busyEndUs = 0;
+    if (eraseAll) {
+      std::fill(flash.begin(), flash.end(), 0xFF);
+      massErases++;
+      eraseAll = false;
+    } else {
+      // Programming only clears bits
+      for (unsigned i = 0; i < pendingSize; i++)
+        flash[pendingOffset + i] &= pendingValue >> 8 * i;
+      programmed++;
+    }
+    sr = (sr & ~srBusy()) | srEop();
+  }
+
+  bool flashRegWrite(uint32_t off, uint32_t v) {
+    switch (off) {
+    case 0x04: // KEYR
+      if (keyLockout || !(cr & crLock())) {
+        keyLockout = true;
+      } else if (keyStep == 0 && v == 0x45670123) {
+        keyStep = 1;
+      } else if (keyStep == 1 && v == 0xCDEF89AB) {
+        cr &= ~crLock();
+        keyStep = 0;
+      } else {
+        keyLockout = true; // Locked until the next reset
+      }
+      return true;
+    case 0x0C: // SR: error and EOP bits are write-1-to-clear
+      sr &= ~(v & (srErrors() | srEop()));
+      return true;
+    case 0x10: // CR
+      if (cr & crLock()) {
+        if (v & crLock())
+          return true;
+        violations++; // Written while locked: ignored
+        return true;
+      }
+      if (sr & srBusy()) {
+        violations++;
+        return true;
+      }
+      cr = v;
+      if ((v & 0x04) && (v & crStart())) {
+        eraseAll = true;
+        sr |= srBusy();
+        busyEndUs = nowUs + eraseUs;
+      }
+      return true;
+    }
+    return true;
+  }
+
+  bool flashWrite(uint32_t off, uint8_t size, uint32_t v) {
+    if ((cr & crLock()) || !(cr & 0x01)) {
+      violations++; // No PG: a real part faults the bus
+      return false;
+    }
+    if (sr & srBusy()) {
+      violations++;
+      return true; // Stalls on silicon; the stub always polls BSY
+    }
+    if (size != programWidth()) {
+      sr |= srWidthErr();
+      return true;
+    }
+    if (off >= wrpStart && off < wrpEnd) {
+      sr |= srWrpErr();
+      return true;
+    }
+    // F1 refuses to program a halfword that is not erased
+    if (f1() && (flash[off] & flash[off + 1]) != 0xFF) {
+      sr |= srPgErr();
+      return true;
+    }
+    pendingOffset = off;
+    pendingValue = v;
+    pendingSize = size;
+    sr |= srBusy();
+    busyEndUs = nowUs + progUs;
+    return true;
+  }
+
+  // ============== BUS ==============
+
+  bool inFlash(uint32_t addr, uint8_t size) const {
+    return addr >= FLASH_BASE && addr + size <= FLASH_BASE + flash.size();
+  }
+  bool inSram(uint32_t addr, uint8_t size) const {
+    return addr >= SRAM_BASE && addr + size <= SRAM_BASE + SRAM_SIZE;
+  }
+
+  bool load(uint32_t addr, uint8_t size, uint32_t &v, bool host) {
+    if (resetEndUs && host)
+      return false; // Held in reset
+    v = 0;
+    if (inSram(addr, size)) {
+      if (host && size == 4)
+        hostReads.push_back(addr);
+      memcpy(&v, &sram[addr - SRAM_BASE], size);
+      return true;
+    }
+    if (inFlash(addr, size)) {
+      memcpy(&v, &flash[addr - FLASH_BASE], size);
+      return true;
+    }
+    uint32_t sizeReg = f1() ? 0x1FFFF7E0 : 0x1FFF7A22;
+    if (addr == sizeReg) {
+      v = flashKb;
+      return true;
+    }
+    if (addr == 0xE0042000) {
+      v = devId | 0x10000000;
+      return true;
+    }
+    if (addr == regBase() + 0x0C) {
+      v = sr;
+      return true;
+    }
+    if (addr == regBase() + 0x10) {
+      v = cr;
+      return true;
+    }
+    if (addr == 0xE000EDF0) {
+      v = (debugEn ? 0x01 : 0) | (halted ? 0x02 : 0) |
+          (regReady ? 1u << 16 : 0) | (halted ? 1u << 17 : 0);
+      return true;
+    }
+    if (addr == 0xE000EDF8) {
+      v = dcrdr;
+      return true;
+    }
+    if (addr == 0xE000EDFC) {
+      v = vcCoreReset ? 1 : 0;
+      return true;
+    }
+    return false;
+  }
+
+  bool store(uint32_t addr, uint8_t size, uint32_t v, bool host) {
+    if (resetEndUs && host)
+      return false;
+    if (inSram(addr, size)) {
+      memcpy(&sram[addr - SRAM_BASE], &v, size);
+      return true;
+    }
+    if (inFlash(addr, size))
+      return flashWrite(addr - FLASH_BASE, size, v);
+    if (addr >= regBase() && addr < regBase() + 0x20)
+      return flashRegWrite(addr - regBase(), v);
+    switch (addr) {
+    case 0xE000EDF0: // DHCSR
+      if ((v & 0xFFFF0000) != 0xA05F0000)
+        return true; // No key: ignored
+      debugEn = v & 0x01;
+      if (v & 0x02) {
+        halted = true;
+      } else if (halted) {
+        halted = false;
+        if (!(reg[16] & 0x01000000)) {
+          coreFaults++; // Thumb bit clear
+          halted = true;
+        }
+      }
+      return true;
+    case 0xE000EDF4: // DCRSR
+      if (!halted) {
+        violations++;
+        return true;
+      }
+      if ((v & 0x1F) <= 16 && (v & 0x10000))
+        reg[v & 0x1F] = dcrdr;
+      else if ((v & 0x1F) <= 16)
+        dcrdr = reg[v & 0x1F];
+      return true;
+    case 0xE000EDF8:
+      dcrdr = v;
+      return true;
+    case 0xE000EDFC:
+      vcCoreReset = v & 0x01;
+      return true;
+    case 0xE000ED0C: // AIRCR
+      if (v == 0x05FA0004)
+        systemReset();
+      return true;
+    }
+    return false;
+  }
+
+  // ============== CORE ==============
+
+  enum { N = 1u << 31, Z = 1u << 30, C = 1u << 29, V = 1u << 28 };
+
+  void fault() {
+    coreFaults++;
+    halted = true;
+  }
+
+  void setNZ(uint32_t r) {
+    reg[16] = (reg[16] & ~(N | Z)) | (r & N) | (r ? 0 : Z);
+  }
+
+  uint32_t addFlags(uint32_t a, uint32_t b, bool carry) {
+    uint64_t wide = (uint64_t)a + b + carry;
+    uint32_t r = (uint32_t)wide;
+    setNZ(r);
+    reg[16] &= ~(C | V);
+    if (wide >> 32)
+      reg[16] |= C;
+    if (((a ^ r) & (b ^ r)) >> 31)
+      reg[16] |= V;
+    return r;
+  }
+
+  bool condition(unsigned cond) const {
+    uint32_t f = reg[16];
+    bool n = f & N, z = f & Z, c = f & C, v = f & V;
+    switch (cond) {
+    case 0x0: return z;
+    case 0x1: return !z;
+    case 0x2: return c;
+    case 0x3: return !c;
+    case 0x4: return n;
+    case 0x5: return !n;
+    case 0xA: return n == v;
+    case 0xB: return n != v;
+    case 0xC: return !z && n == v;
+    case 0xD: return z || n != v;
+    default: return false;
+    }
+  }
+
+  bool coreLoad(uint32_t addr, uint8_t size, uint32_t &v) {
+    if ((addr & (size - 1)) || !load(addr, size, v, false)) {
+      fault();
+      return false;
+    }
+    return true;
+  }
+
+  void coreStore(uint32_t addr, uint8_t size, uint32_t v) {
+    if ((addr & (size - 1)) || !store(addr, size, v, false))
+      fault();
+  }
+
+  void execute() {
+    uint32_t pc = reg[15];
+    uint32_t fetched;
+    if (!inSram(pc, 2) || (pc & 1)) {
+      fault();
+      return;
+    }
+    memcpy(&fetched, &sram[pc - SRAM_BASE], 2);
+    uint16_t op = fetched & 0xFFFF;
+    reg[15] = pc + 2;
+    uint32_t target = pc + 4; // PC as read by the instruction
+    unsigned rd = op & 7, rn = op >> 3 & 7, rm = op >> 6 & 7;
+    uint32_t v;
+
+    if ((op & 0xF800) == 0x6800) { // LDR Rt, [Rn, #imm5 * 4]
+      if (coreLoad(reg[rn] + (op >> 6 & 0x1F) * 4, 4, v))
+        reg[rd] = v;
+    } else if ((op & 0xF800) == 0x6000) { // STR
+      coreStore(reg[rn] + (op >> 6 & 0x1F) * 4, 4, reg[rd]);
+    } else if ((op & 0xF800) == 0x8800) { // LDRH
+      if (coreLoad(reg[rn] + (op >> 6 & 0x1F) * 2, 2, v))
+        reg[rd] = v;
+    } else if ((op & 0xF800) == 0x8000) { // STRH
+      coreStore(reg[rn] + (op >> 6 & 0x1F) * 2, 2, reg[rd] & 0xFFFF);
+    } else if ((op & 0xF800) == 0x2000) { // MOVS Rd, #imm8
+      reg[op >> 8 & 7] = op & 0xFF;
+      setNZ(op & 0xFF);
+    } else if ((op & 0xF800) == 0x2800) { // CMP Rn, #imm8
+      addFlags(reg[op >> 8 & 7], ~(uint32_t)(op & 0xFF), true);
+    } else if ((op & 0xFE00) == 0x1800) { // ADDS Rd, Rn, Rm
+      reg[rd] = addFlags(reg[rn], reg[rm], false);
+    } else if ((op & 0xFE00) == 0x1A00) { // SUBS Rd, Rn, Rm
+      reg[rd] = addFlags(reg[rn], ~reg[rm], true);
+    } else if ((op & 0xF800) == 0x0000) { // LSLS Rd, Rm, #imm5
+      unsigned sh = op >> 6 & 0x1F;
+      uint32_t m = reg[rn];
+      if (sh) {
+        reg[16] = (reg[16] & ~C) | ((m >> (32 - sh)) & 1 ? C : 0);
+        m <<= sh;
+      }
+      reg[rd] = m;
+      setNZ(m);
+    } else if ((op & 0xFC00) == 0x4000) { // Data processing
+      uint32_t &dn = reg[rd];
+      uint32_t m = reg[rn];
+      switch (op >> 6 & 0xF) {
+      case 0x0: dn &= m; setNZ(dn); break;   // ANDS
+      case 0x1: dn ^= m; setNZ(dn); break;   // EORS
+      case 0x8: setNZ(dn & m); break;        // TST
+      case 0xA: addFlags(dn, ~m, true); break; // CMP
+      case 0xC: dn |= m; setNZ(dn); break;   // ORRS
+      default: fault(); return;
+      }
+    } else if ((op & 0xF000) == 0xD000 && (op & 0x0F00) < 0x0E00) { // B<c>
+      if (condition(op >> 8 & 0xF))
+        reg[15] = target + (int8_t)(op & 0xFF) * 2;
+    } else if ((op & 0xF800) == 0xE000) { // B
+      int32_t off = op & 0x7FF;
+      if (off & 0x400)
+        off -= 0x800;
+      reg[15] = target + off * 2;
+    } else if ((op & 0xFF00) == 0xBE00) { // BKPT
+      reg[15] = pc;
+      halted = true;
+    } else {
+      reg[15] = pc;
+      fault();
+    }
+  }
+};
+
+} // namespace sim
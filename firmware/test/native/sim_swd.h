@@ -0,0 +1,486 @@
+#pragma once
+#include <deque>
+#include <hardware/pio.h>
+#include <map>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief Target memory behind the MEM-AP. Accesses use the byte lanes of
+ * their address; false is a bus error (sets STICKYERR)
+ */
+struct SwdMemory {
+  virtual ~SwdMemory() {}
+  virtual bool read(uint32_t addr, uint8_t size, uint32_t &lanes) = 0;
+  virtual bool write(uint32_t addr, uint8_t size, uint32_t lanes) = 0;
+};
+
+/**
+ * @brief RAM regions; anything outside them is a bus error
+ */
+struct SwdRam : SwdMemory {
+  std::map<uint32_t, std::vector<uint8_t>> regions;
+
+  void add(uint32_t base, uint32_t size, uint8_t fill = 0) {
+    regions[base] = std::vector<uint8_t>(size, fill);
+  }
+
+  uint8_t *at(uint32_t addr, uint8_t size) {
+    for (auto &r : regions)
+      if (addr >= r.first && addr + size <= r.first + r.second.size())
+        return &r.second[addr - r.first];
+    return nullptr;
+  }
+
+  bool read(uint32_t addr, uint8_t size, uint32_t &lanes) override {
+    uint8_t *p = at(addr, size);
+    if (!p)
+      return false;
+    uint32_t v = 0;
+    memcpy(&v, p, size);
+    lanes = v << (addr & 3) * 8;
+    return true;
+  }
+
+  bool write(uint32_t addr, uint8_t size, uint32_t lanes) override {
+    uint8_t *p = at(addr, size);
+    if (!p)
+      return false;
+    uint32_t v = lanes >> (addr & 3) * 8;
+    memcpy(p, &v, size);
+    return true;
+  }
+};
+
+/**
+ * @brief SW-DP with one MEM-AP, clocked bit by bit
+ *
+ * Checks what a real target would: the JTAG-to-SWD switch (50 ones, 0xE79E,
+ * line reset), IDCODE as the first read after a line reset, start, parity,
+ * stop and park bits of every request, and that the host releases SWDIO for
+ * exactly the turnaround cycles and never drives it while the target does.
+ * Write data parity errors set WDATAERR. AP reads are posted (each returns
+ * the previous result, RDBUFF the last one), TAR auto-increments inside its
+ * 1KB block, a bus error sets STICKYERR and AP accesses answer FAULT until
+ * ABORT clears it.
+ */
+class SwdTarget {
+public:
+  struct Transfer {
+    bool ap;
+    bool read;
+    uint8_t addr; // A[3:2] << 2, bank from SELECT added for AP registers
+    uint8_t ack;
+    uint32_t data;
+  };
+
+  SwdMemory *memory = nullptr;
+  uint32_t idcode = 0x2BA01477;
+  bool packedSupported = true;
+
+  // Injected faults
+  unsigned waitCount = 0;       // Next AP / RDBUFF accesses answer WAIT
+  unsigned badReadParity = 0;   // Next read data phases with wrong parity
+
+  // Observations
+  unsigned cycles = 0;
+  unsigned violations = 0;     // SWDIO driven by both sides, or by nobody
+  unsigned protocolErrors = 0; // Bad request header, missing IDCODE read
+  unsigned lineResets = 0;
+  std::vector<Transfer> log;
+
+  bool swdMode() const { return swd; }
+  uint32_t ctrlStat() const { return ctrl; }
+  uint32_t tar() const { return tarReg; }
+
+  // Stickies and power-up as CTRL/STAT reports them
+  static constexpr uint32_t STICKYERR = 1u << 5;
+  static constexpr uint32_t WDATAERR = 1u << 7;
+
+  /**
+   * @brief One SWCLK cycle
+   * @return The SWDIO level the host samples
+   */
+  bool clock(bool hostDrives, bool hostBit) {
+    cycles++;
+    if (hostDrives)
+      watchLineReset(hostBit);
+    else
+      ones = 0;
+
+    switch (state) {
+    case State::IDLE:
+      if (!hostDrives) {
+        violations++; // Nobody drives the line outside a turnaround
+      } else if (hostBit && swd && ones < 50) {
+        header = 1;
+        headerBits = 1;
+        state = State::HEADER;
+      }
+      return hostDrives ? hostBit : true;
+
+    case State::HEADER:
+      if (!hostDrives) {
+        violations++;
+        state = State::IDLE;
+        return true;
+      }
+      header |= hostBit << headerBits++;
+      if (headerBits == 8)
+        request();
+      return hostBit;
+
+    case State::LOCKOUT:
+      return hostDrives ? hostBit : true;
+
+    case State::TURN_ACK:
+      if (hostDrives)
+        violations++;
+      state = State::ACK;
+      bit = 0;
+      return true;
+
+    case State::ACK: {
+      bool out = ack >> bit & 1;
+      if (hostDrives)
+        violations++;
+      if (++bit < 3)
+        return out;
+      bit = 0;
+      if (ack != ACK_OK)
+        state = State::TURN_HOST;
+      else if (rnw)
+        state = State::DATA_OUT;
+      else
+        state = State::TURN_DATA;
+      return out;
+    }
+
+    case State::DATA_OUT: {
+      if (hostDrives)
+        violations++;
+      bool out;
+      if (bit < 32) {
+        out = data >> bit & 1;
+      } else {
+        out = parity(data);
+        if (badReadParity) {
+          badReadParity--;
+          out = !out;
+        }
+      }
+      if (++bit == 33)
+        state = State::TURN_HOST;
+      return out;
+    }
+
+    case State::TURN_DATA:
+    case State::TURN_HOST:
+      if (hostDrives)
+        violations++;
+      if (state == State::TURN_DATA) {
+        state = State::DATA_IN;
+        bit = 0;
+        data = 0;
+      } else {
+        state = State::IDLE;
+      }
+      return true;
+
+    case State::DATA_IN:
+      if (!hostDrives) {
+        violations++;
+        state = State::IDLE;
+        return true;
+      }
+      if (bit < 32) {
+        data |= (uint32_t)hostBit << bit;
+      } else {
+        if (hostBit != parity(data))
+          ctrl |= WDATAERR; // Write discarded
+        else
+          writeRegister();
+        state = State::IDLE;
+      }
+      bit++;
+      return hostBit;
+    }
+    return true;
+  }
+
+private:
+  enum class State {
+    IDLE,
+    HEADER,
+    LOCKOUT, // Protocol error: silent until a line reset
+    TURN_ACK,
+    ACK,
+    DATA_OUT,
+    TURN_DATA, // Before host write data
+    DATA_IN,
+    TURN_HOST // Back to the host after a read or a WAIT / FAULT
+  };
+  static constexpr uint8_t ACK_OK = 1, ACK_WAIT = 2, ACK_FAULT = 4;
+
+  State state = State::IDLE;
+  bool swd = false;      // JTAG-to-SWD switch done
+  bool switched = false; // 0xE79E seen, waiting for the line reset
+  bool needIdcode = true;
+  unsigned ones = 0;
+  std::deque<bool> history; // Host bits, newest last
+
+  uint8_t header = 0, headerBits = 0, bit = 0;
+  bool apnDp = false, rnw = false;
+  uint8_t regAddr = 0;
+  uint8_t ack = 0;
+  uint32_t data = 0;
+
+  // DP
+  uint32_t ctrl = 0;
+  uint32_t select = 0;
+  uint32_t rdbuff = 0;
+  // MEM-AP
+  uint32_t csw = 0x03000040;
+  uint32_t tarReg = 0;
+
+  static bool parity(uint32_t v) { return __builtin_popcount(v) & 1; }
+
+  void watchLineReset(bool hostBit) {
+    history.push_back(hostBit);
+    if (history.size() > 66)
+      history.pop_front();
+    ones = hostBit ? ones + 1 : 0;
+
+    // 50 ones, then 0xE79E LSB first
+    if (hostBit && history.size() == 66) {
+      uint16_t seq = 0;
+      bool preamble = true;
+      for (unsigned i = 0; i < 16; i++)
+        seq |= history[50 + i] << i;
+      for (unsigned i = 0; i < 50; i++)
+        preamble = preamble && history[i];
+      if (preamble && seq == 0xE79E)
+        switched = true;
+    }
+
+    // Line reset: anything in progress is dropped
+    if (ones >= 50) {
+      if (ones == 50) {
+        lineResets++;
+        swd = swd || switched;
+        switched = false;
+      }
+      needIdcode = true;
+      state = State::IDLE;
+    }
+  }
+
+  void request() {
+    apnDp = header >> 1 & 1;
+    rnw = header >> 2 & 1;
+    regAddr = (header >> 3 & 3) << 2;
+    bool par = header >> 5 & 1;
+    bool stop = header >> 6 & 1;
+    bool park = header >> 7 & 1;
+    if (header == 0xFF) {
+      state = State::LOCKOUT; // Line reset in progress
+      return;
+    }
+    if (par != parity(header >> 1 & 0xF) || stop || !park) {
+      protocolErrors++;
+      state = State::LOCKOUT;
+      return;
+    }
+    if (needIdcode && !(rnw && !apnDp && regAddr == 0)) {
+      protocolErrors++;
+      state = State::LOCKOUT;
+      return;
+    }
+    needIdcode = false;
+
+    ack = ACK_OK;
+    bool apAccess = apnDp || (rnw && regAddr == 0x0C);
+    if (apAccess && waitCount) {
+      waitCount--;
+      ack = ACK_WAIT;
+    } else if (apnDp && ((ctrl & (STICKYERR | WDATAERR)) ||
+                         !(ctrl & (1u << 29)))) {
+      ack = ACK_FAULT; // Sticky error, or debug domain powered down
+    }
+    if (ack == ACK_OK && rnw)
+      data = readRegister();
+    log.push_back({apnDp, rnw, apAddr(), ack, ack == ACK_OK ? data : 0});
+    state = State::TURN_ACK;
+  }
+
+  uint8_t apAddr() const {
+    return apnDp ? (uint8_t)((select & 0xF0) | regAddr) : regAddr;
+  }
+
+  // ============== DP / AP REGISTERS ==============
+
+  uint32_t readRegister() {
+    if (!apnDp) {
+      switch (regAddr) {
+      case 0x00:
+        return idcode;
+      case 0x04:
+        return ctrl;
+      case 0x08:
+        return 0; // RESEND: not modelled
+      default:
+        return rdbuff;
+      }
+    }
+    // Posted: this access returns the previous result
+    uint32_t previous = rdbuff;
+    rdbuff = apRead(apAddr());
+    return previous;
+  }
+
+  void writeRegister() {
+    log.back().data = data;
+    if (!apnDp) {
+      switch (regAddr) {
+      case 0x00: // ABORT
+        if (data & 0x04)
+          ctrl &= ~STICKYERR;
+        if (data & 0x08)
+          ctrl &= ~WDATAERR;
+        break;
+      case 0x04: {
+        // Power-up requests are acknowledged at once
+        uint32_t req = data & 0x50000000;
+        ctrl = (ctrl & (STICKYERR | WDATAERR)) | (data & 0x50000000) |
+               (req << 1);
+        break;
+      }
+      case 0x08:
+        select = data;
+        break;
+      }
+      return;
+    }
+    apWrite(apAddr(), data);
+  }
+
+  bool memAp() const { return (select >> 24) == 0; }
+  uint8_t size() const { return 1 << (csw & 7); }
+  uint8_t addrInc() const { return csw >> 4 & 3; }
+
+  void advanceTar(uint8_t bytes) {
+    // Auto-increment only carries inside the 1KB block
+    if (addrInc())
+      tarReg = (tarReg & ~0x3FFu) | ((tarReg + bytes) & 0x3FF);
+  }
+
+  uint32_t apRead(uint8_t addr) {
+    if (!memAp())
+      return 0; // No AP there
+    switch (addr) {
+    case 0x00:
+      return csw;
+    case 0x04:
+      return tarReg;
+    case 0x0C:
+      return drw(true, 0);
+    case 0xFC:
+      return 0x24770011; // AHB-AP IDR
+    default:
+      return 0;
+    }
+  }
+
+  void apWrite(uint8_t addr, uint32_t value) {
+    if (!memAp())
+      return;
+    switch (addr) {
+    case 0x00:
+      csw = (value & ~0x40u) | 0x40; // DeviceEn reads as 1
+      if (addrInc() == 2 && !packedSupported)
+        csw &= ~0x30u;
+      break;
+    case 0x04:
+      tarReg = value;
+      break;
+    case 0x0C:
+      drw(false, value);
+      break;
+    }
+  }
+
+  uint32_t drw(bool read, uint32_t value) {
+    // Packed: every lane of the word in ascending addresses, TAR += 4
+    uint8_t sz = size();
+    unsigned count = addrInc() == 2 && sz < 4 ? 4 / sz : 1;
+    uint32_t result = 0;
+    uint32_t base = tarReg;
+    for (unsigned i = 0; i < count; i++) {
+      uint32_t addr = count > 1 ? (base & ~3u) + i * sz : base;
+      uint32_t mask = sz == 4 ? 0xFFFFFFFF : ((1u << sz * 8) - 1)
+                                                 << (addr & 3) * 8;
+      bool ok;
+      if (read) {
+        uint32_t lanes = 0;
+        ok = memory && memory->read(addr, sz, lanes);
+        result |= lanes & mask;
+      } else {
+        ok = memory && memory->write(addr, sz, value & mask);
+      }
+      if (!ok) {
+        ctrl |= STICKYERR;
+        break;
+      }
+    }
+    advanceTar(count > 1 ? 4 : sz);
+    return result;
+  }
+};
+
+/**
+ * @brief PIO SWD program model (see pio_swd.cpp): runs one phase command
+ * per step against a SwdTarget
+ */
+class PioSwdLink : public PioModel {
+public:
+  SwdTarget &target;
+  explicit PioSwdLink(SwdTarget &t) : target(t) {}
+
+  void step() override {
+    if (tx.empty()) {
+      txStall = true;
+      return;
+    }
+    uint32_t cmd = tx.front();
+    unsigned bits = (cmd & 0xFF) + 1;
+    bool turnaround = cmd & (1u << 8);
+    bool drive = cmd & (1u << 9);
+    if (drive && tx.size() < 2) {
+      txStall = true; // pull block on the data word
+      return;
+    }
+    if (!drive && rxFull())
+      return; // push block
+    tx.pop_front();
+
+    if (turnaround)
+      target.clock(false, true);
+    if (drive) {
+      uint32_t out = tx.front();
+      tx.pop_front();
+      for (unsigned i = 0; i < bits; i++)
+        target.clock(true, out >> i & 1);
+    } else {
+      // in pins with right shift: the first bit ends up at 32 - bits
+      uint32_t in = 0;
+      for (unsigned i = 0; i < bits; i++)
+        in |= (uint32_t)target.clock(false, true) << (32 - bits + i);
+      rx.push_back(in);
+    }
+  }
+};
+
+} // namespace sim
@@ -0,0 +1,454 @@
+#pragma once
+#include <algorithm>
+#include <hardware/uart.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief tinyAVR 0/1 UPDI responder (NVM controller V0) on a UART line
+ *
+ * Parses the byte stream the way the UPDI does: every instruction starts
+ * with SYNCH, operands and store data follow in exact counts, and REPEAT
+ * must be followed by an LD / ST through the pointer, whose data units it
+ * counts. Anything out of frame is a protocol error (the real UPDI would
+ * stop answering until the next break). ACKs follow ST / STS unless
+ * CTRLA.RSD is set; a host that keeps sending while an ACK is due collides
+ * with it on the line (see UartState::collisions).
+ *
+ * Data space: NVMCTRL at 0x1000, EEPROM at 0x1400, SRAM from 0x3E00 and
+ * flash mapped at 0x8000. Flash and EEPROM writes go to the page buffer and
+ * reach the array with the NVMCTRL page commands, which keep the controller
+ * busy for nvmBusyUs. Keys (NVMProg, NVMErase) take effect on the next
+ * reset, which holds RSTSYS for resetUs; a chip erase adds eraseUs and
+ * clears the lock bits.
+ *
+ * The UPDI clock follows ASI_CTRLA.UPDICLKSEL (4 MHz after a break). Bytes
+ * sent faster than that clock can sample (225 kbaud at 4 MHz) are lost and
+ * counted in tooFast.
+ */
+class UpdiTarget : public UartDevice {
+public:
+  static constexpr uint32_t FLASH_BASE = 0x8000, FLASH_SIZE = 0x2000;
+  static constexpr uint32_t EEPROM_BASE = 0x1400, EEPROM_SIZE = 0x80;
+  static constexpr uint32_t SRAM_BASE = 0x3E00, SRAM_SIZE = 0x200;
+  static constexpr uint32_t FLASH_PAGE = 64, EEPROM_PAGE = 32;
+
+  // NVMCTRL V0 commands
+  static constexpr uint8_t CMD_WP = 1, CMD_ER = 2, CMD_ERWP = 3, CMD_PBC = 4;
+
+  bool present = true; // Connected to the line
+  bool locked = false;
+  const char *sib = "tinyAVR P:0D:0-3";
+  uint32_t resetUs = 200;
+  uint32_t eraseUs = 5000;
+  uint32_t nvmBusyUs = 400;
+
+  std::vector<uint8_t> flash, eeprom, sram;
+
+  // Observations
+  unsigned bytes = 0;          // Bytes seen (while enabled or not)
+  unsigned protocolErrors = 0; // Missing SYNCH, bad REPEAT use, bad opcode
+  unsigned violations = 0;     // Memory access while locked, NVM misuse
+  unsigned chipErases = 0;
+  unsigned appResets = 0; // Resets leaving programming mode
+  unsigned tooFast = 0;   // Bytes above the UPDI clock's baud limit
+  bool nvmProg = false;
+  bool disabled = false; // CTRLB.UPDIDIS written
+  uint8_t ctrla = 0;
+  uint8_t asiCtrla = 0x03; // UPDICLKSEL: 1 = 16 MHz, 2 = 8 MHz, 3 = 4 MHz
+  std::vector<uint8_t> bursts; // REPEAT counts - 1, in order
+  struct NvmCommand {
+    uint8_t cmd;
+    uint32_t page; // Data-space address of the page buffer
+  };
+  std::vector<NvmCommand> commands;
+
+  UpdiTarget()
+      : flash(FLASH_SIZE, 0xFF), eeprom(EEPROM_SIZE, 0xFF),
+        sram(SRAM_SIZE, 0) {}
+
+  void lineBreak(bool on) override {
+    if (!present || on)
+      return;
+    // A break resets the UPDI (not the core) and re-enables it
+    enabled = true;
+    disabled = false;
+    phase = Phase::SYNCH;
+    ctrla = ctrlb = 0;
+    asiCtrla = 0x03;
+    repeatCount = 0;
+  }
+
+  // Fastest baud the UPDI clock can follow
+  unsigned maxBaud() const {
+    static const unsigned limits[4] = {225000, 900000, 450000, 225000};
+    return limits[asiCtrla & 0x03];
+  }
+
+  void received(uint8_t b) override {
+    bytes++;
+    if (!present || !enabled || disabled)
+      return;
+    if (baud > maxBaud()) {
+      tooFast++; // Mis-sampled: the UPDI waits for a break
+      return;
+    }
+    switch (phase) {
+    case Phase::SYNCH:
+      if (b == 0x55)
+        phase = Phase::OPCODE;
+      else
+        protocolErrors++;
+      return;
+    case Phase::OPCODE:
+      opcode(b);
+      return;
+    case Phase::OPERANDS:
+      operands.push_back(b);
+      if (operands.size() == need)
+        execute();
+      return;
+    case Phase::STORE:
+      unit.push_back(b);
+      if (unit.size() == unitSize)
+        storeUnit();
+      return;
+    }
+  }
+
+  void step() override {
+    if (resetEndUs && nowUs >= resetEndUs) {
+      resetEndUs = 0;
+      resetDone();
+    }
+    if (eraseEndUs && nowUs >= eraseEndUs) {
+      eraseEndUs = 0;
+      locked = false;
+    }
+  }
+
+  uint8_t sysStatus() const {
+    return (locked ? 0x01 : 0) | (nvmProg ? 0x08 : 0) |
+           (inReset || resetEndUs ? 0x20 : 0);
+  }
+
+private:
+  enum class Phase { SYNCH, OPCODE, OPERANDS, STORE };
+  Phase phase = Phase::SYNCH;
+  bool enabled = false; // UPDI woken by a break
+  uint8_t ctrlb = 0;
+  uint8_t op = 0;
+  std::vector<uint8_t> operands, unit;
+  unsigned need = 0, unitSize = 0, units = 0;
+  unsigned repeatCount = 0; // Units for the next LD / ST
+  bool storeIsSts = false;
+  bool storeInc = false;
+  uint32_t storeAddr = 0;
+  uint32_t pointer = 0;
+
+  uint8_t keyStatus = 0;
+  bool inReset = false;
+  uint64_t resetEndUs = 0, eraseEndUs = 0;
+
+  // NVMCTRL
+  uint8_t nvmStatus = 0;
+  uint64_t nvmBusyEndUs = 0;
+  uint8_t pageBuffer[FLASH_PAGE];
+  bool pageWritten[FLASH_PAGE] = {};
+  uint32_t pageAddr = 0;
+
+  bool rsd() const { return ctrla & 0x08; }
+
+  void send(const uint8_t *data, unsigned len) {
+    for (unsigned i = 0; i < len; i++)
+      reply.push_back(data[i]);
+  }
+  void ack() {
+    if (!rsd())
+      reply.push_back(0x40);
+  }
+
+  uint32_t operandValue() const {
+    uint32_t v = 0;
+    for (unsigned i = 0; i < operands.size() && i < 4; i++)
+      v |= (uint32_t)operands[i] << (8 * i);
+    return v;
+  }
+
+  void opcode(uint8_t b) {
+    op = b;
+    operands.clear();
+    unsigned ptrMode = op >> 2 & 3;
+    bool viaPointer = (op & 0xE0) == 0x20 || (op & 0xE0) == 0x60;
+    if (repeatCount && !(viaPointer && ptrMode < 2)) {
+      protocolErrors++; // REPEAT only applies to LD / ST through the pointer
+      repeatCount = 0;
+    }
+    switch (op & 0xE0) {
+    case 0x00: // LDS
+    case 0x40: // STS
+      expect((op >> 2 & 3) + 1);
+      return;
+    case 0x20: // LD
+      if (ptrMode == 2) {
+        send(reinterpret_cast<const uint8_t *>(&pointer), 2);
+      } else {
+        unsigned n = repeatCount ? repeatCount : 1;
+        repeatCount = 0;
+        for (unsigned i = 0; i < n; i++) {
+          for (unsigned j = 0; j <= (op & 3); j++) {
+            uint8_t v = load(pointer + j);
+            send(&v, 1);
+          }
+          if (ptrMode == 1)
+            pointer += (op & 3) + 1;
+        }
+      }
+      phase = Phase::SYNCH;
+      return;
+    case 0x60: // ST
+      if (ptrMode == 2) {
+        expect((op & 3) + 1);
+      } else {
+        units = repeatCount ? repeatCount : 1;
+        repeatCount = 0;
+        startStore(false, ptrMode == 1, pointer, (op & 3) + 1);
+      }
+      return;
+    case 0x80: { // LDCS
+      uint8_t v = csRead(op & 0x0F);
+      send(&v, 1);
+      phase = Phase::SYNCH;
+      return;
+    }
+    case 0xC0: // STCS
+      expect(1);
+      return;
+    case 0xA0: // REPEAT
+      expect((op & 3) + 1);
+      return;
+    case 0xE0: // KEY / SIB
+      if (op & 0x04) {
+        send(reinterpret_cast<const uint8_t *>(sib), 16);
+        phase = Phase::SYNCH;
+      } else {
+        expect(8);
+      }
+      return;
+    }
+  }
+
+  void expect(unsigned n) {
+    need = n;
+    phase = Phase::OPERANDS;
+  }
+
+  void startStore(bool sts, bool inc, uint32_t addr, unsigned size) {
+    storeIsSts = sts;
+    storeInc = inc;
+    storeAddr = addr;
+    unitSize = size;
+    unit.clear();
+    phase = Phase::STORE;
+  }
+
+  void execute() {
+    uint32_t value = operandValue();
+    phase = Phase::SYNCH;
+    switch (op & 0xE0) {
+    case 0x00: { // LDS
+      for (unsigned j = 0; j <= (op & 3); j++) {
+        uint8_t v = load(value + j);
+        send(&v, 1);
+      }
+      return;
+    }
+    case 0x40: // STS: ACK the address, then one data unit
+      ack();
+      units = 1;
+      startStore(true, false, value, (op & 3) + 1);
+      return;
+    case 0x60: // ST ptr
+      pointer = value;
+      ack();
+      return;
+    case 0xC0:
+      csWrite(op & 0x0F, value);
+      return;
+    case 0xA0:
+      repeatCount = value + 1;
+      bursts.push_back(value);
+      return;
+    case 0xE0: {
+      // 64-bit key, last character first
+      char k[9] = {0};
+      for (unsigned i = 0; i < 8; i++)
+        k[i] = operands[7 - i];
+      if (!strcmp(k, "NVMProg "))
+        keyStatus |= 0x10;
+      else if (!strcmp(k, "NVMErase"))
+        keyStatus |= 0x08;
+      return;
+    }
+    }
+  }
+
+  void storeUnit() {
+    for (unsigned j = 0; j < unitSize; j++)
+      store(storeAddr + j, unit[j]);
+    unit.clear();
+    if (storeInc)
+      storeAddr += unitSize;
+    if (!storeIsSts)
+      pointer = storeAddr;
+    ack();
+    if (--units == 0)
+      phase = Phase::SYNCH;
+  }
+
+  // ============== CONTROL / STATUS ==============
+
+  uint8_t csRead(uint8_t reg) {
+    switch (reg) {
+    case 0x00:
+      return 0x30; // STATUSA: UPDI revision 3
+    case 0x02:
+      return ctrla;
+    case 0x03:
+      return ctrlb;
+    case 0x07:
+      return keyStatus;
+    case 0x09:
+      return asiCtrla;
+    case 0x0B:
+      return sysStatus();
+    default:
+      return 0;
+    }
+  }
+
+  void csWrite(uint8_t reg, uint8_t value) {
+    switch (reg) {
+    case 0x02:
+      ctrla = value;
+      break;
+    case 0x03:
+      ctrlb = value;
+      if (value & 0x04)
+        disabled = true;
+      break;
+    case 0x09:
+      asiCtrla = value;
+      break;
+    case 0x08:
+      if (value == 0x59) {
+        inReset = true;
+      } else if (inReset) {
+        inReset = false;
+        resetEndUs = nowUs + resetUs;
+      }
+      break;
+    }
+  }
+
+  void resetDone() {
+    if (keyStatus & 0x08) {
+      chipErases++;
+      std::fill(flash.begin(), flash.end(), 0xFF);
+      std::fill(eeprom.begin(), eeprom.end(), 0xFF);
+      eraseEndUs = nowUs + eraseUs;
+    }
+    if (keyStatus & 0x10) {
+      nvmProg = true;
+    } else if (nvmProg) {
+      nvmProg = false;
+      appResets++;
+    }
+    keyStatus = 0;
+  }
+
+  // ============== DATA SPACE ==============
+
+  bool inFlash(uint32_t a) const {
+    return a >= FLASH_BASE && a < FLASH_BASE + FLASH_SIZE;
+  }
+  bool inEeprom(uint32_t a) const {
+    return a >= EEPROM_BASE && a < EEPROM_BASE + EEPROM_SIZE;
+  }
+
+  uint8_t load(uint32_t a) {
+    if (locked) {
+      violations++;
+      return 0;
+    }
+    if (a == 0x1002) {
+      if (nvmBusyEndUs && nowUs >= nvmBusyEndUs) {
+        nvmBusyEndUs = 0;
+        nvmStatus &= ~0x03;
+      }
+      return nvmStatus;
+    }
+    if (inFlash(a))
+      return flash[a - FLASH_BASE];
+    if (inEeprom(a))
+      return eeprom[a - EEPROM_BASE];
+    if (a >= SRAM_BASE && a < SRAM_BASE + SRAM_SIZE)
+      return sram[a - SRAM_BASE];
+    return 0;
+  }
+
+  void store(uint32_t a, uint8_t v) {
+    if (locked) {
+      violations++;
+      return;
+    }
+    if (a == 0x1000) {
+      nvmCommand(v);
+    } else if (inFlash(a) || inEeprom(a)) {
+      if (!nvmProg || (nvmStatus & 0x03)) {
+        violations++; // Page buffer written outside NVMPROG or while busy
+        return;
+      }
+      unsigned page = inFlash(a) ? FLASH_PAGE : EEPROM_PAGE;
+      pageAddr = a & ~(page - 1);
+      pageBuffer[a % page] = v;
+      pageWritten[a % page] = true;
+    } else if (a >= SRAM_BASE && a < SRAM_BASE + SRAM_SIZE) {
+      sram[a - SRAM_BASE] = v;
+    }
+  }
+
+  void nvmCommand(uint8_t cmd) {
+    if (!nvmProg || (nvmStatus & 0x03)) {
+      violations++;
+      nvmStatus |= 0x04; // WRERROR
+      return;
+    }
+    commands.push_back({cmd, pageAddr});
+    nvmStatus &= ~0x04;
+    if (cmd == CMD_PBC) {
+      memset(pageWritten, 0, sizeof(pageWritten));
+      return;
+    }
+    bool ee = inEeprom(pageAddr);
+    unsigned page = ee ? EEPROM_PAGE : FLASH_PAGE;
+    uint8_t *mem = ee ? &eeprom[pageAddr - EEPROM_BASE]
+                      : &flash[pageAddr - FLASH_BASE];
+    for (unsigned i = 0; i < page; i++) {
+      // Flash erases the whole page, EEPROM only the bytes written
+      bool erase = (cmd == CMD_ER || cmd == CMD_ERWP) && (!ee || pageWritten[i]);
+      if (erase)
+        mem[i] = 0xFF;
+      if ((cmd == CMD_WP || cmd == CMD_ERWP) && pageWritten[i])
+        mem[i] &= pageBuffer[i];
+    }
+    memset(pageWritten, 0, sizeof(pageWritten));
+    nvmStatus |= ee ? 0x02 : 0x01;
+    nvmBusyEndUs = nowUs + nvmBusyUs;
+  }
+};
+
+} // namespace sim
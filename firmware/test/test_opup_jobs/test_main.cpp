@@ -0,0 +1,291 @@
+// OPUP core and job scheduler over the Serial shim: control commands served
+// while a NAND_READ stream runs in the background (sim_nand.h)
+#include <sim_nand.h>
+#include <unity.h>
+
+#include "led_driver.cpp"
+#undef TAG
+#include "protocol/OPUP.cpp"
+#include "qspi_driver.cpp"
+#undef TAG
+#include "spi_nand.cpp"
+
+#include "protocol/drivers/OPUP_NAND.h"
+#include "protocol/drivers/OPUP_System.h"
+
+// Bit-banged quad bus at 2 MHz: a 1KB step (2 clocks per byte) keeps the
+// core for about 1 ms, a reply must never wait for more than one of them
+#define BUS_CLOCK_NS 500
+#define PING_MAX_US 1500
+
+LEDDriver led;
+
+static sim::SpiNand *chip;
+static QSPIDriver *qspi;
+static SPINand *nand;
+static OPUP *opup;
+static OPUP_System *sys;
+static OPUP_NAND *opupNand;
+
+struct Frame {
+  uint8_t seq, cmd, flags;
+  std::vector<uint8_t> data;
+  uint64_t atUs; // Time the frame was complete in Serial.tx
+};
+static std::vector<Frame> frames;
+static size_t parsed;
+
+// PING sent by the host at pingAt. The bus clock moves time on without
+// stepping the models, so a PING sent during a step is queued when the step
+// returns, which is also the first moment the firmware could look at it.
+static uint64_t pingAt, pingSentUs;
+static uint8_t pingSeq;
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static void send(uint8_t seq, uint8_t cmd, uint8_t flags,
+                 const std::vector<uint8_t> &payload = {}) {
+  std::vector<uint8_t> f = {OPUP_SOF, seq, cmd, flags,
+                            (uint8_t)payload.size(),
+                            (uint8_t)(payload.size() >> 8)};
+  f.insert(f.end(), payload.begin(), payload.end());
+  uint32_t crc = crc32(f.data(), f.size());
+  for (int i = 0; i < 4; i++)
+    f.push_back(crc >> (8 * i));
+  Serial.rx.insert(Serial.rx.end(), f.begin(), f.end());
+}
+
+// Split Serial.tx into frames as soon as they are complete
+static void collect() {
+  const std::vector<uint8_t> &tx = Serial.tx;
+  while (tx.size() - parsed >= 10) {
+    TEST_ASSERT_EQUAL_HEX8(OPUP_SOF, tx[parsed]);
+    uint16_t len = tx[parsed + 4] | (tx[parsed + 5] << 8);
+    if (tx.size() - parsed < 10u + len)
+      return;
+    uint32_t crc;
+    memcpy(&crc, &tx[parsed + 6 + len], 4);
+    TEST_ASSERT_EQUAL_HEX32(crc32(&tx[parsed], 6 + len), crc);
+    Frame f{tx[parsed + 1], tx[parsed + 2], tx[parsed + 3],
+            std::vector<uint8_t>(&tx[parsed + 6], &tx[parsed + 6 + len]),
+            sim::nowUs};
+    frames.push_back(f);
+    parsed += 10 + len;
+  }
+}
+
+static void link() {
+  if (pingAt && sim::nowUs >= pingAt) {
+    pingSentUs = pingAt;
+    pingAt = 0;
+    send(++pingSeq, SYS_PING, 0);
+  }
+  collect();
+}
+
+// One pass of the firmware loop()
+static void loopOnce() {
+  opup->update();
+  led.update();
+  collect();
+}
+
+void setUp() {
+  sim::reset();
+  Serial.rx.clear();
+  Serial.tx.clear();
+  frames.clear();
+  parsed = 0;
+  pingAt = 0;
+  pingSeq = 0;
+
+  chip = new sim::SpiNand(sim::SpiNand::Vendor::WINBOND);
+  qspi = new QSPIDriver();
+  nand = new SPINand(*qspi);
+  opup = new OPUP();
+  sys = new OPUP_System(opup->getScheduler());
+  opupNand = new OPUP_NAND(*nand);
+  opup->registerDriver(0x00, 0x0F, sys);
+  opup->registerDriver(0x70, 0x7F, opupNand);
+  led.begin();
+  qspi->begin();
+  opup->begin();
+  sim::models().push_back(link);
+
+  send(0x40, NAND_INFO, 0);
+  loopOnce();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_EQUAL_HEX8(OPUP_FLAG_RESP, frames[0].flags);
+  frames.clear();
+  chip->clockNs = BUS_CLOCK_NS;
+}
+
+void tearDown() {
+  delete opupNand;
+  delete sys;
+  delete opup;
+  delete nand;
+  delete qspi;
+  delete chip;
+}
+
+static const Frame *find(uint8_t cmd, uint8_t seq, bool async) {
+  for (const Frame &f : frames)
+    if (f.cmd == cmd && f.seq == seq && !!(f.flags & OPUP_FLAG_ASYNC) == async)
+      return &f;
+  return nullptr;
+}
+
+static uint8_t startStream(uint32_t page, uint32_t count) {
+  std::vector<uint8_t> p(9, 0);
+  memcpy(&p[0], &page, 4);
+  memcpy(&p[4], &count, 4);
+  send(0x80, NAND_READ, OPUP_FLAG_ASYNC, p);
+  loopOnce();
+  const Frame *start = find(NAND_READ, 0x80, false);
+  TEST_ASSERT_NOT_NULL(start);
+  TEST_ASSERT_EQUAL_HEX8(OPUP_FLAG_RESP, start->flags);
+  return start->data[0];
+}
+
+// Completion event of the stream, nullptr while it runs
+static const Frame *streamDone() {
+  for (const Frame &f : frames)
+    if (f.cmd == NAND_READ && (f.flags & OPUP_FLAG_ASYNC) &&
+        f.data[1] != static_cast<uint8_t>(OPUPJobStatus::DATA))
+      return &f;
+  return nullptr;
+}
+
+void test_ping_idle() {
+  for (int i = 0; i < 5; i++) {
+    pingAt = sim::nowUs + 1;
+    for (int n = 0; n < 10 && !find(SYS_PING, pingSeq, false); n++)
+      loopOnce();
+    const Frame *pong = find(SYS_PING, pingSeq, false);
+    TEST_ASSERT_NOT_NULL(pong);
+    TEST_ASSERT_EQUAL_HEX8(0xCA, pong->data[0]);
+    TEST_ASSERT_LESS_THAN(50, pong->atUs - pingSentUs);
+  }
+}
+
+void test_ping_during_stream() {
+  // 96 pages from page 32 (crosses into block 1): about 200 steps of 1KB
+  for (uint32_t row = 32; row < 128; row++) {
+    std::vector<uint8_t> &p = chip->page(row);
+    for (unsigned i = 0; i < sim::SpiNand::PAGE; i++)
+      p[i] = (uint8_t)(i * 3 + row);
+  }
+  uint8_t id = startStream(32, 96);
+
+  uint64_t worst = 0;
+  unsigned pongs = 0;
+  pingAt = sim::nowUs + 100;
+  while (!streamDone() && sim::nowUs < 2000000) {
+    loopOnce();
+    const Frame *pong = pingSeq ? find(SYS_PING, pingSeq, false) : nullptr;
+    if (pong && !pingAt) {
+      TEST_ASSERT_EQUAL_HEX8(0xFE, pong->data[1]);
+      uint64_t latency = pong->atUs - pingSentUs;
+      if (latency > worst)
+        worst = latency;
+      pongs++;
+      // Next one lands at a different point of a step
+      pingAt = sim::nowUs + 150 + (pongs * 337) % 900;
+      frames.erase(frames.begin() + (pong - frames.data()));
+    }
+  }
+  const Frame *done = streamDone();
+  TEST_ASSERT_NOT_NULL(done);
+  TEST_ASSERT_EQUAL(id, done->data[0]);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(OPUPJobStatus::OK), done->data[1]);
+
+  // Replies stayed within one step while the dump went on
+  TEST_ASSERT_LESS_OR_EQUAL(PING_MAX_US, worst);
+  TEST_ASSERT_GREATER_THAN(50, pongs);
+  TEST_ASSERT_GREATER_THAN(PING_MAX_US / 3, worst); // Pings did hit steps
+
+  // Every byte of the dump arrived, in order
+  uint32_t offset = 0;
+  for (const Frame &f : frames) {
+    if (f.cmd != NAND_READ || !(f.flags & OPUP_FLAG_ASYNC) ||
+        f.data[1] != static_cast<uint8_t>(OPUPJobStatus::DATA))
+      continue;
+    uint32_t at;
+    memcpy(&at, &f.data[2], 4);
+    TEST_ASSERT_EQUAL(offset, at);
+    TEST_ASSERT_LESS_OR_EQUAL(OPUP_JOB_DATA_MAX, f.data.size() - 6);
+    for (size_t i = 6; i < f.data.size(); i++, offset++) {
+      uint32_t row = 32 + offset / sim::SpiNand::PAGE;
+      TEST_ASSERT_EQUAL_HEX8(chip->page(row)[offset % sim::SpiNand::PAGE],
+                             f.data[i]);
+    }
+  }
+  TEST_ASSERT_EQUAL(96 * sim::SpiNand::PAGE, offset);
+  TEST_ASSERT_FALSE(chip->selected());
+  TEST_ASSERT_EQUAL(0, chip->violations);
+}
+
+void test_status_busy() {
+  // SYS_GET_STATUS reports Busy while the stream runs, Idle once it is done
+  uint8_t id = startStream(0, 2);
+  send(0x81, SYS_GET_STATUS, 0);
+  loopOnce();
+  const Frame *status = find(SYS_GET_STATUS, 0x81, false);
+  TEST_ASSERT_NOT_NULL(status);
+  TEST_ASSERT_EQUAL(1, status->data[0]);
+
+  while (!streamDone() && sim::nowUs < 1000000)
+    loopOnce();
+  TEST_ASSERT_NOT_NULL(streamDone());
+  TEST_ASSERT_EQUAL(id, streamDone()->data[0]);
+  send(0x82, SYS_GET_STATUS, 0);
+  loopOnce();
+  status = find(SYS_GET_STATUS, 0x82, false);
+  TEST_ASSERT_NOT_NULL(status);
+  TEST_ASSERT_EQUAL(0, status->data[0]);
+}
+
+void test_abort_stream() {
+  // JOB_ABORT is answered between steps and drops the held CS at once
+  uint8_t id = startStream(0, 64);
+  for (int i = 0; i < 5; i++)
+    loopOnce();
+  TEST_ASSERT_TRUE(chip->selected()); // Continuous read in progress
+
+  send(0x81, JOB_ABORT, 0, {id});
+  loopOnce();
+  const Frame *ack = find(JOB_ABORT, 0x81, false);
+  TEST_ASSERT_NOT_NULL(ack);
+  TEST_ASSERT_EQUAL(1, ack->data[0]);
+  TEST_ASSERT_FALSE(chip->selected());
+
+  const Frame *done = streamDone();
+  TEST_ASSERT_NOT_NULL(done);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(OPUPJobStatus::ABORTED),
+                    done->data[1]);
+
+  send(0x82, JOB_STATUS, 0);
+  loopOnce();
+  const Frame *status = find(JOB_STATUS, 0x82, false);
+  TEST_ASSERT_NOT_NULL(status);
+  TEST_ASSERT_EQUAL(0, status->data[0]);
+  TEST_ASSERT_EQUAL(0, chip->violations);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ping_idle);
+  RUN_TEST(test_ping_during_stream);
+  RUN_TEST(test_status_busy);
+  RUN_TEST(test_abort_stream);
+  return UNITY_END();
+}
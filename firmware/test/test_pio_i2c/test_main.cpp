@@ -0,0 +1,156 @@
+// PIO I2C engine against the simulated bus (sim_i2c.h)
+#include <sim_i2c.h>
+#include <unity.h>
+
+#include "i2c_driver.cpp"
+#include "pio_i2c.cpp"
+
+static sim::PioI2cBus *bus;
+static sim::I2cMemory *eeprom;
+static PIOI2C *pio;
+
+void setUp() {
+  sim::reset();
+  bus = new sim::PioI2cBus();
+  eeprom = new sim::I2cMemory(0x50, 4096);
+  bus->devices.push_back(eeprom);
+  sim::attachPio(*bus);
+  pio = new PIOI2C();
+  TEST_ASSERT_TRUE(pio->begin(Board::PIN_I2C_SDA, Board::PIN_I2C_SCL, 400000));
+}
+
+void tearDown() {
+  delete pio;
+  delete eeprom;
+  delete bus;
+}
+
+static void assertBusIdle() {
+  TEST_ASSERT_TRUE(bus->idle());
+  TEST_ASSERT_EQUAL(0, bus->errors);
+  TEST_ASSERT_EQUAL(0, bus->txOverflows);
+}
+
+void test_write() {
+  const uint8_t prefix[] = {0x01, 0x20};
+  const uint8_t data[] = {0xDE, 0xAD, 0xBE};
+  TEST_ASSERT_TRUE(pio->write(0x50, prefix, 2, data, 3, true));
+
+  TEST_ASSERT_EQUAL(1, eeprom->writes.size());
+  TEST_ASSERT_EQUAL(5, eeprom->writes[0].size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, &eeprom->mem[0x120], 3);
+  assertBusIdle();
+}
+
+void test_page_write() {
+  // Longer than both FIFOs: every byte pushes an RX word that must be
+  // drained until the machine goes idle
+  const uint8_t prefix[] = {0x00, 0x40};
+  uint8_t page[64];
+  for (unsigned i = 0; i < sizeof(page); i++)
+    page[i] = i * 7 + 3;
+  TEST_ASSERT_TRUE(pio->write(0x50, prefix, 2, page, sizeof(page), true));
+
+  TEST_ASSERT_EQUAL(1, eeprom->writes.size());
+  TEST_ASSERT_EQUAL(2 + sizeof(page), eeprom->writes[0].size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(page, &eeprom->mem[0x40], sizeof(page));
+  assertBusIdle();
+}
+
+void test_read() {
+  // Random read: pointer write, repeated START, DMA read past the FIFOs
+  for (unsigned i = 0; i < 300; i++)
+    eeprom->mem[0x200 + i] = i ^ 0x5A;
+  const uint8_t ptr[] = {0x02, 0x00};
+  uint8_t buf[300];
+  memset(buf, 0, sizeof(buf));
+  TEST_ASSERT_TRUE(pio->write(0x50, nullptr, 0, ptr, 2, false));
+  TEST_ASSERT_TRUE(pio->read(0x50, buf, sizeof(buf)));
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(&eeprom->mem[0x200], buf, sizeof(buf));
+  TEST_ASSERT_EQUAL(2, bus->starts);
+  TEST_ASSERT_EQUAL(1, bus->stops);
+  TEST_ASSERT_EQUAL(0, bus->rxUnderflows);
+  assertBusIdle();
+}
+
+void test_read_single_byte() {
+  eeprom->mem[0] = 0xA5;
+  uint8_t b = 0;
+  TEST_ASSERT_TRUE(pio->read(0x50, &b, 1));
+  TEST_ASSERT_EQUAL_HEX8(0xA5, b);
+  assertBusIdle();
+}
+
+void test_clock_stretching() {
+  eeprom->stretchTicks = 40;
+  const uint8_t prefix[] = {0x00, 0x00};
+  const uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t buf[8];
+  TEST_ASSERT_TRUE(pio->write(0x50, prefix, 2, data, sizeof(data), false));
+  eeprom->pointer = 0;
+  TEST_ASSERT_TRUE(pio->read(0x50, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, buf, sizeof(buf));
+  assertBusIdle();
+}
+
+void test_data_nak() {
+  // Write-protected after two data bytes: the write fails and the bus is
+  // released with a STOP
+  eeprom->ackLimit = 2;
+  const uint8_t prefix[] = {0x00, 0x10};
+  uint8_t data[16] = {0};
+  TEST_ASSERT_FALSE(pio->write(0x50, prefix, 2, data, sizeof(data), true));
+  assertBusIdle();
+
+  // The machine runs again after the recovery
+  eeprom->ackLimit = 0xFFFF;
+  TEST_ASSERT_TRUE(pio->write(0x50, prefix, 2, data, 4, true));
+  assertBusIdle();
+}
+
+void test_probe() {
+  TEST_ASSERT_TRUE(pio->probe(0x50, PIO_I2C_STRETCH_TIMEOUT_US));
+  TEST_ASSERT_FALSE(pio->probe(0x51, PIO_I2C_STRETCH_TIMEOUT_US));
+  TEST_ASSERT_TRUE(pio->probe(0x50, PIO_I2C_STRETCH_TIMEOUT_US));
+  TEST_ASSERT_EQUAL(0, eeprom->writes[0].size()); // Address only
+  assertBusIdle();
+}
+
+void test_quick_scan() {
+  sim::I2cMemory rtc(0x68, 256), sensor(0x1D, 16);
+  bus->devices.push_back(&rtc);
+  bus->devices.push_back(&sensor);
+  pio->end();
+
+  I2CDriver i2c;
+  i2c.begin();
+  uint8_t found[128];
+  uint8_t count = 0;
+  uint64_t start = sim::nowUs;
+  i2c.scan(found, count, true);
+  uint64_t elapsed = sim::nowUs - start;
+
+  TEST_ASSERT_EQUAL(3, count);
+  TEST_ASSERT_EQUAL_HEX8(0x1D, found[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x50, found[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x68, found[2]);
+  // Every address probed once; an address NAK ends its probe at once
+  // instead of running into the scan timeout
+  TEST_ASSERT_EQUAL(126, bus->addressed.size());
+  TEST_ASSERT_LESS_THAN(126 * PIO_I2C_SCAN_TIMEOUT_US, elapsed);
+  assertBusIdle();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_write);
+  RUN_TEST(test_page_write);
+  RUN_TEST(test_read);
+  RUN_TEST(test_read_single_byte);
+  RUN_TEST(test_clock_stretching);
+  RUN_TEST(test_data_nak);
+  RUN_TEST(test_probe);
+  RUN_TEST(test_quick_scan);
+  return UNITY_END();
+}
@@ -0,0 +1,292 @@
+// SPI NAND engine against a simulated chip on the QSPI pins (sim_nand.h)
+#include <sim_nand.h>
+#include <unity.h>
+
+#include "qspi_driver.cpp"
+#undef TAG
+#include "spi_nand.cpp"
+
+#define PPB sim::SpiNand::PAGES_PER_BLOCK
+#define PAGE sim::SpiNand::PAGE
+
+static sim::SpiNand *chip;
+static QSPIDriver *qspi;
+static SPINand *nand;
+
+static void attach(sim::SpiNand::Vendor vendor,
+                   std::initializer_list<uint16_t> factoryBad) {
+  chip = new sim::SpiNand(vendor);
+  for (uint16_t block : factoryBad)
+    chip->markFactoryBad(block);
+  TEST_ASSERT_TRUE(nand->identify());
+}
+
+void setUp() {
+  sim::reset();
+  qspi = new QSPIDriver();
+  qspi->begin();
+  nand = new SPINand(*qspi);
+  chip = nullptr;
+}
+
+void tearDown() {
+  delete nand;
+  delete qspi;
+  delete chip;
+}
+
+// Distinct contents for every row (main + spare)
+static void fillRows(uint32_t row, uint32_t count) {
+  for (uint32_t r = row; r < row + count; r++) {
+    std::vector<uint8_t> &p = chip->page(r);
+    for (unsigned i = 0; i < p.size(); i++)
+      p[i] = (uint8_t)(i * 13 + r * 7 + (i >> 8));
+    p[PAGE] = 0xFF; // Keep the bad block marker clear
+  }
+}
+
+// Stream count logical pages through readNext in chunks of chunk bytes and
+// compare them with the given physical rows
+static void assertRead(uint32_t page, const std::vector<uint32_t> &rows,
+                       bool spare, uint16_t chunk) {
+  TEST_ASSERT_TRUE(nand->startRead(page, rows.size(), false, spare));
+  uint16_t len = nand->getReadPageLen();
+  TEST_ASSERT_EQUAL(PAGE + (spare ? chip->spare : 0), len);
+  static uint8_t buf[PAGE + 128];
+  for (uint32_t row : rows) {
+    for (uint16_t off = 0; off < len;) {
+      uint16_t n = nand->readNext(buf + off, chunk);
+      TEST_ASSERT_NOT_EQUAL(0, n);
+      off += n;
+    }
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(chip->page(row).data(), buf, len);
+  }
+  TEST_ASSERT_EQUAL(0, nand->readNext(buf, chunk));
+  nand->endRead();
+  TEST_ASSERT_FALSE(chip->selected());
+}
+
+static void assertCleanBus() {
+  TEST_ASSERT_EQUAL(0, chip->violations);
+  TEST_ASSERT_EQUAL(0, chip->contention);
+}
+
+void test_identify() {
+  attach(sim::SpiNand::Vendor::WINBOND, {1, 5});
+  TEST_ASSERT_EQUAL_STRING("W25N01GV", nand->getChip()->name);
+  TEST_ASSERT_EQUAL_HEX8(0x00, chip->protect);
+  TEST_ASSERT_EQUAL_HEX8(0x18, chip->config & 0x18); // ECC-E, BUF
+  TEST_ASSERT_EQUAL(2, nand->getBadCount());
+  TEST_ASSERT_TRUE(nand->isBad(1));
+  TEST_ASSERT_TRUE(nand->isBad(5));
+  TEST_ASSERT_FALSE(nand->isBad(0));
+  assertCleanBus();
+}
+
+void test_map_block() {
+  attach(sim::SpiNand::Vendor::MICRON, {0, 3, 4, 1023});
+  TEST_ASSERT_EQUAL_STRING("MT29F1G01ABAFD", nand->getChip()->name);
+  TEST_ASSERT_EQUAL(4, nand->getBadCount());
+  TEST_ASSERT_EQUAL(1, nand->mapBlock(0));
+  TEST_ASSERT_EQUAL(2, nand->mapBlock(1));
+  TEST_ASSERT_EQUAL(5, nand->mapBlock(2));
+  TEST_ASSERT_EQUAL(1022, nand->mapBlock(1019));
+  TEST_ASSERT_EQUAL(-1, nand->mapBlock(1020)); // Past the last good block
+  // Logical reads end with the good blocks
+  TEST_ASSERT_FALSE(nand->startRead(1020 * PPB, 1, false, false));
+  TEST_ASSERT_TRUE(nand->startRead(1020 * PPB, 1, true, false));
+  nand->endRead();
+  assertCleanBus();
+}
+
+void test_cache_read_skips_bad_block() {
+  // Micron pipeline: 0x31 per page, 0x3F on the last one of each block;
+  // logical block 1 lives in physical block 2
+  attach(sim::SpiNand::Vendor::MICRON, {1});
+  fillRows(PPB - 3, 3);
+  fillRows(2 * PPB, 3);
+  std::vector<uint32_t> rows = {PPB - 3, PPB - 2, PPB - 1,
+                                2 * PPB, 2 * PPB + 1, 2 * PPB + 2};
+  nand->resetStats();
+  assertRead(PPB - 3, rows, false, 512);
+  // Every page after the first of a block came out of the pipeline
+  TEST_ASSERT_EQUAL(6, nand->getStats().pagesRead);
+  TEST_ASSERT_EQUAL(4, nand->getStats().pipelined);
+  TEST_ASSERT_EQUAL(0, chip->streams.size());
+  assertCleanBus();
+}
+
+void test_cache_read_spare() {
+  attach(sim::SpiNand::Vendor::MICRON, {});
+  fillRows(10, 2);
+  assertRead(10, {10, 11}, true, 1000);
+  assertCleanBus();
+}
+
+void test_continuous_stops_at_block_end() {
+  // Winbond continuous read: the stream must end with the block, the chip
+  // would otherwise run on into the bad block 1
+  attach(sim::SpiNand::Vendor::WINBOND, {1});
+  fillRows(PPB - 4, 4);
+  fillRows(2 * PPB, 3);
+  std::vector<uint32_t> rows = {PPB - 4, PPB - 3, PPB - 2, PPB - 1,
+                                2 * PPB, 2 * PPB + 1, 2 * PPB + 2};
+  assertRead(PPB - 4, rows, false, 2048);
+
+  TEST_ASSERT_EQUAL(2, chip->streams.size());
+  TEST_ASSERT_EQUAL(PPB - 4, chip->streams[0].row);
+  TEST_ASSERT_EQUAL(4 * PAGE, chip->streams[0].bytes);
+  TEST_ASSERT_EQUAL(2 * PPB, chip->streams[1].row);
+  TEST_ASSERT_EQUAL(3 * PAGE, chip->streams[1].bytes);
+  TEST_ASSERT_EQUAL(5, nand->getStats().pipelined);
+  assertCleanBus();
+}
+
+void test_continuous_not_for_spare() {
+  // The stream carries the main area only: spare reads use buffer mode
+  attach(sim::SpiNand::Vendor::WINBOND, {});
+  fillRows(0, 3);
+  assertRead(0, {0, 1, 2}, true, 700);
+  TEST_ASSERT_EQUAL(0, chip->streams.size());
+  assertCleanBus();
+}
+
+void test_interrupt_resumes() {
+  // Another bus user in the middle of a pipelined page: the background
+  // load is waited for and the page is loaded again
+  attach(sim::SpiNand::Vendor::MICRON, {});
+  fillRows(0, 3);
+  fillRows(500, 1);
+  static uint8_t buf[PAGE];
+  TEST_ASSERT_TRUE(nand->startRead(0, 3, false, false));
+  TEST_ASSERT_EQUAL(PAGE, nand->readNext(buf, PAGE));
+  TEST_ASSERT_EQUAL(1000, nand->readNext(buf, 1000));
+  nand->interrupt();
+
+  static uint8_t other[64];
+  nand->readPage(500, other, sizeof(other));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(chip->page(500).data(), other, sizeof(other));
+
+  TEST_ASSERT_EQUAL(PAGE - 1000, nand->readNext(buf + 1000, PAGE));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(chip->page(1).data(), buf, PAGE);
+  TEST_ASSERT_EQUAL(PAGE, nand->readNext(buf, PAGE));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(chip->page(2).data(), buf, PAGE);
+  nand->endRead();
+  assertCleanBus();
+}
+
+void test_program_first_page_moves_on() {
+  // Failure on page 0 of a block: retire it and use the next good block
+  attach(sim::SpiNand::Vendor::WINBOND, {});
+  chip->failRows.insert(0);
+  static uint8_t data[PAGE];
+  for (unsigned i = 0; i < sizeof(data); i++)
+    data[i] = i ^ 0x5A;
+  NandProgramStatus status;
+  uint16_t block;
+  TEST_ASSERT_TRUE(nand->programLogical(0, data, sizeof(data), true, status,
+                                        block));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(NandProgramStatus::OK),
+                    static_cast<uint8_t>(status));
+  TEST_ASSERT_EQUAL(1, block);
+  TEST_ASSERT_TRUE(nand->isBad(0));
+  TEST_ASSERT_EQUAL(1, nand->mapBlock(0));
+  TEST_ASSERT_EQUAL(1, nand->getStats().newBad);
+  TEST_ASSERT_EQUAL(1, nand->getStats().programmed);
+  TEST_ASSERT_EQUAL(2, chip->erases);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, chip->page(PPB).data(), sizeof(data));
+  assertCleanBus();
+}
+
+void test_program_retry_block() {
+  // Failure after earlier pages of the block: the host has to resend them
+  attach(sim::SpiNand::Vendor::WINBOND, {});
+  static uint8_t data[PAGE];
+  memset(data, 0x11, sizeof(data));
+  NandProgramStatus status;
+  uint16_t block;
+  for (uint32_t page = 0; page < 2; page++) {
+    TEST_ASSERT_TRUE(nand->programLogical(page, data, sizeof(data), true,
+                                          status, block));
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(NandProgramStatus::OK),
+                      static_cast<uint8_t>(status));
+  }
+  chip->failRows.insert(2);
+  TEST_ASSERT_TRUE(
+      nand->programLogical(2, data, sizeof(data), true, status, block));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(NandProgramStatus::RETRY_BLOCK),
+                    static_cast<uint8_t>(status));
+  TEST_ASSERT_EQUAL(0, block);
+  TEST_ASSERT_EQUAL(1, nand->mapBlock(0));
+
+  // Resent from page 0: lands in block 1
+  for (uint32_t page = 0; page < 3; page++) {
+    TEST_ASSERT_TRUE(nand->programLogical(page, data, sizeof(data), true,
+                                          status, block));
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(NandProgramStatus::OK),
+                      static_cast<uint8_t>(status));
+    TEST_ASSERT_EQUAL(1, block);
+  }
+  // The marker keeps block 0 retired after a rescan
+  TEST_ASSERT_EQUAL_HEX8(0x00, chip->page(0)[PAGE]);
+  TEST_ASSERT_EQUAL(1, nand->scanBadBlocks());
+  TEST_ASSERT_TRUE(nand->isBad(0));
+  assertCleanBus();
+}
+
+void test_program_blank_page() {
+  attach(sim::SpiNand::Vendor::WINBOND, {});
+  static uint8_t data[PAGE];
+  memset(data, 0xFF, sizeof(data));
+  NandProgramStatus status;
+  uint16_t block;
+  TEST_ASSERT_TRUE(
+      nand->programLogical(0, data, sizeof(data), true, status, block));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(NandProgramStatus::BLANK),
+                    static_cast<uint8_t>(status));
+  TEST_ASSERT_EQUAL(1, chip->erases);
+  TEST_ASSERT_EQUAL(0, chip->programs);
+  assertCleanBus();
+}
+
+void test_erase_logical() {
+  // Logical blocks 2..4 with physical block 3 failing: 2, 4 and 5 erased
+  attach(sim::SpiNand::Vendor::MICRON, {});
+  fillRows(2 * PPB, 1);
+  fillRows(5 * PPB, 1);
+  chip->failBlocks.insert(3);
+  uint16_t newBad;
+  TEST_ASSERT_EQUAL(3, nand->eraseLogical(2, 3, newBad));
+  TEST_ASSERT_EQUAL(1, newBad);
+  TEST_ASSERT_TRUE(nand->isBad(3));
+  TEST_ASSERT_TRUE(chip->isErased(2 * PPB));
+  TEST_ASSERT_TRUE(chip->isErased(5 * PPB));
+  TEST_ASSERT_EQUAL(3, chip->erases);
+  TEST_ASSERT_EQUAL(1, nand->scanBadBlocks());
+  assertCleanBus();
+}
+
+void test_no_chip() {
+  // Nothing on the bus: every ID byte reads back as 0
+  TEST_ASSERT_FALSE(nand->identify());
+  TEST_ASSERT_NULL(nand->getChip());
+  TEST_ASSERT_FALSE(nand->startRead(0, 1, false, false));
+  TEST_ASSERT_EQUAL(-1, nand->mapBlock(0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_identify);
+  RUN_TEST(test_map_block);
+  RUN_TEST(test_cache_read_skips_bad_block);
+  RUN_TEST(test_cache_read_spare);
+  RUN_TEST(test_continuous_stops_at_block_end);
+  RUN_TEST(test_continuous_not_for_spare);
+  RUN_TEST(test_interrupt_resumes);
+  RUN_TEST(test_program_first_page_moves_on);
+  RUN_TEST(test_program_retry_block);
+  RUN_TEST(test_program_blank_page);
+  RUN_TEST(test_erase_logical);
+  RUN_TEST(test_no_chip);
+  return UNITY_END();
+}
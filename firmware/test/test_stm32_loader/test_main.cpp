@@ -0,0 +1,213 @@
+// STM32 flash loader against a simulated F1 / F4 running the stub
+// (sim_stm32.h on the SWD target model)
+#include <sim_stm32.h>
+#include <unity.h>
+
+#include "pio_swd.cpp"
+#include "stm32_loader.cpp"
+#include "swd_driver.cpp"
+
+#define MAILBOX (STM32_LOADER_RAM + STM32_LOADER_MAILBOX)
+#define STATE0 (MAILBOX + 0x10 + 0x0C)
+#define STATE1 (MAILBOX + 0x20 + 0x0C)
+
+static sim::Stm32Target *stm;
+static sim::SwdTarget *dap;
+static sim::PioSwdLink *link;
+static SWDDriver *swd;
+static STM32Loader *loader;
+
+static void attach(sim::Stm32Target::Family family, uint32_t flashKb) {
+  stm = new sim::Stm32Target(family, flashKb);
+  dap->memory = stm;
+  sim::models().push_back([] { stm->step(); });
+}
+
+void setUp() {
+  sim::reset();
+  dap = new sim::SwdTarget();
+  link = new sim::PioSwdLink(*dap);
+  sim::attachPio(*link);
+  swd = new SWDDriver();
+  loader = new STM32Loader(*swd);
+  stm = nullptr;
+}
+
+void tearDown() {
+  delete loader;
+  delete swd;
+  delete link;
+  delete dap;
+  delete stm;
+}
+
+static uint32_t sramWord(uint32_t addr) {
+  uint32_t v;
+  memcpy(&v, &stm->sram[addr - sim::Stm32Target::SRAM_BASE], 4);
+  return v;
+}
+
+static void fill(uint8_t *data, unsigned len, uint8_t seed) {
+  for (unsigned i = 0; i < len; i++)
+    data[i] = (i * 31 + seed) ^ (i >> 8);
+}
+
+static void assertCleanRun() {
+  TEST_ASSERT_EQUAL(0, stm->coreFaults);
+  TEST_ASSERT_EQUAL(0, stm->violations);
+  TEST_ASSERT_EQUAL(0, dap->violations);
+  TEST_ASSERT_EQUAL(0, dap->protocolErrors);
+}
+
+static void beginOk(bool massErase) {
+  TEST_ASSERT_EQUAL_HEX32(0x2BA01477, swd->init());
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(Stm32LoaderStatus::OK),
+                    static_cast<uint8_t>(loader->begin(massErase)));
+}
+
+void test_no_link() {
+  // STM32_FLASH_BEGIN before SWD_INIT: nothing is clocked out
+  attach(sim::Stm32Target::Family::F1, 64);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(Stm32LoaderStatus::NO_LINK),
+                    static_cast<uint8_t>(loader->begin(true)));
+  TEST_ASSERT_EQUAL(0, dap->cycles);
+  uint32_t sr;
+  TEST_ASSERT_FALSE(loader->write(STM32_FLASH_BASE, stm->sram.data(), 4));
+  TEST_ASSERT_FALSE(loader->end(sr));
+}
+
+void test_unsupported() {
+  attach(sim::Stm32Target::Family::F1, 512);
+  stm->devId = 0x430; // XL density
+  TEST_ASSERT_TRUE(swd->init());
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(Stm32LoaderStatus::UNSUPPORTED),
+                    static_cast<uint8_t>(loader->begin(false)));
+  TEST_ASSERT_TRUE(stm->halted);
+}
+
+void test_f1_program() {
+  // Three buffers of up to 1KB, halfword programming
+  attach(sim::Stm32Target::Family::F1, 64);
+  stm->flash[0x2000] = 0x00; // Mass erase clears it
+  static uint8_t data[3000];
+  fill(data, sizeof(data), 1);
+  beginOk(true);
+  TEST_ASSERT_EQUAL_HEX16(0x410, loader->getDeviceId());
+  TEST_ASSERT_EQUAL(64 * 1024, loader->getFlashSize());
+  TEST_ASSERT_EQUAL(1, stm->massErases);
+
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE, data, sizeof(data)));
+  uint32_t sr = 0xFFFF;
+  TEST_ASSERT_TRUE(loader->end(sr));
+  TEST_ASSERT_EQUAL_HEX32(0, sr);
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, stm->flash.data(), sizeof(data));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, stm->flash[0x2000]);
+  TEST_ASSERT_EQUAL(sizeof(data) / 2, stm->programmed);
+  // Both descriptors handed back, flash locked, application started
+  TEST_ASSERT_EQUAL_HEX32(STM32_STATE_EMPTY, sramWord(STATE0));
+  TEST_ASSERT_EQUAL_HEX32(STM32_STATE_EMPTY, sramWord(STATE1));
+  TEST_ASSERT_EQUAL_HEX32(0x80, stm->flashCr() & 0x80);
+  delay(1); // Out of reset without the vector catch
+  TEST_ASSERT_EQUAL(1, stm->appStarts);
+  TEST_ASSERT_FALSE(stm->halted);
+  assertCleanRun();
+}
+
+void test_f4_program() {
+  // Word programming (PSIZE x32) from 4KB buffers, no erase
+  attach(sim::Stm32Target::Family::F4, 256);
+  static uint8_t data[10000];
+  fill(data, sizeof(data), 7);
+  beginOk(false);
+  TEST_ASSERT_EQUAL_HEX16(0x413, loader->getDeviceId());
+  TEST_ASSERT_EQUAL(0, stm->massErases);
+
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE + 0x4000, data, 4096));
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE + 0x5000, data + 4096,
+                                 sizeof(data) - 4096));
+  uint32_t sr;
+  TEST_ASSERT_TRUE(loader->end(sr));
+  TEST_ASSERT_EQUAL_HEX32(0, sr);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, &stm->flash[0x4000], sizeof(data));
+  TEST_ASSERT_EQUAL(sizeof(data) / 4, stm->programmed);
+  assertCleanRun();
+}
+
+void test_end_drains_in_order() {
+  // Slow flash: both buffers are still FULL when end() starts. It must
+  // wait for the older one first, then the newer one, before halting
+  attach(sim::Stm32Target::Family::F1, 64);
+  stm->progUs = 400;
+  static uint8_t data[3 * 1024];
+  fill(data, sizeof(data), 3);
+  beginOk(false);
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE, data, sizeof(data)));
+  // Buffers went out as 0, 1, 0: descriptor 1 is the older one now
+  TEST_ASSERT_EQUAL_HEX32(STM32_STATE_FULL, sramWord(STATE1));
+
+  size_t from = stm->hostReads.size();
+  uint32_t sr;
+  TEST_ASSERT_TRUE(loader->end(sr));
+  TEST_ASSERT_EQUAL_HEX32(0, sr);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, stm->flash.data(), sizeof(data));
+
+  std::vector<uint32_t> polled;
+  for (size_t i = from; i < stm->hostReads.size(); i++)
+    if (polled.empty() || polled.back() != stm->hostReads[i])
+      polled.push_back(stm->hostReads[i]);
+  TEST_ASSERT_EQUAL(2, polled.size());
+  TEST_ASSERT_EQUAL_HEX32(STATE1, polled[0]);
+  TEST_ASSERT_EQUAL_HEX32(STATE0, polled[1]);
+  assertCleanRun();
+}
+
+void test_write_protect_error() {
+  // Second buffer hits a protected page: the stub reports ERROR | SR and
+  // halts, end() returns the error bits
+  attach(sim::Stm32Target::Family::F1, 64);
+  stm->wrpStart = 0x400;
+  stm->wrpEnd = 0x800;
+  static uint8_t data[2048];
+  fill(data, sizeof(data), 5);
+  beginOk(false);
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE, data, sizeof(data)));
+  uint32_t sr;
+  TEST_ASSERT_TRUE(loader->end(sr));
+  TEST_ASSERT_EQUAL_HEX32(0x10, sr); // WRPRTERR
+  TEST_ASSERT_EQUAL_HEX32(STM32_STATE_ERROR | 0x10, sramWord(STATE1));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, stm->flash.data(), 1024);
+  TEST_ASSERT_EACH_EQUAL_HEX8(0xFF, &stm->flash[0x400], 1024);
+  assertCleanRun();
+}
+
+void test_error_stops_writes() {
+  // F1 will not program over data: PGERR on the first halfword
+  attach(sim::Stm32Target::Family::F1, 64);
+  stm->flash[0] = 0x00;
+  static uint8_t data[1024];
+  fill(data, sizeof(data), 9);
+  beginOk(false);
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE, data, sizeof(data)));
+  TEST_ASSERT_TRUE(loader->write(STM32_FLASH_BASE + 1024, data, 1024));
+  // Descriptor 0 is needed again: its error surfaces here
+  TEST_ASSERT_FALSE(loader->write(STM32_FLASH_BASE + 2048, data, 1024));
+  TEST_ASSERT_FALSE(loader->write(STM32_FLASH_BASE + 3072, data, 1024));
+  uint32_t sr;
+  TEST_ASSERT_TRUE(loader->end(sr));
+  TEST_ASSERT_EQUAL_HEX32(0x04, sr); // PGERR
+  TEST_ASSERT_EQUAL(0, stm->programmed);
+  assertCleanRun();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_link);
+  RUN_TEST(test_unsupported);
+  RUN_TEST(test_f1_program);
+  RUN_TEST(test_f4_program);
+  RUN_TEST(test_end_drains_in_order);
+  RUN_TEST(test_write_protect_error);
+  RUN_TEST(test_error_stops_writes);
+  return UNITY_END();
+}
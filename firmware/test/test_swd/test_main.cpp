@@ -0,0 +1,269 @@
+// PIO SWD PHY and SWDDriver against the bit-level target model (sim_swd.h)
+#include <sim_swd.h>
+#include <unity.h>
+
+#include "pio_swd.cpp"
+#include "swd_driver.cpp"
+
+#define SRAM 0x20000000
+
+static sim::SwdRam *ram;
+static sim::SwdTarget *target;
+static sim::PioSwdLink *link;
+static SWDDriver *swd;
+
+void setUp() {
+  sim::reset();
+  ram = new sim::SwdRam();
+  ram->add(SRAM, 0x2000);
+  target = new sim::SwdTarget();
+  target->memory = ram;
+  link = new sim::PioSwdLink(*target);
+  sim::attachPio(*link);
+  swd = new SWDDriver();
+}
+
+void tearDown() {
+  delete swd;
+  delete link;
+  delete target;
+  delete ram;
+}
+
+static void assertCleanWire() {
+  TEST_ASSERT_EQUAL(0, target->violations);
+  TEST_ASSERT_EQUAL(0, target->protocolErrors);
+  TEST_ASSERT_EQUAL_HEX32(0, target->ctrlStat() & sim::SwdTarget::WDATAERR);
+}
+
+void test_not_initialised() {
+  // Nothing reaches the (unclaimed) state machine before SWD_INIT
+  uint32_t v = 0x12345678;
+  uint8_t buf[8];
+  TEST_ASSERT_FALSE(swd->isActive());
+  TEST_ASSERT_FALSE(swd->readDP(SWD_DP_IDCODE, &v));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(SwdAck::NO_RESPONSE),
+                    static_cast<uint8_t>(swd->getLastAck()));
+  TEST_ASSERT_FALSE(swd->writeAP(SWD_MEM_AP, SWD_AP_TAR, SRAM));
+  TEST_ASSERT_FALSE(swd->memRead(SRAM, buf, sizeof(buf), 4));
+  TEST_ASSERT_FALSE(swd->memWrite(SRAM, buf, 0, 4));
+  TEST_ASSERT_EQUAL(0, target->cycles);
+  TEST_ASSERT_EQUAL(0, link->txOverflows);
+}
+
+void test_init() {
+  TEST_ASSERT_EQUAL_HEX32(0x2BA01477, swd->init());
+  TEST_ASSERT_TRUE(target->swdMode());
+  TEST_ASSERT_EQUAL(2, target->lineResets);
+  // Debug and system power-up acknowledged
+  TEST_ASSERT_EQUAL_HEX32(0xF0000000, target->ctrlStat() & 0xF0000000);
+  assertCleanWire();
+}
+
+void test_no_switch() {
+  // Without the JTAG-to-SWD sequence the target never answers
+  swd->begin();
+  uint32_t v;
+  TEST_ASSERT_FALSE(swd->readDP(SWD_DP_IDCODE, &v));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(SwdAck::NO_RESPONSE),
+                    static_cast<uint8_t>(swd->getLastAck()));
+  TEST_ASSERT_FALSE(target->swdMode());
+}
+
+void test_register_access() {
+  TEST_ASSERT_TRUE(swd->init());
+  uint32_t v;
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_CSW, 0x23000012));
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_TAR, 0x20000010));
+  TEST_ASSERT_TRUE(swd->readAP(SWD_MEM_AP, SWD_AP_TAR, &v));
+  TEST_ASSERT_EQUAL_HEX32(0x20000010, v);
+  TEST_ASSERT_TRUE(swd->readAP(SWD_MEM_AP, 0xFC, &v)); // IDR, bank 0xF
+  TEST_ASSERT_EQUAL_HEX32(0x24770011, v);
+  // Data of both parities in both directions
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_DRW, 0x00000001));
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_DRW, 0x00000003));
+  TEST_ASSERT_TRUE(swd->readDP(SWD_DP_CTRL_STAT, &v));
+  TEST_ASSERT_EQUAL_HEX8(1, ram->at(0x20000010, 4)[0]);
+  TEST_ASSERT_EQUAL_HEX8(3, ram->at(0x20000014, 4)[0]);
+  TEST_ASSERT_EQUAL_HEX32(0x20000018, target->tar());
+  assertCleanWire();
+}
+
+void test_wait_retried() {
+  TEST_ASSERT_TRUE(swd->init());
+  target->waitCount = 5;
+  uint32_t v;
+  TEST_ASSERT_TRUE(swd->readAP(SWD_MEM_AP, 0xFC, &v));
+  TEST_ASSERT_EQUAL_HEX32(0x24770011, v);
+  TEST_ASSERT_EQUAL(0, target->waitCount);
+  assertCleanWire();
+}
+
+void test_read_parity_error() {
+  TEST_ASSERT_TRUE(swd->init());
+  target->badReadParity = 1;
+  uint32_t v;
+  TEST_ASSERT_FALSE(swd->readDP(SWD_DP_CTRL_STAT, &v));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(SwdAck::PARITY),
+                    static_cast<uint8_t>(swd->getLastAck()));
+  TEST_ASSERT_TRUE(swd->readDP(SWD_DP_CTRL_STAT, &v));
+  assertCleanWire();
+}
+
+void test_fault_cleared() {
+  TEST_ASSERT_TRUE(swd->init());
+  // A bus error leaves STICKYERR set: the next AP access is FAULTed, the
+  // driver writes ABORT and the one after that goes through
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_TAR, 0x40000000));
+  TEST_ASSERT_TRUE(swd->writeAP(SWD_MEM_AP, SWD_AP_DRW, 0));
+  uint32_t v;
+  TEST_ASSERT_FALSE(swd->readAP(SWD_MEM_AP, SWD_AP_CSW, &v));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(SwdAck::FAULT),
+                    static_cast<uint8_t>(swd->getLastAck()));
+  TEST_ASSERT_TRUE(swd->readAP(SWD_MEM_AP, SWD_AP_CSW, &v));
+  TEST_ASSERT_EQUAL_HEX32(0, target->ctrlStat() & sim::SwdTarget::STICKYERR);
+  assertCleanWire();
+}
+
+void test_memory_round_trip() {
+  // Word accesses across the 1KB auto-increment boundary
+  uint8_t data[64], back[64];
+  for (unsigned i = 0; i < sizeof(data); i++)
+    data[i] = i * 13 + 1;
+  TEST_ASSERT_TRUE(swd->init());
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM + 0x3E0, data, sizeof(data), 4));
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 0x3E0, back, sizeof(back), 4));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, ram->at(SRAM + 0x3E0, 64), 64);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, back, sizeof(back));
+  assertCleanWire();
+}
+
+// Transfers in the target log since `from` matching AP/DP, direction and
+// register
+static unsigned count(size_t from, bool ap, bool read, uint8_t addr) {
+  unsigned n = 0;
+  for (size_t i = from; i < target->log.size(); i++) {
+    const sim::SwdTarget::Transfer &t = target->log[i];
+    if (t.ap == ap && t.read == read && t.addr == addr && t.ack == 1)
+      n++;
+  }
+  return n;
+}
+
+void test_mem_state_cached() {
+  uint8_t buf[64];
+  TEST_ASSERT_TRUE(swd->init());
+  TEST_ASSERT_TRUE(swd->memRead(SRAM, buf, 32, 4));
+  // Same CSW, TAR continues where the last run stopped: only DRW / RDBUFF
+  size_t from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 32, buf, 32, 4));
+  TEST_ASSERT_EQUAL(0, count(from, false, false, SWD_DP_SELECT));
+  TEST_ASSERT_EQUAL(0, count(from, true, false, SWD_AP_CSW));
+  TEST_ASSERT_EQUAL(0, count(from, true, false, SWD_AP_TAR));
+  TEST_ASSERT_EQUAL(8, count(from, true, true, SWD_AP_DRW));
+  TEST_ASSERT_EQUAL(1, count(from, false, true, SWD_DP_RDBUFF));
+
+  // A write elsewhere only sends the new TAR
+  from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM + 0x100, buf, 16, 4));
+  TEST_ASSERT_EQUAL(0, count(from, false, false, SWD_DP_SELECT));
+  TEST_ASSERT_EQUAL(0, count(from, true, false, SWD_AP_CSW));
+  TEST_ASSERT_EQUAL(1, count(from, true, false, SWD_AP_TAR));
+  TEST_ASSERT_EQUAL(4, count(from, true, false, SWD_AP_DRW));
+  assertCleanWire();
+}
+
+void test_mem_block_split() {
+  // 0x3F0..0x40F: two runs, TAR set at the start of each
+  uint8_t data[32], back[32];
+  for (unsigned i = 0; i < sizeof(data); i++)
+    data[i] = 0xA0 + i;
+  TEST_ASSERT_TRUE(swd->init());
+  size_t from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM + 0x3F0, data, sizeof(data), 4));
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 0x3F0, back, sizeof(back), 4));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, back, sizeof(back));
+  TEST_ASSERT_EQUAL(4, count(from, true, false, SWD_AP_TAR));
+  TEST_ASSERT_EQUAL(2, count(from, false, true, SWD_DP_RDBUFF));
+  TEST_ASSERT_EQUAL(8, count(from, true, true, SWD_AP_DRW));
+  assertCleanWire();
+}
+
+void test_mem_packed() {
+  // Unaligned head byte by byte, packed words, then the tail byte by byte
+  uint8_t data[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9}, back[9];
+  TEST_ASSERT_TRUE(swd->init());
+  size_t from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM + 0x101, data, sizeof(data), 1));
+  TEST_ASSERT_EQUAL(3 + 1 + 2, count(from, true, false, SWD_AP_DRW));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, ram->at(SRAM + 0x101, 9), 9);
+  TEST_ASSERT_EQUAL_HEX8(0, ram->at(SRAM + 0x100, 1)[0]);
+  TEST_ASSERT_EQUAL_HEX8(0, ram->at(SRAM + 0x10A, 1)[0]);
+
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 0x101, back, sizeof(back), 1));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, back, sizeof(back));
+
+  // Halfwords: one DRW access per word
+  from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 0x100, back, 8, 2));
+  TEST_ASSERT_EQUAL(2, count(from, true, true, SWD_AP_DRW));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ram->at(SRAM + 0x100, 8), back, 8);
+  assertCleanWire();
+}
+
+void test_mem_unpacked() {
+  // An AP without packed transfers gets one access per halfword
+  target->packedSupported = false;
+  uint8_t data[8] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+  uint8_t back[8];
+  TEST_ASSERT_TRUE(swd->init());
+  size_t from = target->log.size();
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM + 0x200, data, sizeof(data), 2));
+  TEST_ASSERT_EQUAL(4, count(from, true, false, SWD_AP_DRW));
+  TEST_ASSERT_TRUE(swd->memRead(SRAM + 0x200, back, sizeof(back), 2));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, back, sizeof(back));
+  assertCleanWire();
+}
+
+void test_mem_bus_error() {
+  // The failing access is the last of the block: only CTRL/STAT shows it
+  uint8_t buf[8] = {0};
+  TEST_ASSERT_TRUE(swd->init());
+  TEST_ASSERT_FALSE(swd->memRead(SRAM + 0x2000 - 4, buf, 8, 4));
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(SwdAck::FAULT),
+                    static_cast<uint8_t>(swd->getLastAck()));
+  TEST_ASSERT_FALSE(swd->memWrite(0x40000000, buf, 4, 4));
+
+  // Cleared: the next block goes through
+  TEST_ASSERT_TRUE(swd->memWrite(SRAM, buf, 8, 4));
+  TEST_ASSERT_EQUAL_HEX32(0, target->ctrlStat() & sim::SwdTarget::STICKYERR);
+  assertCleanWire();
+}
+
+void test_clock_change() {
+  TEST_ASSERT_FALSE(swd->setClock(SWD_CLOCK_MIN - 1));
+  TEST_ASSERT_FALSE(swd->setClock(SWD_CLOCK_MAX + 1));
+  TEST_ASSERT_TRUE(swd->setClock(SWD_CLOCK_MAX));
+  TEST_ASSERT_EQUAL_HEX32(0x2BA01477, swd->init());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 2.0f, link->config.clkdiv);
+  assertCleanWire();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_not_initialised);
+  RUN_TEST(test_init);
+  RUN_TEST(test_no_switch);
+  RUN_TEST(test_register_access);
+  RUN_TEST(test_wait_retried);
+  RUN_TEST(test_read_parity_error);
+  RUN_TEST(test_fault_cleared);
+  RUN_TEST(test_memory_round_trip);
+  RUN_TEST(test_mem_state_cached);
+  RUN_TEST(test_mem_block_split);
+  RUN_TEST(test_mem_packed);
+  RUN_TEST(test_mem_unpacked);
+  RUN_TEST(test_mem_bus_error);
+  RUN_TEST(test_clock_change);
+  return UNITY_END();
+}
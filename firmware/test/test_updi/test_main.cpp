@@ -0,0 +1,191 @@
+// UPDI driver against the simulated tinyAVR responder (sim_updi.h)
+#include <sim_updi.h>
+#include <unity.h>
+
+#include "updi_driver.cpp"
+
+static sim::UpdiTarget *target;
+static UPDIDriver *updi;
+
+void setUp() {
+  sim::reset();
+  target = new sim::UpdiTarget();
+  sim::attachUart(uart1, *target, true);
+  updi = new UPDIDriver();
+  updi->begin();
+}
+
+void tearDown() {
+  delete updi;
+  delete target;
+}
+
+static sim::UartState &line() { return sim::uartState(uart1); }
+
+static void assertCleanLink() {
+  TEST_ASSERT_EQUAL(0, target->protocolErrors);
+  TEST_ASSERT_EQUAL(0, target->violations);
+  TEST_ASSERT_EQUAL(0, target->tooFast);
+  TEST_ASSERT_EQUAL(0, line().collisions);
+  TEST_ASSERT_EQUAL(0, line().overruns);
+  TEST_ASSERT_EQUAL(0, line().writesDisabled);
+}
+
+void test_enter() {
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  TEST_ASSERT_TRUE(updi->isActive());
+  TEST_ASSERT_TRUE(target->nvmProg);
+  TEST_ASSERT_EQUAL_MEMORY(target->sib, updi->getSib(), 16);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiNvm::V0),
+                    static_cast<uint8_t>(updi->getNvm()));
+  // 8E2
+  TEST_ASSERT_EQUAL(8, line().dataBits);
+  TEST_ASSERT_EQUAL(2, line().stopBits);
+  TEST_ASSERT_EQUAL(UART_PARITY_EVEN, line().parity);
+  assertCleanLink();
+}
+
+void test_no_target() {
+  target->present = false;
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::NO_LINK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  TEST_ASSERT_FALSE(updi->isActive());
+}
+
+void test_fast_link() {
+  // Above 225 kbaud the UPDI clock goes up before the host speeds up
+  for (unsigned i = 0; i < target->flash.size(); i++)
+    target->flash[i] = i * 5 + 1;
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(400000)));
+  TEST_ASSERT_EQUAL_HEX8(0x02, target->asiCtrla); // 8 MHz
+  TEST_ASSERT_EQUAL(400000, line().baud);
+
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_MAX)));
+  TEST_ASSERT_EQUAL_HEX8(0x01, target->asiCtrla); // 16 MHz
+  TEST_ASSERT_EQUAL(UPDI_BAUD_MAX, line().baud);
+  static uint8_t buf[512];
+  TEST_ASSERT_TRUE(updi->read(0x8000, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(target->flash.data(), buf, sizeof(buf));
+  assertCleanLink();
+}
+
+void test_read_bursts() {
+  // 601 bytes: REPEAT bursts of 256 and 44 words, then a single byte
+  for (unsigned i = 0; i < target->flash.size(); i++)
+    target->flash[i] = i * 7 + (i >> 8);
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  static uint8_t buf[601];
+  TEST_ASSERT_TRUE(updi->read(0x8000 + 0x100, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(&target->flash[0x100], buf, sizeof(buf));
+  TEST_ASSERT_EQUAL(2, target->bursts.size());
+  TEST_ASSERT_EQUAL(255, target->bursts[0]);
+  TEST_ASSERT_EQUAL(43, target->bursts[1]);
+  assertCleanLink();
+}
+
+void test_page_write() {
+  uint8_t page[64];
+  for (unsigned i = 0; i < sizeof(page); i++)
+    page[i] = 0xC3 ^ i;
+  uint32_t busyUs = 0;
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  TEST_ASSERT_TRUE(updi->writePage(0x8040, page, sizeof(page), false, true,
+                                   busyUs));
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(page, &target->flash[0x40], sizeof(page));
+  TEST_ASSERT_EACH_EQUAL_HEX8(0xFF, &target->flash[0x80], 64);
+  // Page buffer cleared, one burst without ACKs, erase-write
+  TEST_ASSERT_EQUAL(2, target->commands.size());
+  TEST_ASSERT_EQUAL(sim::UpdiTarget::CMD_PBC, target->commands[0].cmd);
+  TEST_ASSERT_EQUAL(sim::UpdiTarget::CMD_ERWP, target->commands[1].cmd);
+  TEST_ASSERT_EQUAL_HEX32(0x8040, target->commands[1].page);
+  TEST_ASSERT_EQUAL(1, target->bursts.size());
+  TEST_ASSERT_EQUAL(31, target->bursts[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x80, target->ctrla); // RSD off again
+  TEST_ASSERT_GREATER_OR_EQUAL(target->nvmBusyUs, busyUs);
+  assertCleanLink();
+}
+
+void test_eeprom_write() {
+  // Odd length: word burst plus a single byte store
+  const uint8_t data[5] = {1, 2, 3, 4, 5};
+  uint32_t busyUs;
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  TEST_ASSERT_TRUE(updi->writePage(0x1400 + 0x20, data, sizeof(data), true,
+                                   false, busyUs));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, &target->eeprom[0x20], sizeof(data));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, target->eeprom[0x25]);
+  assertCleanLink();
+}
+
+void test_locked_chip_erase() {
+  target->locked = true;
+  target->flash[0] = 0x12;
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::LOCKED),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  TEST_ASSERT_FALSE(updi->isActive());
+  TEST_ASSERT_TRUE(updi->chipErase());
+  TEST_ASSERT_TRUE(updi->isActive());
+  TEST_ASSERT_EQUAL(1, target->chipErases);
+  TEST_ASSERT_FALSE(target->locked);
+  TEST_ASSERT_TRUE(target->nvmProg);
+  TEST_ASSERT_EACH_EQUAL_HEX8(0xFF, target->flash.data(), 16);
+  assertCleanLink();
+}
+
+void test_exit() {
+  TEST_ASSERT_EQUAL(static_cast<uint8_t>(UpdiEnterStatus::OK),
+                    static_cast<uint8_t>(updi->enterProgrammingMode(
+                        UPDI_BAUD_DEFAULT)));
+  updi->endProgrammingMode();
+  TEST_ASSERT_FALSE(updi->isActive());
+  TEST_ASSERT_FALSE(target->nvmProg);
+  TEST_ASSERT_EQUAL(1, target->appResets);
+  TEST_ASSERT_TRUE(target->disabled);
+  TEST_ASSERT_FALSE(line().enabled);
+
+  // Link closed: a second exit and a chip erase stay off the UART
+  unsigned seen = target->bytes;
+  updi->endProgrammingMode();
+  TEST_ASSERT_FALSE(updi->chipErase());
+  TEST_ASSERT_EQUAL(seen, target->bytes);
+  assertCleanLink();
+}
+
+void test_closed_link() {
+  // UPDI_EXIT / UPDI_CHIP_ERASE before UPDI_ENTER: UART1 never touched
+  updi->endProgrammingMode();
+  TEST_ASSERT_FALSE(updi->chipErase());
+  uint8_t b;
+  TEST_ASSERT_FALSE(updi->read(0x8000, &b, 1));
+  TEST_ASSERT_EQUAL(0, target->bytes);
+  TEST_ASSERT_FALSE(line().enabled);
+  assertCleanLink();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_enter);
+  RUN_TEST(test_no_target);
+  RUN_TEST(test_fast_link);
+  RUN_TEST(test_read_bursts);
+  RUN_TEST(test_page_write);
+  RUN_TEST(test_eeprom_write);
+  RUN_TEST(test_locked_chip_erase);
+  RUN_TEST(test_exit);
+  RUN_TEST(test_closed_link);
+  return UNITY_END();
+}
@@ -40,7 +40,7 @@ export const STM32OptionBytes: React.FC<STM32OptionBytesProps> = ({
             await serialManager.sendCommand(CMD.SWD_INIT);
 
             // Configure MEM-AP
-            const csw = new Uint8Array([0, 0x00, 0x00, 0x00, 0x00, 0x52, 0x00, 0x00, 0x23]);
+            const csw = new Uint8Array([1, 0x00, 0x00, 0x00, 0x00, 0x52, 0x00, 0x00, 0x23]);
             await serialManager.sendCommand(CMD.SWD_WRITE, csw);
 
             // Read Option Bytes from 0x1FFFF800 (Flash Option Bytes base for STM32F1)
@@ -49,10 +49,10 @@ export const STM32OptionBytes: React.FC<STM32OptionBytesProps> = ({
             // Read RDP (offset 0x00)
             const readWord = async (offset: number) => {
                 const addr = baseAddr + offset;
-                const tar = new Uint8Array([0, 0x04, 0x00, 0x00, 0x00, addr & 0xFF, (addr >> 8) & 0xFF, (addr >> 16) & 0xFF, (addr >> 24) & 0xFF]);
+                const tar = new Uint8Array([1, 0x04, 0x00, 0x00, 0x00, addr & 0xFF, (addr >> 8) & 0xFF, (addr >> 16) & 0xFF, (addr >> 24) & 0xFF]);
                 await serialManager.sendCommand(CMD.SWD_WRITE, tar);
 
-                const drw = new Uint8Array([0, 0x0C, 0x00, 0x00, 0x00]);
+                const drw = new Uint8Array([1, 0x0C, 0x00, 0x00, 0x00]);
                 const resp = await serialManager.sendCommand(CMD.SWD_READ, drw);
 
                 return resp[0] | (resp[1] << 8) | (resp[2] << 16) | (resp[3] << 24);
@@ -2,7 +2,7 @@ import { QSPIMode } from './opup';
 
 export interface ChipDef {
     name: string;
-    type: 'I2C' | 'SPI' | 'AVR' | 'STM32';
+    type: 'I2C' | 'SPI' | 'NAND' | 'AVR' | 'STM32';
     size: number; // in bytes
     pageSize: number; // in bytes
     address?: number; // I2C address
@@ -10,6 +10,11 @@ export interface ChipDef {
     // QSPI capabilities (for SPI Flash only)
     qspiModes?: QSPIMode[]; // Supported QSPI modes
     jedecId?: number; // JEDEC manufacturer ID (e.g., 0xEF for Winbond)
+
+    // SPI NAND geometry (size and pageSize cover the main area only)
+    spareSize?: number; // Spare (OOB) bytes per page
+    pagesPerBlock?: number;
+    planes?: number;
 }
 
 export const CHIP_DB: ChipDef[] = [
@@ -85,6 +90,15 @@ export const CHIP_DB: ChipDef[] = [
     { name: '25Q64', type: 'SPI', size: 8 * 1024 * 1024, pageSize: 256, qspiModes: [QSPIMode.STANDARD] },
     { name: '25Q128', type: 'SPI', size: 16 * 1024 * 1024, pageSize: 256, qspiModes: [QSPIMode.STANDARD] },
 
+    // SPI NAND - Winbond W25N / GigaDevice GD5F / Micron MT29F (NAND_* engine)
+    { name: 'W25N01GV', type: 'NAND', size: 128 * 1024 * 1024, pageSize: 2048, jedecId: 0xEF, spareSize: 64, pagesPerBlock: 64, planes: 1 },
+    { name: 'W25N02KV', type: 'NAND', size: 256 * 1024 * 1024, pageSize: 2048, jedecId: 0xEF, spareSize: 128, pagesPerBlock: 64, planes: 1 },
+    { name: 'GD5F1GQ4U', type: 'NAND', size: 128 * 1024 * 1024, pageSize: 2048, jedecId: 0xC8, spareSize: 128, pagesPerBlock: 64, planes: 1 },
+    { name: 'GD5F2GQ4U', type: 'NAND', size: 256 * 1024 * 1024, pageSize: 2048, jedecId: 0xC8, spareSize: 128, pagesPerBlock: 64, planes: 1 },
+    { name: 'GD5F1GQ5U', type: 'NAND', size: 128 * 1024 * 1024, pageSize: 2048, jedecId: 0xC8, spareSize: 128, pagesPerBlock: 64, planes: 1 },
+    { name: 'MT29F1G01ABAFD', type: 'NAND', size: 128 * 1024 * 1024, pageSize: 2048, jedecId: 0x2C, spareSize: 128, pagesPerBlock: 64, planes: 1 },
+    { name: 'MT29F2G01ABAGD', type: 'NAND', size: 256 * 1024 * 1024, pageSize: 2048, jedecId: 0x2C, spareSize: 128, pagesPerBlock: 64, planes: 2 },
+
     // AVR Microcontrollers
     { name: 'ATmega328P', type: 'AVR', size: 32 * 1024, pageSize: 128 },
     { name: 'ATmega168', type: 'AVR', size: 16 * 1024, pageSize: 128 },
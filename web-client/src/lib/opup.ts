@@ -12,6 +12,9 @@ export enum OpupCmd {
     I2C_SCAN = 0x10,
     I2C_READ = 0x11,
     I2C_WRITE = 0x12,
+    I2C_EEPROM_WRITE = 0x13, // Page writes with ACK polling
+    I2C_WRITE_READ = 0x14,   // Memory address + repeated start read
+    I2C_SET_SPEED = 0x15,    // SCL frequency (up to 1 MHz Fm+)
 
     SPI_SCAN = 0x20,
     SPI_CONFIG = 0x21,